@@ -1,3 +1,8 @@
+newoption {
+	trigger = "profile",
+	description = "Compile the profiler (--profile <path>) into release builds"
+}
+
 workspace "heightmap"
 	language "C++"
 	cppdialect "C++17"
@@ -31,6 +36,7 @@ workspace "heightmap"
 		links "dl"
 		links "GL"
 		links "GLX"
+		links "EGL"
 	
 	filter "system:windows"
 		links { "opengl32", "gdi32" }
@@ -50,12 +56,15 @@ workspace "heightmap"
 	--configurations
 	filter "debug"
 		symbols "On"
-		defines { "_DEBUG=1" }
+		defines { "_DEBUG=1", "HEIGHTMAP_PROFILE=1" }
 
 	filter "release"
 		optimize "On"
 		defines { "NDEBUG=1" }
 
+	filter { "release", "options:profile" }
+		defines { "HEIGHTMAP_PROFILE=1" }
+
 	filter "*"
 
 -- Third party dependencies
@@ -0,0 +1,208 @@
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+
+#include "bench.hpp"
+
+GpuTimer::GpuTimer(const unsigned int slots) : slots(slots) {
+}
+
+void GpuTimer::begin(const std::size_t frame) {
+    if (queries.empty()) {
+        queries.resize(slots);
+        glGenQueries(static_cast<GLsizei>(slots), &queries[0]);
+    }
+    // Every query busy: wait for the oldest
+    if (inFlight.size() == slots) {
+        resolveOldest();
+    }
+
+    const GLuint query = queries[nextSlot];
+    nextSlot = (nextSlot + 1) % slots;
+    inFlight.emplace_back(frame, query);
+    glBeginQuery(GL_TIME_ELAPSED, query);
+}
+
+void GpuTimer::end() {
+    glEndQuery(GL_TIME_ELAPSED);
+}
+
+void GpuTimer::finish() {
+    while (!inFlight.empty()) {
+        resolveOldest();
+    }
+}
+
+double GpuTimer::milliseconds(const std::size_t frame) const {
+    return frame < results.size() ? results[frame] : -1.0;
+}
+
+void GpuTimer::destroy() {
+    if (!queries.empty()) {
+        glDeleteQueries(static_cast<GLsizei>(queries.size()), &queries[0]);
+        queries.clear();
+    }
+    inFlight.clear();
+}
+
+void GpuTimer::resolveOldest() {
+    const auto [frame, query] = inFlight.front();
+    inFlight.pop_front();
+
+    GLuint64 nanoseconds = 0;
+    glGetQueryObjectui64v(query, GL_QUERY_RESULT, &nanoseconds);
+    if (results.size() <= frame) {
+        results.resize(frame + 1, -1.0);
+    }
+    results[frame] = static_cast<double>(nanoseconds) * 1e-6;
+}
+
+static bool endsWith(const std::string& text, const std::string& suffix) {
+    return text.size() >= suffix.size() && text.compare(text.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+static std::string escapeJSON(const std::string& text) {
+    std::string escaped;
+    for (const char c : text) {
+        if (c == '"' || c == '\\') {
+            escaped += '\\';
+        }
+        escaped += static_cast<unsigned char>(c) < 0x20 ? ' ' : c;
+    }
+    return escaped;
+}
+
+bool writeBenchResults(const std::string& path, const BenchInfo& info, const std::vector<BenchFrame>& frames) {
+    std::ofstream file(path);
+    if (!file.is_open()) {
+        std::cerr << "Benchmark results " << path << " could not be written" << std::endl;
+        return false;
+    }
+    file << std::fixed << std::setprecision(4);
+
+    if (!endsWith(path, ".json")) {
+        file << "frame,cpu_ms,gpu_ms,frame_ms,draw_calls,vertices,triangles,tiles_tested,tiles_culled,tiles_drawn"
+             << std::endl;
+        for (std::size_t i = 0; i < frames.size(); i++) {
+            const BenchFrame& frame = frames[i];
+            file << i << "," << frame.cpuMilliseconds << "," << frame.gpuMilliseconds << ","
+                 << frame.frameMilliseconds << "," << frame.stats.drawCalls << "," << frame.stats.vertices << ","
+                 << frame.stats.triangles << "," << frame.stats.tilesTested << "," << frame.stats.tilesCulled << ","
+                 << frame.stats.tilesDrawn << std::endl;
+        }
+        return file.good();
+    }
+
+    file << "{" << std::endl
+         << "  \"renderer\": \"" << escapeJSON(info.renderer) << "\"," << std::endl
+         << "  \"mode\": \"" << escapeJSON(info.mode) << "\"," << std::endl
+         << "  \"points\": " << info.nPoints << "," << std::endl
+         << "  \"width\": " << info.width << "," << std::endl
+         << "  \"height\": " << info.height << "," << std::endl
+         << "  \"frames\": [" << std::endl;
+    for (std::size_t i = 0; i < frames.size(); i++) {
+        const BenchFrame& frame = frames[i];
+        file << "    {\"frame\": " << i << ", \"cpu_ms\": " << frame.cpuMilliseconds << ", \"gpu_ms\": "
+             << frame.gpuMilliseconds << ", \"frame_ms\": " << frame.frameMilliseconds << ", \"draw_calls\": "
+             << frame.stats.drawCalls << ", \"vertices\": " << frame.stats.vertices << ", \"triangles\": "
+             << frame.stats.triangles << ", \"tiles_tested\": " << frame.stats.tilesTested << ", \"tiles_culled\": "
+             << frame.stats.tilesCulled << ", \"tiles_drawn\": " << frame.stats.tilesDrawn << "}"
+             << (i + 1 < frames.size() ? "," : "") << std::endl;
+    }
+    file << "  ]" << std::endl << "}" << std::endl;
+    return file.good();
+}
+
+// Mean, median, 95th percentile & maximum of one timing over every frame
+static void printTimingRow(const char* name, const std::vector<BenchFrame>& frames,
+                           const std::function<double(const BenchFrame&)>& timing) {
+    std::vector<double> values;
+    for (const auto& frame : frames) {
+        if (timing(frame) >= 0.0) {
+            values.push_back(timing(frame));
+        }
+    }
+    if (values.empty()) {
+        std::cout << "  " << name << "  unavailable" << std::endl;
+        return;
+    }
+    std::sort(values.begin(), values.end());
+
+    double sum = 0.0;
+    for (const double value : values) {
+        sum += value;
+    }
+    // Nearest rank
+    const auto percentile = [&values](const double p) {
+        const auto rank = static_cast<std::size_t>(std::ceil(p * static_cast<double>(values.size())));
+        return values[std::max<std::size_t>(rank, 1) - 1];
+    };
+    std::cout << "  " << name << std::setw(10) << sum / static_cast<double>(values.size()) << std::setw(10)
+              << percentile(0.5) << std::setw(10) << percentile(0.95) << std::setw(10) << values.back() << std::endl;
+}
+
+void printBenchSummary(const BenchInfo& info, const std::vector<BenchFrame>& frames) {
+    std::size_t drawCalls = 0;
+    std::size_t triangles = 0;
+    for (const auto& frame : frames) {
+        drawCalls += frame.stats.drawCalls;
+        triangles += frame.stats.triangles;
+    }
+    const auto count = static_cast<double>(std::max<std::size_t>(frames.size(), 1));
+
+    std::cout << frames.size() << " frames, " << info.mode << ", " << info.width << " x " << info.height << " on "
+              << info.renderer << std::endl
+              << std::fixed << std::setprecision(2) << "  " << drawCalls / count << " draws, " << triangles / count
+              << " triangles per frame" << std::endl
+              << "  ms           mean    median       p95       max" << std::endl;
+    printTimingRow("cpu  ", frames, [](const BenchFrame& frame) { return frame.cpuMilliseconds; });
+    printTimingRow("gpu  ", frames, [](const BenchFrame& frame) { return frame.gpuMilliseconds; });
+    printTimingRow("frame", frames, [](const BenchFrame& frame) { return frame.frameMilliseconds; });
+}
+
+void FrameTimeStats::addFrame(const double frameMilliseconds) {
+    if (milliseconds.size() < maxFrameTimes) {
+        milliseconds.push_back(static_cast<float>(frameMilliseconds));
+        return;
+    }
+    milliseconds[next] = static_cast<float>(frameMilliseconds);
+    next = (next + 1) % maxFrameTimes;
+}
+
+std::size_t FrameTimeStats::size() const {
+    return milliseconds.size();
+}
+
+void FrameTimeStats::print(const std::string& title) const {
+    if (milliseconds.empty()) {
+        return;
+    }
+    // Consecutive frames, oldest first
+    double sum = 0.0;
+    double change = 0.0;
+    for (std::size_t i = 0; i < milliseconds.size(); i++) {
+        const float current = milliseconds[(next + i) % milliseconds.size()];
+        sum += current;
+        if (i > 0) {
+            change += std::abs(current - milliseconds[(next + i - 1) % milliseconds.size()]);
+        }
+    }
+    std::vector<float> sorted = milliseconds;
+    std::sort(sorted.begin(), sorted.end());
+    // Nearest rank
+    const auto percentile = [&sorted](const double p) {
+        const auto rank = static_cast<std::size_t>(std::ceil(p * static_cast<double>(sorted.size())));
+        return sorted[std::max<std::size_t>(rank, 1) - 1];
+    };
+
+    const auto count = static_cast<double>(sorted.size());
+    std::cout << title << ", " << sorted.size() << " frames" << std::endl << std::fixed << std::setprecision(2)
+              << "  ms       mean    median       p90       p99     p99.9       max    jitter" << std::endl
+              << "  frame" << std::setw(9) << sum / count << std::setw(10) << percentile(0.5) << std::setw(10)
+              << percentile(0.9) << std::setw(10) << percentile(0.99) << std::setw(10) << percentile(0.999)
+              << std::setw(10) << sorted.back() << std::setw(10)
+              << (sorted.size() > 1 ? change / (count - 1.0) : 0.0) << std::endl;
+}
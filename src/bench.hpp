@@ -0,0 +1,87 @@
+#ifndef BENCH_HPP
+#define BENCH_HPP
+
+#include <cstddef>
+#include <deque>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <GL/glew.h>
+
+#include "render_stats.hpp"
+
+// Timings & submitted work of one benchmark frame
+struct BenchFrame {
+    // Recording the frame's GL commands on the CPU
+    double cpuMilliseconds = 0.0;
+    // GL_TIME_ELAPSED of the frame's commands, negative if unavailable
+    double gpuMilliseconds = -1.0;
+    // Wall time from the start of the frame to the start of the next one
+    double frameMilliseconds = 0.0;
+    RenderStats stats;
+};
+
+// What was benchmarked, written alongside the frames
+struct BenchInfo {
+    std::string renderer;
+    std::string mode;
+    unsigned int nPoints;
+    unsigned int width;
+    unsigned int height;
+};
+
+// GL_TIME_ELAPSED queries of consecutive frames. A few stay in flight so reading results rarely stalls.
+class GpuTimer {
+public:
+    explicit GpuTimer(unsigned int slots = 4);
+    GpuTimer(const GpuTimer&) = delete;
+    GpuTimer& operator=(const GpuTimer&) = delete;
+
+    // Brackets the commands of one frame; frames are numbered from 0
+    void begin(std::size_t frame);
+    void end();
+
+    // Waits for the results of every frame begun
+    void finish();
+
+    // Elapsed GPU time of a frame, negative until its result is read
+    double milliseconds(std::size_t frame) const;
+
+    void destroy();
+
+private:
+    void resolveOldest();
+
+    unsigned int slots;
+    std::vector<GLuint> queries;
+    std::size_t nextSlot = 0;
+    // (frame, query) pairs, oldest first
+    std::deque<std::pair<std::size_t, GLuint>> inFlight;
+    std::vector<double> results;
+};
+
+// Writes per-frame results as JSON if path ends in .json, as CSV otherwise
+bool writeBenchResults(const std::string& path, const BenchInfo& info, const std::vector<BenchFrame>& frames);
+
+// Prints mean & percentiles of the frame timings
+void printBenchSummary(const BenchInfo& info, const std::vector<BenchFrame>& frames);
+
+// Wall time between the frames of an interactive session, for the percentiles of its jitter. Keeps the latest
+// maxFrameTimes frames.
+class FrameTimeStats {
+public:
+    static constexpr std::size_t maxFrameTimes = 1 << 20;
+
+    void addFrame(double milliseconds);
+    std::size_t size() const;
+
+    // Mean, percentiles up to p99.9 and maximum frame time, and the mean change from one frame to the next
+    void print(const std::string& title) const;
+
+private:
+    std::vector<float> milliseconds;
+    std::size_t next = 0;
+};
+
+#endif
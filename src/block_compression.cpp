@@ -0,0 +1,344 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <utility>
+
+#include <glm/glm.hpp>
+
+#include "block_compression.hpp"
+#include "parallel.hpp"
+
+// Block rows encoded per parallelFor chunk at least
+static constexpr std::size_t minBlockRows = 8;
+// Power iterations converging on the principal axis of a block's colours
+static constexpr int axisIterations = 4;
+// BC1 palette weights of end point 0, by index
+static constexpr float bc1Weights[4] = {1.0f, 0.0f, 2.0f / 3.0f, 1.0f / 3.0f};
+
+static std::size_t blockBytes(const TextureCompression compression) {
+    return compression == TextureCompression::BC1 ? 8 : 16;
+}
+
+static std::uint16_t packRGB565(const glm::vec3& colour) {
+    const glm::vec3 c = glm::clamp(colour, 0.0f, 255.0f);
+    const auto r = static_cast<std::uint16_t>(std::lround(c.r * 31.0f / 255.0f));
+    const auto g = static_cast<std::uint16_t>(std::lround(c.g * 63.0f / 255.0f));
+    const auto b = static_cast<std::uint16_t>(std::lround(c.b * 31.0f / 255.0f));
+    return static_cast<std::uint16_t>(r << 11 | g << 5 | b);
+}
+
+// Bit replication, as the hardware expands end points
+static glm::ivec3 unpackRGB565(const std::uint16_t packed) {
+    const int r = packed >> 11 & 31;
+    const int g = packed >> 5 & 63;
+    const int b = packed & 31;
+    return {r << 3 | r >> 2, g << 2 | g >> 4, b << 3 | b >> 2};
+}
+
+static int squaredDistance(const glm::ivec3& a, const glm::ivec3& b) {
+    const glm::ivec3 d = a - b;
+    return d.x * d.x + d.y * d.y + d.z * d.z;
+}
+
+// Four colours when c0 > c1, otherwise three and transparent black
+static void bc1Palette(const std::uint16_t c0, const std::uint16_t c1, glm::ivec3 palette[4]) {
+    palette[0] = unpackRGB565(c0);
+    palette[1] = unpackRGB565(c1);
+    if (c0 > c1) {
+        palette[2] = (2 * palette[0] + palette[1]) / 3;
+        palette[3] = (palette[0] + 2 * palette[1]) / 3;
+    } else {
+        palette[2] = (palette[0] + palette[1]) / 2;
+        palette[3] = glm::ivec3(0);
+    }
+}
+
+// Orders the end points for four colour mode and picks the nearest entry for every pixel.
+// Returns the summed squared error.
+static int fitBC1(std::uint16_t& c0, std::uint16_t& c1, const glm::ivec3 pixels[16], std::uint32_t& indices) {
+    if (c0 < c1) {
+        std::swap(c0, c1);
+    }
+    glm::ivec3 palette[4];
+    bc1Palette(c0, c1, palette);
+    // Equal end points leave three colour mode, where every pixel is index 0 anyway
+    const int entries = c0 > c1 ? 4 : 1;
+
+    indices = 0;
+    int error = 0;
+    for (int i = 0; i < 16; i++) {
+        int best = 0;
+        int bestError = std::numeric_limits<int>::max();
+        for (int entry = 0; entry < entries; entry++) {
+            const int entryError = squaredDistance(pixels[i], palette[entry]);
+            if (entryError < bestError) {
+                best = entry;
+                bestError = entryError;
+            }
+        }
+        indices |= static_cast<std::uint32_t>(best) << (2 * i);
+        error += bestError;
+    }
+    return error;
+}
+
+// End points along the principal axis of the colours, then refitted by least squares to the chosen indices
+static void encodeBC1Block(const glm::ivec3 pixels[16], unsigned char* block) {
+    glm::vec3 mean(0.0f);
+    glm::vec3 lo(255.0f);
+    glm::vec3 hi(0.0f);
+    for (int i = 0; i < 16; i++) {
+        const glm::vec3 pixel(pixels[i]);
+        mean += pixel;
+        lo = glm::min(lo, pixel);
+        hi = glm::max(hi, pixel);
+    }
+    mean /= 16.0f;
+
+    glm::mat3 covariance(0.0f);
+    for (int i = 0; i < 16; i++) {
+        const glm::vec3 d = glm::vec3(pixels[i]) - mean;
+        covariance += glm::mat3(d * d.x, d * d.y, d * d.z);
+    }
+
+    std::uint16_t c0;
+    std::uint16_t c1;
+    glm::vec3 axis = hi - lo;
+    if (glm::length(axis) < 1e-3f) {
+        // Flat block
+        c0 = c1 = packRGB565(mean);
+    } else {
+        // Power iteration, starting from the bounding box diagonal
+        axis = glm::normalize(axis);
+        for (int iteration = 0; iteration < axisIterations; iteration++) {
+            const glm::vec3 next = covariance * axis;
+            if (glm::length(next) < 1e-6f) {
+                break;
+            }
+            axis = glm::normalize(next);
+        }
+        float minT = std::numeric_limits<float>::max();
+        float maxT = -std::numeric_limits<float>::max();
+        for (int i = 0; i < 16; i++) {
+            const float t = glm::dot(glm::vec3(pixels[i]) - mean, axis);
+            minT = std::min(minT, t);
+            maxT = std::max(maxT, t);
+        }
+        // Inset by 1/16 of the range: the extremes are reached by interpolation often enough anyway
+        const float inset = (maxT - minT) / 16.0f;
+        c0 = packRGB565(mean + axis * (maxT - inset));
+        c1 = packRGB565(mean + axis * (minT + inset));
+    }
+
+    std::uint32_t indices;
+    const int error = fitBC1(c0, c1, pixels, indices);
+    if (c0 != c1) {
+        // Normal equations of sum |a * e0 + b * e1 - p|^2 with the weights of the current indices
+        float aa = 0.0f;
+        float ab = 0.0f;
+        float bb = 0.0f;
+        glm::vec3 ap(0.0f);
+        glm::vec3 bp(0.0f);
+        for (int i = 0; i < 16; i++) {
+            const float a = bc1Weights[indices >> (2 * i) & 3];
+            const float b = 1.0f - a;
+            aa += a * a;
+            ab += a * b;
+            bb += b * b;
+            ap += a * glm::vec3(pixels[i]);
+            bp += b * glm::vec3(pixels[i]);
+        }
+        const float determinant = aa * bb - ab * ab;
+        if (std::abs(determinant) > 1e-6f) {
+            std::uint16_t r0 = packRGB565((ap * bb - bp * ab) / determinant);
+            std::uint16_t r1 = packRGB565((bp * aa - ap * ab) / determinant);
+            std::uint32_t refitIndices;
+            if (fitBC1(r0, r1, pixels, refitIndices) < error) {
+                c0 = r0;
+                c1 = r1;
+                indices = refitIndices;
+            }
+        }
+    }
+
+    block[0] = static_cast<unsigned char>(c0 & 0xff);
+    block[1] = static_cast<unsigned char>(c0 >> 8);
+    block[2] = static_cast<unsigned char>(c1 & 0xff);
+    block[3] = static_cast<unsigned char>(c1 >> 8);
+    for (int i = 0; i < 4; i++) {
+        block[4 + i] = static_cast<unsigned char>(indices >> (8 * i) & 0xff);
+    }
+}
+
+// Eight values interpolated between r0 > r1, otherwise six and the extremes
+static void bc4Palette(const int r0, const int r1, int palette[8]) {
+    palette[0] = r0;
+    palette[1] = r1;
+    if (r0 > r1) {
+        for (int k = 2; k < 8; k++) {
+            palette[k] = ((8 - k) * r0 + (k - 1) * r1 + 3) / 7;
+        }
+    } else {
+        for (int k = 2; k < 6; k++) {
+            palette[k] = ((6 - k) * r0 + (k - 1) * r1 + 2) / 5;
+        }
+        palette[6] = 0;
+        palette[7] = 255;
+    }
+}
+
+// Block extremes as end points, eight value mode
+static void encodeBC4Block(const int values[16], unsigned char* block) {
+    const auto [lo, hi] = std::minmax_element(values, values + 16);
+    int palette[8];
+    bc4Palette(*hi, *lo, palette);
+
+    std::uint64_t indices = 0;
+    if (*hi > *lo) {
+        for (int i = 0; i < 16; i++) {
+            int best = 0;
+            for (int entry = 1; entry < 8; entry++) {
+                if (std::abs(values[i] - palette[entry]) < std::abs(values[i] - palette[best])) {
+                    best = entry;
+                }
+            }
+            indices |= static_cast<std::uint64_t>(best) << (3 * i);
+        }
+    }
+
+    block[0] = static_cast<unsigned char>(*hi);
+    block[1] = static_cast<unsigned char>(*lo);
+    for (int i = 0; i < 6; i++) {
+        block[2 + i] = static_cast<unsigned char>(indices >> (8 * i) & 0xff);
+    }
+}
+
+static void decodeBC4Block(const unsigned char* block, int values[16]) {
+    int palette[8];
+    bc4Palette(block[0], block[1], palette);
+    std::uint64_t indices = 0;
+    for (int i = 0; i < 6; i++) {
+        indices |= static_cast<std::uint64_t>(block[2 + i]) << (8 * i);
+    }
+    for (int i = 0; i < 16; i++) {
+        values[i] = palette[indices >> (3 * i) & 7];
+    }
+}
+
+const char* compressionName(const TextureCompression compression) {
+    switch (compression) {
+        case TextureCompression::BC1: return "BC1";
+        case TextureCompression::BC5: return "BC5";
+        default: return "uncompressed";
+    }
+}
+
+GLenum compressedInternalFormat(const TextureCompression compression) {
+    switch (compression) {
+        case TextureCompression::BC1: return GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+        case TextureCompression::BC5: return GL_COMPRESSED_RG_RGTC2;
+        default: return GL_RGB;
+    }
+}
+
+bool compressionSupported(const TextureCompression compression) {
+    if (compression != TextureCompression::BC1 || GLEW_EXT_texture_compression_s3tc) {
+        return true;
+    }
+    // GLEW only finds extensions without entry points in the legacy extension string, absent from core profiles
+    GLint extensionCount = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &extensionCount);
+    for (GLint i = 0; i < extensionCount; i++) {
+        const auto* extension = reinterpret_cast<const char*>(glGetStringi(GL_EXTENSIONS, static_cast<GLuint>(i)));
+        if (std::strcmp(extension, "GL_EXT_texture_compression_s3tc") == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+std::size_t compressedLevelSize(const TextureCompression compression, const int width, const int height) {
+    const auto blocksX = static_cast<std::size_t>((width + 3) / 4);
+    const auto blocksY = static_cast<std::size_t>((height + 3) / 4);
+    return blocksX * blocksY * blockBytes(compression);
+}
+
+CompressedLevel compressLevel(const RowAccessor& row, const int width, const int height, const int channels,
+                              const TextureCompression compression) {
+    CompressedLevel level{width, height, std::vector<unsigned char>(compressedLevelSize(compression, width, height))};
+    const int blocksX = (width + 3) / 4;
+    const int blocksY = (height + 3) / 4;
+    const std::size_t bytes = blockBytes(compression);
+
+    parallelFor(0, blocksY, [&](const std::size_t begin, const std::size_t end) {
+        glm::ivec3 pixels[16];
+        int red[16];
+        int green[16];
+        for (auto by = static_cast<int>(begin); by < static_cast<int>(end); by++) {
+            const unsigned char* rows[4];
+            for (int y = 0; y < 4; y++) {
+                rows[y] = row(std::min(4 * by + y, height - 1));
+            }
+            for (int bx = 0; bx < blocksX; bx++) {
+                for (int i = 0; i < 16; i++) {
+                    const unsigned char* pixel = rows[i / 4] + std::min(4 * bx + i % 4, width - 1) * channels;
+                    pixels[i] = glm::ivec3(pixel[2], pixel[1], pixel[0]);
+                    red[i] = pixel[2];
+                    green[i] = pixel[1];
+                }
+                unsigned char* block = &level.blocks[(static_cast<std::size_t>(by) * blocksX + bx) * bytes];
+                if (compression == TextureCompression::BC1) {
+                    encodeBC1Block(pixels, block);
+                } else {
+                    encodeBC4Block(red, block);
+                    encodeBC4Block(green, block + 8);
+                }
+            }
+        }
+    }, minBlockRows);
+    return level;
+}
+
+std::vector<unsigned char> decompressLevel(const CompressedLevel& level, const TextureCompression compression) {
+    std::vector<unsigned char> pixels(static_cast<std::size_t>(level.width) * level.height * 3);
+    const int blocksX = (level.width + 3) / 4;
+    const int blocksY = (level.height + 3) / 4;
+    const std::size_t bytes = blockBytes(compression);
+
+    glm::ivec3 colours[16];
+    for (int by = 0; by < blocksY; by++) {
+        for (int bx = 0; bx < blocksX; bx++) {
+            const unsigned char* block = &level.blocks[(static_cast<std::size_t>(by) * blocksX + bx) * bytes];
+            if (compression == TextureCompression::BC1) {
+                glm::ivec3 palette[4];
+                bc1Palette(static_cast<std::uint16_t>(block[0] | block[1] << 8),
+                           static_cast<std::uint16_t>(block[2] | block[3] << 8), palette);
+                for (int i = 0; i < 16; i++) {
+                    colours[i] = palette[block[4 + i / 4] >> (2 * (i % 4)) & 3];
+                }
+            } else {
+                int red[16];
+                int green[16];
+                decodeBC4Block(block, red);
+                decodeBC4Block(block + 8, green);
+                for (int i = 0; i < 16; i++) {
+                    colours[i] = glm::ivec3(red[i], green[i], 0);
+                }
+            }
+
+            for (int i = 0; i < 16; i++) {
+                const int x = 4 * bx + i % 4;
+                const int y = 4 * by + i / 4;
+                if (x < level.width && y < level.height) {
+                    unsigned char* pixel = &pixels[(static_cast<std::size_t>(y) * level.width + x) * 3];
+                    pixel[0] = static_cast<unsigned char>(colours[i].b);
+                    pixel[1] = static_cast<unsigned char>(colours[i].g);
+                    pixel[2] = static_cast<unsigned char>(colours[i].r);
+                }
+            }
+        }
+    }
+    return pixels;
+}
@@ -0,0 +1,43 @@
+#ifndef BLOCK_COMPRESSION_HPP
+#define BLOCK_COMPRESSION_HPP
+
+#include <cstddef>
+#include <vector>
+
+#include <GL/glew.h>
+
+#include "mip_chain.hpp"
+
+// GPU block compression of 8 bit BGR(A) textures, 4x4 pixels per block
+enum class TextureCompression {
+    None,
+    BC1, // 8 bytes/block: two RGB565 end points & 2 bit indices (EXT_texture_compression_s3tc)
+    BC5  // 16 bytes/block: red & green as two BC4 channels, for tangent-space normals (RGTC, core in GL 3.0)
+};
+
+// One compressed level, block rows bottom-up
+struct CompressedLevel {
+    int width;
+    int height;
+    std::vector<unsigned char> blocks;
+};
+
+const char* compressionName(TextureCompression compression);
+
+GLenum compressedInternalFormat(TextureCompression compression);
+
+// Whether the current context can sample the format. GL thread only.
+bool compressionSupported(TextureCompression compression);
+
+// Bytes of a width x height level, partial blocks included
+std::size_t compressedLevelSize(TextureCompression compression, int width, int height);
+
+// Encodes bottom-up 8 bit BGR or BGRA rows; edge blocks repeat the last row/column.
+// BC1 keeps the colour and drops alpha, BC5 keeps red & green.
+CompressedLevel compressLevel(const RowAccessor& row, int width, int height, int channels,
+                              TextureCompression compression);
+
+// Tightly packed bottom-up BGR rows of a compressed level, blue being 0 for BC5
+std::vector<unsigned char> decompressLevel(const CompressedLevel& level, TextureCompression compression);
+
+#endif
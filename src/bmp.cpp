@@ -1,66 +1,168 @@
-﻿#include <iostream>
+﻿#include <cstdint>
+#include <cstdlib>
+#include <iostream>
 
-unsigned char* loadBMP(const char* path, int& width, int& height) {
-    std::cout << "Reading file: " << path << std::endl;
+#include "bmp.hpp"
 
-    // Data read from the header of the BMP file
-    unsigned char header[54];
+// Size of BITMAPFILEHEADER
+static constexpr std::size_t fileHeaderSize = 14;
+// Size of BITMAPINFOHEADER, the smallest info header supported
+static constexpr std::size_t infoHeaderSize = 40;
 
-    // Open the file
-    FILE* file = fopen(path, "rb");
-    if (!file) {
-        std::cout << path << " could not be opened. Are you in the right directory?" << std::endl;
-        return nullptr;
+// Compression modes
+static constexpr std::uint32_t compressionRGB = 0;
+static constexpr std::uint32_t compressionBitfields = 3;
+static constexpr std::uint32_t compressionAlphaBitfields = 6;
+
+// Images larger than this on either side are rejected as corrupt
+static constexpr std::int32_t maxDimension = 1 << 16;
+
+// Header fields are little endian and not necessarily aligned, read them byte by byte
+static std::uint16_t readU16(const unsigned char* data) {
+    return static_cast<std::uint16_t>(data[0] | data[1] << 8);
+}
+
+static std::uint32_t readU32(const unsigned char* data) {
+    return static_cast<std::uint32_t>(data[0]) | static_cast<std::uint32_t>(data[1]) << 8 |
+           static_cast<std::uint32_t>(data[2]) << 16 | static_cast<std::uint32_t>(data[3]) << 24;
+}
+
+static std::int32_t readI32(const unsigned char* data) {
+    return static_cast<std::int32_t>(readU32(data));
+}
+
+const unsigned char* ImageView::row(const int y) const {
+    const int memoryRow = topDown ? height - 1 - y : y;
+    return pixels + static_cast<std::size_t>(memoryRow) * stride;
+}
+
+std::size_t ImageView::byteSize() const {
+    return stride * static_cast<std::size_t>(height);
+}
+
+// Whether each entry i of an 8 bpp colour table is grey level i, so the indices can be used as grey levels directly
+static bool isGreyRamp(const unsigned char* palette, const std::uint32_t entries) {
+    for (std::uint32_t i = 0; i < entries; i++) {
+        const unsigned char* entry = palette + 4 * i;
+        if (entry[0] != i || entry[1] != i || entry[2] != i) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool parseFormat(const unsigned char* data, const std::size_t size, const std::uint16_t bitsPerPixel,
+                        const std::uint32_t compression, PixelFormat& format) {
+    if (compression == compressionRGB) {
+        switch (bitsPerPixel) {
+            case 8: format = PixelFormat::R8; return true;
+            case 16: format = PixelFormat::BGR5A1; return true;
+            case 24: format = PixelFormat::BGR8; return true;
+            case 32: format = PixelFormat::BGRA8; return true;
+            default: return false;
+        }
+    }
+    if (compression != compressionBitfields && compression != compressionAlphaBitfields) {
+        return false;
+    }
+
+    // Channel masks follow a BITMAPINFOHEADER, or live inside the larger V2+ headers at the same offset
+    const std::size_t masksOffset = fileHeaderSize + infoHeaderSize;
+    if (masksOffset + 12 > size) {
+        return false;
     }
+    const std::uint32_t red = readU32(data + masksOffset);
+    const std::uint32_t green = readU32(data + masksOffset + 4);
+    const std::uint32_t blue = readU32(data + masksOffset + 8);
 
-    // Read the header, i.e. the 54 first bytes
-    // If less than 54 bytes are read, problem
-    if (fread(header, 1, 54, file) != 54) {
-        std::cout << "Not a correct BMP file" << std::endl;
-        fclose(file);
-        return nullptr;
+    if (bitsPerPixel == 16 && red == 0xF800 && green == 0x07E0 && blue == 0x001F) {
+        format = PixelFormat::R5G6B5;
+        return true;
     }
-    // A BMP files always begins with "BM"
-    if (header[0] != 'B' || header[1] != 'M') {
-        std::cout << "Not a correct BMP file" << std::endl;
-        fclose(file);
-        return nullptr;
+    if (bitsPerPixel == 16 && red == 0x7C00 && green == 0x03E0 && blue == 0x001F) {
+        format = PixelFormat::BGR5A1;
+        return true;
     }
+    if (bitsPerPixel == 32 && red == 0x00FF0000 && green == 0x0000FF00 && blue == 0x000000FF) {
+        format = PixelFormat::BGRA8;
+        return true;
+    }
+    return false;
+}
 
-    // Make sure this is a 24bpp file
-    if (*(int*) &(header[0x1E]) != 0) {
-        std::cout << "Not a correct BMP file" << std::endl;
-        fclose(file);
-        return nullptr;
+bool parseBMP(const unsigned char* data, const std::size_t size, ImageView& view) {
+    // A BMP file always begins with "BM", followed by the file header and at least a BITMAPINFOHEADER
+    if (data == nullptr || size < fileHeaderSize + infoHeaderSize || data[0] != 'B' || data[1] != 'M') {
+        return false;
     }
-    if (*(int*) &(header[0x1C]) != 24) {
-        std::cout << "Not a correct BMP file" << std::endl;
-        fclose(file);
-        return nullptr;
+
+    const std::uint32_t dataPos = readU32(data + 0x0A);
+    const std::uint32_t headerSize = readU32(data + 0x0E);
+    const std::int32_t width = readI32(data + 0x12);
+    const std::int32_t height = readI32(data + 0x16);
+    const std::uint16_t planes = readU16(data + 0x1A);
+    const std::uint16_t bitsPerPixel = readU16(data + 0x1C);
+    const std::uint32_t compression = readU32(data + 0x1E);
+    const std::uint32_t paletteSize = readU32(data + 0x2E);
+
+    // Negative heights mark top-down images
+    if (headerSize < infoHeaderSize || planes != 1 || width <= 0 || width > maxDimension ||
+        height == 0 || height < -maxDimension || height > maxDimension) {
+        return false;
     }
 
-    // Read the information about the image
-    unsigned int dataPos = *(int*) &(header[0x0A]);
-    unsigned int imageSize = *(int*) &(header[0x22]);
-    width = *(int*) &(header[0x12]);
-    height = *(int*) &(header[0x16]);
+    PixelFormat format;
+    if (!parseFormat(data, size, bitsPerPixel, compression, format)) {
+        return false;
+    }
 
-    // Some BMP files are malformed, guess missing information
-    if (imageSize == 0) {
-        imageSize = width * height * 3; // 3 : one byte for each Red, Green and Blue component
+    // Rows are padded to 4 bytes; all sizes fit in 64 bits given maxDimension
+    const std::uint64_t rows = static_cast<std::uint64_t>(std::abs(static_cast<std::int64_t>(height)));
+    const std::uint64_t stride = (static_cast<std::uint64_t>(width) * bitsPerPixel + 31) / 32 * 4;
+    // Some BMP files are malformed and leave dataPos empty, the pixels then follow the header
+    const std::uint64_t pixelsOffset = dataPos != 0 ? dataPos : fileHeaderSize + headerSize;
+    if (pixelsOffset + stride * rows > size) {
+        return false;
     }
-    if (dataPos == 0) {
-        dataPos = 54; // The BMP header is done that way
+
+    view.palette = nullptr;
+    view.paletteSize = 0;
+    if (format == PixelFormat::R8) {
+        // The colour table follows the info header, 256 entries when unspecified
+        const std::uint64_t paletteOffset = fileHeaderSize + static_cast<std::uint64_t>(headerSize);
+        const std::uint32_t entries = paletteSize == 0 || paletteSize > 256 ? 256 : paletteSize;
+        // Indices are uploaded as a single grey channel, so a missing or any other palette would render wrong
+        if (paletteOffset + entries * 4ull > pixelsOffset || !isGreyRamp(data + paletteOffset, entries)) {
+            return false;
+        }
+        view.palette = data + paletteOffset;
+        view.paletteSize = entries;
     }
 
-    // Create a buffer
-    const auto data = new unsigned char[imageSize];
+    view.pixels = data + pixelsOffset;
+    view.width = width;
+    view.height = static_cast<int>(rows);
+    view.bitsPerPixel = bitsPerPixel;
+    view.format = format;
+    view.stride = static_cast<std::size_t>(stride);
+    view.topDown = height < 0;
+    return true;
+}
+
+bool openBMP(const char* path, BMPImage& image) {
+    std::cout << "Reading file: " << path << std::endl;
 
-    // Read the actual data from the file into the buffer
-    fseek(file, dataPos, SEEK_SET);
-    fread(data, 1, imageSize, file);
+    // Map the file, pixel data is never copied
+    image.file = MappedFile(path);
+    if (!image.file.isOpen()) {
+        std::cout << path << " could not be opened. Are you in the right directory?" << std::endl;
+        return false;
+    }
 
-    // Everything is in memory now, the file can be closed.
-    fclose(file);
-    return data;
+    if (!parseBMP(image.file.data(), image.file.size(), image.view)) {
+        std::cout << "Not a correct BMP file, or an 8 bpp one without a greyscale palette" << std::endl;
+        image.file = MappedFile();
+        return false;
+    }
+    return true;
 }
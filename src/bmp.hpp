@@ -1,6 +1,52 @@
 #ifndef BMP_HPP
 #define BMP_HPP
 
-unsigned char* loadBMP(const char* path, int& width, int& height);
+#include <cstddef>
 
-#endif
\ No newline at end of file
+#include "mapped_file.hpp"
+
+// Layout of a single pixel, as stored in the BMP
+enum class PixelFormat {
+    R8,       // 8 bpp palette indices, into a grey ramp
+    BGR5A1,   // 16 bpp, 5-5-5 with the top bit unused
+    R5G6B5,   // 16 bpp, 5-6-5
+    BGR8,     // 24 bpp
+    BGRA8     // 32 bpp
+};
+
+// Non-owning view of pixel data stored in place
+struct ImageView {
+    const unsigned char* pixels = nullptr; // First row in memory
+    int width = 0;
+    int height = 0;
+    int bitsPerPixel = 0;
+    PixelFormat format = PixelFormat::BGR8;
+    std::size_t stride = 0; // Bytes between consecutive rows in memory, including padding
+    bool topDown = false; // Whether the first row in memory is the top of the image
+
+    // 8 bpp colour table, BGRX entries
+    const unsigned char* palette = nullptr;
+    unsigned int paletteSize = 0;
+
+    // Row y counted from the bottom of the image, which is the order OpenGL expects
+    const unsigned char* row(int y) const;
+
+    // Bytes covered by all rows, including padding
+    std::size_t byteSize() const;
+};
+
+// A BMP file mapped into memory, its pixels are viewed in place without copying
+struct BMPImage {
+    MappedFile file;
+    ImageView view;
+};
+
+// Validates a BMP held in memory and points view at its pixels.
+// Returns false if the header is malformed, unsupported, or the pixel data does not fit in size bytes. 8 bpp images are
+// only supported with a grey ramp palette, entry i being (i, i, i), as their indices are used as grey levels.
+bool parseBMP(const unsigned char* data, std::size_t size, ImageView& view);
+
+// Maps and validates a BMP file. Returns false if the file cannot be opened or parseBMP fails.
+bool openBMP(const char* path, BMPImage& image);
+
+#endif
@@ -0,0 +1,128 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "bmp.hpp"
+#include "bmp_tools.hpp"
+
+using Clock = std::chrono::steady_clock;
+
+static double secondsSince(const Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+// Sums every pixel byte, so each page of the mapping is actually read
+static std::uint64_t checksumPixels(const ImageView& view) {
+    const std::size_t rowBytes = (static_cast<std::size_t>(view.width) * view.bitsPerPixel + 7) / 8;
+    std::uint64_t sum = 0;
+    for (int y = 0; y < view.height; y++) {
+        const unsigned char* row = view.row(y);
+        for (std::size_t x = 0; x < rowBytes; x++) {
+            sum += row[x];
+        }
+    }
+    return sum;
+}
+
+int runBMPBenchmark(const char* path, const unsigned int iterations) {
+    BMPImage image;
+    if (!openBMP(path, image)) {
+        return EXIT_FAILURE;
+    }
+    const ImageView& view = image.view;
+    const double megabytes = static_cast<double>(view.byteSize()) / (1024.0 * 1024.0);
+    std::cout << view.width << " x " << view.height << ", " << view.bitsPerPixel << " bpp, "
+              << std::fixed << std::setprecision(2) << megabytes << " MiB of pixels" << std::endl;
+
+    // Map + validate, pixels untouched
+    Clock::time_point start = Clock::now();
+    for (unsigned int i = 0; i < iterations; i++) {
+        const MappedFile file(path);
+        ImageView parsed;
+        parseBMP(file.data(), file.size(), parsed);
+    }
+    const double openSeconds = secondsSince(start) / iterations;
+
+    // Header validation alone, on an already mapped file
+    start = Clock::now();
+    unsigned int accepted = 0;
+    for (unsigned int i = 0; i < iterations; i++) {
+        ImageView parsed;
+        accepted += parseBMP(image.file.data(), image.file.size(), parsed);
+    }
+    const double parseSeconds = secondsSince(start) / iterations;
+
+    // Streaming every row in place, as an upload would
+    start = Clock::now();
+    std::uint64_t checksum = 0;
+    for (unsigned int i = 0; i < iterations; i++) {
+        checksum += checksumPixels(view);
+    }
+    const double readSeconds = secondsSince(start) / iterations;
+
+    std::cout << "  map + parse  " << std::setw(10) << openSeconds * 1e6 << " us" << std::endl
+              << "  parse        " << std::setw(10) << parseSeconds * 1e9 << " ns" << std::endl
+              << "  read pixels  " << std::setw(10) << readSeconds * 1e3 << " ms ("
+              << megabytes / readSeconds << " MiB/s, checksum " << checksum << ")" << std::endl;
+    return accepted == iterations ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+int runBMPFuzz(const char* path, const unsigned int iterations, const unsigned int seed) {
+    const MappedFile file(path);
+    if (!file.isOpen()) {
+        std::cout << path << " could not be opened. Are you in the right directory?" << std::endl;
+        return EXIT_FAILURE;
+    }
+    const std::vector<unsigned char> original(file.data(), file.data() + file.size());
+
+    std::mt19937 random(seed);
+    std::uniform_int_distribution<unsigned int> byteValue(0, 255);
+    std::uniform_int_distribution<unsigned int> mutationCount(1, 8);
+    // Most interesting bytes are in the headers, bias mutations towards them
+    std::uniform_int_distribution<std::size_t> headerByte(0, std::min<std::size_t>(original.size(), 70) - 1);
+    std::uniform_int_distribution<std::size_t> anyByte(0, original.size() - 1);
+
+    unsigned int accepted = 0;
+    unsigned int violations = 0;
+    std::vector<unsigned char> buffer;
+    for (unsigned int i = 0; i < iterations; i++) {
+        buffer = original;
+        for (unsigned int m = mutationCount(random); m > 0; m--) {
+            const std::size_t position = random() % 4 != 0 ? headerByte(random) : anyByte(random);
+            buffer[position] = static_cast<unsigned char>(byteValue(random));
+        }
+        if (random() % 4 == 0) {
+            buffer.resize(anyByte(random));
+        }
+
+        ImageView view;
+        if (!parseBMP(buffer.data(), buffer.size(), view)) {
+            continue;
+        }
+        accepted++;
+
+        // Every row and the palette must lie inside the buffer
+        const unsigned char* begin = buffer.data();
+        const unsigned char* end = begin + buffer.size();
+        const std::size_t rowBytes = (static_cast<std::size_t>(view.width) * view.bitsPerPixel + 7) / 8;
+        const bool rowsInside = view.pixels >= begin && view.byteSize() <= static_cast<std::size_t>(end - view.pixels)
+                                && rowBytes <= view.stride;
+        const bool paletteInside = view.palette == nullptr ||
+                                   (view.palette >= begin && view.palette + view.paletteSize * 4 <= view.pixels);
+        if (!rowsInside || !paletteInside) {
+            std::cout << "Out of bounds view at iteration " << i << std::endl;
+            violations++;
+            continue;
+        }
+        checksumPixels(view);
+    }
+
+    std::cout << iterations << " inputs, " << accepted << " accepted, " << iterations - accepted
+              << " rejected, " << violations << " out of bounds" << std::endl;
+    return violations == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
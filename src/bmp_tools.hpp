@@ -0,0 +1,13 @@
+#ifndef BMP_TOOLS_HPP
+#define BMP_TOOLS_HPP
+
+// Headless BMP decoder harnesses, both return a process exit code
+
+// Times mapping + parsing a BMP and streaming its pixels, averaged over iterations
+int runBMPBenchmark(const char* path, unsigned int iterations);
+
+// Feeds randomly mutated and truncated copies of a BMP to parseBMP and checks that every
+// accepted view stays inside its buffer. Fails if any view reaches out of bounds.
+int runBMPFuzz(const char* path, unsigned int iterations, unsigned int seed);
+
+#endif
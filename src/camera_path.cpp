@@ -0,0 +1,116 @@
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/constants.hpp>
+
+#include "camera_path.hpp"
+
+// Keyframes of the orbit; the last one repeats the first a full turn later
+static constexpr unsigned int orbitKeyframes = 9;
+
+template<typename T>
+static T catmullRom(const T& p0, const T& p1, const T& p2, const T& p3, const float t) {
+    const float t2 = t * t;
+    const float t3 = t2 * t;
+    return 0.5f * (2.0f * p1 + (p2 - p0) * t + (2.0f * p0 - 5.0f * p1 + 4.0f * p2 - p3) * t2 +
+                   (3.0f * p1 - p0 - 3.0f * p2 + p3) * t3);
+}
+
+CameraPose mixPoses(const CameraPose& a, const CameraPose& b, const float t) {
+    return {glm::mix(a.position, b.position, t), glm::mix(a.horizontalAngle, b.horizontalAngle, t),
+            glm::mix(a.verticalAngle, b.verticalAngle, t)};
+}
+
+CameraPath CameraPath::orbit(const float extent) {
+    CameraPath path;
+    const float pi = glm::pi<float>();
+    for (unsigned int i = 0; i < orbitKeyframes; i++) {
+        const float angle = 2.0f * pi * static_cast<float>(i) / static_cast<float>(orbitKeyframes - 1);
+        // Alternate between skimming the peaks and looking down from above
+        const float height = i % 2 == 0 ? 4.0f : 8.0f;
+        const glm::vec3 position(-1.4f * extent * std::sin(angle), height, -1.4f * extent * std::cos(angle));
+        // Looking at the centre: the horizontal angle follows the orbit without wrapping
+        const float pitch = -std::atan2(height - 2.0f, 1.4f * extent);
+        path.add({position, angle, pitch});
+    }
+    return path;
+}
+
+bool CameraPath::load(const std::string& path) {
+    std::ifstream file(path);
+    if (!file.is_open()) {
+        std::cerr << "Camera path " << path << " could not be opened" << std::endl;
+        return false;
+    }
+
+    keyframes.clear();
+    std::string line;
+    unsigned int lineNumber = 0;
+    while (std::getline(file, line)) {
+        lineNumber++;
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+        std::istringstream fields(line);
+        CameraPose pose;
+        if (!(fields >> pose.position.x >> pose.position.y >> pose.position.z >> pose.horizontalAngle
+                     >> pose.verticalAngle)) {
+            std::cerr << path << ":" << lineNumber << ": expected x y z horizontalAngle verticalAngle" << std::endl;
+            return false;
+        }
+        keyframes.push_back(pose);
+    }
+
+    if (keyframes.size() < 2) {
+        std::cerr << "Camera path " << path << " needs at least 2 keyframes" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool CameraPath::append(const std::string& path, const CameraPose& pose) {
+    std::ofstream file(path, std::ios::app);
+    if (!file.is_open()) {
+        std::cerr << "Camera path " << path << " could not be opened" << std::endl;
+        return false;
+    }
+    file << pose.position.x << " " << pose.position.y << " " << pose.position.z << " " << pose.horizontalAngle << " "
+         << pose.verticalAngle << std::endl;
+    return true;
+}
+
+void CameraPath::add(const CameraPose& pose) {
+    keyframes.push_back(pose);
+}
+
+std::size_t CameraPath::size() const {
+    return keyframes.size();
+}
+
+CameraPose CameraPath::sample(const float t) const {
+    if (keyframes.size() == 1) {
+        return keyframes.front();
+    }
+
+    // Segment i runs from keyframe i to i + 1; the end points repeat at both ends of the path
+    const auto segments = static_cast<float>(keyframes.size() - 1);
+    const float u = glm::clamp(t, 0.0f, 1.0f) * segments;
+    const auto last = static_cast<int>(keyframes.size()) - 1;
+    const int i = std::min(static_cast<int>(u), last - 1);
+    const auto at = [this, last](const int index) -> const CameraPose& {
+        return keyframes[std::clamp(index, 0, last)];
+    };
+    const CameraPose& p0 = at(i - 1);
+    const CameraPose& p1 = at(i);
+    const CameraPose& p2 = at(i + 1);
+    const CameraPose& p3 = at(i + 2);
+    const float f = u - static_cast<float>(i);
+
+    return {catmullRom(p0.position, p1.position, p2.position, p3.position, f),
+            catmullRom(p0.horizontalAngle, p1.horizontalAngle, p2.horizontalAngle, p3.horizontalAngle, f),
+            catmullRom(p0.verticalAngle, p1.verticalAngle, p2.verticalAngle, p3.verticalAngle, f)};
+}
@@ -0,0 +1,43 @@
+#ifndef CAMERA_PATH_HPP
+#define CAMERA_PATH_HPP
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include <glm/vec3.hpp>
+
+// Camera position and orientation, angles in radians as in controls.cpp:
+// horizontal from +Z towards +X, vertical up from the horizon
+struct CameraPose {
+    glm::vec3 position;
+    float horizontalAngle;
+    float verticalAngle;
+};
+
+// Linear blend from a to b, t in [0, 1]. Angles are not wrapped, as controls.cpp never wraps them.
+CameraPose mixPoses(const CameraPose& a, const CameraPose& b, float t);
+
+// Keyframed camera path, interpolated as a Catmull-Rom spline through every keyframe.
+// Files hold one keyframe per line: x y z horizontalAngle verticalAngle; lines starting with # are ignored.
+class CameraPath {
+public:
+    // Circles the terrain square [-extent, extent]^2 once, looking at its centre
+    static CameraPath orbit(float extent);
+
+    bool load(const std::string& path);
+
+    // Appends one keyframe line to a path file, creating it if needed
+    static bool append(const std::string& path, const CameraPose& pose);
+
+    void add(const CameraPose& pose);
+    std::size_t size() const;
+
+    // Pose at t in [0, 1], keyframes evenly spaced in t
+    CameraPose sample(float t) const;
+
+private:
+    std::vector<CameraPose> keyframes;
+};
+
+#endif
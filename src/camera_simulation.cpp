@@ -0,0 +1,92 @@
+#include <algorithm>
+
+// GLEW before the GLFW header controls.hpp brings in
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include "camera_simulation.hpp"
+#include "profiler.hpp"
+
+using Clock = std::chrono::steady_clock;
+
+// Ticks the simulation may fall behind before it gives up on catching up and restarts its schedule from now
+static constexpr int maxCatchUpTicks = 4;
+
+CameraSimulation::CameraSimulation(const unsigned int tickRate)
+    : tick(std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / tickRate))) {
+}
+
+CameraSimulation::~CameraSimulation() {
+    stop();
+}
+
+void CameraSimulation::start(const CameraPose& pose) {
+    stop();
+    // The thread is not running yet, so this thread can publish the first snapshot in its place
+    snapshots.back() = {pose, pose, Clock::now(), tickCount.load()};
+    snapshots.publish();
+    running.store(true);
+    thread = std::thread(&CameraSimulation::loop, this, pose);
+}
+
+void CameraSimulation::stop() {
+    running.store(false);
+    if (thread.joinable()) {
+        thread.join();
+    }
+}
+
+bool CameraSimulation::isRunning() const {
+    return running.load();
+}
+
+void CameraSimulation::publishInput(const CameraInput& input) {
+    inputs.back() = input;
+    inputs.publish();
+}
+
+CameraPose CameraSimulation::pose(const Clock::time_point now) {
+    snapshots.update();
+    const CameraSnapshot& snapshot = snapshots.front();
+    // The snapshot's previous tick was at time - tick, so now - tick lies this far between the two
+    const float t = std::chrono::duration<float>(now - snapshot.time) / std::chrono::duration<float>(tick);
+    return mixPoses(snapshot.previous, snapshot.current, glm::clamp(t, 0.0f, 1.0f));
+}
+
+std::uint64_t CameraSimulation::ticks() const {
+    return tickCount.load(std::memory_order_relaxed);
+}
+
+std::uint64_t CameraSimulation::lateTicks() const {
+    return lateTickCount.load(std::memory_order_relaxed);
+}
+
+void CameraSimulation::loop(CameraPose pose) {
+    PROFILE_THREAD("camera simulation");
+    const float deltaTime = std::chrono::duration<float>(tick).count();
+    // Cursor travel is a running total, so input published between two ticks is never lost
+    inputs.update();
+    glm::dvec2 lastCursorTravel = inputs.front().cursorTravel;
+
+    Clock::time_point next = Clock::now() + tick;
+    while (running.load()) {
+        std::this_thread::sleep_until(next);
+        const Clock::time_point now = Clock::now();
+        if (now - next >= tick) {
+            lateTickCount.fetch_add(1, std::memory_order_relaxed);
+        }
+        if (now - next > maxCatchUpTicks * tick) {
+            next = now;
+        }
+
+        inputs.update();
+        const CameraInput& input = inputs.front();
+        const CameraPose previous = pose;
+        pose = stepCamera(pose, input, glm::vec2(input.cursorTravel - lastCursorTravel), deltaTime);
+        lastCursorTravel = input.cursorTravel;
+
+        snapshots.back() = {previous, pose, next, tickCount.fetch_add(1, std::memory_order_relaxed) + 1};
+        snapshots.publish();
+        next += tick;
+    }
+}
@@ -0,0 +1,67 @@
+#ifndef CAMERA_SIMULATION_HPP
+#define CAMERA_SIMULATION_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <thread>
+
+#include "camera_path.hpp"
+#include "controls.hpp"
+#include "triple_buffer.hpp"
+
+// Ticks per second of the camera simulation
+static constexpr unsigned int minTickRate = 10;
+static constexpr unsigned int maxTickRate = 1000;
+static constexpr unsigned int defaultTickRate = 120;
+
+// Poses of the two latest ticks, the current one taken at time
+struct CameraSnapshot {
+    CameraPose previous;
+    CameraPose current;
+    std::chrono::steady_clock::time_point time;
+    std::uint64_t tick = 0;
+};
+
+// Steps the camera on its own thread at a fixed tick, independent of the frame rate.
+// The main thread samples input into one triple buffer and the simulation publishes snapshots through another, so
+// neither side ever waits on the other. Rendering shows the pose one tick behind, interpolated between the last
+// two ticks, so motion stays smooth whatever the frame times.
+class CameraSimulation {
+public:
+    explicit CameraSimulation(unsigned int tickRate = defaultTickRate);
+    ~CameraSimulation();
+
+    CameraSimulation(const CameraSimulation&) = delete;
+    CameraSimulation& operator=(const CameraSimulation&) = delete;
+
+    // Starts ticking from pose
+    void start(const CameraPose& pose);
+    void stop();
+    bool isRunning() const;
+
+    // Hands the latest input over to the simulation. Input thread only.
+    void publishInput(const CameraInput& input);
+
+    // Pose at now minus one tick, interpolated between the latest snapshot's ticks. Render thread only, once
+    // started.
+    CameraPose pose(std::chrono::steady_clock::time_point now);
+
+    // Ticks simulated so far, and ticks that ran late enough to be caught up in a burst
+    std::uint64_t ticks() const;
+    std::uint64_t lateTicks() const;
+
+private:
+    void loop(CameraPose pose);
+
+    std::chrono::steady_clock::duration tick;
+    TripleBuffer<CameraInput> inputs;
+    TripleBuffer<CameraSnapshot> snapshots;
+
+    std::atomic<bool> running{false};
+    std::atomic<std::uint64_t> tickCount{0};
+    std::atomic<std::uint64_t> lateTickCount{0};
+    std::thread thread;
+};
+
+#endif
@@ -1,4 +1,7 @@
-﻿#include <glm/vec3.hpp>
+﻿#include <algorithm>
+#include <utility>
+
+#include <glm/vec3.hpp>
 #include <glm/matrix.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
@@ -31,72 +34,128 @@ glm::vec3 getCameraPosition() {
     return position;
 }
 
+// Vertical field of view, in radians
+float getFieldOfView() {
+    return glm::radians(initialFoV);
+}
+
+// Optional ground below the camera, and how far above it the camera stays
+std::function<float(const glm::vec2&)> ground;
+float groundClearance = 0.25f;
+
+void setGroundHeight(std::function<float(const glm::vec2& xz)> groundHeight) {
+    ground = std::move(groundHeight);
+}
+
 float speed = 3.0f; // 3 units / second
 float mouseSpeed = 0.00005f;
 
-void computeMatrices(GLFWwindow* window, const unsigned int width, const unsigned int height) {
-    // glfwGetTime is called only once, the first time this function is called
-    static double lastTime = glfwGetTime();
+// Direction : Spherical coordinates to Cartesian coordinates conversion
+static glm::vec3 directionOf(const float horizontal, const float vertical) {
+    return glm::vec3(
+        glm::cos(vertical) * glm::sin(horizontal),
+        glm::sin(vertical),
+        glm::cos(vertical) * glm::cos(horizontal)
+    );
+}
 
-    // Compute time difference between current and last frame
-    const double currentTime = glfwGetTime();
-    const auto deltaTime = static_cast<float>(currentTime - lastTime);
+// Right vector
+static glm::vec3 rightOf(const float horizontal) {
+    return glm::vec3(
+        glm::sin(horizontal - 3.14f / 2.0f),
+        0,
+        glm::cos(horizontal - 3.14f / 2.0f)
+    );
+}
+
+static void updateMatrices(const glm::vec3& direction, const glm::vec3& up) {
+    const float FoV = initialFoV;
+
+    // Projection matrix : 45° Field of View, 4:3 ratio, display range : 0.1 unit <-> 100 units
+    P = glm::perspective(glm::radians(FoV), 4.0f / 3.0f, 0.1f, 500.0f);
+    // Camera matrix
+    V = glm::lookAt(
+        position, // Camera is here
+        position + direction, // and looks here : at the same position, plus "direction"
+        up // Head is up (set to 0,-1,0 to look upside-down)
+    );
+}
+
+CameraPose getCameraPose() {
+    return {position, horizontalAngle, verticalAngle};
+}
+
+void setCameraPose(const CameraPose& pose) {
+    position = pose.position;
+    horizontalAngle = pose.horizontalAngle;
+    verticalAngle = pose.verticalAngle;
+
+    const glm::vec3 direction = directionOf(horizontalAngle, verticalAngle);
+    updateMatrices(direction, glm::cross(rightOf(horizontalAngle), direction));
+}
 
+void sampleCameraInput(GLFWwindow* window, const unsigned int width, const unsigned int height, CameraInput& input) {
     // Get mouse position
     double xpos, ypos;
     glfwGetCursorPos(window, &xpos, &ypos);
 
     // Reset mouse position for next frame
     glfwSetCursorPos(window, width / 2, height / 2);
+    input.cursorTravel += glm::dvec2(xpos - width / 2, ypos - height / 2);
 
-    // Compute new orientation
-    horizontalAngle += mouseSpeed * static_cast<float>(width / 2 - xpos);
-    verticalAngle += mouseSpeed * static_cast<float>(height / 2 - ypos);
-
-    // Direction : Spherical coordinates to Cartesian coordinates conversion
-    glm::vec3 direction(
-        glm::cos(verticalAngle) * glm::sin(horizontalAngle),
-        glm::sin(verticalAngle),
-        glm::cos(verticalAngle) * glm::cos(horizontalAngle)
-    );
+    input.forward = glfwGetKey(window, GLFW_KEY_UP) == GLFW_PRESS;
+    input.backward = glfwGetKey(window, GLFW_KEY_DOWN) == GLFW_PRESS;
+    input.right = glfwGetKey(window, GLFW_KEY_RIGHT) == GLFW_PRESS;
+    input.left = glfwGetKey(window, GLFW_KEY_LEFT) == GLFW_PRESS;
+}
 
-    // Right vector
-    glm::vec3 right = glm::vec3(
-        glm::sin(horizontalAngle - 3.14f / 2.0f),
-        0,
-        glm::cos(horizontalAngle - 3.14f / 2.0f)
-    );
+CameraPose stepCamera(const CameraPose& pose, const CameraInput& input, const glm::vec2& cursorDelta,
+                      const float deltaTime) {
+    CameraPose next = pose;
+
+    // Compute new orientation
+    next.horizontalAngle -= mouseSpeed * cursorDelta.x;
+    next.verticalAngle -= mouseSpeed * cursorDelta.y;
 
-    // Up vector
-    glm::vec3 up = glm::cross(right, direction);
+    const glm::vec3 direction = directionOf(next.horizontalAngle, next.verticalAngle);
+    const glm::vec3 right = rightOf(next.horizontalAngle);
 
     // Move forward
-    if (glfwGetKey(window, GLFW_KEY_UP) == GLFW_PRESS) {
-        position += direction * deltaTime * speed;
+    if (input.forward) {
+        next.position += direction * deltaTime * speed;
     }
     // Move backward
-    if (glfwGetKey(window, GLFW_KEY_DOWN) == GLFW_PRESS) {
-        position -= direction * deltaTime * speed;
+    if (input.backward) {
+        next.position -= direction * deltaTime * speed;
     }
     // Strafe right
-    if (glfwGetKey(window, GLFW_KEY_RIGHT) == GLFW_PRESS) {
-        position += right * deltaTime * speed;
+    if (input.right) {
+        next.position += right * deltaTime * speed;
     }
     // Strafe left
-    if (glfwGetKey(window, GLFW_KEY_LEFT) == GLFW_PRESS) {
-        position -= right * deltaTime * speed;
+    if (input.left) {
+        next.position -= right * deltaTime * speed;
     }
 
-    const float FoV = initialFoV;
+    // Don't fly through the terrain
+    if (ground) {
+        next.position.y = std::max(next.position.y,
+                                   ground(glm::vec2(next.position.x, next.position.z)) + groundClearance);
+    }
+    return next;
+}
 
-    // Projection matrix : 45° Field of View, 4:3 ratio, display range : 0.1 unit <-> 100 units
-    P = glm::perspective(glm::radians(FoV), 4.0f / 3.0f, 0.1f, 500.0f);
-    // Camera matrix
-    V = glm::lookAt(
-        position, // Camera is here
-        position + direction, // and looks here : at the same position, plus "direction"
-        up // Head is up (set to 0,-1,0 to look upside-down)
-    );
+void computeMatrices(GLFWwindow* window, const unsigned int width, const unsigned int height) {
+    // glfwGetTime is called only once, the first time this function is called
+    static double lastTime = glfwGetTime();
+
+    // Compute time difference between current and last frame
+    const double currentTime = glfwGetTime();
+    const auto deltaTime = static_cast<float>(currentTime - lastTime);
+
+    CameraInput input;
+    sampleCameraInput(window, width, height, input);
+    setCameraPose(stepCamera(getCameraPose(), input, glm::vec2(input.cursorTravel), deltaTime));
 
     // For the next frame, the "last time" will be "now"
     lastTime = currentTime;
@@ -1,13 +1,45 @@
 #ifndef CONTROLS_HPP
 #define CONTROLS_HPP
 
+#include <functional>
+
 #include <GLFW/glfw3.h>
+#include <glm/vec2.hpp>
 #include <glm/vec3.hpp>
 #include <glm/matrix.hpp>
 
+#include "camera_path.hpp"
+
+// Arrow keys held, and how far the cursor has moved in total, in pixels
+struct CameraInput {
+    bool forward = false;
+    bool backward = false;
+    bool right = false;
+    bool left = false;
+    glm::dvec2 cursorTravel = glm::dvec2(0.0);
+};
+
+// Reads the keys into input and adds the cursor's offset from the window centre to its travel, recentring the
+// cursor. Main thread only, as GLFW requires.
+void sampleCameraInput(GLFWwindow* window, const unsigned int width, const unsigned int height, CameraInput& input);
+
+// Pose after deltaTime seconds of the keys held and cursorDelta pixels of cursor movement, above the ground.
+// Touches no global state but the ground callback, so it may run on any thread.
+CameraPose stepCamera(const CameraPose& pose, const CameraInput& input, const glm::vec2& cursorDelta,
+                      float deltaTime);
+
+// Samples input and steps the camera by the time since the last call, on the calling thread
 void computeMatrices(GLFWwindow* window, const unsigned int width, const unsigned int height);
 glm::mat4 getViewMatrix();
 glm::mat4 getProjectionMatrix();
 glm::vec3 getCameraPosition();
+float getFieldOfView();
+
+// Current camera pose, and placing the camera without reading input (for scripted camera paths)
+CameraPose getCameraPose();
+void setCameraPose(const CameraPose& pose);
+
+// Ground height below an (x, z) position: the camera is kept above it. Pass nullptr to fly freely.
+void setGroundHeight(std::function<float(const glm::vec2& xz)> groundHeight);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,51 @@
+#include <glm/glm.hpp>
+
+#include "frustum.hpp"
+
+Frustum Frustum::fromMatrix(const glm::mat4& viewProjection) {
+    // GLM matrices are column major: row i is (m[0][i], m[1][i], m[2][i], m[3][i])
+    const auto row = [&viewProjection](const int i) {
+        return glm::vec4(viewProjection[0][i], viewProjection[1][i], viewProjection[2][i], viewProjection[3][i]);
+    };
+
+    Frustum frustum;
+    frustum.planes[0] = row(3) + row(0); // Left
+    frustum.planes[1] = row(3) - row(0); // Right
+    frustum.planes[2] = row(3) + row(1); // Bottom
+    frustum.planes[3] = row(3) - row(1); // Top
+    frustum.planes[4] = row(3) + row(2); // Near
+    frustum.planes[5] = row(3) - row(2); // Far
+    for (auto& plane : frustum.planes) {
+        plane /= glm::length(glm::vec3(plane));
+    }
+    return frustum;
+}
+
+FrustumTest Frustum::test(const glm::vec3& boxMin, const glm::vec3& boxMax) const {
+    FrustumTest result = FrustumTest::Inside;
+    for (const auto& plane : planes) {
+        const glm::vec3 normal(plane);
+
+        // Corner furthest along the normal: if it is behind the plane, so is the whole box
+        const glm::vec3 positive = glm::mix(boxMin, boxMax, glm::greaterThanEqual(normal, glm::vec3(0.0f)));
+        if (glm::dot(normal, positive) + plane.w < 0.0f) {
+            return FrustumTest::Outside;
+        }
+
+        // Corner furthest against the normal: if it is behind the plane, the box straddles it
+        const glm::vec3 negative = glm::mix(boxMax, boxMin, glm::greaterThanEqual(normal, glm::vec3(0.0f)));
+        if (glm::dot(normal, negative) + plane.w < 0.0f) {
+            result = FrustumTest::Intersecting;
+        }
+    }
+    return result;
+}
+
+bool Frustum::contains(const glm::vec3& point) const {
+    for (const auto& plane : planes) {
+        if (glm::dot(glm::vec3(plane), point) + plane.w < 0.0f) {
+            return false;
+        }
+    }
+    return true;
+}
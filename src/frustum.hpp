@@ -0,0 +1,28 @@
+#ifndef FRUSTUM_HPP
+#define FRUSTUM_HPP
+
+#include <glm/mat4x4.hpp>
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+
+// Where a box lies with respect to a frustum
+enum class FrustumTest {
+    Outside,
+    Intersecting,
+    Inside
+};
+
+// View frustum as six inward facing planes (n, d): a point p is inside when dot(n, p) + d >= 0 for all of them
+struct Frustum {
+    glm::vec4 planes[6];
+
+    // Gribb-Hartmann extraction from a projection * view matrix, OpenGL clip space
+    static Frustum fromMatrix(const glm::mat4& viewProjection);
+
+    // Conservative axis-aligned box test: boxes reported Outside are never visible
+    FrustumTest test(const glm::vec3& boxMin, const glm::vec3& boxMax) const;
+
+    bool contains(const glm::vec3& point) const;
+};
+
+#endif
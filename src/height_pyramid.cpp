@@ -0,0 +1,112 @@
+#include <algorithm>
+#include <cmath>
+
+#include <glm/glm.hpp>
+
+#include "height_pyramid.hpp"
+#include "parallel.hpp"
+
+// Rows per chunk when reducing levels in parallel
+static constexpr std::size_t minRowsPerChunk = 16;
+
+const glm::vec2& HeightPyramid::Level::at(const int x, const int y) const {
+    return minMax[static_cast<std::size_t>(y) * width + x];
+}
+
+void HeightPyramid::build(const HeightField& field) {
+    build(field, field);
+}
+
+void HeightPyramid::build(const HeightField& minimums, const HeightField& maximums) {
+    levels.clear();
+    if (minimums.width <= 0 || minimums.height <= 0) {
+        return;
+    }
+
+    Level base{minimums.width, minimums.height, {}};
+    base.minMax.resize(minimums.heights.size());
+    std::transform(minimums.heights.begin(), minimums.heights.end(), maximums.heights.begin(), base.minMax.begin(),
+                   [](const float lowest, const float highest) {
+        return glm::vec2(lowest, highest);
+    });
+    levels.push_back(std::move(base));
+
+    // Halve until 1 x 1; odd edges fold their last texel into the last cell
+    while (levels.back().width > 1 || levels.back().height > 1) {
+        const Level& finer = levels.back();
+        Level coarser{(finer.width + 1) / 2, (finer.height + 1) / 2, {}};
+        coarser.minMax.resize(static_cast<std::size_t>(coarser.width) * coarser.height);
+
+        parallelFor(0, coarser.height, [&](const std::size_t rowBegin, const std::size_t rowEnd) {
+            for (auto y = static_cast<int>(rowBegin); y < static_cast<int>(rowEnd); y++) {
+                const int y0 = 2 * y;
+                const int y1 = std::min(y0 + 1, finer.height - 1);
+                for (int x = 0; x < coarser.width; x++) {
+                    const int x0 = 2 * x;
+                    const int x1 = std::min(x0 + 1, finer.width - 1);
+                    const glm::vec2& a = finer.at(x0, y0);
+                    const glm::vec2& b = finer.at(x1, y0);
+                    const glm::vec2& c = finer.at(x0, y1);
+                    const glm::vec2& d = finer.at(x1, y1);
+                    coarser.minMax[static_cast<std::size_t>(y) * coarser.width + x] = glm::vec2(
+                        std::min(std::min(a.x, b.x), std::min(c.x, d.x)),
+                        std::max(std::max(a.y, b.y), std::max(c.y, d.y)));
+                }
+            }
+        }, minRowsPerChunk);
+        levels.push_back(std::move(coarser));
+    }
+}
+
+bool HeightPyramid::empty() const {
+    return levels.empty();
+}
+
+std::size_t HeightPyramid::levelCount() const {
+    return levels.size();
+}
+
+int HeightPyramid::levelWidth(const std::size_t level) const {
+    return levels[level].width;
+}
+
+int HeightPyramid::levelHeight(const std::size_t level) const {
+    return levels[level].height;
+}
+
+glm::vec2 HeightPyramid::cell(const std::size_t level, const int x, const int y) const {
+    const Level& cells = levels[level];
+    return cells.at(glm::clamp(x, 0, cells.width - 1), glm::clamp(y, 0, cells.height - 1));
+}
+
+glm::vec2 HeightPyramid::range(const glm::vec2& uvMin, const glm::vec2& uvMax) const {
+    // Texels a nearest, clamp to edge sampler can return inside the rectangle
+    const Level& base = levels.front();
+    const auto texel = [](const float uv, const int size) {
+        return glm::clamp(static_cast<int>(std::floor(uv * static_cast<float>(size))), 0, size - 1);
+    };
+    int x0 = texel(uvMin.x, base.width);
+    int x1 = texel(uvMax.x, base.width);
+    int y0 = texel(uvMin.y, base.height);
+    int y1 = texel(uvMax.y, base.height);
+
+    // Climb until the rectangle spans at most two cells per axis
+    std::size_t level = 0;
+    while (x1 - x0 > 1 || y1 - y0 > 1) {
+        x0 >>= 1;
+        x1 >>= 1;
+        y0 >>= 1;
+        y1 >>= 1;
+        level++;
+    }
+
+    const Level& cells = levels[level];
+    glm::vec2 result = cells.at(x0, y0);
+    for (int y = y0; y <= y1; y++) {
+        for (int x = x0; x <= x1; x++) {
+            const glm::vec2& cell = cells.at(x, y);
+            result = glm::vec2(std::min(result.x, cell.x), std::max(result.y, cell.y));
+        }
+    }
+    return result;
+}
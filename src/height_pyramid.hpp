@@ -0,0 +1,45 @@
+#ifndef HEIGHT_PYRAMID_HPP
+#define HEIGHT_PYRAMID_HPP
+
+#include <cstddef>
+#include <vector>
+
+#include <glm/vec2.hpp>
+
+#include "terrain_bake.hpp"
+
+// Min/max mip chain of a height field: level k holds the (min, max) unscaled height of 2^k x 2^k texel blocks
+class HeightPyramid {
+public:
+    void build(const HeightField& field);
+    // Level 0 bounded by two fields of the same size instead, e.g. the min & max of the texels a coarser field stands
+    // for
+    void build(const HeightField& minimums, const HeightField& maximums);
+
+    bool empty() const;
+
+    // Conservative (min, max) of the texels nearest-sampled anywhere inside [uvMin, uvMax], unscaled.
+    // Reads at most 2 x 2 cells of the coarsest level that still separates the rectangle's edges.
+    glm::vec2 range(const glm::vec2& uvMin, const glm::vec2& uvMax) const;
+
+    // Level 0 is the field itself, the last level a single cell
+    std::size_t levelCount() const;
+    int levelWidth(std::size_t level) const;
+    int levelHeight(std::size_t level) const;
+
+    // (min, max) of cell (x, y) of a level, clamped to its edges
+    glm::vec2 cell(std::size_t level, int x, int y) const;
+
+private:
+    struct Level {
+        int width;
+        int height;
+        std::vector<glm::vec2> minMax;
+
+        const glm::vec2& at(int x, int y) const;
+    };
+
+    std::vector<Level> levels;
+};
+
+#endif
@@ -0,0 +1,354 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <limits>
+
+#include <glm/glm.hpp>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define HORIZON_MAP_SSE2 1
+#endif
+
+#include "horizon_map.hpp"
+#include "parallel.hpp"
+#include "profiler.hpp"
+
+// Rows per chunk when sweeping a slice in parallel
+static constexpr std::size_t minRowsPerChunk = 8;
+// Samples one texel apart along the azimuth's major axis near each texel, then further apart by sampleGrowth each
+static constexpr int nearSamples = 24;
+static constexpr float sampleGrowth = 1.04f;
+
+static constexpr float twoPi = 6.28318530718f;
+
+// Angle over which main.frag fades the light out behind the horizon, in radians
+static constexpr float horizonPenumbra = 0.04f;
+// Share of texels over all slices, in percent, --horizon-check lets be wrong by more than the penumbra: samples grow
+// apart with distance, so a narrow peak between two far ones is missed
+static constexpr double maxHorizonCheckShare = 3.0;
+
+void computeHorizonSlice(const HeightField& field, const float azimuth, const glm::vec2& texelSize, float* horizon,
+                         const std::size_t stride) {
+    const int width = field.width;
+    const int height = field.height;
+
+    // Samples step whole texels along the azimuth's major axis and land between two texels along the other, so a
+    // row is swept one sample at a time as two shifted rows (or one row and its neighbour column) blended by a
+    // constant weight, like bakeTerrain's taps
+    struct Sample {
+        int row0;
+        int row1;
+        int column0;
+        int column1;
+        float weight;
+        float inverseDistance;
+    };
+    std::vector<Sample> samples;
+    const glm::vec2 direction = glm::vec2(std::cos(azimuth), std::sin(azimuth)) / texelSize;
+    const bool alongX = std::abs(direction.x) >= std::abs(direction.y);
+    const float major = alongX ? direction.x : direction.y;
+    const float minorPerMajor = (alongX ? direction.y : direction.x) / major;
+    const int majorExtent = alongX ? width : height;
+    const int minorExtent = alongX ? height : width;
+    for (int step = 1; step < majorExtent;
+         step = step < nearSamples ? step + 1 : std::max(step + 1, static_cast<int>(step * sampleGrowth))) {
+        const int offset = major < 0.0f ? -step : step;
+        const float minor = static_cast<float>(offset) * minorPerMajor;
+        const float minorFloor = std::floor(minor);
+        if (std::abs(minorFloor) >= static_cast<float>(minorExtent)) {
+            break;
+        }
+        const auto near = static_cast<int>(minorFloor);
+        const float weight = minor - minorFloor;
+        const int far = weight > 0.0f ? near + 1 : near;
+        const glm::vec2 texels = alongX ? glm::vec2(offset, minor) : glm::vec2(minor, offset);
+        const float inverseDistance = 1.0f / glm::length(texels * texelSize);
+        samples.push_back(alongX ? Sample{near, far, offset, offset, weight, inverseDistance}
+                                 : Sample{offset, offset, near, far, weight, inverseDistance});
+    }
+
+    parallelFor(0, height, [&](const std::size_t rowBegin, const std::size_t rowEnd) {
+        std::vector<float> slopes(width);
+        for (auto y = static_cast<int>(rowBegin); y < static_cast<int>(rowEnd); y++) {
+            // The horizon never lies below the horizontal plane
+            std::fill(slopes.begin(), slopes.end(), 0.0f);
+            const float* row = &field.heights[static_cast<std::size_t>(y) * width];
+            for (const Sample& sample : samples) {
+                if (y + std::min(sample.row0, sample.row1) < 0 || y + std::max(sample.row0, sample.row1) >= height) {
+                    continue;
+                }
+                // Texels whose sample leaves the field have nothing there to block the light
+                const float* source0 = &field.heights[static_cast<std::size_t>(y + sample.row0) * width]
+                                       + sample.column0;
+                const float* source1 = &field.heights[static_cast<std::size_t>(y + sample.row1) * width]
+                                       + sample.column1;
+                const int begin = std::max(0, -std::min(sample.column0, sample.column1));
+                const int end = std::min(width, width - std::max(sample.column0, sample.column1));
+                int x = begin;
+#ifdef HORIZON_MAP_SSE2
+                const __m128 weight = _mm_set1_ps(sample.weight);
+                const __m128 inverseDistance = _mm_set1_ps(sample.inverseDistance);
+                for (; x + 4 <= end; x += 4) {
+                    const __m128 near = _mm_loadu_ps(source0 + x);
+                    const __m128 blocker = _mm_add_ps(near, _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(source1 + x), near),
+                                                                       weight));
+                    const __m128 rise = _mm_sub_ps(blocker, _mm_loadu_ps(row + x));
+                    _mm_storeu_ps(&slopes[x], _mm_max_ps(_mm_loadu_ps(&slopes[x]),
+                                                         _mm_mul_ps(rise, inverseDistance)));
+                }
+#endif
+                for (; x < end; x++) {
+                    const float blocker = source0[x] + (source1[x] - source0[x]) * sample.weight;
+                    slopes[x] = std::max(slopes[x], (blocker - row[x]) * sample.inverseDistance);
+                }
+            }
+
+            float* destination = horizon + static_cast<std::size_t>(y) * width * stride;
+            for (int x = 0; x < width; x++) {
+                destination[x * stride] = slopes[x];
+            }
+        }
+    }, minRowsPerChunk);
+}
+
+// Bilinear height at a position in texels, the centre of texel (x, y) being at (x, y)
+static float bilinearHeight(const HeightField& field, const glm::vec2& position) {
+    const int x = std::min(static_cast<int>(position.x), field.width - 2);
+    const int y = std::min(static_cast<int>(position.y), field.height - 2);
+    const glm::vec2 weight = position - glm::vec2(x, y);
+    const float bottom = glm::mix(field.at(x, y), field.at(x + 1, y), weight.x);
+    const float top = glm::mix(field.at(x, y + 1), field.at(x + 1, y + 1), weight.x);
+    return glm::mix(bottom, top, weight.y);
+}
+
+// Horizon tangent of texel (x, y) found by marching along the exact azimuth across every texel line of its major
+// axis, up to and including the point where the ray leaves the field
+static float marchHorizon(const HeightField& field, const int x, const int y, const glm::vec2& direction,
+                          const glm::vec2& texelSize) {
+    const glm::vec2 texelDirection = direction / texelSize;
+    const glm::vec2 step = texelDirection / std::max(std::abs(texelDirection.x), std::abs(texelDirection.y));
+    const float stepDistance = glm::length(step * texelSize);
+    const glm::vec2 origin(x, y);
+    const glm::vec2 last(field.width - 1, field.height - 1);
+    float exit = std::numeric_limits<float>::max();
+    for (int axis = 0; axis < 2; axis++) {
+        if (step[axis] > 0.0f) {
+            exit = std::min(exit, (last[axis] - origin[axis]) / step[axis]);
+        } else if (step[axis] < 0.0f) {
+            exit = std::min(exit, -origin[axis] / step[axis]);
+        }
+    }
+
+    const float height = field.at(x, y);
+    float slope = 0.0f;
+    for (int i = 1; ; i++) {
+        const float steps = std::min(static_cast<float>(i), exit);
+        if (steps <= 0.0f) {
+            return slope;
+        }
+        const glm::vec2 position = glm::clamp(origin + steps * step, glm::vec2(0.0f), last);
+        slope = std::max(slope, (bilinearHeight(field, position) - height) / (steps * stepDistance));
+        if (steps == exit) {
+            return slope;
+        }
+    }
+}
+
+int runHorizonCheck(const char* path, const float uvScale, const float heightMapScale) {
+    BMPImage image;
+    HeightField field;
+    if (!openBMP(path, image) || !decodeHeightField(image.view, field)) {
+        std::cout << "Height maps must be 24 bpp BMPs" << std::endl;
+        return EXIT_FAILURE;
+    }
+    if (field.width < 2 || field.height < 2) {
+        std::cout << "Height maps must be at least 2 x 2 texels" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    const glm::vec2 texelSize = 1.0f / (uvScale * glm::vec2(field.width, field.height));
+    const std::size_t texels = field.heights.size();
+    std::vector<float> swept(texels);
+    std::vector<float> marched(texels);
+    std::size_t totalWrong = 0;
+    for (unsigned int slice = 0; slice < horizonSlices; slice++) {
+        const float azimuth = static_cast<float>(slice) * twoPi / horizonSlices;
+        computeHorizonSlice(field, azimuth, texelSize, swept.data(), 1);
+        const glm::vec2 direction(std::cos(azimuth), std::sin(azimuth));
+        parallelFor(0, field.height, [&](const std::size_t rowBegin, const std::size_t rowEnd) {
+            for (auto y = static_cast<int>(rowBegin); y < static_cast<int>(rowEnd); y++) {
+                for (int x = 0; x < field.width; x++) {
+                    marched[static_cast<std::size_t>(y) * field.width + x] =
+                        marchHorizon(field, x, y, direction, texelSize);
+                }
+            }
+        }, 1);
+
+        // Compared as the elevation angles main.frag shades with
+        std::size_t wrong = 0;
+        double maxError = 0.0;
+        for (std::size_t i = 0; i < texels; i++) {
+            const double error = std::abs(std::atan(static_cast<double>(swept[i]) * heightMapScale) -
+                                          std::atan(static_cast<double>(marched[i]) * heightMapScale));
+            maxError = std::max(maxError, error);
+            if (error > horizonPenumbra) {
+                wrong++;
+            }
+        }
+        totalWrong += wrong;
+        std::cout << "Slice " << slice << ": " << 100.0 * static_cast<double>(wrong) / static_cast<double>(texels)
+                  << "% of texels off by more than the penumbra, max error " << maxError << " rad" << std::endl;
+    }
+
+    const double share = 100.0 * static_cast<double>(totalWrong) / static_cast<double>(texels * horizonSlices);
+    std::cout << field.width << " x " << field.height << " texels, " << share
+              << "% off by more than the penumbra over all slices" << std::endl;
+    return share < maxHorizonCheckShare ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+HorizonMap::~HorizonMap() {
+    waitForJob(job);
+}
+
+void HorizonMap::setHeights(const HeightField& heights, const float uvScale) {
+    waitForJob(job);
+    job = nullptr;
+    field = &heights;
+    texelSize = 1.0f / (uvScale * glm::vec2(heights.width, heights.height));
+    texels.assign(static_cast<std::size_t>(heights.width) * heights.height, glm::vec2(0.0f));
+    channelSlices[0] = channelSlices[1] = -1;
+
+    if (textureID == 0) {
+        glGenTextures(1, &textureID);
+    }
+    glBindTexture(GL_TEXTURE_2D, textureID);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RG32F, heights.width, heights.height, 0, GL_RG, GL_FLOAT, texels.data());
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+bool HorizonMap::hasHeights() const {
+    return field != nullptr;
+}
+
+float HorizonMap::slicePosition(const glm::vec3& lightDirection) {
+    // Towards the light; straight overhead there is no azimuth
+    const glm::vec2 toLight(-lightDirection.x, -lightDirection.z);
+    if (glm::dot(toLight, toLight) == 0.0f) {
+        return -1.0f;
+    }
+    const float azimuth = std::atan2(toLight.y, toLight.x);
+    const float position = (azimuth < 0.0f ? azimuth + twoPi : azimuth) / twoPi * horizonSlices;
+    return position < static_cast<float>(horizonSlices) ? position : 0.0f;
+}
+
+void HorizonMap::update(const glm::vec3& lightDirection) {
+    if (field == nullptr) {
+        return;
+    }
+    position = slicePosition(lightDirection);
+
+    // Swap in the finished slice
+    if (job != nullptr && isJobFinished(job)) {
+        channelSlices[jobSlice % 2] = jobSlice;
+        glBindTexture(GL_TEXTURE_2D, textureID);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, field->width, field->height, GL_RG, GL_FLOAT, texels.data());
+        glBindTexture(GL_TEXTURE_2D, 0);
+        computed++;
+        totalMilliseconds += jobMilliseconds;
+        job = nullptr;
+    }
+    if (job != nullptr || position < 0.0f) {
+        return;
+    }
+
+    // The slice of the pair closest to the light goes first
+    const auto lower = static_cast<int>(position);
+    const int upper = (lower + 1) % static_cast<int>(horizonSlices);
+    const bool lowerFirst = position - static_cast<float>(lower) < 0.5f;
+    for (const int slice : {lowerFirst ? lower : upper, lowerFirst ? upper : lower}) {
+        if (channelSlices[slice % 2] == slice) {
+            continue;
+        }
+        // The job only writes the slice's channel, which no upload reads until it has finished
+        jobSlice = slice;
+        job = submitJob([this, slice] {
+            PROFILE_SCOPE("computeHorizonSlice");
+            const auto start = std::chrono::steady_clock::now();
+            const float azimuth = static_cast<float>(slice) * twoPi / horizonSlices;
+            computeHorizonSlice(*field, azimuth, texelSize, &texels[0][slice % 2], 2);
+            jobMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start)
+                .count();
+        }, {}, JobPriority::Background);
+        break;
+    }
+}
+
+void HorizonMap::finish(const glm::vec3& lightDirection) {
+    update(lightDirection);
+    while (job != nullptr) {
+        waitForJob(job);
+        update(lightDirection);
+    }
+}
+
+glm::vec2 HorizonMap::weights() const {
+    if (position < 0.0f) {
+        return glm::vec2(0.0f);
+    }
+
+    // Linear in the distance to each channel's slice, so a resident pair interpolates between its slices and a
+    // slice more than one step away drops out
+    glm::vec2 result(0.0f);
+    float nearest = static_cast<float>(horizonSlices);
+    int nearestChannel = -1;
+    for (int channel = 0; channel < 2; channel++) {
+        if (channelSlices[channel] < 0) {
+            continue;
+        }
+        const float offset = std::abs(position - static_cast<float>(channelSlices[channel]));
+        const float distance = std::min(offset, static_cast<float>(horizonSlices) - offset);
+        result[channel] = std::max(0.0f, 1.0f - distance);
+        if (distance < nearest) {
+            nearest = distance;
+            nearestChannel = channel;
+        }
+    }
+    // Turned too fast for either: the nearest slice stands in until the right ones arrive
+    if (result.x + result.y == 0.0f && nearestChannel >= 0) {
+        result[nearestChannel] = 1.0f;
+    }
+    return result;
+}
+
+void HorizonMap::bind() const {
+    glActiveTexture(GL_TEXTURE0 + horizonMapUnit);
+    glBindTexture(GL_TEXTURE_2D, textureID);
+}
+
+std::size_t HorizonMap::slicesComputed() const {
+    return computed;
+}
+
+double HorizonMap::meanSliceMilliseconds() const {
+    return computed > 0 ? totalMilliseconds / static_cast<double>(computed) : 0.0;
+}
+
+void HorizonMap::unload() {
+    waitForJob(job);
+    job = nullptr;
+    glDeleteTextures(1, &textureID);
+    textureID = 0;
+    field = nullptr;
+    texels.clear();
+    channelSlices[0] = channelSlices[1] = -1;
+}
@@ -0,0 +1,89 @@
+#ifndef HORIZON_MAP_HPP
+#define HORIZON_MAP_HPP
+
+#include <cstddef>
+#include <vector>
+
+#include <GL/glew.h>
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
+
+#include "job_system.hpp"
+#include "terrain_bake.hpp"
+
+// Azimuth slices per full turn of the light. Even, so neighbouring slices always land in different channels.
+static constexpr unsigned int horizonSlices = 32;
+
+// Texture unit main.frag samples the horizon map from
+static constexpr GLuint horizonMapUnit = 6;
+
+// Tangent of the horizon's elevation seen from every texel of field towards azimuth (radians, from +x towards +z),
+// in unscaled height per world unit and never below 0. texelSize is the world size of a texel along x & z.
+// Writes texel (x, y) to horizon[(y * width + x) * stride].
+void computeHorizonSlice(const HeightField& field, float azimuth, const glm::vec2& texelSize, float* horizon,
+                         std::size_t stride);
+
+// Compares every slice of a height map BMP with a ray march along the exact azimuth, as elevation angles with the
+// height scaled by heightMapScale. uvScale maps world units to uv. Headless; returns a process exit code.
+int runHorizonCheck(const char* path, float uvScale, float heightMapScale);
+
+// Horizon map for soft self-shadowing of the terrain.
+// main.frag compares the light's elevation with the horizon in the light's direction, interpolated between the two
+// azimuth slices around it: even slices live in the red channel of an RG32F texture, odd ones in the green, so that
+// is a single fetch. As the light turns towards another pair, only the slice it lacks is computed, in a background
+// job, while frames keep shading with the slices already uploaded.
+class HorizonMap {
+public:
+    HorizonMap() = default;
+    ~HorizonMap();
+
+    HorizonMap(const HorizonMap&) = delete;
+    HorizonMap& operator=(const HorizonMap&) = delete;
+
+    // Computes slices of field, which must outlive them, from the next update. uvScale maps world units to uv.
+    // GL thread only.
+    void setHeights(const HeightField& field, float uvScale);
+    bool hasHeights() const;
+
+    // Uploads a finished slice and starts computing the next one the light needs. Call once per frame on the GL
+    // thread.
+    void update(const glm::vec3& lightDirection);
+
+    // Blocks until both slices around the light are uploaded. GL thread only.
+    void finish(const glm::vec3& lightDirection);
+
+    // Weights of the red & green channels: the horizon's tangent in the light's direction is dot(texel.rg, weights)
+    glm::vec2 weights() const;
+
+    void bind() const;
+
+    // Slices computed so far, and their mean time
+    std::size_t slicesComputed() const;
+    double meanSliceMilliseconds() const;
+
+    // Waits for the slice in progress and deletes the texture. GL thread only.
+    void unload();
+
+private:
+    // Light azimuth in slices, in [0, horizonSlices)
+    static float slicePosition(const glm::vec3& lightDirection);
+
+    const HeightField* field = nullptr;
+    glm::vec2 texelSize = glm::vec2(0.0f);
+
+    GLuint textureID = 0;
+    // Both channels, interleaved as uploaded; a job only writes the channel of its slice
+    std::vector<glm::vec2> texels;
+    // Slice held by each channel, -1 if none yet
+    int channelSlices[2] = {-1, -1};
+
+    JobHandle job;
+    int jobSlice = -1;
+    double jobMilliseconds = 0.0;
+
+    float position = -1.0f;
+    std::size_t computed = 0;
+    double totalMilliseconds = 0.0;
+};
+
+#endif
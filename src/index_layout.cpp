@@ -0,0 +1,417 @@
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <string>
+
+#include "index_layout.hpp"
+#include "parallel.hpp"
+#include "terrain_mesh_builder.hpp"
+
+// Entries of the LRU cache Forsyth's scores model
+static constexpr int forsythCacheSize = 32;
+
+// Grid sizes reported besides nPoints
+static constexpr unsigned int reportedGridSizes[] = {256, 512, 1024};
+
+// FIFO sizes simulated by the report
+static constexpr unsigned int reportedCacheSizes[] = {16, 32};
+
+static constexpr const char* layoutNames[] = {"strip", "rows", "zorder", "hilbert", "forsyth"};
+static_assert(sizeof(layoutNames) / sizeof(layoutNames[0]) == static_cast<std::size_t>(IndexLayout::Count),
+              "Every layout needs a name");
+
+const char* indexLayoutName(const IndexLayout layout) {
+    return layoutNames[static_cast<std::size_t>(layout)];
+}
+
+bool parseIndexLayout(const std::string& name, IndexLayout& layout) {
+    for (std::size_t i = 0; i < static_cast<std::size_t>(IndexLayout::Count); i++) {
+        if (name == layoutNames[i]) {
+            layout = static_cast<IndexLayout>(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+bool GridIndices::isStrip() const {
+    return layout == IndexLayout::Strip;
+}
+
+std::vector<std::uint16_t> GridIndices::narrow() const {
+    std::vector<std::uint16_t> narrowed(indices.size());
+    std::transform(indices.begin(), indices.end(), narrowed.begin(), [](const std::uint32_t index) {
+        return index == restartIndex ? shortRestartIndex : static_cast<std::uint16_t>(index);
+    });
+    return narrowed;
+}
+
+// Quad rows per band: as many as keep the band's vertices below shortRestartIndex, or every row if not even two
+// rows of vertices fit
+static unsigned int bandRows(const unsigned int nPoints, bool& shortIndices) {
+    const unsigned int rows = shortRestartIndex / nPoints;
+    shortIndices = rows >= 2;
+    return shortIndices ? std::min(rows - 1, nPoints - 1) : nPoints - 1;
+}
+
+// Triangles of quad (row, column) as the strip draws them: (v0, v1, v2) and (v2, v1, v3), sharing the v1-v2 diagonal
+static std::uint32_t* emitQuad(std::uint32_t* out, const unsigned int nPoints, const unsigned int row,
+                               const unsigned int column) {
+    const std::uint32_t v1 = row * nPoints + column;
+    const std::uint32_t v0 = v1 + nPoints;
+    const std::uint32_t v2 = v0 + 1;
+    const std::uint32_t v3 = v1 + 1;
+    *out++ = v0;
+    *out++ = v1;
+    *out++ = v2;
+    *out++ = v2;
+    *out++ = v1;
+    *out++ = v3;
+    return out;
+}
+
+static std::uint64_t mortonCode(const std::uint32_t x, const std::uint32_t y) {
+    const auto spread = [](std::uint64_t value) {
+        value = (value | (value << 16)) & 0x0000FFFF0000FFFFull;
+        value = (value | (value << 8)) & 0x00FF00FF00FF00FFull;
+        value = (value | (value << 4)) & 0x0F0F0F0F0F0F0F0Full;
+        value = (value | (value << 2)) & 0x3333333333333333ull;
+        value = (value | (value << 1)) & 0x5555555555555555ull;
+        return value;
+    };
+    return spread(x) | (spread(y) << 1);
+}
+
+// Distance of (x, y) along the Hilbert curve filling a side x side square, side a power of two
+static std::uint64_t hilbertDistance(const std::uint32_t side, std::uint32_t x, std::uint32_t y) {
+    std::uint64_t distance = 0;
+    for (std::uint32_t s = side / 2; s > 0; s /= 2) {
+        const std::uint32_t rx = (x & s) != 0 ? 1 : 0;
+        const std::uint32_t ry = (y & s) != 0 ? 1 : 0;
+        distance += static_cast<std::uint64_t>(s) * s * ((3 * rx) ^ ry);
+        // Rotate the quadrant so the curve continues
+        if (ry == 0) {
+            if (rx == 1) {
+                x = side - 1 - x;
+                y = side - 1 - y;
+            }
+            std::swap(x, y);
+        }
+    }
+    return distance;
+}
+
+// Forsyth's vertex score: recently used vertices score high (the last triangle's three equally), and vertices
+// with few triangles left get a boost so they are finished off instead of being left stranded
+static float forsythScore(const int cachePosition, const std::uint32_t remainingTriangles) {
+    if (remainingTriangles == 0) {
+        return -1.0f;
+    }
+    float score = 0.0f;
+    if (cachePosition >= 0) {
+        score = cachePosition < 3 ? 0.75f : std::pow(1.0f - static_cast<float>(cachePosition - 3) /
+                                                                (forsythCacheSize - 3), 1.5f);
+    }
+    return score + 2.0f / std::sqrt(static_cast<float>(remainingTriangles));
+}
+
+// Reorders a triangle list in place, greedily emitting the best scoring triangle of the vertices in cache
+static void optimizeForsyth(std::uint32_t* indices, const std::size_t indexCount, const std::size_t vertexCount) {
+    const std::size_t triangleCount = indexCount / 3;
+
+    // Triangles of every vertex, the ones not emitted yet first
+    std::vector<std::uint32_t> firstTriangle(vertexCount + 1, 0);
+    for (std::size_t i = 0; i < indexCount; i++) {
+        firstTriangle[indices[i] + 1]++;
+    }
+    for (std::size_t v = 0; v < vertexCount; v++) {
+        firstTriangle[v + 1] += firstTriangle[v];
+    }
+    std::vector<std::uint32_t> vertexTriangles(indexCount);
+    std::vector<std::uint32_t> remaining(vertexCount, 0);
+    for (std::size_t i = 0; i < indexCount; i++) {
+        const std::uint32_t v = indices[i];
+        vertexTriangles[firstTriangle[v] + remaining[v]++] = static_cast<std::uint32_t>(i / 3);
+    }
+
+    std::vector<int> cachePositions(vertexCount, -1);
+    std::vector<float> vertexScores(vertexCount);
+    for (std::size_t v = 0; v < vertexCount; v++) {
+        vertexScores[v] = forsythScore(-1, remaining[v]);
+    }
+    std::vector<float> triangleScores(triangleCount);
+    for (std::size_t t = 0; t < triangleCount; t++) {
+        triangleScores[t] = vertexScores[indices[3 * t]] + vertexScores[indices[3 * t + 1]] +
+                            vertexScores[indices[3 * t + 2]];
+    }
+
+    std::vector<bool> emitted(triangleCount, false);
+    std::vector<std::uint32_t> output;
+    output.reserve(indexCount);
+    std::vector<std::uint32_t> cache;
+    std::vector<std::uint32_t> nextCache;
+    std::size_t nextUnemitted = 0;
+    std::size_t best = 0;
+    bool haveBest = triangleCount > 0;
+    for (std::size_t count = 0; count < triangleCount; count++) {
+        // Nothing in cache has triangles left: continue from the first one not emitted
+        if (!haveBest) {
+            while (emitted[nextUnemitted]) {
+                nextUnemitted++;
+            }
+            best = nextUnemitted;
+        }
+        emitted[best] = true;
+        const std::uint32_t* triangle = &indices[3 * best];
+        output.insert(output.end(), triangle, triangle + 3);
+
+        // Retire the triangle from its vertices and move them to the front of the cache
+        nextCache.assign(triangle, triangle + 3);
+        for (int k = 0; k < 3; k++) {
+            const std::uint32_t v = triangle[k];
+            std::uint32_t* active = &vertexTriangles[firstTriangle[v]];
+            std::swap(*std::find(active, active + remaining[v], static_cast<std::uint32_t>(best)),
+                      active[remaining[v] - 1]);
+            remaining[v]--;
+        }
+        for (const std::uint32_t v : cache) {
+            if (v != triangle[0] && v != triangle[1] && v != triangle[2]) {
+                nextCache.push_back(v);
+            }
+        }
+
+        // Rescore the cache, including the vertices it just pushed out
+        haveBest = false;
+        float bestScore = -std::numeric_limits<float>::infinity();
+        for (std::size_t position = 0; position < nextCache.size(); position++) {
+            const std::uint32_t v = nextCache[position];
+            cachePositions[v] = position < forsythCacheSize ? static_cast<int>(position) : -1;
+            const float score = forsythScore(cachePositions[v], remaining[v]);
+            const float delta = score - vertexScores[v];
+            vertexScores[v] = score;
+            for (std::uint32_t i = 0; i < remaining[v]; i++) {
+                const std::uint32_t t = vertexTriangles[firstTriangle[v] + i];
+                triangleScores[t] += delta;
+                if (cachePositions[v] >= 0 && triangleScores[t] > bestScore) {
+                    bestScore = triangleScores[t];
+                    best = t;
+                    haveBest = true;
+                }
+            }
+        }
+        nextCache.resize(std::min<std::size_t>(nextCache.size(), forsythCacheSize));
+        std::swap(cache, nextCache);
+    }
+    std::copy(output.begin(), output.end(), indices);
+}
+
+// Indices of quad rows [rowBegin, rowEnd), relative to row rowBegin's first vertex
+static void buildBand(const unsigned int nPoints, const IndexLayout layout, const unsigned int rowBegin,
+                      const unsigned int rowEnd, std::uint32_t* out) {
+    const unsigned int rows = rowEnd - rowBegin;
+    const unsigned int columns = nPoints - 1;
+    if (layout == IndexLayout::Strip) {
+        // (bottomLeft, topLeft) per column, as TerrainMeshBuilder::buildIndices
+        for (unsigned int row = 0; row < rows; row++) {
+            for (unsigned int column = 0; column < nPoints; column++) {
+                *out++ = (row + 1) * nPoints + column;
+                *out++ = row * nPoints + column;
+            }
+            *out++ = restartIndex;
+        }
+        return;
+    }
+
+    if (layout == IndexLayout::Rows || layout == IndexLayout::Forsyth) {
+        std::uint32_t* begin = out;
+        for (unsigned int row = 0; row < rows; row++) {
+            for (unsigned int column = 0; column < columns; column++) {
+                out = emitQuad(out, nPoints, row, column);
+            }
+        }
+        if (layout == IndexLayout::Forsyth) {
+            optimizeForsyth(begin, static_cast<std::size_t>(out - begin), static_cast<std::size_t>(rows + 1) * nPoints);
+        }
+        return;
+    }
+
+    // Space filling curves: sort the band's quads by their distance along the curve
+    std::uint32_t side = 1;
+    while (side < std::max(rows, columns)) {
+        side *= 2;
+    }
+    std::vector<std::pair<std::uint64_t, std::uint32_t>> quads;
+    quads.reserve(static_cast<std::size_t>(rows) * columns);
+    for (unsigned int row = 0; row < rows; row++) {
+        for (unsigned int column = 0; column < columns; column++) {
+            const std::uint64_t key = layout == IndexLayout::ZOrder ? mortonCode(column, row)
+                                                                    : hilbertDistance(side, column, row);
+            quads.emplace_back(key, row * columns + column);
+        }
+    }
+    std::sort(quads.begin(), quads.end());
+    for (const auto& quad : quads) {
+        out = emitQuad(out, nPoints, quad.second / columns, quad.second % columns);
+    }
+}
+
+GridIndices buildGridIndices(const unsigned int nPoints, const IndexLayout layout) {
+    GridIndices grid;
+    grid.layout = layout;
+    const unsigned int rowsPerBand = bandRows(nPoints, grid.shortIndices);
+    const std::size_t indicesPerRow = layout == IndexLayout::Strip ? 2 * static_cast<std::size_t>(nPoints) + 1
+                                                                   : 6 * static_cast<std::size_t>(nPoints - 1);
+
+    for (unsigned int row = 0; row < nPoints - 1; row += rowsPerBand) {
+        const unsigned int rows = std::min(rowsPerBand, nPoints - 1 - row);
+        grid.chunks.push_back({static_cast<std::uint32_t>(row * indicesPerRow),
+                               static_cast<std::uint32_t>(rows * indicesPerRow), row * nPoints});
+    }
+    grid.indices.resize(static_cast<std::size_t>(nPoints - 1) * indicesPerRow);
+
+    // Bands are independent
+    parallelFor(0, grid.chunks.size(), [&](const std::size_t begin, const std::size_t end) {
+        for (std::size_t chunk = begin; chunk < end; chunk++) {
+            const auto rowBegin = static_cast<unsigned int>(chunk * rowsPerBand);
+            const unsigned int rowEnd = std::min(rowBegin + rowsPerBand, nPoints - 1);
+            buildBand(nPoints, layout, rowBegin, rowEnd, &grid.indices[grid.chunks[chunk].firstIndex]);
+        }
+    });
+    return grid;
+}
+
+double VertexCacheStats::acmr() const {
+    return triangles == 0 ? 0.0 : static_cast<double>(transforms) / static_cast<double>(triangles);
+}
+
+double VertexCacheStats::atvr() const {
+    return uniqueVertices == 0 ? 0.0 : static_cast<double>(transforms) / static_cast<double>(uniqueVertices);
+}
+
+VertexCacheStats simulateVertexCache(const GridIndices& grid, const unsigned int nPoints,
+                                     const unsigned int cacheSize) {
+    VertexCacheStats stats;
+    std::vector<std::uint32_t> fifo(cacheSize, restartIndex);
+    std::size_t oldest = 0;
+    std::vector<bool> seen(static_cast<std::size_t>(nPoints) * nPoints, false);
+    for (const IndexChunk& chunk : grid.chunks) {
+        std::size_t stripLength = 0;
+        for (std::size_t i = chunk.firstIndex; i < chunk.firstIndex + chunk.indexCount; i++) {
+            if (grid.isStrip() && grid.indices[i] == restartIndex) {
+                stripLength = 0;
+                continue;
+            }
+            const std::uint32_t vertex = grid.indices[i] + chunk.baseVertex;
+            if (std::find(fifo.begin(), fifo.end(), vertex) == fifo.end()) {
+                fifo[oldest] = vertex;
+                oldest = (oldest + 1) % cacheSize;
+                stats.transforms++;
+            }
+            if (!seen[vertex]) {
+                seen[vertex] = true;
+                stats.uniqueVertices++;
+            }
+            // Every strip index past the second completes a triangle
+            if (grid.isStrip() && ++stripLength >= 3) {
+                stats.triangles++;
+            }
+        }
+        if (!grid.isStrip()) {
+            stats.triangles += chunk.indexCount / 3;
+        }
+    }
+    return stats;
+}
+
+// Every triangle of the grid with absolute indices, rotated to start at its smallest index so the winding is kept
+static std::vector<std::array<std::uint32_t, 3>> canonicalTriangles(const GridIndices& grid) {
+    std::vector<std::array<std::uint32_t, 3>> triangles;
+    const auto add = [&triangles](const std::uint32_t a, const std::uint32_t b, const std::uint32_t c) {
+        if (b < a && b < c) {
+            triangles.push_back({b, c, a});
+        } else if (c < a && c < b) {
+            triangles.push_back({c, a, b});
+        } else {
+            triangles.push_back({a, b, c});
+        }
+    };
+    for (const IndexChunk& chunk : grid.chunks) {
+        const std::uint32_t* indices = &grid.indices[chunk.firstIndex];
+        const std::uint32_t base = chunk.baseVertex;
+        if (!grid.isStrip()) {
+            for (std::uint32_t i = 0; i + 2 < chunk.indexCount; i += 3) {
+                add(indices[i] + base, indices[i + 1] + base, indices[i + 2] + base);
+            }
+            continue;
+        }
+        // Odd triangles of a strip swap their first two vertices to keep the winding
+        std::uint32_t stripStart = 0;
+        for (std::uint32_t i = 0; i < chunk.indexCount; i++) {
+            if (indices[i] == restartIndex) {
+                stripStart = i + 1;
+            } else if (i >= stripStart + 2) {
+                const bool odd = (i - stripStart) % 2 == 1;
+                add(indices[i - (odd ? 1 : 2)] + base, indices[i - (odd ? 2 : 1)] + base, indices[i] + base);
+            }
+        }
+    }
+    std::sort(triangles.begin(), triangles.end());
+    return triangles;
+}
+
+int runIndexReport(const unsigned int nPoints) {
+    using Clock = std::chrono::steady_clock;
+    bool consistent = true;
+    std::cout << std::fixed << std::setprecision(2);
+    std::vector<unsigned int> gridSizes = {nPoints};
+    for (const unsigned int size : reportedGridSizes) {
+        if (size != nPoints) {
+            gridSizes.push_back(size);
+        }
+    }
+
+    for (const unsigned int points : gridSizes) {
+        std::cout << "Grid " << points << " x " << points << " (" << static_cast<std::size_t>(points) * points
+                  << " vertices)" << std::endl;
+        std::cout << "  " << std::left << std::setw(10) << "layout" << std::right << std::setw(10) << "MiB"
+                  << std::setw(6) << "bits" << std::setw(8) << "draws" << std::setw(10) << "build ms";
+        for (const unsigned int cacheSize : reportedCacheSizes) {
+            std::cout << std::setw(10) << "ACMR " + std::to_string(cacheSize);
+        }
+        std::cout << std::setw(10) << "ATVR " + std::to_string(reportedCacheSizes[0]) << std::endl;
+
+        std::vector<std::array<std::uint32_t, 3>> reference;
+        for (std::size_t i = 0; i < static_cast<std::size_t>(IndexLayout::Count); i++) {
+            const auto layout = static_cast<IndexLayout>(i);
+            const Clock::time_point start = Clock::now();
+            const GridIndices grid = buildGridIndices(points, layout);
+            const double milliseconds = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+            const std::size_t indexSize = grid.shortIndices ? sizeof(std::uint16_t) : sizeof(std::uint32_t);
+            std::cout << "  " << std::left << std::setw(10) << indexLayoutName(layout) << std::right
+                      << std::setw(10) << static_cast<double>(grid.indices.size() * indexSize) / (1024.0 * 1024.0)
+                      << std::setw(6) << indexSize * 8 << std::setw(8) << grid.chunks.size()
+                      << std::setw(10) << milliseconds;
+            for (const unsigned int cacheSize : reportedCacheSizes) {
+                std::cout << std::setw(10) << simulateVertexCache(grid, points, cacheSize).acmr();
+            }
+            std::cout << std::setw(10) << simulateVertexCache(grid, points, reportedCacheSizes[0]).atvr();
+
+            // Every layout must draw exactly the strip's triangles
+            std::vector<std::array<std::uint32_t, 3>> triangles = canonicalTriangles(grid);
+            if (layout == IndexLayout::Strip) {
+                reference = std::move(triangles);
+            } else if (triangles != reference) {
+                std::cout << "  differs from strip";
+                consistent = false;
+            }
+            std::cout << std::endl;
+        }
+    }
+    return consistent ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,76 @@
+#ifndef INDEX_LAYOUT_HPP
+#define INDEX_LAYOUT_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Triangle orderings of the terrain grid. All of them draw the same triangles, with the same diagonal & winding
+// as the strip, and leave the vertices where TerrainMeshBuilder puts them.
+enum class IndexLayout : std::uint32_t {
+    Strip, // Row-major triangle strips separated by restart indices
+    Rows, // Row-major triangle list
+    ZOrder, // Triangle list visiting quads in Morton order
+    Hilbert, // Triangle list visiting quads along a Hilbert curve
+    Forsyth, // Row-major list reordered by Forsyth's linear-speed vertex cache optimiser
+    Count
+};
+
+const char* indexLayoutName(IndexLayout layout);
+
+// Returns false if name is not one of the indexLayoutName()s
+bool parseIndexLayout(const std::string& name, IndexLayout& layout);
+
+// Indices of one draw, relative to baseVertex
+struct IndexChunk {
+    std::uint32_t firstIndex;
+    std::uint32_t indexCount;
+    std::uint32_t baseVertex;
+};
+
+// Restart index of 16-bit strips; 32-bit strips use restartIndex
+constexpr std::uint16_t shortRestartIndex = 0xFFFF;
+
+// Indices of an nPoints x nPoints grid, split into bands of whole rows. Each band is one chunk, as many rows as
+// keep its vertices addressable with 16-bit indices when the grid allows it.
+struct GridIndices {
+    IndexLayout layout = IndexLayout::Strip;
+    // Relative to their chunk's baseVertex; strip rows end with restartIndex
+    std::vector<std::uint32_t> indices;
+    std::vector<IndexChunk> chunks;
+    // Every relative index fits 16 bits, with shortRestartIndex to spare
+    bool shortIndices = false;
+
+    // GL_TRIANGLE_STRIP with primitive restart, GL_TRIANGLES otherwise
+    bool isStrip() const;
+
+    // indices narrowed to 16 bits, restartIndex mapped to shortRestartIndex. Requires shortIndices.
+    std::vector<std::uint16_t> narrow() const;
+};
+
+// nPoints must be in [2, maxTerrainPoints]
+GridIndices buildGridIndices(unsigned int nPoints, IndexLayout layout);
+
+// Post-transform vertex cache behaviour of an index sequence
+struct VertexCacheStats {
+    std::size_t triangles = 0;
+    // Vertices transformed, i.e. cache misses
+    std::size_t transforms = 0;
+    std::size_t uniqueVertices = 0;
+
+    // Average cache miss ratio: transforms per triangle, 0.5 at best on a large grid
+    double acmr() const;
+    // Average transform to vertex ratio: transforms per unique vertex, 1 at best
+    double atvr() const;
+};
+
+// Replays the indices of nPoints x nPoints grid through a FIFO post-transform cache of cacheSize entries,
+// as most GPUs implement it. Restarts do not flush the cache.
+VertexCacheStats simulateVertexCache(const GridIndices& grid, unsigned int nPoints, unsigned int cacheSize);
+
+// Builds every layout for a few grid sizes, nPoints included, and prints their size, chunking, build time and
+// simulated ACMR / ATVR. Headless; returns a process exit code.
+int runIndexReport(unsigned int nPoints);
+
+#endif
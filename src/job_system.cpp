@@ -0,0 +1,346 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <thread>
+
+#include "job_system.hpp"
+#include "parallel.hpp"
+#include "profiler.hpp"
+
+using Clock = std::chrono::steady_clock;
+
+struct Job {
+    std::function<void()> fn;
+    JobPriority priority = JobPriority::Normal;
+    // Dependencies still running, plus one held by submitJob until every dependency has been registered
+    std::atomic<int> unfinishedDependencies{1};
+    std::atomic<bool> finished{false};
+    // Guards continuations against the job finishing while a dependent registers
+    std::mutex mutex;
+    std::vector<JobHandle> continuations;
+};
+
+// Index of the calling thread's deque, -1 on threads that are not workers
+static thread_local int workerIndex = -1;
+// Jobs the calling thread is running, more than one while a job waits on others
+static thread_local int runningJobs = 0;
+
+namespace {
+
+struct WorkerDeque {
+    std::mutex mutex;
+    std::deque<JobHandle> jobs;
+};
+
+struct WorkerCounters {
+    std::atomic<std::uint64_t> jobs{0};
+    std::atomic<std::uint64_t> steals{0};
+    std::atomic<std::uint64_t> busyNanoseconds{0};
+};
+
+class Scheduler {
+public:
+    explicit Scheduler(unsigned int count);
+    ~Scheduler();
+
+    Scheduler(const Scheduler&) = delete;
+    Scheduler& operator=(const Scheduler&) = delete;
+
+    void push(JobHandle job);
+    void wait(const Job& job);
+
+    JobStats stats() const;
+    void resetStats();
+
+private:
+    void workerLoop(int index);
+    // Runs one queued job, if any; Background ones only when runBackground is set
+    bool runOne(int index, bool runBackground);
+    bool pop(std::mutex& mutex, std::deque<JobHandle>& jobs, bool back, JobHandle& job);
+    void run(const JobHandle& job, int index);
+    void wake();
+
+    std::vector<WorkerDeque> deques;
+    std::vector<WorkerCounters> counters;
+
+    std::mutex sharedMutex;
+    std::deque<JobHandle> shared;
+    std::deque<JobHandle> background;
+
+    // Queued jobs, and the Normal ones among them; incremented once a job is in a queue
+    std::atomic<int> queued{0};
+    std::atomic<int> queuedNormal{0};
+
+    // Idle workers and waiting threads sleep here until a job is queued or finishes
+    std::mutex sleepMutex;
+    std::condition_variable awake;
+    std::atomic<int> sleepers{0};
+    bool stopping = false;
+
+    std::atomic<Clock::rep> statsStart;
+    std::vector<std::thread> threads;
+};
+
+}
+
+Scheduler::Scheduler(const unsigned int count)
+    : deques(count), counters(count + 1), statsStart(Clock::now().time_since_epoch().count()) {
+    for (unsigned int i = 0; i < count; i++) {
+        threads.emplace_back(&Scheduler::workerLoop, this, static_cast<int>(i));
+    }
+}
+
+Scheduler::~Scheduler() {
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        stopping = true;
+    }
+    awake.notify_all();
+    for (auto& thread : threads) {
+        thread.join();
+    }
+}
+
+void Scheduler::push(JobHandle job) {
+    const bool normal = job->priority == JobPriority::Normal;
+    if (normal && workerIndex >= 0 && workerIndex < static_cast<int>(deques.size())) {
+        WorkerDeque& deque = deques[workerIndex];
+        std::lock_guard<std::mutex> lock(deque.mutex);
+        deque.jobs.push_back(std::move(job));
+    } else {
+        std::lock_guard<std::mutex> lock(sharedMutex);
+        (normal ? shared : background).push_back(std::move(job));
+    }
+    if (normal) {
+        queuedNormal.fetch_add(1);
+    }
+    queued.fetch_add(1);
+    wake();
+}
+
+void Scheduler::wake() {
+    if (sleepers.load() > 0) {
+        // Taking the mutex orders this against a sleeper checking its condition
+        { std::lock_guard<std::mutex> lock(sleepMutex); }
+        awake.notify_all();
+    }
+}
+
+bool Scheduler::pop(std::mutex& mutex, std::deque<JobHandle>& jobs, const bool back, JobHandle& job) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (jobs.empty()) {
+        return false;
+    }
+    if (back) {
+        job = std::move(jobs.back());
+        jobs.pop_back();
+    } else {
+        job = std::move(jobs.front());
+        jobs.pop_front();
+    }
+    return true;
+}
+
+bool Scheduler::runOne(const int index, const bool runBackground) {
+    const auto workers = static_cast<int>(deques.size());
+    const bool worker = index >= 0 && index < workers;
+    JobHandle job;
+    // Own deque newest first, then jobs from other threads, then the oldest job of another worker
+    bool found = worker && pop(deques[index].mutex, deques[index].jobs, true, job);
+    found = found || pop(sharedMutex, shared, false, job);
+    for (int i = worker ? 1 : 0; !found && i < workers; i++) {
+        WorkerDeque& victim = deques[(index + i + workers) % workers];
+        if (pop(victim.mutex, victim.jobs, false, job)) {
+            counters[worker ? index : workers].steals.fetch_add(1, std::memory_order_relaxed);
+            found = true;
+        }
+    }
+    if (!found && runBackground && pop(sharedMutex, background, false, job)) {
+        found = true;
+    }
+    if (!found) {
+        return false;
+    }
+    if (job->priority == JobPriority::Normal) {
+        queuedNormal.fetch_sub(1);
+    }
+    queued.fetch_sub(1);
+    run(job, worker ? index : workers);
+    return true;
+}
+
+void Scheduler::run(const JobHandle& job, const int index) {
+    const Clock::time_point start = Clock::now();
+    runningJobs++;
+    {
+        PROFILE_SCOPE("job");
+        job->fn();
+    }
+    job->fn = nullptr;
+    runningJobs--;
+    // Jobs run while another one waits are already part of its busy time
+    WorkerCounters& counter = counters[index];
+    if (runningJobs == 0) {
+        counter.busyNanoseconds.fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            Clock::now() - start).count(), std::memory_order_relaxed);
+    }
+    counter.jobs.fetch_add(1, std::memory_order_relaxed);
+
+    std::vector<JobHandle> continuations;
+    {
+        std::lock_guard<std::mutex> lock(job->mutex);
+        job->finished.store(true);
+        continuations.swap(job->continuations);
+    }
+    for (auto& continuation : continuations) {
+        if (continuation->unfinishedDependencies.fetch_sub(1) == 1) {
+            push(std::move(continuation));
+        }
+    }
+    wake();
+}
+
+void Scheduler::workerLoop(const int index) {
+    PROFILE_THREAD("job worker");
+    workerIndex = index;
+    while (true) {
+        if (runOne(index, true)) {
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(sleepMutex);
+        sleepers.fetch_add(1);
+        awake.wait(lock, [this] { return stopping || queued.load() > 0; });
+        sleepers.fetch_sub(1);
+        // Queued jobs still run when stopping, so no job is left unfinished
+        if (stopping && queued.load() == 0) {
+            return;
+        }
+    }
+}
+
+void Scheduler::wait(const Job& job) {
+    while (!job.finished.load()) {
+        if (runOne(workerIndex, false)) {
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(sleepMutex);
+        sleepers.fetch_add(1);
+        awake.wait(lock, [&] { return job.finished.load() || queuedNormal.load() > 0; });
+        sleepers.fetch_sub(1);
+    }
+}
+
+JobStats Scheduler::stats() const {
+    JobStats stats;
+    const Clock::time_point start{Clock::duration(statsStart.load())};
+    stats.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    for (const auto& counter : counters) {
+        WorkerStats worker;
+        worker.jobs = counter.jobs.load(std::memory_order_relaxed);
+        worker.steals = counter.steals.load(std::memory_order_relaxed);
+        worker.busySeconds = static_cast<double>(counter.busyNanoseconds.load(std::memory_order_relaxed)) * 1e-9;
+        stats.workers.push_back(worker);
+    }
+    return stats;
+}
+
+void Scheduler::resetStats() {
+    for (auto& counter : counters) {
+        counter.jobs.store(0, std::memory_order_relaxed);
+        counter.steals.store(0, std::memory_order_relaxed);
+        counter.busyNanoseconds.store(0, std::memory_order_relaxed);
+    }
+    statsStart.store(Clock::now().time_since_epoch().count());
+}
+
+static std::mutex schedulerMutex;
+static std::unique_ptr<Scheduler> schedulerInstance;
+
+static Scheduler& scheduler() {
+    std::lock_guard<std::mutex> lock(schedulerMutex);
+    if (schedulerInstance == nullptr) {
+        // The thread waiting on the jobs makes up the last worker, but Background jobs need one worker at least
+        schedulerInstance = std::make_unique<Scheduler>(std::max(1u, workerCount() - 1));
+    }
+    return *schedulerInstance;
+}
+
+double JobStats::utilization() const {
+    double busySeconds = 0.0;
+    for (std::size_t i = 0; i + 1 < workers.size(); i++) {
+        busySeconds += workers[i].busySeconds;
+    }
+    const double workerSeconds = seconds * static_cast<double>(workers.size() - 1);
+    return workerSeconds > 0.0 ? std::min(busySeconds / workerSeconds, 1.0) : 0.0;
+}
+
+std::uint64_t JobStats::steals() const {
+    std::uint64_t steals = 0;
+    for (const auto& worker : workers) {
+        steals += worker.steals;
+    }
+    return steals;
+}
+
+JobHandle submitJob(std::function<void()> fn, const std::vector<JobHandle>& dependencies,
+                    const JobPriority priority) {
+    auto job = std::make_shared<Job>();
+    job->fn = std::move(fn);
+    job->priority = priority;
+    Scheduler& jobs = scheduler();
+    for (const auto& dependency : dependencies) {
+        if (dependency == nullptr) {
+            continue;
+        }
+        std::lock_guard<std::mutex> lock(dependency->mutex);
+        if (!dependency->finished.load()) {
+            job->unfinishedDependencies.fetch_add(1);
+            dependency->continuations.push_back(job);
+        }
+    }
+    if (job->unfinishedDependencies.fetch_sub(1) == 1) {
+        jobs.push(job);
+    }
+    return job;
+}
+
+void waitForJob(const JobHandle& job) {
+    if (!isJobFinished(job)) {
+        scheduler().wait(*job);
+    }
+}
+
+bool isJobFinished(const JobHandle& job) {
+    return job == nullptr || job->finished.load();
+}
+
+void restartJobSystem() {
+    std::lock_guard<std::mutex> lock(schedulerMutex);
+    schedulerInstance.reset();
+}
+
+JobStats jobStats() {
+    return scheduler().stats();
+}
+
+void resetJobStats() {
+    scheduler().resetStats();
+}
+
+void printJobStats(const JobStats& stats) {
+    std::cout << std::fixed << std::setprecision(1) << "Jobs over " << stats.seconds << " s, workers "
+              << stats.utilization() * 100.0 << "% busy, " << stats.steals() << " steals" << std::endl;
+    for (std::size_t i = 0; i < stats.workers.size(); i++) {
+        const WorkerStats& worker = stats.workers[i];
+        const double busy = stats.seconds > 0.0 ? worker.busySeconds / stats.seconds * 100.0 : 0.0;
+        std::cout << "  " << std::left << std::setw(10)
+                  << (i + 1 < stats.workers.size() ? "worker " + std::to_string(i) : std::string("others"))
+                  << std::right << std::setw(8) << worker.jobs << " jobs" << std::setw(8) << worker.steals
+                  << " steals" << std::setw(8) << busy << "% busy" << std::endl;
+    }
+}
@@ -0,0 +1,61 @@
+#ifndef JOB_SYSTEM_HPP
+#define JOB_SYSTEM_HPP
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+
+// Work-stealing scheduler behind parallelFor and the texture loader.
+//
+// max(1, workerCount() - 1) worker threads each own a deque: jobs submitted from a worker go to the back of its own
+// deque and are popped from there, most recent first, while idle workers steal the oldest jobs from the front of the
+// others'. Jobs submitted from any other thread go to a shared queue. A job runs once every job it depends on has
+// finished, and a thread waiting on a job runs other jobs meanwhile, so the waiting thread makes up the last worker.
+
+struct Job;
+using JobHandle = std::shared_ptr<Job>;
+
+enum class JobPriority {
+    Normal, // Run by workers and by threads waiting on a job
+    Background // Only run by workers, so a wait never ends up running a long job such as a texture decode
+};
+
+// What one thread did since resetJobStats()
+struct WorkerStats {
+    std::uint64_t jobs = 0;
+    // Jobs taken from another worker's deque
+    std::uint64_t steals = 0;
+    double busySeconds = 0.0;
+};
+
+struct JobStats {
+    double seconds = 0.0;
+    // One per worker thread, then one for all other threads together
+    std::vector<WorkerStats> workers;
+
+    // Busy time of the worker threads over their wall time, in [0, 1]
+    double utilization() const;
+    std::uint64_t steals() const;
+};
+
+// Queues fn to run once every dependency has finished. Dependencies may be finished already, or null.
+JobHandle submitJob(std::function<void()> fn, const std::vector<JobHandle>& dependencies = {},
+                    JobPriority priority = JobPriority::Normal);
+
+// Runs other jobs until job has finished. Null jobs count as finished.
+void waitForJob(const JobHandle& job);
+
+bool isJobFinished(const JobHandle& job);
+
+// Joins the workers once their jobs are done and starts as many as workerCount() asks for. Call while no job is
+// queued, as setWorkerCount does.
+void restartJobSystem();
+
+JobStats jobStats();
+void resetJobStats();
+
+// One line per thread: jobs, steals and utilization
+void printJobStats(const JobStats& stats);
+
+#endif
@@ -1,7 +1,16 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <filesystem>
+#include <iomanip>
 #include <iostream>
+#include <limits>
 #include <vector>
-#include <fstream>
 #include <sstream>
+#include <utility>
 
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
@@ -9,18 +18,57 @@
 #include <glm/gtc/matrix_transform.hpp>
 
 #include "controls.hpp"
+#include "bench.hpp"
 #include "bmp.hpp"
+#include "bmp_tools.hpp"
+#include "camera_path.hpp"
+#include "camera_simulation.hpp"
+#include "frustum.hpp"
+#include "height_pyramid.hpp"
+#include "horizon_map.hpp"
+#include "index_layout.hpp"
+#include "job_system.hpp"
+#include "offscreen.hpp"
+#include "options.hpp"
+#include "profiler.hpp"
+#include "procedural_terrain.hpp"
+#include "program_reflection.hpp"
+#include "render_stats.hpp"
+#include "shader_blocks.hpp"
+#include "shader_program.hpp"
+#include "terrain_mesh_builder.hpp"
+#include "tangent_frame.hpp"
+#include "terrain_bake.hpp"
+#include "terrain_cache.hpp"
+#include "terrain_lod.hpp"
+#include "terrain_lod_indirect.hpp"
+#include "terrain_materials.hpp"
+#include "terrain_query.hpp"
+#include "terrain_tessellation.hpp"
+#include "texture_cache.hpp"
+#include "texture_loader.hpp"
+#include "tile_streamer.hpp"
+#include "tiled_height_map.hpp"
+#include "uniform_ring.hpp"
+#include "vertex_format.hpp"
+
+using Clock = std::chrono::steady_clock;
 
 // Window properties
 static constexpr unsigned int windowWidth = 1268;
 static constexpr unsigned int windowHeight = 720;
 
 // Model properties
-static constexpr unsigned int nPoints = 200; //minimum 2
+unsigned int nPoints = 200; // minimum 2, set with --points
 static constexpr float mScale = 5;
 
-// Model vertex indices
-unsigned int nIndices;
+// Model vertex indices: one draw per chunk, 16-bit where the chunks allow it
+IndexLayout indexLayout = IndexLayout::Hilbert;
+GLenum stripPrimitive;
+GLenum stripIndexType;
+std::vector<GLsizei> stripChunkCounts;
+std::vector<const void*> stripChunkOffsets;
+std::vector<GLint> stripChunkBaseVertices;
 
 // VAO
 GLuint vertexArrayID;
@@ -30,25 +78,48 @@ GLuint vertexBuffer;
 GLuint uvBuffer;
 GLuint tangentBuffer;
 GLuint bitangentBuffer;
+GLuint qtangentBuffer;
 GLuint elementBuffer;
 
 // Texture ids
 GLuint heightMapTextureID;
-GLuint grassTextureID;
-GLuint grassNormalMapID;
-GLuint grassRoughnessMapID;
-GLuint rocksTextureID;
-GLuint rocksNormalMapID;
-GLuint rocksRoughnessMapID;
-GLuint snowTextureID;
-GLuint snowNormalMapID;
-GLuint snowRoughnessMapID;
+
+// Out-of-core height map streamed around the camera instead, set with --tiles
+const char* tiledHeightMapPath = nullptr;
+TileStreamer tileStreamer;
+
+// Default height map, baked with the strip into the terrain cache
+const char* heightMapPath = "assets/mountains_height.bmp";
+
+// Precompiled mesh streams & baked height map kept across runs, set with --terrain-cache ("" to build every run)
+const char* terrainCachePath = "cache/terrain.hmc";
+TerrainCache terrainCache;
+// Set when the height map went through the terrain cache with the strip, leaving loadTextures nothing to load
+bool heightMapInTerrainCache = false;
+
+// Grass, rocks & snow, each taking over from the previous one at its height
+TerrainMaterials terrainMaterials;
+
+// Decodes textures on worker threads, uploads them as they arrive
+TextureLoader textureLoader;
+
+// Material textures uploaded as BC1 / BC5, cached on disk across runs
+bool compressTextures = true;
 
 // Height map scale
 float heightMapScale = 1.75e-6f;
 constexpr float scaleDelta = 5e-8f;
 constexpr float minHeightMapScale = 0.0f;
 constexpr float maxHeightMapScale = 3e-6f;
+// Largest unscaled height, (255 << 16) + (255 << 8) + 255
+constexpr float maxPackedHeight = 16777215.0f;
+
+// Min/max heights & height queries of the height map, built by the baker; only read once heightDataReady is set
+HeightPyramid heightPyramid;
+TerrainQuery terrainQuery(mScale, glm::vec2(0.0f));
+std::atomic<bool> heightDataReady(false);
+// heightMapScale as the camera simulation thread reads it; terrainQuery's heights stay unscaled
+std::atomic<float> groundHeightScale(heightMapScale);
 
 // Light
 glm::vec3 lightDirection_wcs = glm::vec3(0.0f, -0.5f, -0.5f);
@@ -56,8 +127,34 @@ constexpr float rotationDelta = glm::radians(5.0f);
 const glm::vec3 up = glm::vec3(0.0f, 1.0f, 0.0f);
 const glm::vec3 right = glm::vec3(1.0f, 0.0f, 0.0f);
 
-// Id of the shader program loaded
-GLuint programID;
+// Terrain self-shadowing, over terrainQuery's heights
+HorizonMap horizonMap;
+
+// Terrain shader programs, reloaded with R without stalling
+ShaderProgram terrainProgram("src/shaders/main.vert", "src/shaders/main.frag");
+ShaderProgram tessellationProgram("src/shaders/tess.vert", "src/shaders/tess.tesc", "src/shaders/tess.tese",
+                                  "src/shaders/main.frag");
+
+// Uniforms of terrainProgram, resolved once per link
+ProgramReflection programReflection;
+struct ProgramUniforms {
+    GLint lodNode = -1;
+    GLint lodMorphRange = -1;
+    GLint lodIndirect = -1;
+} programUniforms;
+
+// Uniform blocks, streamed through ring buffers
+FrameUniforms frameUniforms;
+UniformRing frameUniformRing(frameUniformsBinding, sizeof(FrameUniforms));
+UniformRing materialUniformRing(materialUniformsBinding, sizeof(MaterialUniforms));
+
+// Terrain shading: ambient, specular & light colours and tiling; materials fill in their count & heights
+MaterialUniforms materialUniforms = {
+    glm::vec3(0.01f), 10.0f,
+    glm::vec3(0.2f), 0,
+    glm::vec3(1.0f), 0.0f,
+    {}
+};
 
 // Wireframing
 bool showWireframe = false;
@@ -65,7 +162,76 @@ bool showWireframe = false;
 // Normal mode - Display normals as colours
 bool normalMode = false;
 
-GLFWwindow* initializeGL() {
+// Packed tangents - One QTangent attribute instead of tangent & bitangent streams
+bool packedTangents = false;
+
+// Compact vertices - One interleaved, quantised vertex buffer
+bool compactVertices = false;
+CompactVertexDecode compactVertexDecode;
+
+// Pulled vertices - The strip is generated by main.vert from vertex & instance IDs, nothing is uploaded
+bool pulledVertices = false;
+
+// Bytes of the strip's vertex & index buffers
+std::size_t stripBufferBytes = 0;
+
+// LOD mode - Quadtree nodes drawn with one shared patch instead of the full strip
+bool lodMode = false;
+TerrainLod terrainLod(mScale, LodSettings());
+LodPatch lodPatch;
+std::vector<LodNode> lodNodes;
+glm::vec2 terrainUV; // (scale, offset) of xz to uv
+
+// VAO & buffers of the shared LOD patch
+GLuint lodVertexArrayID;
+GLuint lodVertexBuffer;
+GLuint lodElementBuffer;
+
+// GPU culling - LOD nodes culled by a compute shader & drawn with one indirect draw where GL 4.3 is available,
+// instead of culled on the CPU & drawn one by one. Turned off with --cpu-culling or C.
+bool gpuCulling = true;
+ShaderProgram lodCullProgram("src/shaders/lod_cull.comp");
+TerrainLodIndirect terrainLodIndirect(maxPackedHeight);
+
+// Tessellated mode - Coarse patches subdivided & displaced on the GPU instead of the full strip
+bool tessellationMode = false;
+TerrainTessellation terrainTessellation(mScale, TessellationSettings());
+
+// Work submitted this frame, shown in the window title
+RenderStats renderStats;
+constexpr double renderStatsInterval = 0.5;
+
+// Camera keyframes file P appends to, set with --camera-path
+const char* cameraPathFile = nullptr;
+
+// Loads of each mode timed by --startup-report
+constexpr unsigned int startupReportRuns = 5;
+
+// Frames rendered before the benchmark starts measuring
+constexpr unsigned int benchWarmupFrames = 10;
+
+double millisecondsSince(const Clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+bool initializeGLEW() {
+    // Try initialising GLEW
+    glewExperimental = true; // Needed for core profile
+    if (glewInit() != GLEW_OK) {
+        std::cerr << "Failed to initialize GLEW" << std::endl;
+        return false;
+    }
+
+    // Early return if GLEW_ARB_debug_output is false
+    if (!GLEW_ARB_debug_output) {
+        std::cerr << "GLEW_ARB_debug_output not found" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// Hidden windows only provide a context; nothing reads their input
+GLFWwindow* initializeGL(const bool visible = true) {
     // Try initialising GLFW
     if (!glfwInit()) {
         std::cerr << "Failed to initialize GLFW" << std::endl;
@@ -78,6 +244,7 @@ GLFWwindow* initializeGL() {
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 2);
     glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE); // To make macOS happy
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    glfwWindowHint(GLFW_VISIBLE, visible ? GLFW_TRUE : GLFW_FALSE);
 
     // Create window
     GLFWwindow* window = glfwCreateWindow(windowWidth, windowHeight, "OpenGLRenderer", nullptr, nullptr);
@@ -90,19 +257,12 @@ GLFWwindow* initializeGL() {
     }
     glfwMakeContextCurrent(window);
 
-    // Try initialising GLEW
-    glewExperimental = true; // Needed for core profile
-    if (glewInit() != GLEW_OK) {
-        std::cerr << "Failed to initialize GLEW" << std::endl;
+    if (!initializeGLEW()) {
         glfwTerminate();
         return nullptr;
     }
-
-    // Early return if GLEW_ARB_debug_output is false
-    if (!GLEW_ARB_debug_output) {
-        std::cerr << "GLEW_ARB_debug_output not found" << std::endl;
-        glfwTerminate();
-        return nullptr;
+    if (!visible) {
+        return window;
     }
 
     glfwSetInputMode(window, GLFW_STICKY_KEYS, GL_TRUE);
@@ -113,94 +273,87 @@ GLFWwindow* initializeGL() {
     return window;
 }
 
-void loadModel() {
-    std::vector<glm::vec3> vertices;
-    std::vector<glm::vec2> uvs;
-    std::vector<unsigned int> indices;
-
-    // Compute vertices and uvs
-    for (unsigned int i = 0; i < nPoints; i++) {
-        float x = mScale * (i / static_cast<float>(nPoints - 1) - 0.5f) * 2.0f;
-
-        for (unsigned int j = 0; j < nPoints; j++) {
-            float z = mScale * (j / static_cast<float>(nPoints - 1) - 0.5f) * 2.0f;
-            vertices.emplace_back(x, 0, z);
-            uvs.emplace_back((i + 0.5f) / static_cast<float>(nPoints - 1),
-                             (j + 0.5f) / static_cast<float>(nPoints - 1));
-        }
-    }
-
-    // Compute indices
-    glEnable(GL_PRIMITIVE_RESTART);
-    constexpr unsigned int restartIndex = std::numeric_limits<std::uint32_t>::max();
-    glPrimitiveRestartIndex(restartIndex);
-    int n = 0;
-    for (unsigned int i = 0; i < nPoints - 1; i++) {
-        for (unsigned int j = 0; j < nPoints; j++) {
-            unsigned int topLeft = n;
-            unsigned int bottomLeft = topLeft + nPoints;
-            indices.push_back(bottomLeft);
-            indices.push_back(topLeft);
-            n++;
-        }
-        indices.push_back(restartIndex);
-    }
-
-    // Calculate tangents for each triangle (v1, v2, v3)
+// Strip streams in the current vertex layout, as loadModel uploads them
+struct StripStreams {
+    TerrainMesh mesh;
+    GridIndices indices;
+    std::vector<std::uint16_t> shortIndices;
     std::vector<glm::vec3> tangents;
     std::vector<glm::vec3> bitangents;
+    std::vector<glm::i16vec4> qtangents;
+    std::vector<CompactVertex> compactVertices;
+};
 
-    for (unsigned int i = 0; i < indices.size(); i += 3) {
-        // CCW even triangles: [v0, v2, v1]
-        // CCW odd triangles:  [v0, v1, v2]
-        bool isEven = i % 2 == 0;
-        unsigned int vi0 = indices[i];
-        unsigned int vi1 = isEven ? indices[i + 2] : indices[i + 1];
-        unsigned int vi2 = isEven ? indices[i + 1] : indices[i + 2];
-
-        // Skip if one of the indices is restartIndex
-        if (vi0 == restartIndex || vi1 == restartIndex || vi2 == restartIndex) {
-            continue;
-        }
-
-        glm::vec3 v0 = vertices[vi0];
-        glm::vec3 v1 = vertices[vi1];
-        glm::vec3 v2 = vertices[vi2];
-
-        glm::vec2 uv0 = uvs[vi0];
-        glm::vec2 uv1 = uvs[vi1];
-        glm::vec2 uv2 = uvs[vi2];
-
-        glm::vec3 e1 = v1 - v0;
-        glm::vec3 e2 = v2 - v0;
-
-        glm::vec2 duv1 = uv1 - uv0;
-        glm::vec2 duv2 = uv2 - uv0;
+template<typename T>
+ByteRange bytesOf(const std::vector<T>& values) {
+    return {values.data(), values.size() * sizeof(T)};
+}
 
-        float r = 1.0f / (duv1.x * duv2.y - duv2.x * duv1.y);
+void buildStrip(StripStreams& strip, TerrainCacheMetadata& metadata, TerrainSections& sections) {
+    metadata.nPoints = nPoints;
+    if (pulledVertices) {
+        return;
+    }
 
-        glm::vec3 tangent = (e1 * duv2.y - e2 * duv1.y) * r;
-        glm::vec3 bitangent = (e2 * duv1.x - e1 * duv2.x) * r;
+    // Vertices & uvs, then their tangent frames, as jobs running alongside the indices in the chosen layout
+    const TerrainMesh& mesh = strip.mesh;
+    const JobHandle meshJob = submitJob([&strip] {
+        PROFILE_SCOPE("buildTerrainMesh");
+        const TerrainMeshBuilder builder(nPoints, mScale);
+        strip.mesh.nPoints = nPoints;
+        strip.mesh.vertices.resize(builder.vertexCount());
+        strip.mesh.uvs.resize(builder.vertexCount());
+        builder.buildVertices(strip.mesh.vertices.data(), strip.mesh.uvs.data());
+    });
+    const JobHandle framesJob = submitJob([&] {
+        if (compactVertices) {
+            // Quantise positions & uvs and interleave them with the packed tangent frame
+            PROFILE_SCOPE("packCompactVertices");
+            const CompactVertexDecode decode = packCompactVertices(mesh, mScale,
+                                                                   packQTangent(gridTangentFrame(mesh), up),
+                                                                   strip.compactVertices);
+            metadata.compactScale = decode.scale;
+            metadata.compactUVRange = decode.uvRange;
+            sections[TerrainSection::CompactVertices] = bytesOf(strip.compactVertices);
+            return;
+        }
 
-        // All the 3 vertices have the same tangent & bitangent
-        tangents.push_back(tangent);
-        tangents.push_back(tangent);
-        tangents.push_back(tangent);
+        // Calculate per-vertex tangent frames, either as two vec3 streams or one packed QTangent
+        PROFILE_SCOPE("generateTangentFrames");
+        sections[TerrainSection::Positions] = bytesOf(mesh.vertices);
+        sections[TerrainSection::UVs] = bytesOf(mesh.uvs);
+        if (packedTangents) {
+            generatePackedTangentFrames(mesh, up, strip.qtangents);
+            sections[TerrainSection::QTangents] = bytesOf(strip.qtangents);
+        } else {
+            generateTangentFrames(mesh, strip.tangents, strip.bitangents);
+            sections[TerrainSection::Tangents] = bytesOf(strip.tangents);
+            sections[TerrainSection::Bitangents] = bytesOf(strip.bitangents);
+        }
+    }, {meshJob});
 
-        bitangents.push_back(bitangent);
-        bitangents.push_back(bitangent);
-        bitangents.push_back(bitangent);
+    {
+        PROFILE_SCOPE("buildGridIndices");
+        strip.indices = buildGridIndices(nPoints, indexLayout);
     }
+    metadata.shortIndices = strip.indices.shortIndices;
+    if (strip.indices.shortIndices) {
+        strip.shortIndices = strip.indices.narrow();
+        sections[TerrainSection::Indices] = bytesOf(strip.shortIndices);
+    } else {
+        sections[TerrainSection::Indices] = bytesOf(strip.indices.indices);
+    }
+    sections[TerrainSection::IndexChunks] = bytesOf(strip.indices.chunks);
+    waitForJob(framesJob);
+}
 
-    // Indexed rendering
-    glGenVertexArrays(1, &vertexArrayID);
-    glBindVertexArray(vertexArrayID);
-
+void bindFloatVertices(const TerrainSections& sections) {
     // Bind vertices buffer
+    const ByteRange& vertices = sections[TerrainSection::Positions];
     glEnableVertexAttribArray(0);
     glGenBuffers(1, &vertexBuffer);
     glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
-    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(glm::vec3), &vertices[0], GL_STATIC_DRAW);
+    glBufferData(GL_ARRAY_BUFFER, static_cast<GLsizeiptr>(vertices.size), vertices.data, GL_STATIC_DRAW);
     glVertexAttribPointer(
         0, // attribute index
         3, // size (x, y ,z)
@@ -211,10 +364,11 @@ void loadModel() {
     );
 
     // Bind uvs buffer
+    const ByteRange& uvs = sections[TerrainSection::UVs];
     glEnableVertexAttribArray(1);
     glGenBuffers(1, &uvBuffer);
     glBindBuffer(GL_ARRAY_BUFFER, uvBuffer);
-    glBufferData(GL_ARRAY_BUFFER, uvs.size() * sizeof(glm::vec2), &uvs[0], GL_STATIC_DRAW);
+    glBufferData(GL_ARRAY_BUFFER, static_cast<GLsizeiptr>(uvs.size), uvs.data, GL_STATIC_DRAW);
     glVertexAttribPointer(
         1, // attribute index
         2, // size (u, v)
@@ -224,210 +378,531 @@ void loadModel() {
         nullptr // array buffer offset
     );
 
-    // Bind tangents buffer
-    glEnableVertexAttribArray(2);
-    glGenBuffers(1, &tangentBuffer);
-    glBindBuffer(GL_ARRAY_BUFFER, tangentBuffer);
-    glBufferData(GL_ARRAY_BUFFER, tangents.size() * sizeof(glm::vec3), &tangents[0], GL_STATIC_DRAW);
-    glVertexAttribPointer(
-        2, // attribute index
-        3, // size (x, y, z)
-        GL_FLOAT, // type of each individual element
-        GL_FALSE, // normalized?
-        0, // stride
-        nullptr // array buffer offset
-    );
+    if (packedTangents) {
+        // Bind QTangents buffer
+        const ByteRange& qtangents = sections[TerrainSection::QTangents];
+        glEnableVertexAttribArray(4);
+        glGenBuffers(1, &qtangentBuffer);
+        glBindBuffer(GL_ARRAY_BUFFER, qtangentBuffer);
+        glBufferData(GL_ARRAY_BUFFER, static_cast<GLsizeiptr>(qtangents.size), qtangents.data, GL_STATIC_DRAW);
+        glVertexAttribPointer(
+            4, // attribute index
+            4, // size (x, y, z, w)
+            GL_SHORT, // type of each individual element
+            GL_TRUE, // normalized?
+            0, // stride
+            nullptr // array buffer offset
+        );
+    } else {
+        // Bind tangents buffer
+        const ByteRange& tangents = sections[TerrainSection::Tangents];
+        glEnableVertexAttribArray(2);
+        glGenBuffers(1, &tangentBuffer);
+        glBindBuffer(GL_ARRAY_BUFFER, tangentBuffer);
+        glBufferData(GL_ARRAY_BUFFER, static_cast<GLsizeiptr>(tangents.size), tangents.data, GL_STATIC_DRAW);
+        glVertexAttribPointer(
+            2, // attribute index
+            3, // size (x, y, z)
+            GL_FLOAT, // type of each individual element
+            GL_FALSE, // normalized?
+            0, // stride
+            nullptr // array buffer offset
+        );
+
+        // Bind bitangents buffer
+        const ByteRange& bitangents = sections[TerrainSection::Bitangents];
+        glEnableVertexAttribArray(3);
+        glGenBuffers(1, &bitangentBuffer);
+        glBindBuffer(GL_ARRAY_BUFFER, bitangentBuffer);
+        glBufferData(GL_ARRAY_BUFFER, static_cast<GLsizeiptr>(bitangents.size), bitangents.data, GL_STATIC_DRAW);
+        glVertexAttribPointer(
+            3, // attribute index
+            3, // size (x, y, z)
+            GL_FLOAT, // type of each individual element
+            GL_FALSE, // normalized?
+            0, // stride
+            nullptr // array buffer offset
+        );
+    }
+}
 
-    // Bind bitangents buffer
-    glEnableVertexAttribArray(3);
-    glGenBuffers(1, &bitangentBuffer);
-    glBindBuffer(GL_ARRAY_BUFFER, bitangentBuffer);
-    glBufferData(GL_ARRAY_BUFFER, bitangents.size() * sizeof(glm::vec3), &bitangents[0], GL_STATIC_DRAW);
+void bindCompactVertices(const TerrainSections& sections) {
+    const ByteRange& vertices = sections[TerrainSection::CompactVertices];
+    glGenBuffers(1, &vertexBuffer);
+    glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+    glBufferData(GL_ARRAY_BUFFER, static_cast<GLsizeiptr>(vertices.size), vertices.data, GL_STATIC_DRAW);
+    glEnableVertexAttribArray(0);
+    glEnableVertexAttribArray(1);
+    glEnableVertexAttribArray(4);
+    if (GLEW_ARB_vertex_attrib_binding) {
+        // Separate format from storage: one buffer binding, three attribute formats
+        glBindVertexBuffer(0, vertexBuffer, 0, sizeof(CompactVertex));
+        glVertexAttribFormat(0, 2, GL_UNSIGNED_SHORT, GL_TRUE, offsetof(CompactVertex, position));
+        glVertexAttribFormat(1, 2, GL_UNSIGNED_SHORT, GL_TRUE, offsetof(CompactVertex, uv));
+        glVertexAttribFormat(4, 4, GL_SHORT, GL_TRUE, offsetof(CompactVertex, qtangent));
+        glVertexAttribBinding(0, 0);
+        glVertexAttribBinding(1, 0);
+        glVertexAttribBinding(4, 0);
+    } else {
+        // Same layout through strided pointers, for GL 4.2 drivers
+        const auto offset = [](const std::size_t bytes) { return reinterpret_cast<const void*>(bytes); };
+        glVertexAttribPointer(0, 2, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(CompactVertex),
+                              offset(offsetof(CompactVertex, position)));
+        glVertexAttribPointer(1, 2, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(CompactVertex),
+                              offset(offsetof(CompactVertex, uv)));
+        glVertexAttribPointer(4, 4, GL_SHORT, GL_TRUE, sizeof(CompactVertex),
+                              offset(offsetof(CompactVertex, qtangent)));
+    }
+}
+
+// Decoded & baked height map, as loadHeightMapTexture bakes it
+struct BakedHeightMap {
+    HeightField field;
+    std::vector<glm::vec3> baked;
+};
+
+bool bakeHeightMap(const char* path, BakedHeightMap& heightMap, TerrainCacheMetadata& metadata,
+                   TerrainSections& sections) {
+    PROFILE_SCOPE("bakeHeightMap");
+    BMPImage image;
+    if (!openBMP(path, image)) {
+        return false;
+    }
+    if (!decodeHeightField(image.view, heightMap.field)) {
+        std::cerr << "Height maps must be 24 bpp BMPs" << std::endl;
+        return false;
+    }
+    heightMap.baked.resize(heightMap.field.heights.size());
+    bakeTerrain(heightMap.field, static_cast<float>(nPoints - 1), heightMap.baked.data());
+
+    metadata.heightMapWidth = static_cast<std::uint32_t>(heightMap.field.width);
+    metadata.heightMapHeight = static_cast<std::uint32_t>(heightMap.field.height);
+    sections[TerrainSection::Heights] = bytesOf(heightMap.field.heights);
+    sections[TerrainSection::BakedHeights] = bytesOf(heightMap.baked);
+    return true;
+}
+
+void uploadHeightMap(const TerrainCacheMetadata& metadata, const TerrainSections& sections) {
+    PROFILE_SCOPE("uploadHeightMap");
+    const auto width = static_cast<GLsizei>(metadata.heightMapWidth);
+    const auto height = static_cast<GLsizei>(metadata.heightMapHeight);
+    glGenTextures(1, &heightMapTextureID);
+    glBindTexture(GL_TEXTURE_2D, heightMapTextureID);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB32F, width, height, 0, GL_RGB, GL_FLOAT,
+                 sections[TerrainSection::BakedHeights].data);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+    // Clamped to edge & no interpolation, as loadPointTexture sets up
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    // Tile bounds for culling & height queries
+    HeightField field;
+    field.width = width;
+    field.height = height;
+    const auto* heights = static_cast<const float*>(sections[TerrainSection::Heights].data);
+    field.heights.assign(heights, heights + static_cast<std::size_t>(width) * height);
+    {
+        PROFILE_SCOPE("buildHeightPyramid");
+        heightPyramid.build(field);
+    }
+    {
+        PROFILE_SCOPE("buildTerrainQuery");
+        terrainQuery.build(std::move(field));
+    }
+    heightDataReady.store(true, std::memory_order_release);
+    heightMapInTerrainCache = true;
+}
+
+void loadModel() {
+    PROFILE_SCOPE("loadModel");
+    const Clock::time_point start = Clock::now();
+
+    // Sections point into the mapped cache when it is up to date, into what is built here otherwise
+    StripStreams strip;
+    BakedHeightMap heightMap;
+    TerrainCacheMetadata metadata;
+    TerrainSections sections;
+
+    // Tiled height maps are streamed instead, the cache then only holds the strip
+    const bool useCache = terrainCachePath != nullptr && terrainCachePath[0] != '\0';
+    const char* cachedHeightMap = tiledHeightMapPath == nullptr ? heightMapPath : "";
+    const TerrainCacheSettings settings = {nPoints, mScale, packedTangents, compactVertices, pulledVertices,
+                                           static_cast<std::uint32_t>(indexLayout)};
+    const std::uint64_t key = useCache ? terrainCacheKey(cachedHeightMap, settings) : 0;
+    const bool cached = useCache && terrainCache.open(terrainCachePath, key, settings);
+    double buildMilliseconds = 0.0;
+    bool written = false;
+    if (cached) {
+        metadata = terrainCache.metadata();
+        sections = terrainCache.sections();
+    } else {
+        // The height map bakes in a job while the strip is built. Without the cache, loadTextures bakes it in
+        // the background instead.
+        bool baked = false;
+        const JobHandle bakeJob = useCache && cachedHeightMap[0] != '\0' ? submitJob([&] {
+            baked = bakeHeightMap(cachedHeightMap, heightMap, metadata, sections);
+        }) : nullptr;
+        buildStrip(strip, metadata, sections);
+        waitForJob(bakeJob);
+        buildMilliseconds = millisecondsSince(start);
+        if (useCache && (baked || cachedHeightMap[0] == '\0')) {
+            PROFILE_SCOPE("writeTerrainCache");
+            written = TerrainCache::write(terrainCachePath, key, metadata, sections);
+        }
+    }
+
+    // Rows of the strip layout are separated by a restart index as wide as the indices
+    glEnable(GL_PRIMITIVE_RESTART);
+    glPrimitiveRestartIndex(metadata.shortIndices ? shortRestartIndex : restartIndex);
+
+    // Indexed rendering, or an empty vertex array for pulled vertices
+    glGenVertexArrays(1, &vertexArrayID);
+    glBindVertexArray(vertexArrayID);
+
+    if (pulledVertices) {
+        stripBufferBytes = 0;
+    } else {
+        if (compactVertices) {
+            compactVertexDecode = {metadata.compactScale, metadata.compactUVRange};
+            bindCompactVertices(sections);
+        } else {
+            bindFloatVertices(sections);
+        }
+
+        // Generate a buffer for the indices as well, drawn chunk by chunk from their base vertices
+        const ByteRange& indices = sections[TerrainSection::Indices];
+        glGenBuffers(1, &elementBuffer);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, elementBuffer);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, static_cast<GLsizeiptr>(indices.size), indices.data, GL_STATIC_DRAW);
+        stripPrimitive = indexLayout == IndexLayout::Strip ? GL_TRIANGLE_STRIP : GL_TRIANGLES;
+        stripIndexType = metadata.shortIndices ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+        const std::size_t indexSize = metadata.shortIndices ? sizeof(std::uint16_t) : sizeof(std::uint32_t);
+        const ByteRange& chunkBytes = sections[TerrainSection::IndexChunks];
+        const auto* chunks = static_cast<const IndexChunk*>(chunkBytes.data);
+        stripChunkCounts.clear();
+        stripChunkOffsets.clear();
+        stripChunkBaseVertices.clear();
+        for (std::size_t i = 0; i < chunkBytes.size / sizeof(IndexChunk); i++) {
+            stripChunkCounts.push_back(static_cast<GLsizei>(chunks[i].indexCount));
+            stripChunkOffsets.push_back(reinterpret_cast<const void*>(chunks[i].firstIndex * indexSize));
+            stripChunkBaseVertices.push_back(static_cast<GLint>(chunks[i].baseVertex));
+        }
+
+        stripBufferBytes = 0;
+        for (const TerrainSection section : {TerrainSection::Positions, TerrainSection::UVs, TerrainSection::Tangents,
+                                             TerrainSection::Bitangents, TerrainSection::QTangents,
+                                             TerrainSection::CompactVertices, TerrainSection::Indices,
+                                             TerrainSection::IndexChunks}) {
+            stripBufferBytes += sections[section].size;
+        }
+    }
+
+    if (sections[TerrainSection::BakedHeights].size != 0) {
+        uploadHeightMap(metadata, sections);
+    }
+    terrainCache.close();
+
+    if (useCache) {
+        const double milliseconds = millisecondsSince(start);
+        std::cout << std::fixed << std::setprecision(2);
+        if (cached) {
+            std::cout << "Terrain loaded from " << terrainCachePath << " in " << milliseconds << " ms" << std::endl;
+        } else {
+            std::cout << "Terrain built in " << buildMilliseconds << " ms" << (written ? ", cached to " : "")
+                      << (written ? terrainCachePath : "") << ", total " << milliseconds << " ms" << std::endl;
+        }
+    }
+}
+
+void loadLodModel() {
+    PROFILE_SCOPE("loadLodModel");
+    lodPatch = buildLodPatch(terrainLod.getSettings().patchSize);
+
+    glGenVertexArrays(1, &lodVertexArrayID);
+    glBindVertexArray(lodVertexArrayID);
+
+    // Bind patch grid points, read as unnormalized floats
+    glEnableVertexAttribArray(0);
+    glGenBuffers(1, &lodVertexBuffer);
+    glBindBuffer(GL_ARRAY_BUFFER, lodVertexBuffer);
+    glBufferData(GL_ARRAY_BUFFER, lodPatch.vertices.size() * sizeof(glm::u16vec2), &lodPatch.vertices[0],
+                 GL_STATIC_DRAW);
     glVertexAttribPointer(
-        3, // attribute index
-        3, // size (x, y, z)
-        GL_FLOAT, // type of each individual element
+        0, // attribute index
+        2, // size (x, z)
+        GL_UNSIGNED_SHORT, // type of each individual element
         GL_FALSE, // normalized?
         0, // stride
         nullptr // array buffer offset
     );
 
-    // Generate a buffer for the indices as well
-    glGenBuffers(1, &elementBuffer);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, elementBuffer);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
+    // Quadrant ranges of the patch, shared by every node
+    glGenBuffers(1, &lodElementBuffer);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, lodElementBuffer);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, lodPatch.indices.size() * sizeof(unsigned short), &lodPatch.indices[0],
+                 GL_STATIC_DRAW);
+
+    // The same patch drawn indirectly, where the context can cull on the GPU
+    if (TerrainLodIndirect::isSupported()) {
+        terrainLodIndirect.load(lodPatch, lodVertexBuffer, lodElementBuffer);
+    } else if (gpuCulling) {
+        std::cout << "GPU culling needs OpenGL 4.3, LOD nodes are culled on the CPU" << std::endl;
+    }
+}
 
-    nIndices = indices.size();
+double timeBufferUpload(const void* data, const std::size_t bytes) {
+    GLuint buffer;
+    glGenBuffers(1, &buffer);
+    glBindBuffer(GL_ARRAY_BUFFER, buffer);
+
+    // Wait for the GPU on both sides so only the transfer is measured
+    glFinish();
+    const double start = glfwGetTime();
+    glBufferData(GL_ARRAY_BUFFER, static_cast<GLsizeiptr>(bytes), data, GL_STATIC_DRAW);
+    glFinish();
+    const double elapsed = glfwGetTime() - start;
+
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glDeleteBuffers(1, &buffer);
+    return elapsed;
 }
 
-void loadPointTexture(const std::string& path, GLuint* textureID) {
-    // Try load .bmp
-    int width, height;
-    const unsigned char* data = nullptr;
-    if (data = loadBMP(path.c_str(), width, height); data == nullptr) {
-        std::cerr << "Failed to load " + path << std::endl;
-        return;
+void printVertexFormatRow(const char* layout, const std::size_t vertexCount, const std::size_t vertexSize,
+                          const double seconds) {
+    const double megabytes = static_cast<double>(vertexCount * vertexSize) / (1024.0 * 1024.0);
+    std::cout << "  " << std::left << std::setw(10) << layout << std::right
+              << std::setw(4) << vertexSize << " B/vertex"
+              << std::setw(10) << megabytes << " MiB"
+              << std::setw(10) << seconds * 1000.0 << " ms"
+              << std::setw(10) << megabytes / 1024.0 / seconds << " GiB/s" << std::endl;
+}
+
+void reportVertexFormats() {
+    std::cout << std::fixed << std::setprecision(2);
+    for (const unsigned int points : {nPoints, 1024u, 2048u, 4096u}) {
+        const TerrainMesh mesh = TerrainMeshBuilder(points, mScale).build();
+        std::cout << "Grid " << points << " x " << points << " (" << mesh.vertices.size() << " vertices)" << std::endl;
+
+        // Four separate float streams, as uploaded by bindFloatVertices
+        std::vector<glm::vec3> tangents;
+        std::vector<glm::vec3> bitangents;
+        generateTangentFrames(mesh, tangents, bitangents);
+        const double floatSeconds =
+            timeBufferUpload(&mesh.vertices[0], mesh.vertices.size() * sizeof(glm::vec3)) +
+            timeBufferUpload(&mesh.uvs[0], mesh.uvs.size() * sizeof(glm::vec2)) +
+            timeBufferUpload(&tangents[0], tangents.size() * sizeof(glm::vec3)) +
+            timeBufferUpload(&bitangents[0], bitangents.size() * sizeof(glm::vec3));
+        printVertexFormatRow("float", mesh.vertices.size(), floatVertexSize, floatSeconds);
+
+        // One interleaved quantised stream, as uploaded by bindCompactVertices
+        std::vector<CompactVertex> compact;
+        packCompactVertices(mesh, mScale, packQTangent(gridTangentFrame(mesh), up), compact);
+        const double compactSeconds = timeBufferUpload(&compact[0], compact.size() * sizeof(CompactVertex));
+        printVertexFormatRow("compact", mesh.vertices.size(), sizeof(CompactVertex), compactSeconds);
+
+        // Nothing at all for pulled vertices, generated by main.vert
+        std::cout << "  " << std::left << std::setw(10) << "pulled" << std::right << std::setw(4) << 0
+                  << " B/vertex, no vertex or index buffers" << std::endl;
     }
+}
 
-    // Bind .bmp to OpenGL texture
-    glGenTextures(1, textureID);
-    glBindTexture(GL_TEXTURE_2D, *textureID);
-    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_BGR, GL_UNSIGNED_BYTE, data);
-    delete[] data;
+void loadPointTexture(const std::string& path, GLuint* textureID) {
+    // Black placeholder, i.e. flat terrain until the height map arrives
+    textureLoader.load(path, textureID, TextureFilter::Point, glm::u8vec3(0, 0, 0));
+}
 
-    // Clamp to edge makes obtaining values outside [0, 1] to repeat the edge value
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    // No interpolation
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    // Generate OpenGL mipmaps for texture
-    glGenerateMipmap(GL_TEXTURE_2D);
+void loadHeightMapTexture(const std::string& path, GLuint* textureID) {
+    // Heights and normal kernel gradients, baked once on a worker thread: (height, nx, nz) as RGB32F
+    const auto cells = static_cast<float>(nPoints - 1);
+    textureLoader.load(path, textureID, TextureFilter::Point, glm::u8vec3(0, 0, 0),
+                       [cells](const ImageView& image, BakedTexture& baked) {
+        PROFILE_SCOPE("bakeHeightMap");
+        HeightField field;
+        if (!decodeHeightField(image, field)) {
+            std::cerr << "Height maps must be 24 bpp BMPs" << std::endl;
+            return false;
+        }
 
-    // Texture already processed, unbind
-    glBindTexture(GL_TEXTURE_2D, -1);
+        baked.width = field.width;
+        baked.height = field.height;
+        baked.internalFormat = GL_RGB32F;
+        baked.format = GL_RGB;
+        baked.type = GL_FLOAT;
+        baked.pixels.resize(field.heights.size() * sizeof(glm::vec3));
+        bakeTerrain(field, cells, reinterpret_cast<glm::vec3*>(baked.pixels.data()));
+
+        // Tile bounds for culling
+        {
+            PROFILE_SCOPE("buildHeightPyramid");
+            heightPyramid.build(field);
+        }
+        {
+            PROFILE_SCOPE("buildTerrainQuery");
+            terrainQuery.build(std::move(field));
+        }
+        heightDataReady.store(true, std::memory_order_release);
+        return true;
+    });
 }
 
-void loadTrilinearTexture(const std::string& path, GLuint* textureID) {
-    // Try load .bmp
-    int width, height;
-    const unsigned char* data = nullptr;
-    if (data = loadBMP(path.c_str(), width, height); data == nullptr) {
-        std::cerr << "Failed to load " + path << std::endl;
+void loadTiledHeightMap(const std::string& path, GLuint* textureID) {
+    // The overview is baked straight away; full resolution tiles arrive as the camera gets near them
+    HeightField minimums;
+    HeightField maximums;
+    if (!tileStreamer.open(path, static_cast<float>(nPoints - 1), textureID, minimums, maximums)) {
+        std::cerr << "Falling back to the default height map" << std::endl;
+        loadHeightMapTexture(heightMapPath, textureID);
         return;
     }
 
-    // Bind .bmp to OpenGL texture
-    glGenTextures(1, textureID);
-    glBindTexture(GL_TEXTURE_2D, *textureID);
-    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_BGR, GL_UNSIGNED_BYTE, data);
-    delete[] data;
-
-    // Repeat texture
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-    // Trilinear interpolation
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-    // Generate OpenGL mipmaps for texture
-    glGenerateMipmap(GL_TEXTURE_2D);
-
-    // Texture already processed, unbind
-    glBindTexture(GL_TEXTURE_2D, -1);
+    // Culling uses the overview's bounds, height queries its maximums so the camera stays above every peak
+    heightPyramid.build(minimums, maximums);
+    terrainQuery.build(std::move(maximums));
+    heightDataReady.store(true, std::memory_order_release);
 }
 
 void loadTextures() {
-    loadPointTexture("assets/mountains_height.bmp", &heightMapTextureID);
-    loadTrilinearTexture("assets/grass.bmp", &grassTextureID);
-    loadTrilinearTexture("assets/grass-r.bmp", &grassRoughnessMapID);
-    loadTrilinearTexture("assets/grass-n.bmp", &grassNormalMapID);
-    loadTrilinearTexture("assets/rocks.bmp", &rocksTextureID);
-    loadTrilinearTexture("assets/rocks-r.bmp", &rocksRoughnessMapID);
-    loadTrilinearTexture("assets/rocks-n.bmp", &rocksNormalMapID);
-    loadTrilinearTexture("assets/snow.bmp", &snowTextureID);
-    loadTrilinearTexture("assets/snow-r.bmp", &snowRoughnessMapID);
-    loadTrilinearTexture("assets/snow-n.bmp", &snowNormalMapID);
-}
-
-bool readAndCompileShader(const char* shader_path, const GLuint& id) {
-    std::string shaderCode;
-    std::ifstream shaderStream(shader_path, std::ios::in);
-
-    // Try read shader file
-    if (shaderStream.is_open()) {
-        std::stringstream sstr;
-        sstr << shaderStream.rdbuf();
-        shaderCode = sstr.str();
-        shaderStream.close();
-    } else {
-        std::cout << "Unable to open " << shader_path << ". Are you in the right directory?" << std::endl;
-        return false;
+    PROFILE_SCOPE("loadTextures");
+    if (tiledHeightMapPath != nullptr) {
+        loadTiledHeightMap(tiledHeightMapPath, &heightMapTextureID);
+    } else if (!heightMapInTerrainCache) {
+        loadHeightMapTexture(heightMapPath, &heightMapTextureID);
     }
 
-    // Compile shader
-    std::cout << "Compiling shader: " << shader_path << std::endl;
-    char const* sourcePointer = shaderCode.c_str();
-    glShaderSource(id, 1, &sourcePointer, nullptr);
-    glCompileShader(id);
-
-    // Report compilation result
-    GLint compilationResult = GL_FALSE;
-    int infoLogLength;
-    glGetShaderiv(id, GL_COMPILE_STATUS, &compilationResult);
-    glGetShaderiv(id, GL_INFO_LOG_LENGTH, &infoLogLength);
-    if (infoLogLength > 0) {
-        std::vector<char> shaderErrorMessage(infoLogLength + 1);
-        glGetShaderInfoLog(id, infoLogLength, nullptr, &shaderErrorMessage[0]);
-        std::cout << &shaderErrorMessage[0] << std::endl;
-    }
-    std::cout << "Compilation of Shader: " << shader_path << " " << (compilationResult == GL_TRUE
-                                                                         ? "Success"
-                                                                         : "Failed!") << std::endl;
-    return compilationResult == 1;
-}
-
-void loadShaders(GLuint& program, const char* vertex_file_path, const char* fragment_file_path) {
-    // Compiles shaders
-    GLuint vertexShaderID = glCreateShader(GL_VERTEX_SHADER);
-    GLuint fragmentShaderID = glCreateShader(GL_FRAGMENT_SHADER);
-    bool vok = readAndCompileShader(vertex_file_path, vertexShaderID);
-    bool fok = readAndCompileShader(fragment_file_path, fragmentShaderID);
-
-    // If both were compiled successfully, try linking
-    if (vok && fok) {
-        GLint result = GL_FALSE;
-        int infoLogLength;
-        std::cout << "Linking program..." << std::endl;
-        program = glCreateProgram();
-        glAttachShader(program, vertexShaderID);
-        glAttachShader(program, fragmentShaderID);
-        glLinkProgram(program);
-        glGetProgramiv(program, GL_LINK_STATUS, &result);
-        glGetProgramiv(program, GL_INFO_LOG_LENGTH, &infoLogLength);
-        if (infoLogLength > 0) {
-            std::vector<char> programErrorMessages(infoLogLength + 1);
-            glGetProgramInfoLog(program, infoLogLength, nullptr, &programErrorMessages[0]);
-            std::cout << programErrorMessages[0];
+    terrainMaterials.add({"assets/grass.bmp", "assets/grass-r.bmp", "assets/grass-n.bmp", 0.0f});
+    terrainMaterials.add({"assets/rocks.bmp", "assets/rocks-r.bmp", "assets/rocks-n.bmp", 0.5f});
+    terrainMaterials.add({"assets/snow.bmp", "assets/snow-r.bmp", "assets/snow-n.bmp", 2.5f});
+    terrainMaterials.load(textureLoader, compressTextures);
+    terrainMaterials.writeUniforms(materialUniforms);
+}
+
+// The C++ images of the blocks must match the layout the compiler chose
+void checkUniformBlocks(const ProgramReflection& reflection) {
+    const std::pair<const char*, std::size_t> blockMembers[] = {
+        {"MVP", offsetof(FrameUniforms, MVP)},
+        {"V", offsetof(FrameUniforms, V)},
+        {"M", offsetof(FrameUniforms, M)},
+        {"lightDirection_wcs", offsetof(FrameUniforms, lightDirection_wcs)},
+        {"heightMapScale", offsetof(FrameUniforms, heightMapScale)},
+        {"cameraPosition_wcs", offsetof(FrameUniforms, cameraPosition_wcs)},
+        {"normalMode", offsetof(FrameUniforms, normalMode)},
+        {"compactVertexDecode", offsetof(FrameUniforms, compactVertexDecode)},
+        {"lodUVTransform", offsetof(FrameUniforms, lodUVTransform)},
+        {"packedTangents", offsetof(FrameUniforms, packedTangents)},
+        {"compactVertices", offsetof(FrameUniforms, compactVertices)},
+        {"lodMode", offsetof(FrameUniforms, lodMode)},
+        {"tiledHeightMap", offsetof(FrameUniforms, tiledHeightMap)},
+        {"heightTileGrid", offsetof(FrameUniforms, heightTileGrid)},
+        {"tessellationGrid", offsetof(FrameUniforms, tessellationGrid)},
+        {"tessellationDetail", offsetof(FrameUniforms, tessellationDetail)},
+        {"pulledGrid", offsetof(FrameUniforms, pulledGrid)},
+        {"pulledVertices", offsetof(FrameUniforms, pulledVertices)},
+        {"specularIntensity", offsetof(MaterialUniforms, specularIntensity)},
+        {"tiles", offsetof(MaterialUniforms, tiles)},
+        {"ambientIntensity", offsetof(MaterialUniforms, ambientIntensity)},
+        {"materialCount", offsetof(MaterialUniforms, materialCount)},
+        {"lightColour", offsetof(MaterialUniforms, lightColour)},
+        {"materialHeights", offsetof(MaterialUniforms, materialHeights)},
+        {"horizonWeights", offsetof(MaterialUniforms, horizonWeights)}
+    };
+    for (const auto& [name, offset] : blockMembers) {
+        const GLint reflected = reflection.blockOffset(name);
+        if (reflected != -1 && static_cast<std::size_t>(reflected) != offset) {
+            std::cerr << "Uniform block member " << name << " is at offset " << reflected << ", expected " << offset
+                      << std::endl;
         }
-        std::cout << "Linking program: " << (result == GL_TRUE ? "Success" : "Failed!") << std::endl;
-    } else {
-        std::cout << "Program will not be linked: one of the shaders has an error" << std::endl;
     }
+}
 
-    // Delete shaders after use
-    glDeleteShader(vertexShaderID);
-    glDeleteShader(fragmentShaderID);
+void reflectProgram() {
+    programReflection.reflect(terrainProgram.id());
+    programUniforms.lodNode = programReflection.location("lodNode");
+    programUniforms.lodMorphRange = programReflection.location("lodMorphRange");
+    programUniforms.lodIndirect = programReflection.location("lodIndirect");
+    checkUniformBlocks(programReflection);
+}
+
+// Only uses the uniform blocks, nothing to keep
+void reflectTessellationProgram() {
+    ProgramReflection reflection;
+    reflection.reflect(tessellationProgram.id());
+    checkUniformBlocks(reflection);
 }
 
 void loadProgram() {
-    programID = glCreateProgram();
-    loadShaders(programID, "src/shaders/main.vert", "src/shaders/main.frag");
+    terrainProgram.load();
+    tessellationProgram.load();
+
+    // Locations change with every link
+    reflectProgram();
+    reflectTessellationProgram();
+
+    // Without its program, LOD nodes are culled on the CPU
+    if (terrainLodIndirect.isLoaded()) {
+        if (lodCullProgram.load()) {
+            terrainLodIndirect.setProgram(lodCullProgram.id());
+        } else {
+            terrainLodIndirect.unload();
+        }
+    }
+}
+
+void reloadPrograms() {
+    terrainProgram.reload();
+    tessellationProgram.reload();
+    if (terrainLodIndirect.isLoaded()) {
+        lodCullProgram.reload();
+    }
+}
+
+// Swaps in programs whose reload has linked
+void updatePrograms() {
+    if (terrainProgram.update()) {
+        reflectProgram();
+    }
+    if (tessellationProgram.update()) {
+        reflectTessellationProgram();
+    }
+    if (terrainLodIndirect.isLoaded() && lodCullProgram.update()) {
+        terrainLodIndirect.setProgram(lodCullProgram.id());
+    }
 }
 
 void unloadModel() {
     glDeleteBuffers(1, &vertexBuffer);
     glDeleteBuffers(1, &uvBuffer);
+    glDeleteBuffers(1, &tangentBuffer);
+    glDeleteBuffers(1, &bitangentBuffer);
+    glDeleteBuffers(1, &qtangentBuffer);
     glDeleteBuffers(1, &elementBuffer);
     glDeleteVertexArrays(1, &vertexArrayID);
 }
 
+void unloadLodModel() {
+    glDeleteBuffers(1, &lodVertexBuffer);
+    glDeleteBuffers(1, &lodElementBuffer);
+    glDeleteVertexArrays(1, &lodVertexArrayID);
+    terrainLodIndirect.unload();
+}
+
 void unloadTextures() {
+    textureLoader.shutdown();
+    horizonMap.unload();
+    tileStreamer.close();
     glDeleteTextures(1, &heightMapTextureID);
-    glDeleteTextures(1, &grassTextureID);
-    glDeleteTextures(1, &grassRoughnessMapID);
-    glDeleteTextures(1, &grassNormalMapID);
-    glDeleteTextures(1, &rocksTextureID);
-    glDeleteTextures(1, &rocksRoughnessMapID);
-    glDeleteTextures(1, &rocksNormalMapID);
-    glDeleteTextures(1, &snowTextureID);
-    glDeleteTextures(1, &snowRoughnessMapID);
-    glDeleteTextures(1, &snowNormalMapID);
+    terrainMaterials.unload();
 }
 
 void unloadShaders() {
-    glDeleteProgram(programID);
+    terrainProgram.destroy();
+    tessellationProgram.destroy();
+    lodCullProgram.destroy();
+    frameUniformRing.destroy();
+    materialUniformRing.destroy();
 }
 
 void toggleWireframe() {
@@ -443,8 +918,32 @@ void toggleNormalMode() {
     normalMode = !normalMode;
 }
 
+// LOD & tessellated modes replace the strip, one at a time
+void toggleLodMode() {
+    lodMode = !lodMode;
+    tessellationMode = false;
+}
+
+void toggleTessellationMode() {
+    tessellationMode = !tessellationMode;
+    lodMode = false;
+}
+
+// Whether LOD mode culls & draws through terrainLodIndirect
+bool isGpuCulling() {
+    return gpuCulling && terrainLodIndirect.isLoaded();
+}
+
+void toggleGpuCulling() {
+    gpuCulling = !gpuCulling;
+    if (gpuCulling && !terrainLodIndirect.isLoaded()) {
+        std::cout << "GPU culling is not available, LOD nodes are culled on the CPU" << std::endl;
+    }
+}
+
 void scaleHeightMapBy(float delta) {
     heightMapScale = glm::clamp(heightMapScale + delta, minHeightMapScale, maxHeightMapScale);
+    groundHeightScale.store(heightMapScale, std::memory_order_relaxed);
 }
 
 void rotateLight(float deltaInRadians, const glm::vec3& axis) {
@@ -452,12 +951,31 @@ void rotateLight(float deltaInRadians, const glm::vec3& axis) {
     lightDirection_wcs = glm::vec3(rotation * glm::vec4(lightDirection_wcs, 0.0f));
 }
 
+// Starts the horizon map once the heights are known, then keeps the slices around the light up to date
+void updateHorizonMap() {
+    if (!horizonMap.hasHeights() && heightDataReady.load(std::memory_order_acquire)) {
+        horizonMap.setHeights(terrainQuery.heightField(), terrainUV.x);
+    }
+    horizonMap.update(lightDirection_wcs);
+    materialUniforms.horizonWeights = horizonMap.weights();
+}
+
+void recordCameraPose() {
+    if (cameraPathFile == nullptr) {
+        std::cout << "Start with --camera-path <path> to record camera keyframes" << std::endl;
+        return;
+    }
+    if (CameraPath::append(cameraPathFile, getCameraPose())) {
+        std::cout << "Camera keyframe appended to " << cameraPathFile << std::endl;
+    }
+}
+
 void keyCallback(GLFWwindow* window, int key, int scancode, int action, int mods) {
     if (action != GLFW_PRESS) return;
 
     switch (key) {
         case GLFW_KEY_R:
-            loadProgram();
+            reloadPrograms();
             break;
         case GLFW_KEY_SPACE:
             toggleWireframe();
@@ -483,104 +1001,604 @@ void keyCallback(GLFWwindow* window, int key, int scancode, int action, int mods
         case GLFW_KEY_N:
             toggleNormalMode();
             break;
+        case GLFW_KEY_L:
+            toggleLodMode();
+            break;
+        case GLFW_KEY_E:
+            toggleTessellationMode();
+            break;
+        case GLFW_KEY_C:
+            toggleGpuCulling();
+            break;
+        case GLFW_KEY_P:
+            recordCameraPose();
+            break;
         default:
             break;
     }
 }
 
-int main() {
+void drawStrip() {
+    glBindVertexArray(vertexArrayID);
+    if (pulledVertices) {
+        // One instance per row strip, two vertices per column
+        glDrawArraysInstanced(
+            GL_TRIANGLE_STRIP, // mode
+            0, // first
+            static_cast<GLsizei>(2 * nPoints), // count
+            static_cast<GLsizei>(nPoints - 1) // instance count
+        );
+    } else {
+        glMultiDrawElementsBaseVertex(
+            stripPrimitive, // mode
+            stripChunkCounts.data(), // counts
+            stripIndexType, // type
+            stripChunkOffsets.data(), // element array buffer offsets
+            static_cast<GLsizei>(stripChunkCounts.size()), // draw count
+            stripChunkBaseVertices.data() // base vertices
+        );
+    }
+
+    renderStats.drawCalls++;
+    renderStats.vertices += static_cast<std::size_t>(nPoints) * nPoints;
+    renderStats.triangles += 2 * static_cast<std::size_t>(nPoints - 1) * (nPoints - 1);
+}
+
+glm::vec2 terrainHeightRange(const glm::vec2& xzMin, const glm::vec2& xzMax) {
+    // Heights are bounded by the largest packed value until the height map is baked
+    if (!heightDataReady.load(std::memory_order_acquire)) {
+        return glm::vec2(0.0f, maxPackedHeight * heightMapScale);
+    }
+    return heightPyramid.range(xzMin * terrainUV.x + terrainUV.y, xzMax * terrainUV.x + terrainUV.y) * heightMapScale;
+}
+
+// Selects nodes by distance alone, then culls & draws them on the GPU
+void drawLodIndirect(const glm::vec3& cameraPosition, const glm::mat4& viewProjectionMatrix) {
+    {
+        PROFILE_SCOPE("selectLodNodes");
+        terrainLod.selectInRange(cameraPosition, terrainHeightRange, lodNodes);
+    }
+    if (!terrainLodIndirect.hasHeights() && heightDataReady.load(std::memory_order_acquire)) {
+        terrainLodIndirect.setHeights(heightPyramid);
+    }
+    {
+        PROFILE_GPU_SCOPE("cullLodNodes");
+        glUseProgram(lodCullProgram.id());
+        terrainLodIndirect.cull(lodNodes, Frustum::fromMatrix(viewProjectionMatrix), terrainUV, heightMapScale);
+    }
+    glUseProgram(terrainProgram.id());
+    glUniform1i(programUniforms.lodIndirect, GL_TRUE);
+    terrainLodIndirect.draw(renderStats);
+}
+
+void drawLod(const glm::vec3& cameraPosition, const glm::mat4& viewProjectionMatrix) {
+    if (isGpuCulling()) {
+        drawLodIndirect(cameraPosition, viewProjectionMatrix);
+        return;
+    }
+
+    // Only tiles whose bounds intersect the view frustum are selected
+    {
+        PROFILE_SCOPE("selectLodNodes");
+        terrainLod.select(cameraPosition, Frustum::fromMatrix(viewProjectionMatrix), terrainHeightRange, lodNodes,
+                          renderStats);
+    }
+
+    const unsigned int patchSize = lodPatch.patchSize;
+    const std::size_t quadrantVertices = static_cast<std::size_t>(patchSize / 2 + 1) * (patchSize / 2 + 1);
+    glBindVertexArray(lodVertexArrayID);
+    glUniform1i(programUniforms.lodIndirect, GL_FALSE);
+    for (const LodNode& node : lodNodes) {
+        // Set per-node uniforms
+        glUniform4f(programUniforms.lodNode, node.origin.x, node.origin.y, node.size, static_cast<float>(patchSize));
+        glUniform2fv(programUniforms.lodMorphRange, 1, &node.morphRange[0]);
+
+        // Each run of consecutive quadrants is one contiguous index range
+        for (unsigned int quadrant = 0; quadrant < 4;) {
+            if ((node.quadrants & (1u << quadrant)) == 0) {
+                quadrant++;
+                continue;
+            }
+            const unsigned int first = quadrant;
+            while (quadrant < 4 && (node.quadrants & (1u << quadrant)) != 0) {
+                quadrant++;
+            }
+            const std::size_t count = (quadrant - first) * lodPatch.quadrantIndexCount;
+            glDrawElements(
+                GL_TRIANGLES, // mode
+                static_cast<GLsizei>(count), // count
+                GL_UNSIGNED_SHORT, // type
+                reinterpret_cast<const void*>(first * lodPatch.quadrantIndexCount * sizeof(unsigned short))
+            );
+
+            renderStats.drawCalls++;
+            renderStats.vertices += node.quadrants == lodQuadrantsAll ? lodPatch.vertices.size()
+                                                                      : (quadrant - first) * quadrantVertices;
+            renderStats.triangles += count / 3;
+        }
+    }
+}
+
+const char* terrainModeName() {
+    return tessellationMode ? "tessellated" : lodMode ? (isGpuCulling() ? "LOD, GPU culled" : "LOD") : "full grid";
+}
+
+void showRenderStats(GLFWwindow* window) {
+    static double lastUpdate = glfwGetTime();
+    const double currentTime = glfwGetTime();
+    if (currentTime - lastUpdate < renderStatsInterval) {
+        return;
+    }
+    lastUpdate = currentTime;
+
+    std::ostringstream title;
+    title << "OpenGLRenderer - " << terrainModeName() << ": " << renderStats.vertices
+          << " vertices, " << renderStats.triangles << " triangles, " << renderStats.drawCalls << " draws";
+    if (lodMode) {
+        title << ", tiles " << renderStats.tilesTested << " tested / " << renderStats.tilesCulled << " culled / "
+              << renderStats.tilesDrawn << " drawn";
+    }
+    if (tileStreamer.isOpen()) {
+        const TileStreamerStats tiles = tileStreamer.stats();
+        title << ", height tiles " << tiles.residentTiles << " resident / " << tiles.missingTiles << " missing";
+    }
+    // Job workers since the last update
+    const JobStats jobs = jobStats();
+    resetJobStats();
+    title << ", jobs " << static_cast<int>(jobs.utilization() * 100.0 + 0.5) << "% busy / " << jobs.steals()
+          << " steals";
+    glfwSetWindowTitle(window, title.str().c_str());
+}
+
+// Draws the terrain seen from the camera into the bound framebuffer
+void renderFrame(const glm::vec3& cameraPosition, const glm::mat4& viewMatrix, const glm::mat4& projectionMatrix) {
+    PROFILE_GPU_SCOPE("renderFrame");
+
+    // No model, default to identity
+    glm::mat4 modelMatrix = glm::mat4(1.0);
+    glm::mat4 modelViewProjectionMatrix = projectionMatrix * viewMatrix * modelMatrix;
+
+    // Use shader program
+    glUseProgram(tessellationMode ? tessellationProgram.id() : terrainProgram.id());
+
+    // Update per-frame & material uniform blocks; unchanged values are not re-sent
+    {
+        PROFILE_SCOPE("updateUniforms");
+        updateHorizonMap();
+        frameUniforms.MVP = modelViewProjectionMatrix;
+        frameUniforms.V = viewMatrix;
+        frameUniforms.M = modelMatrix;
+        frameUniforms.lightDirection_wcs = lightDirection_wcs;
+        frameUniforms.heightMapScale = heightMapScale;
+        frameUniforms.cameraPosition_wcs = cameraPosition;
+        frameUniforms.normalMode = normalMode;
+        frameUniforms.compactVertexDecode = glm::vec2(compactVertexDecode.scale, compactVertexDecode.uvRange);
+        frameUniforms.lodUVTransform = terrainUV;
+        frameUniforms.packedTangents = packedTangents;
+        frameUniforms.compactVertices = compactVertices;
+        frameUniforms.lodMode = lodMode;
+        frameUniforms.tiledHeightMap = tileStreamer.isOpen();
+        frameUniforms.heightTileGrid = tileStreamer.grid();
+        frameUniforms.tessellationGrid = terrainTessellation.grid();
+        frameUniforms.tessellationDetail = terrainTessellation.detail();
+        frameUniforms.pulledGrid = glm::vec2(static_cast<float>(nPoints), mScale);
+        frameUniforms.pulledVertices = pulledVertices;
+        frameUniformRing.update(&frameUniforms);
+        materialUniformRing.update(&materialUniforms);
+    }
+
+    // Bind the height map, the material arrays and the horizon map
+    {
+        PROFILE_SCOPE("bindTextures");
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, heightMapTextureID);
+        terrainMaterials.bind();
+        horizonMap.bind();
+        if (tileStreamer.isOpen()) {
+            tileStreamer.bind();
+        }
+    }
+
+    // Draw
+    PROFILE_GPU_SCOPE("draw");
+    renderStats = RenderStats();
+    if (tessellationMode) {
+        terrainTessellation.draw(renderStats);
+    } else if (lodMode) {
+        drawLod(cameraPosition, modelViewProjectionMatrix);
+    } else {
+        drawStrip();
+    }
+}
+
+// Requests the height tiles around the camera and uploads the ones that are ready
+void streamHeightTiles(const glm::vec3& cameraPosition) {
+    tileStreamer.update(glm::vec2(cameraPosition.x, cameraPosition.z) * terrainUV.x + terrainUV.y);
+}
+
+void initializeRenderState() {
+    glClearColor(0.7f, 0.8f, 1.0f, 0.0f);
+    glEnable(GL_DEPTH_TEST);
+    glDepthFunc(GL_LESS);
+    glEnable(GL_CULL_FACE);
+}
+
+// A hidden window where there is a display, a surfaceless context otherwise. Returns false without either.
+bool initializeHeadlessGL(GLFWwindow*& window) {
+    window = initializeGL(false);
+    if (window != nullptr) {
+        return true;
+    }
+    std::cout << "Falling back to a surfaceless EGL context" << std::endl;
+    if (!createOffscreenContext(4, 2) || !initializeGLEW()) {
+        destroyOffscreenContext();
+        return false;
+    }
+    return true;
+}
+
+void terminateHeadlessGL(GLFWwindow* window) {
+    if (window != nullptr) {
+        glfwTerminate();
+    } else {
+        destroyOffscreenContext();
+    }
+}
+
+int runBench(const Options& options) {
     GLFWwindow* window;
-    if (window = initializeGL(); window == nullptr) {
+    if (!initializeHeadlessGL(window)) {
         return EXIT_FAILURE;
     }
+    const auto closeContext = [window] { terminateHeadlessGL(window); };
 
+    CameraPath path = CameraPath::orbit(mScale);
+    if (options.cameraPath != nullptr && !path.load(options.cameraPath)) {
+        closeContext();
+        return EXIT_FAILURE;
+    }
+
+    // Everything is resident before measuring
     loadModel();
+    loadLodModel();
+    terrainTessellation.load();
     loadTextures();
     loadProgram();
-    glfwSetKeyCallback(window, keyCallback);
+    textureLoader.finish();
+    updateHorizonMap();
+    horizonMap.finish(lightDirection_wcs);
 
-    glClearColor(0.7f, 0.8f, 1.0f, 0.0f);
-    glEnable(GL_DEPTH_TEST);
-    glDepthFunc(GL_LESS);
-    glEnable(GL_CULL_FACE);
+    OffscreenTarget target;
+    if (!target.create(windowWidth, windowHeight)) {
+        closeContext();
+        return EXIT_FAILURE;
+    }
+    target.bind();
+    initializeRenderState();
+
+    std::vector<BenchFrame> frames(options.benchFrames);
+    GpuTimer gpuTimer;
+    Clock::time_point frameStart = Clock::now();
+    for (unsigned int i = 0; i < benchWarmupFrames + options.benchFrames; i++) {
+        // Warm-up frames hold the first pose
+        const bool measured = i >= benchWarmupFrames;
+        const std::size_t frame = measured ? i - benchWarmupFrames : 0;
+        const float t = measured && frames.size() > 1 ? static_cast<float>(frame) / (frames.size() - 1) : 0.0f;
+        setCameraPose(path.sample(t));
+        streamHeightTiles(getCameraPosition());
+
+        if (measured) {
+            gpuTimer.begin(frame);
+        }
+        const Clock::time_point cpuStart = Clock::now();
+        {
+            PROFILE_SCOPE("frame");
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            renderFrame(getCameraPosition(), getViewMatrix(), getProjectionMatrix());
+        }
+        const double cpuMilliseconds = millisecondsSince(cpuStart);
+        if (measured) {
+            gpuTimer.end();
+        }
 
-    do {
-        // Clear the screen
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        // Nothing is presented: flush so the GPU keeps up with the frames being recorded
+        glFlush();
+        if (measured) {
+            frames[frame].cpuMilliseconds = cpuMilliseconds;
+            frames[frame].frameMilliseconds = millisecondsSince(frameStart);
+            frames[frame].stats = renderStats;
+        }
+        PROFILE_COLLECT();
+        frameStart = Clock::now();
+    }
+    gpuTimer.finish();
+    for (std::size_t i = 0; i < frames.size(); i++) {
+        frames[i].gpuMilliseconds = gpuTimer.milliseconds(i);
+    }
 
-        // Compute the MVP matrix from keyboard and mouse input
-        computeMatrices(window, windowWidth, windowHeight);
-        glm::mat4 projectionMatrix = getProjectionMatrix();
-        glm::mat4 viewMatrix = getViewMatrix();
-        // No model, default to identity
-        glm::mat4 modelMatrix = glm::mat4(1.0);
-        glm::mat4 modelViewProjectionMatrix = projectionMatrix * viewMatrix * modelMatrix;
+    BenchInfo info;
+    info.renderer = reinterpret_cast<const char*>(glGetString(GL_RENDERER));
+    info.mode = std::string(terrainModeName()) +
+                (pulledVertices ? ", pulled vertices" : compactVertices ? ", compact vertices"
+                                  : packedTangents ? ", packed tangents" : "") +
+                (pulledVertices ? "" : std::string(", ") + indexLayoutName(indexLayout) + " indices") +
+                (tileStreamer.isOpen() ? ", tiled height map" : "");
+    info.nPoints = nPoints;
+    info.width = windowWidth;
+    info.height = windowHeight;
+    printBenchSummary(info, frames);
+    std::cout << "Strip vertex & index buffers: " << std::fixed << std::setprecision(2)
+              << static_cast<double>(stripBufferBytes) / (1024.0 * 1024.0) << " MiB" << std::endl;
+    std::cout << "Horizon map: " << horizonMap.slicesComputed() << " slices computed, "
+              << horizonMap.meanSliceMilliseconds() << " ms each" << std::endl;
+    if (tileStreamer.isOpen()) {
+        const TileStreamerStats tiles = tileStreamer.stats();
+        std::cout << "Height tiles: " << tiles.tilesRead << " read, " << tiles.tilesUploaded << " uploaded, "
+                  << tiles.memoryEvictions << " evicted from RAM, " << tiles.gpuEvictions << " from the atlas, "
+                  << tiles.residentTiles << " resident, " << tiles.missingTiles << " missing" << std::endl;
+    }
+    printJobStats(jobStats());
+    const bool written = writeBenchResults(options.benchOutputPath, info, frames);
+    if (options.profilePath != nullptr) {
+        writeProfile(options.profilePath);
+    }
 
-        // Use shader program
-        glUseProgram(programID);
+    gpuTimer.destroy();
+    target.destroy();
+    unloadModel();
+    unloadLodModel();
+    terrainTessellation.unload();
+    unloadShaders();
+    unloadTextures();
+    closeContext();
+    return written ? EXIT_SUCCESS : EXIT_FAILURE;
+}
 
-        // Set matrix uniforms
-        const GLuint mvpID = glGetUniformLocation(programID, "MVP");
-        glUniformMatrix4fv(mvpID, 1, GL_FALSE, &modelViewProjectionMatrix[0][0]);
+// Milliseconds until the strip & height map are uploaded and usable, GPU included; unloads them again
+double timeTerrainStartup() {
+    glFinish();
+    const Clock::time_point start = Clock::now();
+    loadModel();
+    if (!heightMapInTerrainCache) {
+        loadHeightMapTexture(heightMapPath, &heightMapTextureID);
+        textureLoader.finish();
+    }
+    glFinish();
+    const double milliseconds = millisecondsSince(start);
 
-        const GLuint viewID = glGetUniformLocation(programID, "V");
-        glUniformMatrix4fv(viewID, 1, GL_FALSE, &viewMatrix[0][0]);
+    unloadModel();
+    glDeleteTextures(1, &heightMapTextureID);
+    heightDataReady.store(false, std::memory_order_release);
+    heightMapInTerrainCache = false;
+    return milliseconds;
+}
 
-        const GLuint modelID = glGetUniformLocation(programID, "M");
-        glUniformMatrix4fv(modelID, 1, GL_FALSE, &modelMatrix[0][0]);
+int runStartupReport() {
+    GLFWwindow* window;
+    if (!initializeHeadlessGL(window)) {
+        return EXIT_FAILURE;
+    }
 
-        // Set heightMapScale uniform
-        const GLuint heightMapScaleID = glGetUniformLocation(programID, "heightMapScale");
-        glUniform1f(heightMapScaleID, heightMapScale);
+    // A cache of its own, so the report leaves the renderer's untouched
+    std::error_code error;
+    const std::string reportCachePath =
+        (std::filesystem::temp_directory_path(error) / "heightmap-startup-report.hmc").string();
+    struct Mode {
+        const char* name;
+        const char* cachePath;
+        bool cold;
+    };
+    const Mode modes[] = {
+        {"no cache", "", false},
+        {"cold cache", reportCachePath.c_str(), true},
+        {"cached", reportCachePath.c_str(), false}
+    };
+
+    std::vector<std::pair<const char*, std::vector<double>>> results;
+    for (const Mode& mode : modes) {
+        terrainCachePath = mode.cachePath;
+        std::vector<double> milliseconds;
+        for (unsigned int run = 0; run < startupReportRuns; run++) {
+            if (mode.cold) {
+                std::filesystem::remove(reportCachePath, error);
+            }
+            milliseconds.push_back(timeTerrainStartup());
+        }
+        std::sort(milliseconds.begin(), milliseconds.end());
+        results.emplace_back(mode.name, std::move(milliseconds));
+    }
+    const auto cacheSize = std::filesystem::file_size(reportCachePath, error);
+
+    std::cout << std::fixed << std::setprecision(2) << "Terrain startup, " << nPoints << " x " << nPoints
+              << " grid & " << heightMapPath << ", " << startupReportRuns << " runs, cache "
+              << (error ? 0.0 : static_cast<double>(cacheSize) / (1024.0 * 1024.0)) << " MiB" << std::endl
+              << "  " << std::left << std::setw(12) << "ms" << std::right << std::setw(10) << "median"
+              << std::setw(10) << "min" << std::endl;
+    for (const auto& [name, milliseconds] : results) {
+        std::cout << "  " << std::left << std::setw(12) << name << std::right
+                  << std::setw(10) << milliseconds[milliseconds.size() / 2]
+                  << std::setw(10) << milliseconds.front() << std::endl;
+    }
 
-        // Set uniform light properties
-        const GLuint lightDirectionID = glGetUniformLocation(programID, "lightDirection_wcs");
-        glUniform3fv(lightDirectionID, 1, &lightDirection_wcs[0]);
+    std::filesystem::remove(reportCachePath, error);
+    textureLoader.shutdown();
+    terminateHeadlessGL(window);
+    return EXIT_SUCCESS;
+}
 
-        // Set the nPoints uniform
-        const GLuint nPointsID = glGetUniformLocation(programID, "nPoints");
-        glUniform1f(nPointsID, static_cast<float>(nPoints - 1));
+int main(int argc, char** argv) {
+    PROFILE_THREAD("main");
+    Options options;
+    if (!parseOptions(argc, argv, options)) {
+        return EXIT_FAILURE;
+    }
+    // Headless tools run without a window
+    if (options.bmpBenchmarkPath != nullptr) {
+        return runBMPBenchmark(options.bmpBenchmarkPath, options.iterations);
+    }
+    if (options.bmpFuzzPath != nullptr) {
+        return runBMPFuzz(options.bmpFuzzPath, options.iterations, options.seed);
+    }
+    if (options.meshCheck) {
+        return runMeshCheck();
+    }
+    if (options.bakeCheckPath != nullptr) {
+        return runBakeCheck(options.bakeCheckPath, options.nPoints, heightMapScale);
+    }
+    if (options.cullCheckPath != nullptr) {
+        return runCullCheck(options.cullCheckPath, options.nPoints, mScale, heightMapScale);
+    }
+    if (options.horizonCheckPath != nullptr) {
+        return runHorizonCheck(options.horizonCheckPath, terrainUVTransform(mScale, options.nPoints).x,
+                               heightMapScale);
+    }
+    if (options.textureReportPath != nullptr) {
+        return runCompressionReport(options.textureReportPath, options.textureCacheDirectory);
+    }
+    if (options.makeTilesPath != nullptr) {
+        return runMakeTiles(options.makeTilesPath, options.makeTilesOutputPath, options.tileSize);
+    }
+    if (options.generatePath != nullptr || options.generatorBenchmark) {
+        ProceduralSettings settings;
+        settings.size = options.generateSize;
+        settings.seed = options.seed;
+        return options.generatorBenchmark ? runGeneratorBenchmark(settings)
+                                          : runGenerateTerrain(settings, options.generatePath, options.tileSize);
+    }
+    if (options.indexReport) {
+        return runIndexReport(options.nPoints);
+    }
+    if (options.queryBenchmarkPath != nullptr) {
+        return runQueryBenchmark(options.queryBenchmarkPath, options.nPoints, mScale, heightMapScale,
+                                 options.iterations, options.seed);
+    }
 
-        // Set normalMode uniform
-        const GLuint normalModeId = glGetUniformLocation(programID, "normalMode");
-        glUniform1i(normalModeId, normalMode);
+    nPoints = options.nPoints;
+    packedTangents = options.packedTangents || options.compactVertices;
+    compactVertices = options.compactVertices;
+    pulledVertices = options.pulledVertices;
+    indexLayout = options.indexLayout;
+    lodMode = options.lod;
+    tessellationMode = options.tessellation && !options.lod;
+    gpuCulling = !options.cpuCulling;
+    cameraPathFile = options.cameraPath;
+    tiledHeightMapPath = options.tiledHeightMapPath;
+    terrainCachePath = options.terrainCachePath;
+    compressTextures = !options.uncompressedTextures;
+    textureLoader.setCacheDirectory(options.textureCacheDirectory);
+    terrainProgram.setCacheDirectory(options.shaderCacheDirectory);
+    tessellationProgram.setCacheDirectory(options.shaderCacheDirectory);
+    lodCullProgram.setCacheDirectory(options.shaderCacheDirectory);
+
+    // The finest LOD level is at least as dense as the nPoints grid
+    LodSettings lodSettings;
+    lodSettings.levels = lodLevelCount(nPoints, lodSettings.patchSize);
+    terrainLod = TerrainLod(mScale, lodSettings);
+    terrainLod.setProjection(getFieldOfView(), static_cast<float>(windowHeight));
+    terrainTessellation.setProjection(getFieldOfView(), static_cast<float>(windowHeight));
+    terrainUV = terrainUVTransform(mScale, nPoints);
+
+    // Keep the camera above the terrain once its heights are known
+    terrainQuery = TerrainQuery(mScale, terrainUV);
+    setGroundHeight([](const glm::vec2& xz) {
+        const bool onTerrain = std::abs(xz.x) <= mScale && std::abs(xz.y) <= mScale;
+        if (!onTerrain || !heightDataReady.load(std::memory_order_acquire)) {
+            return -std::numeric_limits<float>::infinity();
+        }
+        return terrainQuery.height(xz) * groundHeightScale.load(std::memory_order_relaxed);
+    });
 
-        // Bind texture ids to textures
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, heightMapTextureID);
-        glActiveTexture(GL_TEXTURE1);
-        glBindTexture(GL_TEXTURE_2D, grassTextureID);
-        glActiveTexture(GL_TEXTURE2);
-        glBindTexture(GL_TEXTURE_2D, grassRoughnessMapID);
-        glActiveTexture(GL_TEXTURE3);
-        glBindTexture(GL_TEXTURE_2D, grassNormalMapID);
-        glActiveTexture(GL_TEXTURE4);
-        glBindTexture(GL_TEXTURE_2D, rocksTextureID);
-        glActiveTexture(GL_TEXTURE5);
-        glBindTexture(GL_TEXTURE_2D, rocksRoughnessMapID);
-        glActiveTexture(GL_TEXTURE6);
-        glBindTexture(GL_TEXTURE_2D, rocksNormalMapID);
-        glActiveTexture(GL_TEXTURE7);
-        glBindTexture(GL_TEXTURE_2D, snowTextureID);
-        glActiveTexture(GL_TEXTURE8);
-        glBindTexture(GL_TEXTURE_2D, snowRoughnessMapID);
-        glActiveTexture(GL_TEXTURE9);
-        glBindTexture(GL_TEXTURE_2D, snowNormalMapID);
-
-        // Draw
-        glDrawElements(
-            GL_TRIANGLE_STRIP, // mode
-            static_cast<GLsizei>(nIndices), // count
-            GL_UNSIGNED_INT, // type
-            nullptr // element array buffer offset
-        );
+    if (options.startupReport) {
+        return runStartupReport();
+    }
+    if (options.benchOutputPath != nullptr) {
+        return runBench(options);
+    }
+
+    GLFWwindow* window;
+    if (window = initializeGL(); window == nullptr) {
+        return EXIT_FAILURE;
+    }
+
+    if (options.vertexReport) {
+        reportVertexFormats();
+        glfwTerminate();
+        return EXIT_SUCCESS;
+    }
+
+    {
+        PROFILE_SCOPE("startup");
+        loadModel();
+        loadLodModel();
+        terrainTessellation.load();
+        loadTextures();
+        loadProgram();
+    }
+    glfwSetKeyCallback(window, keyCallback);
+    initializeRenderState();
+
+    // The camera steps on its own thread at a fixed tick unless serial; frames render its interpolated pose
+    CameraSimulation cameraSimulation(options.tickRate);
+    CameraInput cameraInput;
+    if (!options.serialFrames) {
+        cameraSimulation.start(getCameraPose());
+    }
+    FrameTimeStats frameTimes;
+    Clock::time_point frameStart = Clock::now();
+
+    do {
+        PROFILE_SCOPE("frame");
+
+        // Replace placeholders with textures that finished decoding, and the program once a reload has linked
+        textureLoader.update();
+        updatePrograms();
+
+        // Clear the screen
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+        // Compute the MVP matrix from keyboard and mouse input
+        {
+            PROFILE_SCOPE("computeMatrices");
+            if (cameraSimulation.isRunning()) {
+                sampleCameraInput(window, windowWidth, windowHeight, cameraInput);
+                cameraSimulation.publishInput(cameraInput);
+                setCameraPose(cameraSimulation.pose(Clock::now()));
+            } else {
+                computeMatrices(window, windowWidth, windowHeight);
+            }
+        }
+        streamHeightTiles(getCameraPosition());
+        renderFrame(getCameraPosition(), getViewMatrix(), getProjectionMatrix());
+        showRenderStats(window);
 
         // Swap buffers and poll events to update screen properly
-        glfwSwapBuffers(window);
+        {
+            PROFILE_GPU_SCOPE("swapBuffers");
+            glfwSwapBuffers(window);
+        }
         glfwPollEvents();
+        PROFILE_COLLECT();
+
+        const Clock::time_point frameEnd = Clock::now();
+        frameTimes.addFrame(std::chrono::duration<double, std::milli>(frameEnd - frameStart).count());
+        frameStart = frameEnd;
     } while (glfwGetKey(window, GLFW_KEY_ESCAPE) != GLFW_PRESS && glfwWindowShouldClose(window) == 0);
 
+    cameraSimulation.stop();
+    if (options.serialFrames) {
+        frameTimes.print("Frame times, camera stepped every frame");
+    } else {
+        frameTimes.print("Frame times, camera at " + std::to_string(options.tickRate) + " Hz, " +
+                         std::to_string(cameraSimulation.ticks()) + " ticks, " +
+                         std::to_string(cameraSimulation.lateTicks()) + " late");
+    }
+
+    if (options.profilePath != nullptr) {
+        writeProfile(options.profilePath);
+    }
     unloadModel();
+    unloadLodModel();
+    terrainTessellation.unload();
     unloadShaders();
     unloadTextures();
     glfwTerminate();
@@ -0,0 +1,110 @@
+#include <algorithm>
+#include <utility>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "mapped_file.hpp"
+
+MappedFile::MappedFile(const char* path) {
+#ifdef _WIN32
+    const HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                                    FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        return;
+    }
+    LARGE_INTEGER fileSize;
+    if (GetFileSizeEx(file, &fileSize) && fileSize.QuadPart > 0) {
+        // The view keeps the mapping object alive, both handles can be closed straight away
+        const HANDLE fileMapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (fileMapping != nullptr) {
+            mapping = static_cast<const unsigned char*>(MapViewOfFile(fileMapping, FILE_MAP_READ, 0, 0, 0));
+            length = mapping != nullptr ? static_cast<std::size_t>(fileSize.QuadPart) : 0;
+            CloseHandle(fileMapping);
+        }
+    }
+    CloseHandle(file);
+#else
+    const int file = open(path, O_RDONLY);
+    if (file < 0) {
+        return;
+    }
+    struct stat status{};
+    if (fstat(file, &status) == 0 && status.st_size > 0) {
+        // The mapping outlives the descriptor, close it straight away
+        void* view = mmap(nullptr, static_cast<std::size_t>(status.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+        if (view != MAP_FAILED) {
+            mapping = static_cast<const unsigned char*>(view);
+            length = static_cast<std::size_t>(status.st_size);
+        }
+    }
+    ::close(file);
+#endif
+}
+
+MappedFile::~MappedFile() {
+    close();
+}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept
+    : mapping(std::exchange(other.mapping, nullptr)), length(std::exchange(other.length, 0)) {
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept {
+    if (this != &other) {
+        close();
+        mapping = std::exchange(other.mapping, nullptr);
+        length = std::exchange(other.length, 0);
+    }
+    return *this;
+}
+
+bool MappedFile::isOpen() const {
+    return mapping != nullptr;
+}
+
+const unsigned char* MappedFile::data() const {
+    return mapping;
+}
+
+std::size_t MappedFile::size() const {
+    return length;
+}
+
+void MappedFile::evict(const std::size_t offset, const std::size_t size) const {
+    if (mapping == nullptr || offset >= length) {
+        return;
+    }
+#ifdef _WIN32
+    // Windows trims the working set of file views on its own
+    (void) size;
+#else
+    const auto pageSize = static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+    const std::size_t begin = (offset + pageSize - 1) / pageSize * pageSize;
+    const std::size_t end = std::min(offset + size, length) / pageSize * pageSize;
+    if (begin < end) {
+        madvise(const_cast<unsigned char*>(mapping) + begin, end - begin, MADV_DONTNEED);
+    }
+#endif
+}
+
+void MappedFile::close() {
+    if (mapping == nullptr) {
+        return;
+    }
+#ifdef _WIN32
+    UnmapViewOfFile(mapping);
+#else
+    munmap(const_cast<unsigned char*>(mapping), length);
+#endif
+    mapping = nullptr;
+    length = 0;
+}
@@ -0,0 +1,33 @@
+#ifndef MAPPED_FILE_HPP
+#define MAPPED_FILE_HPP
+
+#include <cstddef>
+
+// Read-only memory mapping of a whole file. The mapping lives as long as the object.
+class MappedFile {
+public:
+    MappedFile() = default;
+    explicit MappedFile(const char* path);
+    ~MappedFile();
+
+    MappedFile(MappedFile&& other) noexcept;
+    MappedFile& operator=(MappedFile&& other) noexcept;
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool isOpen() const;
+    const unsigned char* data() const;
+    std::size_t size() const;
+
+    // Drops the pages of [offset, offset + size) from the resident set; they are read from the file again
+    // if touched later. Only whole pages inside the range are dropped.
+    void evict(std::size_t offset, std::size_t size) const;
+
+private:
+    void close();
+
+    const unsigned char* mapping = nullptr;
+    std::size_t length = 0;
+};
+
+#endif
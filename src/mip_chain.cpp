@@ -0,0 +1,61 @@
+#include <algorithm>
+
+#include "mip_chain.hpp"
+
+static std::size_t paddedStride(const int width, const int channels) {
+    return (static_cast<std::size_t>(width) * channels + 3) & ~static_cast<std::size_t>(3);
+}
+
+// 2x2 box filter, the last row/column is repeated for odd sizes
+static MipLevel downsample(const RowAccessor& row, const int width, const int height, const int channels) {
+    MipLevel level;
+    level.width = std::max(1, width / 2);
+    level.height = std::max(1, height / 2);
+    level.stride = paddedStride(level.width, channels);
+    level.pixels.resize(level.stride * level.height);
+
+    for (int y = 0; y < level.height; y++) {
+        const unsigned char* row0 = row(std::min(2 * y, height - 1));
+        const unsigned char* row1 = row(std::min(2 * y + 1, height - 1));
+        unsigned char* destination = &level.pixels[y * level.stride];
+        for (int x = 0; x < level.width; x++) {
+            const int x0 = std::min(2 * x, width - 1) * channels;
+            const int x1 = std::min(2 * x + 1, width - 1) * channels;
+            for (int c = 0; c < channels; c++) {
+                const int sum = row0[x0 + c] + row0[x1 + c] + row1[x0 + c] + row1[x1 + c];
+                destination[x * channels + c] = static_cast<unsigned char>((sum + 2) / 4);
+            }
+        }
+    }
+    return level;
+}
+
+RowAccessor MipLevel::rows() const {
+    const unsigned char* first = pixels.data();
+    const std::size_t rowStride = stride;
+    return [first, rowStride](const int y) { return first + y * rowStride; };
+}
+
+int mipChannels(const PixelFormat format) {
+    switch (format) {
+        case PixelFormat::R8: return 1;
+        case PixelFormat::BGR8: return 3;
+        case PixelFormat::BGRA8: return 4;
+        default: return 0;
+    }
+}
+
+std::vector<MipLevel> buildMipChain(const ImageView& image, const int channels) {
+    std::vector<MipLevel> levels;
+    RowAccessor row = [&image](const int y) { return image.row(y); };
+    int width = image.width;
+    int height = image.height;
+    while (width > 1 || height > 1) {
+        levels.push_back(downsample(row, width, height, channels));
+        // Moving a level keeps its pixel buffer, so the accessor survives the vector growing
+        row = levels.back().rows();
+        width = levels.back().width;
+        height = levels.back().height;
+    }
+    return levels;
+}
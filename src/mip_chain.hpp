@@ -0,0 +1,30 @@
+#ifndef MIP_CHAIN_HPP
+#define MIP_CHAIN_HPP
+
+#include <cstddef>
+#include <functional>
+#include <vector>
+
+#include "bmp.hpp"
+
+// Row y of an image counted from the bottom, rows being stored bottom-up as OpenGL expects
+using RowAccessor = std::function<const unsigned char*(int)>;
+
+// One generated mipmap level, bottom-up rows padded to 4 bytes like BMP rows
+struct MipLevel {
+    int width;
+    int height;
+    std::size_t stride;
+    std::vector<unsigned char> pixels;
+
+    RowAccessor rows() const;
+};
+
+// Channels of the 8 bit per channel formats whose mipmaps are built on the CPU, 0 otherwise
+int mipChannels(PixelFormat format);
+
+// Every level below the image down to 1x1, each a 2x2 box filter of the previous one.
+// channels must be mipChannels(image.format) and non-zero.
+std::vector<MipLevel> buildMipChain(const ImageView& image, int channels);
+
+#endif
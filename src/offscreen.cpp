@@ -0,0 +1,112 @@
+#include <iostream>
+
+#if defined(__linux__)
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+
+#include "offscreen.hpp"
+
+#if defined(__linux__)
+static EGLDisplay display = EGL_NO_DISPLAY;
+static EGLContext context = EGL_NO_CONTEXT;
+#endif
+
+bool createOffscreenContext(const int major, const int minor) {
+#if defined(__linux__)
+    // Surfaceless platform where available, so no X or Wayland display is needed
+    const auto getPlatformDisplay =
+        reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(eglGetProcAddress("eglGetPlatformDisplayEXT"));
+    if (getPlatformDisplay != nullptr) {
+        display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+    }
+    if (display == EGL_NO_DISPLAY) {
+        display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    }
+    if (display == EGL_NO_DISPLAY || !eglInitialize(display, nullptr, nullptr)) {
+        std::cerr << "Failed to initialize EGL" << std::endl;
+        display = EGL_NO_DISPLAY;
+        return false;
+    }
+
+    if (!eglBindAPI(EGL_OPENGL_API)) {
+        std::cerr << "EGL has no desktop OpenGL" << std::endl;
+        destroyOffscreenContext();
+        return false;
+    }
+
+    // No config and no surface: everything is drawn into framebuffer objects
+    const EGLint attributes[] = {
+        EGL_CONTEXT_MAJOR_VERSION, major,
+        EGL_CONTEXT_MINOR_VERSION, minor,
+        EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+        EGL_NONE
+    };
+    context = eglCreateContext(display, nullptr, EGL_NO_CONTEXT, attributes);
+    if (context == EGL_NO_CONTEXT || !eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context)) {
+        std::cerr << "Failed to create a surfaceless OpenGL " << major << "." << minor << " context" << std::endl;
+        destroyOffscreenContext();
+        return false;
+    }
+    return true;
+#else
+    std::cerr << "Offscreen contexts need EGL" << std::endl;
+    return false;
+#endif
+}
+
+void destroyOffscreenContext() {
+#if defined(__linux__)
+    if (display == EGL_NO_DISPLAY) {
+        return;
+    }
+    eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    if (context != EGL_NO_CONTEXT) {
+        eglDestroyContext(display, context);
+        context = EGL_NO_CONTEXT;
+    }
+    eglTerminate(display);
+    display = EGL_NO_DISPLAY;
+#endif
+}
+
+bool OffscreenTarget::create(const GLsizei width, const GLsizei height) {
+    this->width = width;
+    this->height = height;
+
+    glGenRenderbuffers(1, &colourBuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, colourBuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+    glGenRenderbuffers(1, &depthBuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, depthBuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    glGenFramebuffers(1, &framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colourBuffer);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depthBuffer);
+    const GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    if (status != GL_FRAMEBUFFER_COMPLETE) {
+        std::cerr << "Offscreen framebuffer is incomplete: 0x" << std::hex << status << std::dec << std::endl;
+        destroy();
+        return false;
+    }
+    return true;
+}
+
+void OffscreenTarget::bind() const {
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glViewport(0, 0, width, height);
+}
+
+void OffscreenTarget::destroy() {
+    glDeleteFramebuffers(1, &framebuffer);
+    glDeleteRenderbuffers(1, &colourBuffer);
+    glDeleteRenderbuffers(1, &depthBuffer);
+    framebuffer = 0;
+    colourBuffer = 0;
+    depthBuffer = 0;
+}
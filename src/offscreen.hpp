@@ -0,0 +1,31 @@
+#ifndef OFFSCREEN_HPP
+#define OFFSCREEN_HPP
+
+#include <GL/glew.h>
+
+// Makes a windowless OpenGL major.minor core context current: a surfaceless EGL context
+// (Mesa, including llvmpipe without a GPU or display). Returns false where EGL is not available.
+bool createOffscreenContext(int major, int minor);
+void destroyOffscreenContext();
+
+// Colour & depth framebuffer object to render into instead of a window
+class OffscreenTarget {
+public:
+    OffscreenTarget() = default;
+    OffscreenTarget(const OffscreenTarget&) = delete;
+    OffscreenTarget& operator=(const OffscreenTarget&) = delete;
+
+    // Returns false if the framebuffer is incomplete
+    bool create(GLsizei width, GLsizei height);
+    void bind() const;
+    void destroy();
+
+private:
+    GLuint framebuffer = 0;
+    GLuint colourBuffer = 0;
+    GLuint depthBuffer = 0;
+    GLsizei width = 0;
+    GLsizei height = 0;
+};
+
+#endif
@@ -0,0 +1,207 @@
+#include <iostream>
+#include <limits>
+#include <string>
+
+#include "camera_simulation.hpp"
+#include "options.hpp"
+#include "procedural_terrain.hpp"
+#include "tiled_height_map.hpp"
+#include "terrain_mesh_builder.hpp"
+
+static void printUsage(const char* executable) {
+    std::cout << "Usage: " << executable << " [options]" << std::endl
+              << "  --points <n>    Grid resolution, n x n vertices (2 to " << maxTerrainPoints << ")" << std::endl
+              << "  --packed-tangents    Upload tangent frames as one QTangent attribute" << std::endl
+              << "  --compact-vertices   Upload one interleaved 16-bit vertex buffer" << std::endl
+              << "  --pulled-vertices    Generate strip vertices from their IDs, without vertex buffers" << std::endl
+              << "  --index-layout <name>  Triangle order of the strip: strip, rows, zorder, hilbert or forsyth"
+              << std::endl
+              << "                       (default hilbert)" << std::endl
+              << "  --lod                Start in quadtree level-of-detail mode" << std::endl
+              << "  --tessellation       Start in tessellated mode" << std::endl
+              << "  --cpu-culling        Cull & draw LOD nodes one by one on the CPU, not on the GPU" << std::endl
+              << "  --serial-frames      Step the camera on the render thread each frame, not at a fixed tick"
+              << std::endl
+              << "  --tick-rate <hz>     Camera simulation ticks per second (" << minTickRate << " to "
+              << maxTickRate << ", default " << defaultTickRate << ")" << std::endl
+              << "  --vertex-report      Compare vertex layout sizes and upload times, then exit" << std::endl
+              << "  --index-report       Compare vertex cache efficiency and size of the index layouts, then exit"
+              << std::endl
+              << "  --bmp-bench <path>   Benchmark the BMP decoder on a file, then exit" << std::endl
+              << "  --bmp-fuzz <path>    Fuzz the BMP decoder with mutations of a file, then exit" << std::endl
+              << "  --mesh-check         Check the terrain grid builder against the scalar reference, then exit"
+              << std::endl
+              << "  --bake-check <path>  Compare baked normals of a height map with the original shader's, then exit"
+              << std::endl
+              << "  --cull-check <path>  Check frustum culling of height map tiles from fixed poses, then exit"
+              << std::endl
+              << "  --horizon-check <path>  Check the horizon map of a height map against a ray march, then exit"
+              << std::endl
+              << "  --tiles <path>       Stream a tiled height map (.hmt) around the camera" << std::endl
+              << "  --make-tiles <bmp> <path>  Convert a height map BMP into a tiled height map, then exit"
+              << std::endl
+              << "  --tile-size <n>      Tile size of --make-tiles (" << minTileSize << " to " << maxTileSize
+              << ", default 256)" << std::endl
+              << "  --bench-queries <path>  Benchmark height & ray queries on a height map, then exit" << std::endl
+              << "  --generate <path>    Generate an eroded procedural terrain into a height map BMP, or a tiled"
+              << std::endl
+              << "                       height map for a .hmt path, then exit" << std::endl
+              << "  --generate-size <n>  Texels per side of --generate (" << minProceduralSize << " to "
+              << maxProceduralSize << ", default 1025)" << std::endl
+              << "  --bench-generate     Benchmark the terrain generator on every thread count, then exit"
+              << std::endl
+              << "  --bench <path>       Render --frames frames offscreen along a camera path, write CSV or JSON"
+              << std::endl
+              << "                       timings to path, then exit" << std::endl
+              << "  --frames <n>         Frames rendered by --bench (default 600)" << std::endl
+              << "  --camera-path <path> Camera keyframes for --bench; P appends the current pose to it" << std::endl
+              << "  --uncompressed-textures  Upload material textures without BC1 / BC5 compression" << std::endl
+              << "  --texture-cache <dir>    Directory of compressed textures kept across runs (default cache, \"\""
+              << std::endl
+              << "                           to always encode)" << std::endl
+              << "  --texture-report <path>  Report BC1 / BC5 quality, size & load times of a BMP, then exit"
+              << std::endl
+              << "  --shader-cache <dir>     Directory of linked programs (default cache, \"\" to always compile)"
+              << std::endl
+              << "  --terrain-cache <path>   Precompiled terrain file (default cache/terrain.hmc, \"\" to always build)"
+              << std::endl
+              << "  --startup-report     Compare terrain load times without, with a cold and with a cached terrain"
+              << std::endl
+              << "                       cache, then exit" << std::endl
+              << "  --profile <path>     Write a Chrome trace of CPU & GPU scopes on exit (profiling builds)"
+              << std::endl
+              << "  --iterations <n>     Iterations of the headless tools (default 100)" << std::endl
+              << "  --seed <n>           Random seed of the headless tools (default 1)" << std::endl;
+}
+
+static bool parseUnsigned(const char* text, unsigned long& value) {
+    try {
+        std::size_t consumed;
+        value = std::stoul(text, &consumed);
+        return text[consumed] == '\0';
+    } catch (const std::exception&) {
+        return false;
+    }
+}
+
+bool parseOptions(const int argc, char** argv, Options& options) {
+    for (int i = 1; i < argc; i++) {
+        const std::string argument = argv[i];
+        const bool hasValue = i + 1 < argc;
+
+        if (argument == "--points" && hasValue) {
+            unsigned long value;
+            if (!parseUnsigned(argv[++i], value) || value < 2 || value > maxTerrainPoints) {
+                std::cerr << "Invalid --points value: " << argv[i] << std::endl;
+                printUsage(argv[0]);
+                return false;
+            }
+            options.nPoints = static_cast<unsigned int>(value);
+        } else if (argument == "--packed-tangents") {
+            options.packedTangents = true;
+        } else if (argument == "--compact-vertices") {
+            options.compactVertices = true;
+        } else if (argument == "--pulled-vertices") {
+            options.pulledVertices = true;
+        } else if (argument == "--index-layout" && hasValue) {
+            if (!parseIndexLayout(argv[++i], options.indexLayout)) {
+                std::cerr << "Invalid --index-layout value: " << argv[i] << std::endl;
+                printUsage(argv[0]);
+                return false;
+            }
+        } else if (argument == "--lod") {
+            options.lod = true;
+        } else if (argument == "--tessellation") {
+            options.tessellation = true;
+        } else if (argument == "--cpu-culling") {
+            options.cpuCulling = true;
+        } else if (argument == "--serial-frames") {
+            options.serialFrames = true;
+        } else if (argument == "--tick-rate" && hasValue) {
+            unsigned long value;
+            if (!parseUnsigned(argv[++i], value) || value < minTickRate || value > maxTickRate) {
+                std::cerr << "Invalid --tick-rate value: " << argv[i] << std::endl;
+                printUsage(argv[0]);
+                return false;
+            }
+            options.tickRate = static_cast<unsigned int>(value);
+        } else if (argument == "--vertex-report") {
+            options.vertexReport = true;
+        } else if (argument == "--index-report") {
+            options.indexReport = true;
+        } else if (argument == "--mesh-check") {
+            options.meshCheck = true;
+        } else if (argument == "--bmp-bench" && hasValue) {
+            options.bmpBenchmarkPath = argv[++i];
+        } else if (argument == "--bmp-fuzz" && hasValue) {
+            options.bmpFuzzPath = argv[++i];
+        } else if (argument == "--bake-check" && hasValue) {
+            options.bakeCheckPath = argv[++i];
+        } else if (argument == "--cull-check" && hasValue) {
+            options.cullCheckPath = argv[++i];
+        } else if (argument == "--horizon-check" && hasValue) {
+            options.horizonCheckPath = argv[++i];
+        } else if (argument == "--tiles" && hasValue) {
+            options.tiledHeightMapPath = argv[++i];
+        } else if (argument == "--make-tiles" && i + 2 < argc) {
+            options.makeTilesPath = argv[++i];
+            options.makeTilesOutputPath = argv[++i];
+        } else if (argument == "--tile-size" && hasValue) {
+            unsigned long value;
+            if (!parseUnsigned(argv[++i], value) || value < minTileSize || value > maxTileSize) {
+                std::cerr << "Invalid --tile-size value: " << argv[i] << std::endl;
+                printUsage(argv[0]);
+                return false;
+            }
+            options.tileSize = static_cast<unsigned int>(value);
+        } else if (argument == "--bench-queries" && hasValue) {
+            options.queryBenchmarkPath = argv[++i];
+        } else if (argument == "--generate" && hasValue) {
+            options.generatePath = argv[++i];
+        } else if (argument == "--generate-size" && hasValue) {
+            unsigned long value;
+            if (!parseUnsigned(argv[++i], value) || value < minProceduralSize || value > maxProceduralSize) {
+                std::cerr << "Invalid --generate-size value: " << argv[i] << std::endl;
+                printUsage(argv[0]);
+                return false;
+            }
+            options.generateSize = static_cast<unsigned int>(value);
+        } else if (argument == "--bench-generate") {
+            options.generatorBenchmark = true;
+        } else if (argument == "--bench" && hasValue) {
+            options.benchOutputPath = argv[++i];
+        } else if (argument == "--profile" && hasValue) {
+            options.profilePath = argv[++i];
+        } else if (argument == "--camera-path" && hasValue) {
+            options.cameraPath = argv[++i];
+        } else if (argument == "--uncompressed-textures") {
+            options.uncompressedTextures = true;
+        } else if (argument == "--texture-cache" && hasValue) {
+            options.textureCacheDirectory = argv[++i];
+        } else if (argument == "--shader-cache" && hasValue) {
+            options.shaderCacheDirectory = argv[++i];
+        } else if (argument == "--terrain-cache" && hasValue) {
+            options.terrainCachePath = argv[++i];
+        } else if (argument == "--startup-report") {
+            options.startupReport = true;
+        } else if (argument == "--texture-report" && hasValue) {
+            options.textureReportPath = argv[++i];
+        } else if ((argument == "--iterations" || argument == "--seed" || argument == "--frames") && hasValue) {
+            unsigned long value;
+            if (!parseUnsigned(argv[++i], value) || value > std::numeric_limits<unsigned int>::max() ||
+                (argument != "--seed" && value == 0)) {
+                std::cerr << "Invalid " << argument << " value: " << argv[i] << std::endl;
+                printUsage(argv[0]);
+                return false;
+            }
+            unsigned int& target = argument == "--iterations" ? options.iterations
+                                   : argument == "--frames" ? options.benchFrames : options.seed;
+            target = static_cast<unsigned int>(value);
+        } else {
+            std::cerr << "Unknown argument: " << argument << std::endl;
+            printUsage(argv[0]);
+            return false;
+        }
+    }
+    return true;
+}
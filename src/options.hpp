@@ -0,0 +1,112 @@
+#ifndef OPTIONS_HPP
+#define OPTIONS_HPP
+
+#include "index_layout.hpp"
+
+// Command line configurable settings
+struct Options {
+    // Grid resolution, nPoints x nPoints vertices
+    unsigned int nPoints = 200;
+
+    // Upload tangent frames as one QTangent attribute instead of two vec3 streams
+    bool packedTangents = false;
+
+    // Upload one interleaved, quantised vertex buffer (implies packedTangents)
+    bool compactVertices = false;
+
+    // Generate strip vertices in the vertex shader instead of uploading any vertex or index buffer
+    bool pulledVertices = false;
+
+    // Triangle order of the strip's index buffer
+    IndexLayout indexLayout = IndexLayout::Hilbert;
+
+    // Start in quadtree LOD mode instead of drawing the full grid
+    bool lod = false;
+
+    // Start in tessellated mode instead of drawing the full grid, ignored with lod
+    bool tessellation = false;
+
+    // Cull & draw LOD nodes one by one on the CPU even where the GPU could cull them
+    bool cpuCulling = false;
+
+    // Step the camera on the render thread every frame instead of on the simulation thread at tickRate
+    bool serialFrames = false;
+    unsigned int tickRate = 120;
+
+    // Print bytes per vertex and upload times of the vertex layouts, then exit
+    bool vertexReport = false;
+
+    // Headless vertex cache & size report of every index layout, then exit
+    bool indexReport = false;
+
+    // Headless check of the terrain grid builder against the scalar reference, then exit
+    bool meshCheck = false;
+
+    // Headless BMP decoder benchmark / fuzzing of the given file, then exit
+    const char* bmpBenchmarkPath = nullptr;
+    const char* bmpFuzzPath = nullptr;
+
+    // Headless check of the baked heights & normals of the given height map against the original shader
+    const char* bakeCheckPath = nullptr;
+
+    // Headless check of LOD tile culling of the given height map from fixed camera poses
+    const char* cullCheckPath = nullptr;
+
+    // Headless check of the horizon map slices of the given height map against a ray march
+    const char* horizonCheckPath = nullptr;
+
+    // Stream this tiled height map (.hmt) instead of loading the default height map whole
+    const char* tiledHeightMapPath = nullptr;
+
+    // Headless conversion of a height map BMP into a tiled height map of tileSize texel tiles, then exit
+    const char* makeTilesPath = nullptr;
+    const char* makeTilesOutputPath = nullptr;
+    unsigned int tileSize = 256;
+
+    // Headless benchmark of height & ray queries on the given height map
+    const char* queryBenchmarkPath = nullptr;
+
+    // Headless generation of a procedural terrain of generateSize texels per side into a .bmp or .hmt, then exit
+    const char* generatePath = nullptr;
+    unsigned int generateSize = 1025;
+
+    // Headless benchmark of the procedural terrain generator at generateSize
+    bool generatorBenchmark = false;
+
+    // Render frames offscreen along the camera path, write their timings as CSV or JSON (.json), then exit
+    const char* benchOutputPath = nullptr;
+    unsigned int benchFrames = 600;
+
+    // Upload material textures uncompressed instead of BC1 / BC5
+    bool uncompressedTextures = false;
+
+    // Directory of block compressed textures kept across runs, empty to always encode
+    const char* textureCacheDirectory = "cache";
+
+    // Directory of linked shader program binaries kept across runs, empty to always compile
+    const char* shaderCacheDirectory = "cache";
+
+    // Precompiled mesh streams & baked height map kept across runs, empty to build them every run
+    const char* terrainCachePath = "cache/terrain.hmc";
+
+    // Time terrain loads without, with a cold and with an up to date terrain cache, then exit
+    bool startupReport = false;
+
+    // Headless BC1 / BC5 quality, size & load time report of the given BMP, then exit
+    const char* textureReportPath = nullptr;
+
+    // Camera keyframes: replayed by the benchmark instead of the built-in orbit, appended to with P otherwise
+    const char* cameraPath = nullptr;
+
+    // Write a Chrome trace of instrumented scopes on exit (profiling builds only)
+    const char* profilePath = nullptr;
+
+    // Iterations and random seed of the headless tools
+    unsigned int iterations = 100;
+    unsigned int seed = 1;
+};
+
+// Parses the command line into options. Prints usage and returns false if the arguments are invalid.
+bool parseOptions(int argc, char** argv, Options& options);
+
+#endif
@@ -0,0 +1,53 @@
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "job_system.hpp"
+#include "parallel.hpp"
+
+// Chunks per thread, so threads that finish early steal the chunks of slower ones
+static constexpr std::size_t chunksPerWorker = 4;
+
+static std::atomic<unsigned int> workerOverride{0};
+
+unsigned int workerCount() {
+    static const unsigned int hardwareCount = std::max(1u, std::thread::hardware_concurrency());
+    const unsigned int count = workerOverride.load(std::memory_order_relaxed);
+    return count == 0 ? hardwareCount : count;
+}
+
+void setWorkerCount(const unsigned int count) {
+    workerOverride.store(count, std::memory_order_relaxed);
+    restartJobSystem();
+}
+
+void parallelFor(const std::size_t begin, const std::size_t end,
+                 const std::function<void(std::size_t, std::size_t)>& fn, const std::size_t minChunk) {
+    if (end <= begin) {
+        return;
+    }
+
+    // A few chunks per thread, but never smaller than minChunk
+    const std::size_t count = end - begin;
+    const std::size_t chunks = std::min<std::size_t>(workerCount() * chunksPerWorker,
+                                                     std::max<std::size_t>(1, count / minChunk));
+    if (workerCount() <= 1 || chunks <= 1) {
+        fn(begin, end);
+        return;
+    }
+
+    // The calling thread processes the first chunk itself, then helps with the rest while waiting
+    const std::size_t chunkSize = (count + chunks - 1) / chunks;
+    std::vector<JobHandle> jobs;
+    jobs.reserve(chunks - 1);
+    for (std::size_t chunkBegin = begin + chunkSize; chunkBegin < end; chunkBegin += chunkSize) {
+        const std::size_t chunkEnd = std::min(end, chunkBegin + chunkSize);
+        jobs.push_back(submitJob([&fn, chunkBegin, chunkEnd] { fn(chunkBegin, chunkEnd); }));
+    }
+    fn(begin, std::min(end, begin + chunkSize));
+
+    for (const auto& job : jobs) {
+        waitForJob(job);
+    }
+}
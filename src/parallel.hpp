@@ -0,0 +1,20 @@
+#ifndef PARALLEL_HPP
+#define PARALLEL_HPP
+
+#include <cstddef>
+#include <functional>
+
+// Number of threads running parallelFor & other jobs (at least 1), the job system's workers and a waiting thread
+unsigned int workerCount();
+
+// Overrides workerCount(), 0 restores one thread per hardware thread, and restarts the job system's workers.
+// Call while no parallelFor or other job is running.
+void setWorkerCount(unsigned int count);
+
+// Splits [begin, end) into contiguous chunks and runs fn(chunkBegin, chunkEnd) on each as jobs, across all cores.
+// Returns once every chunk has been processed. Ranges smaller than minChunk run on the calling thread. Nests:
+// a job may run a parallelFor of its own.
+void parallelFor(std::size_t begin, std::size_t end, const std::function<void(std::size_t, std::size_t)>& fn,
+                 std::size_t minChunk = 1);
+
+#endif
@@ -0,0 +1,635 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define PROCEDURAL_SSE2 1
+#endif
+
+#include "parallel.hpp"
+#include "procedural_terrain.hpp"
+#include "texture_cache.hpp"
+#include "tiled_height_map.hpp"
+
+using Clock = std::chrono::steady_clock;
+
+// Largest packed 24 bit height
+static constexpr float maxPackedHeight = 16777215.0f;
+// Rows per chunk of the row parallel stages
+static constexpr std::size_t minRowsPerChunk = 8;
+// Every octave is rotated by about 37 degrees, so the lattices of octaves do not line up
+static constexpr float octaveCos = 0.8f;
+static constexpr float octaveSin = 0.6f;
+
+static double secondsSince(const Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+// Integer hash of a lattice point, after Jenkins / Wang style finalisers
+static std::uint32_t hashLattice(const std::int32_t x, const std::int32_t y, const std::uint32_t seed) {
+    std::uint32_t h = static_cast<std::uint32_t>(x) * 0x8da6b343u + static_cast<std::uint32_t>(y) * 0xd8163841u +
+                      seed * 0xcb1ab31fu;
+    h ^= h >> 15;
+    h *= 0x2c1b3c6du;
+    h ^= h >> 12;
+    h *= 0x297a2d39u;
+    h ^= h >> 15;
+    return h;
+}
+
+// Quintic fade of gradient noise, zero first & second derivatives at the lattice
+static float fade(const float t) {
+    return t * t * t * (t * (t * 6.0f - 15.0f) + 10.0f);
+}
+
+// Gradient noise in about [-1, 1], gradients spread over a square from the hash's two halves
+static float gradientNoise(const float x, const float y, const std::uint32_t seed) {
+    const float x0 = std::floor(x);
+    const float y0 = std::floor(y);
+    const auto ix = static_cast<std::int32_t>(x0);
+    const auto iy = static_cast<std::int32_t>(y0);
+    const float fx = x - x0;
+    const float fy = y - y0;
+    const auto corner = [&](const std::int32_t dx, const std::int32_t dy) {
+        const std::uint32_t h = hashLattice(ix + dx, iy + dy, seed);
+        const float gx = static_cast<float>(static_cast<std::int32_t>(h & 0xffff)) * (1.0f / 32767.5f) - 1.0f;
+        const float gy = static_cast<float>(static_cast<std::int32_t>(h >> 16)) * (1.0f / 32767.5f) - 1.0f;
+        return gx * (fx - static_cast<float>(dx)) + gy * (fy - static_cast<float>(dy));
+    };
+    const float u = fade(fx);
+    const float v = fade(fy);
+    const float n00 = corner(0, 0);
+    const float n10 = corner(1, 0);
+    const float n01 = corner(0, 1);
+    const float n11 = corner(1, 1);
+    const float bottom = n00 + u * (n10 - n00);
+    const float top = n01 + u * (n11 - n01);
+    return bottom + v * (top - bottom);
+}
+
+// Height in [0, 1] at (x, y), in cycles of the first octave
+static float terrainNoise(const ProceduralSettings& settings, float x, float y) {
+    float fbm = 0.0f;
+    float ridges = 0.0f;
+    float amplitude = 1.0f;
+    float weight = 1.0f;
+    float total = 0.0f;
+    for (int octave = 0; octave < settings.octaves; octave++) {
+        const float n = gradientNoise(x, y, settings.seed + static_cast<std::uint32_t>(octave));
+        fbm += n * amplitude;
+        // Sharp creases where the noise crosses zero, fading out octaves that fall in valleys
+        float ridge = 1.0f - std::abs(n);
+        ridge *= ridge * weight;
+        weight = std::min(std::max(ridge * 2.0f, 0.0f), 1.0f);
+        ridges += ridge * amplitude;
+        total += amplitude;
+        amplitude *= settings.gain;
+        const float rotatedX = (octaveCos * x - octaveSin * y) * settings.lacunarity;
+        y = (octaveSin * x + octaveCos * y) * settings.lacunarity;
+        x = rotatedX;
+    }
+    fbm = fbm / total * 0.5f + 0.5f;
+    ridges /= total;
+    return fbm + settings.ridged * (ridges - fbm);
+}
+
+#ifdef PROCEDURAL_SSE2
+// 32 bit multiply, SSE4.1's _mm_mullo_epi32 from two SSE2 64 bit multiplies
+static __m128i multiply(const __m128i a, const __m128i b) {
+    const __m128i even = _mm_mul_epu32(a, b);
+    const __m128i odd = _mm_mul_epu32(_mm_srli_epi64(a, 32), _mm_srli_epi64(b, 32));
+    return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)),
+                              _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+}
+
+static __m128i hashLattice4(const __m128i x, const __m128i y, const __m128i seed) {
+    __m128i h = _mm_add_epi32(_mm_add_epi32(multiply(x, _mm_set1_epi32(static_cast<int>(0x8da6b343u))),
+                                            multiply(y, _mm_set1_epi32(static_cast<int>(0xd8163841u)))),
+                              multiply(seed, _mm_set1_epi32(static_cast<int>(0xcb1ab31fu))));
+    h = _mm_xor_si128(h, _mm_srli_epi32(h, 15));
+    h = multiply(h, _mm_set1_epi32(0x2c1b3c6d));
+    h = _mm_xor_si128(h, _mm_srli_epi32(h, 12));
+    h = multiply(h, _mm_set1_epi32(0x297a2d39));
+    return _mm_xor_si128(h, _mm_srli_epi32(h, 15));
+}
+
+static __m128 fade4(const __m128 t) {
+    const __m128 inner = _mm_add_ps(_mm_mul_ps(t, _mm_sub_ps(_mm_mul_ps(t, _mm_set1_ps(6.0f)), _mm_set1_ps(15.0f))),
+                                    _mm_set1_ps(10.0f));
+    return _mm_mul_ps(_mm_mul_ps(_mm_mul_ps(t, t), t), inner);
+}
+
+// gradientNoise of four points
+static __m128 gradientNoise4(const __m128 x, const __m128 y, const __m128i seed) {
+    // Floor by truncation, one less where that rounded up
+    const __m128 one = _mm_set1_ps(1.0f);
+    __m128 x0 = _mm_cvtepi32_ps(_mm_cvttps_epi32(x));
+    __m128 y0 = _mm_cvtepi32_ps(_mm_cvttps_epi32(y));
+    x0 = _mm_sub_ps(x0, _mm_and_ps(_mm_cmpgt_ps(x0, x), one));
+    y0 = _mm_sub_ps(y0, _mm_and_ps(_mm_cmpgt_ps(y0, y), one));
+    const __m128i ix = _mm_cvttps_epi32(x0);
+    const __m128i iy = _mm_cvttps_epi32(y0);
+    const __m128 fx = _mm_sub_ps(x, x0);
+    const __m128 fy = _mm_sub_ps(y, y0);
+
+    const __m128i lowMask = _mm_set1_epi32(0xffff);
+    const __m128 scale = _mm_set1_ps(1.0f / 32767.5f);
+    const auto corner = [&](const int dx, const int dy) {
+        const __m128i h = hashLattice4(_mm_add_epi32(ix, _mm_set1_epi32(dx)), _mm_add_epi32(iy, _mm_set1_epi32(dy)),
+                                       seed);
+        const __m128 gx = _mm_sub_ps(_mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(h, lowMask)), scale), one);
+        const __m128 gy = _mm_sub_ps(_mm_mul_ps(_mm_cvtepi32_ps(_mm_srli_epi32(h, 16)), scale), one);
+        return _mm_add_ps(_mm_mul_ps(gx, _mm_sub_ps(fx, _mm_set1_ps(static_cast<float>(dx)))),
+                          _mm_mul_ps(gy, _mm_sub_ps(fy, _mm_set1_ps(static_cast<float>(dy)))));
+    };
+    const __m128 u = fade4(fx);
+    const __m128 v = fade4(fy);
+    const __m128 n00 = corner(0, 0);
+    const __m128 n10 = corner(1, 0);
+    const __m128 n01 = corner(0, 1);
+    const __m128 n11 = corner(1, 1);
+    const __m128 bottom = _mm_add_ps(n00, _mm_mul_ps(u, _mm_sub_ps(n10, n00)));
+    const __m128 top = _mm_add_ps(n01, _mm_mul_ps(u, _mm_sub_ps(n11, n01)));
+    return _mm_add_ps(bottom, _mm_mul_ps(v, _mm_sub_ps(top, bottom)));
+}
+
+// terrainNoise of four points
+static __m128 terrainNoise4(const ProceduralSettings& settings, __m128 x, __m128 y) {
+    const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+    const __m128 lacunarity = _mm_set1_ps(settings.lacunarity);
+    const __m128 cosine = _mm_set1_ps(octaveCos);
+    const __m128 sine = _mm_set1_ps(octaveSin);
+    __m128 fbm = _mm_setzero_ps();
+    __m128 ridges = _mm_setzero_ps();
+    __m128 weight = _mm_set1_ps(1.0f);
+    float amplitude = 1.0f;
+    float total = 0.0f;
+    for (int octave = 0; octave < settings.octaves; octave++) {
+        const __m128i seed = _mm_set1_epi32(static_cast<int>(settings.seed + static_cast<std::uint32_t>(octave)));
+        const __m128 n = gradientNoise4(x, y, seed);
+        const __m128 scaled = _mm_set1_ps(amplitude);
+        fbm = _mm_add_ps(fbm, _mm_mul_ps(n, scaled));
+        __m128 ridge = _mm_sub_ps(_mm_set1_ps(1.0f), _mm_and_ps(n, absMask));
+        ridge = _mm_mul_ps(_mm_mul_ps(ridge, ridge), weight);
+        weight = _mm_min_ps(_mm_max_ps(_mm_mul_ps(ridge, _mm_set1_ps(2.0f)), _mm_setzero_ps()), _mm_set1_ps(1.0f));
+        ridges = _mm_add_ps(ridges, _mm_mul_ps(ridge, scaled));
+        total += amplitude;
+        amplitude *= settings.gain;
+        const __m128 rotatedX = _mm_mul_ps(_mm_sub_ps(_mm_mul_ps(cosine, x), _mm_mul_ps(sine, y)), lacunarity);
+        y = _mm_mul_ps(_mm_add_ps(_mm_mul_ps(sine, x), _mm_mul_ps(cosine, y)), lacunarity);
+        x = rotatedX;
+    }
+    const __m128 inverseTotal = _mm_set1_ps(1.0f / total);
+    fbm = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(fbm, inverseTotal), _mm_set1_ps(0.5f)), _mm_set1_ps(0.5f));
+    ridges = _mm_mul_ps(ridges, inverseTotal);
+    return _mm_add_ps(fbm, _mm_mul_ps(_mm_set1_ps(settings.ridged), _mm_sub_ps(ridges, fbm)));
+}
+#endif
+
+void generateNoise(const ProceduralSettings& settings, HeightField& field) {
+    const auto size = static_cast<int>(settings.size);
+    field.width = size;
+    field.height = size;
+    field.heights.resize(static_cast<std::size_t>(size) * size);
+
+    // Texel centres in cycles of the first octave
+    const float step = settings.frequency / static_cast<float>(size);
+    parallelFor(0, settings.size, [&](const std::size_t rowBegin, const std::size_t rowEnd) {
+        for (std::size_t row = rowBegin; row < rowEnd; row++) {
+            float* heights = &field.heights[row * size];
+            const float y = (static_cast<float>(row) + 0.5f) * step;
+            int column = 0;
+#ifdef PROCEDURAL_SSE2
+            const __m128 offsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+            for (; column + 4 <= size; column += 4) {
+                const __m128 x = _mm_mul_ps(_mm_add_ps(_mm_set1_ps(static_cast<float>(column)), offsets),
+                                            _mm_set1_ps(step));
+                _mm_storeu_ps(heights + column, terrainNoise4(settings, x, _mm_set1_ps(y)));
+            }
+#endif
+            for (; column < size; column++) {
+                const float x = (static_cast<float>(column) + 0.5f) * step;
+                heights[column] = terrainNoise(settings, x, y);
+            }
+        }
+    }, minRowsPerChunk);
+
+    // Stretched over the whole relief, then shaped into texels
+    const auto range = std::minmax_element(field.heights.begin(), field.heights.end());
+    const float low = *range.first;
+    const float scale = 1.0f / std::max(*range.second - low, 1e-6f);
+    const float heightScale = settings.relief * static_cast<float>(size);
+    parallelFor(0, field.heights.size(), [&](const std::size_t begin, const std::size_t end) {
+        for (std::size_t i = begin; i < end; i++) {
+            field.heights[i] = std::pow((field.heights[i] - low) * scale, settings.exponent) * heightScale;
+        }
+    }, 1 << 16);
+}
+
+namespace {
+// Cells eroded around a droplet and their share of the sediment
+struct ErosionBrush {
+    std::vector<int> dx;
+    std::vector<int> dy;
+    std::vector<float> weights;
+};
+
+// Droplet tile, clipped to the map
+struct ErosionTile {
+    int x0;
+    int y0;
+    int x1;
+    int y1;
+    std::uint32_t seed;
+};
+
+// Xorshift stream of a tile's droplets
+struct DropletRandom {
+    std::uint32_t state;
+
+    float next() {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        return static_cast<float>(state >> 8) * (1.0f / 16777216.0f);
+    }
+};
+}
+
+static ErosionBrush erosionBrush(const int radius) {
+    ErosionBrush brush;
+    float total = 0.0f;
+    for (int dy = -radius; dy <= radius; dy++) {
+        for (int dx = -radius; dx <= radius; dx++) {
+            const float weight = static_cast<float>(radius) - std::sqrt(static_cast<float>(dx * dx + dy * dy));
+            if (weight > 0.0f) {
+                brush.dx.push_back(dx);
+                brush.dy.push_back(dy);
+                brush.weights.push_back(weight);
+                total += weight;
+            }
+        }
+    }
+    for (float& weight : brush.weights) {
+        weight /= total;
+    }
+    return brush;
+}
+
+// Runs droplets started inside tile, confined to it widened by margin. Returns the steps simulated.
+static std::uint64_t runDroplets(const ProceduralSettings& settings, const ErosionBrush& brush, const ErosionTile& tile,
+                                 const int margin, const int droplets, HeightField& field) {
+    const int size = field.width;
+    float* heights = field.heights.data();
+    // Droplets sample the cell right & above them too
+    const float minX = static_cast<float>(std::max(tile.x0 - margin, 0));
+    const float minY = static_cast<float>(std::max(tile.y0 - margin, 0));
+    const float maxX = static_cast<float>(std::min(tile.x1 + margin, size - 1));
+    const float maxY = static_cast<float>(std::min(tile.y1 + margin, size - 1));
+    const auto cell = [size, heights](const int x, const int y) -> float& {
+        return heights[static_cast<std::size_t>(y) * size + x];
+    };
+
+    DropletRandom random{tile.seed | 1u};
+    std::uint64_t steps = 0;
+    for (int droplet = 0; droplet < droplets; droplet++) {
+        float x = static_cast<float>(tile.x0) + random.next() * static_cast<float>(tile.x1 - tile.x0);
+        float y = static_cast<float>(tile.y0) + random.next() * static_cast<float>(tile.y1 - tile.y0);
+        x = std::min(x, maxX - 0.001f);
+        y = std::min(y, maxY - 0.001f);
+        float directionX = 0.0f;
+        float directionY = 0.0f;
+        float speed = 1.0f;
+        float water = 1.0f;
+        float sediment = 0.0f;
+
+        for (int life = 0; life < settings.dropletLifetime; life++) {
+            const int cx = static_cast<int>(x);
+            const int cy = static_cast<int>(y);
+            const float ox = x - static_cast<float>(cx);
+            const float oy = y - static_cast<float>(cy);
+            const float h00 = cell(cx, cy);
+            const float h10 = cell(cx + 1, cy);
+            const float h01 = cell(cx, cy + 1);
+            const float h11 = cell(cx + 1, cy + 1);
+            const float gradientX = (h10 - h00) * (1.0f - oy) + (h11 - h01) * oy;
+            const float gradientY = (h01 - h00) * (1.0f - ox) + (h11 - h10) * ox;
+            const float height = (h00 * (1.0f - ox) + h10 * ox) * (1.0f - oy) + (h01 * (1.0f - ox) + h11 * ox) * oy;
+
+            // Downhill, keeping some of the previous direction
+            directionX = directionX * settings.inertia - gradientX * (1.0f - settings.inertia);
+            directionY = directionY * settings.inertia - gradientY * (1.0f - settings.inertia);
+            const float length = std::sqrt(directionX * directionX + directionY * directionY);
+            if (length < 1e-6f) {
+                break;
+            }
+            directionX /= length;
+            directionY /= length;
+            x += directionX;
+            y += directionY;
+            steps++;
+            if (x < minX || y < minY || x >= maxX || y >= maxY) {
+                break;
+            }
+
+            const int nx = static_cast<int>(x);
+            const int ny = static_cast<int>(y);
+            const float px = x - static_cast<float>(nx);
+            const float py = y - static_cast<float>(ny);
+            const float nextHeight = (cell(nx, ny) * (1.0f - px) + cell(nx + 1, ny) * px) * (1.0f - py) +
+                                     (cell(nx, ny + 1) * (1.0f - px) + cell(nx + 1, ny + 1) * px) * py;
+            const float deltaHeight = nextHeight - height;
+
+            const float capacity = std::max(-deltaHeight * speed * water * settings.sedimentCapacity,
+                                            settings.minSedimentCapacity);
+            if (sediment > capacity || deltaHeight > 0.0f) {
+                // Fill the pit climbed out of, or drop what the droplet can no longer carry
+                const float amount = deltaHeight > 0.0f ? std::min(deltaHeight, sediment)
+                                                        : (sediment - capacity) * settings.depositionRate;
+                sediment -= amount;
+                cell(cx, cy) += amount * (1.0f - ox) * (1.0f - oy);
+                cell(cx + 1, cy) += amount * ox * (1.0f - oy);
+                cell(cx, cy + 1) += amount * (1.0f - ox) * oy;
+                cell(cx + 1, cy + 1) += amount * ox * oy;
+            } else {
+                // Never dig deeper than the step down, which would leave a pit behind
+                const float amount = std::min((capacity - sediment) * settings.erosionRate, -deltaHeight);
+                for (std::size_t i = 0; i < brush.weights.size(); i++) {
+                    const int bx = cx + brush.dx[i];
+                    const int by = cy + brush.dy[i];
+                    if (bx >= 0 && by >= 0 && bx < size && by < size) {
+                        // Nothing erodes below the base level, or droplets draining off the map dig endless pits
+                        float& target = cell(bx, by);
+                        const float eroded = std::min(amount * brush.weights[i], std::max(target, 0.0f));
+                        target -= eroded;
+                        sediment += eroded;
+                    }
+                }
+            }
+
+            speed = std::sqrt(std::max(speed * speed - deltaHeight * settings.gravity, 0.0f));
+            water *= 1.0f - settings.evaporation;
+        }
+    }
+    return steps;
+}
+
+std::uint64_t erodeHydraulic(const ProceduralSettings& settings, HeightField& field) {
+    const int size = field.width;
+    const int radius = std::min(std::max(settings.erosionRadius, 1), maxErosionRadius);
+    const ErosionBrush brush = erosionBrush(radius);
+    // Droplets & their brushes stay within half a tile of their own, so tiles two apart never touch the same texels
+    const int tileSize = std::max(settings.erosionTileSize, 4 * (radius + 2));
+    const int margin = tileSize / 2 - radius - 2;
+    const int passes = std::max(settings.erosionPasses, 1);
+
+    std::uint64_t steps = 0;
+    std::vector<ErosionTile> tiles;
+    std::vector<std::uint64_t> tileSteps;
+    for (int pass = 0; pass < passes; pass++) {
+        const int shift = pass * tileSize / passes;
+        const int tilesPerSide = (size + shift + tileSize - 1) / tileSize;
+        const std::uint32_t passSeed = settings.seed + static_cast<std::uint32_t>(pass) * 0x9e3779b9u;
+        // Four phases of tiles, each one with no two neighbours
+        for (int phase = 0; phase < 4; phase++) {
+            tiles.clear();
+            for (int ty = phase / 2; ty < tilesPerSide; ty += 2) {
+                for (int tx = phase % 2; tx < tilesPerSide; tx += 2) {
+                    const ErosionTile tile = {std::max(tx * tileSize - shift, 0), std::max(ty * tileSize - shift, 0),
+                                              std::min((tx + 1) * tileSize - shift, size),
+                                              std::min((ty + 1) * tileSize - shift, size),
+                                              hashLattice(tx, ty, passSeed)};
+                    if (tile.x1 > tile.x0 && tile.y1 > tile.y0) {
+                        tiles.push_back(tile);
+                    }
+                }
+            }
+            tileSteps.assign(tiles.size(), 0);
+            parallelFor(0, tiles.size(), [&](const std::size_t begin, const std::size_t end) {
+                for (std::size_t i = begin; i < end; i++) {
+                    const ErosionTile& tile = tiles[i];
+                    const float area = static_cast<float>((tile.x1 - tile.x0) * (tile.y1 - tile.y0));
+                    const auto droplets = static_cast<int>(std::lround(settings.dropletsPerTexel * area / passes));
+                    tileSteps[i] = runDroplets(settings, brush, tile, margin, droplets, field);
+                }
+            });
+            for (const std::uint64_t tileStep : tileSteps) {
+                steps += tileStep;
+            }
+        }
+    }
+    return steps;
+}
+
+// Material sliding from (x, y) to each of its four neighbours (left, right, down, up), returns the total
+static float thermalOutflow(const ProceduralSettings& settings, const HeightField& field, const int x, const int y,
+                            float outflow[4]) {
+    static constexpr int dx[4] = {-1, 1, 0, 0};
+    static constexpr int dy[4] = {0, 0, -1, 1};
+    const float height = field.at(x, y);
+    float excess[4];
+    float total = 0.0f;
+    float steepest = 0.0f;
+    for (int k = 0; k < 4; k++) {
+        const int nx = x + dx[k];
+        const int ny = y + dy[k];
+        const bool inside = nx >= 0 && ny >= 0 && nx < field.width && ny < field.height;
+        excess[k] = inside ? std::max(height - field.at(nx, ny) - settings.talus, 0.0f) : 0.0f;
+        total += excess[k];
+        steepest = std::max(steepest, excess[k]);
+    }
+    if (total == 0.0f) {
+        std::fill(outflow, outflow + 4, 0.0f);
+        return 0.0f;
+    }
+    // At most half the steepest excess, so a cell never ends up below the neighbour it slid to
+    const float moved = settings.thermalRate * 0.5f * steepest;
+    for (int k = 0; k < 4; k++) {
+        outflow[k] = moved * excess[k] / total;
+    }
+    return moved;
+}
+
+void erodeThermal(const ProceduralSettings& settings, HeightField& field) {
+    const int size = field.width;
+    HeightField next = field;
+    for (int iteration = 0; iteration < settings.thermalIterations; iteration++) {
+        // Every cell gathers what its neighbours send it from the previous iteration, so rows are independent
+        parallelFor(0, field.height, [&](const std::size_t rowBegin, const std::size_t rowEnd) {
+            float outflow[4];
+            for (std::size_t row = rowBegin; row < rowEnd; row++) {
+                const auto y = static_cast<int>(row);
+                for (int x = 0; x < size; x++) {
+                    float height = field.at(x, y) - thermalOutflow(settings, field, x, y, outflow);
+                    // The left neighbour's outflow to its right, and so on
+                    if (x > 0) {
+                        thermalOutflow(settings, field, x - 1, y, outflow);
+                        height += outflow[1];
+                    }
+                    if (x + 1 < size) {
+                        thermalOutflow(settings, field, x + 1, y, outflow);
+                        height += outflow[0];
+                    }
+                    if (y > 0) {
+                        thermalOutflow(settings, field, x, y - 1, outflow);
+                        height += outflow[3];
+                    }
+                    if (y + 1 < field.height) {
+                        thermalOutflow(settings, field, x, y + 1, outflow);
+                        height += outflow[2];
+                    }
+                    next.heights[row * size + x] = height;
+                }
+            }
+        }, minRowsPerChunk);
+        std::swap(field.heights, next.heights);
+    }
+}
+
+// Texels to packed heights, clamped to what 24 bits hold
+static void packHeights(const ProceduralSettings& settings, HeightField& field) {
+    const float scale = settings.peakHeight / (settings.relief * static_cast<float>(field.width));
+    parallelFor(0, field.heights.size(), [&](const std::size_t begin, const std::size_t end) {
+        for (std::size_t i = begin; i < end; i++) {
+            field.heights[i] = std::min(std::max(field.heights[i] * scale, 0.0f), maxPackedHeight);
+        }
+    }, 1 << 16);
+}
+
+HeightField generateTerrain(const ProceduralSettings& settings) {
+    HeightField field;
+    generateNoise(settings, field);
+    erodeHydraulic(settings, field);
+    erodeThermal(settings, field);
+    packHeights(settings, field);
+    return field;
+}
+
+// 24 bpp BMP of packed heights, rows bottom-up as decodeHeightField reads them
+static bool writePackedHeightMap(const std::string& path, const HeightField& field) {
+    const std::size_t rowSize = (3 * static_cast<std::size_t>(field.width) + 3) & ~static_cast<std::size_t>(3);
+    const std::size_t pixelBytes = rowSize * field.height;
+    unsigned char header[54] = {'B', 'M'};
+    const auto put = [&header](const std::size_t offset, const std::uint32_t value, const int bytes) {
+        for (int i = 0; i < bytes; i++) {
+            header[offset + i] = static_cast<unsigned char>(value >> (8 * i));
+        }
+    };
+    put(2, static_cast<std::uint32_t>(sizeof(header) + pixelBytes), 4);
+    put(10, sizeof(header), 4);
+    put(14, 40, 4);
+    put(18, static_cast<std::uint32_t>(field.width), 4);
+    put(22, static_cast<std::uint32_t>(field.height), 4);
+    put(26, 1, 2);
+    put(28, 24, 2);
+    put(34, static_cast<std::uint32_t>(pixelBytes), 4);
+
+    std::ofstream file(path, std::ios::binary);
+    file.write(reinterpret_cast<const char*>(header), sizeof(header));
+    std::vector<unsigned char> row(rowSize, 0);
+    for (int y = 0; y < field.height; y++) {
+        for (int x = 0; x < field.width; x++) {
+            const auto packed = static_cast<std::uint32_t>(std::lround(field.at(x, y)));
+            row[3 * x] = static_cast<unsigned char>(packed & 0xff);
+            row[3 * x + 1] = static_cast<unsigned char>(packed >> 8 & 0xff);
+            row[3 * x + 2] = static_cast<unsigned char>(packed >> 16 & 0xff);
+        }
+        file.write(reinterpret_cast<const char*>(row.data()), static_cast<std::streamsize>(row.size()));
+    }
+    if (!file.good()) {
+        std::cerr << "Height map " << path << " could not be written" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+static bool endsWith(const std::string& text, const std::string& suffix) {
+    return text.size() >= suffix.size() && text.compare(text.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+int runGenerateTerrain(const ProceduralSettings& settings, const char* path, const unsigned int tileSize) {
+    HeightField field;
+    Clock::time_point start = Clock::now();
+    generateNoise(settings, field);
+    const double noiseSeconds = secondsSince(start);
+    start = Clock::now();
+    const std::uint64_t steps = erodeHydraulic(settings, field);
+    const double hydraulicSeconds = secondsSince(start);
+    start = Clock::now();
+    erodeThermal(settings, field);
+    const double thermalSeconds = secondsSince(start);
+    packHeights(settings, field);
+
+    std::cout << std::fixed << std::setprecision(2) << "Generated " << settings.size << " x " << settings.size
+              << " terrain, seed " << settings.seed << ": noise " << noiseSeconds * 1e3 << " ms, hydraulic erosion "
+              << hydraulicSeconds * 1e3 << " ms (" << steps << " droplet steps), thermal erosion "
+              << thermalSeconds * 1e3 << " ms" << std::endl;
+
+    const std::string output = path;
+    if (endsWith(output, ".hmt")) {
+        const bool written = writeTiledHeightMap(output, field.width, field.height, tileSize,
+                                                 [&field](const int y, float* row) {
+            std::copy_n(&field.heights[static_cast<std::size_t>(y) * field.width], field.width, row);
+        });
+        return written ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+    if (!writePackedHeightMap(output, field)) {
+        return EXIT_FAILURE;
+    }
+    std::cout << "Wrote " << output << std::endl;
+    return EXIT_SUCCESS;
+}
+
+int runGeneratorBenchmark(const ProceduralSettings& settings) {
+    std::vector<unsigned int> threadCounts;
+    for (unsigned int threads = 1; threads < workerCount(); threads *= 2) {
+        threadCounts.push_back(threads);
+    }
+    threadCounts.push_back(workerCount());
+
+    const double texels = static_cast<double>(settings.size) * settings.size;
+    std::cout << settings.size << " x " << settings.size << " terrain, " << settings.octaves << " octaves, "
+              << settings.dropletsPerTexel << " droplets / texel, " << settings.thermalIterations
+              << " thermal iterations (million samples / s)" << std::endl
+              << "  threads     noise   octaves  droplet steps   thermal   total s" << std::endl;
+    std::uint64_t firstHash = 0;
+    bool identical = true;
+    for (const unsigned int threads : threadCounts) {
+        setWorkerCount(threads);
+        HeightField field;
+        const Clock::time_point start = Clock::now();
+        generateNoise(settings, field);
+        const double noiseSeconds = secondsSince(start);
+        Clock::time_point stage = Clock::now();
+        const std::uint64_t steps = erodeHydraulic(settings, field);
+        const double hydraulicSeconds = secondsSince(stage);
+        stage = Clock::now();
+        erodeThermal(settings, field);
+        const double thermalSeconds = secondsSince(stage);
+        packHeights(settings, field);
+        const double totalSeconds = secondsSince(start);
+
+        const std::uint64_t hash = fnv1a(reinterpret_cast<const unsigned char*>(field.heights.data()),
+                                         field.heights.size() * sizeof(float));
+        if (threads == threadCounts.front()) {
+            firstHash = hash;
+        }
+        identical = identical && hash == firstHash;
+        std::cout << "  " << std::setw(7) << threads << std::fixed << std::setprecision(2) << std::setw(10)
+                  << texels / noiseSeconds * 1e-6 << std::setw(10) << texels * settings.octaves / noiseSeconds * 1e-6
+                  << std::setw(15) << static_cast<double>(steps) / hydraulicSeconds * 1e-6 << std::setw(10)
+                  << texels * settings.thermalIterations / thermalSeconds * 1e-6 << std::setw(10) << totalSeconds
+                  << (hash == firstHash ? "" : "  differs from 1 thread") << std::endl;
+    }
+    setWorkerCount(0);
+    std::cout << (identical ? "Identical terrain at every thread count" : "Terrain depends on the thread count")
+              << std::endl;
+    return identical ? EXIT_SUCCESS : EXIT_FAILURE;
+}
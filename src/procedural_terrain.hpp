@@ -0,0 +1,81 @@
+#ifndef PROCEDURAL_TERRAIN_HPP
+#define PROCEDURAL_TERRAIN_HPP
+
+#include <cstdint>
+
+#include "terrain_bake.hpp"
+
+// Range of generated map sizes, in texels per side
+static constexpr unsigned int minProceduralSize = 16;
+static constexpr unsigned int maxProceduralSize = 8192;
+
+// What generateTerrain builds. Lengths are in texels and heights in texels too while generating, so slopes and
+// talus angles mean the same at any size; heights are only converted to packed units at the end.
+struct ProceduralSettings {
+    unsigned int size = 1025;
+    unsigned int seed = 1;
+
+    // Noise: fBm blended into Musgrave's ridged multifractal, both over the same octaves
+    int octaves = 8;
+    // Cycles of the first octave across the map
+    float frequency = 3.0f;
+    float lacunarity = 2.0f;
+    float gain = 0.5f;
+    // 0 is pure fBm, 1 pure ridges
+    float ridged = 0.6f;
+    // Valleys flatten and peaks sharpen above 1
+    float exponent = 2.0f;
+    // Highest peak over the width of the map
+    float relief = 0.3f;
+
+    // Hydraulic erosion: droplets run downhill eroding where they speed up and depositing where they slow down
+    float dropletsPerTexel = 0.6f;
+    int dropletLifetime = 64;
+    float inertia = 0.05f;
+    float sedimentCapacity = 4.0f;
+    float minSedimentCapacity = 0.01f;
+    float erosionRate = 0.3f;
+    float depositionRate = 0.02f;
+    float evaporation = 0.02f;
+    float gravity = 0.2f;
+    // Radius of the brush eroded around a droplet, at most maxErosionRadius
+    int erosionRadius = 3;
+    // Side of the tiles droplets are confined to; tiles of one phase run in parallel
+    int erosionTileSize = 128;
+    // Tiling passes, each shifted and with its share of the droplets, so tile edges do not line up
+    int erosionPasses = 4;
+
+    // Thermal erosion: material slides off slopes steeper than the talus, in iterations of Jacobi updates
+    int thermalIterations = 12;
+    float talus = 1.2f;
+    float thermalRate = 0.25f;
+
+    // Packed height of a texel at relief, 3.5 at the default heightMapScale
+    float peakHeight = 2.0e6f;
+};
+
+static constexpr int maxErosionRadius = 8;
+
+// Writes fBm / ridged noise into a size x size field, in texels. Rows are independent and vectorised.
+void generateNoise(const ProceduralSettings& settings, HeightField& field);
+
+// Simulates settings.dropletsPerTexel droplets per texel. Droplets never leave their tile's neighbourhood and
+// tiles of a phase are two tiles apart, so tiles run in any order on any number of threads with the same result.
+// Returns the droplet steps simulated.
+std::uint64_t erodeHydraulic(const ProceduralSettings& settings, HeightField& field);
+
+// Runs settings.thermalIterations Jacobi iterations of thermal erosion, rows in parallel
+void erodeThermal(const ProceduralSettings& settings, HeightField& field);
+
+// Noise, hydraulic then thermal erosion, converted to packed heights: identical for a seed at any thread count
+HeightField generateTerrain(const ProceduralSettings& settings);
+
+// Generates a terrain and writes it to path: packed 24 bpp heights for a .bmp, float tiles of tileSize texels
+// for a .hmt. Headless; returns a process exit code.
+int runGenerateTerrain(const ProceduralSettings& settings, const char* path, unsigned int tileSize);
+
+// Times every stage on 1, 2, 4 ... workerCount() threads, in samples per second, and checks that all thread
+// counts produce the same terrain. Headless; returns a process exit code.
+int runGeneratorBenchmark(const ProceduralSettings& settings);
+
+#endif
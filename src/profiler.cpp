@@ -0,0 +1,247 @@
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "profiler.hpp"
+
+#if defined(HEIGHTMAP_PROFILE)
+
+using Clock = std::chrono::steady_clock;
+
+// Events one thread can record between two collections; later ones are dropped
+static constexpr std::size_t ringCapacity = 4096;
+// Bound of the whole profile: 4M collected events, 128 MiB with 64 bit pointers
+static constexpr std::size_t maxProfileEvents = std::size_t(1) << 22;
+// GL_TIMESTAMP queries allocated at a time
+static constexpr std::size_t queryBatch = 64;
+// Trace track of GPU scopes; threads are numbered from 1
+static constexpr unsigned int gpuTrack = 0;
+
+static const Clock::time_point profileEpoch = Clock::now();
+
+static std::int64_t nanosecondsNow() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - profileEpoch).count();
+}
+
+struct ProfileEvent {
+    const char* name;
+    std::int64_t begin;
+    std::int64_t end;
+};
+
+struct CollectedEvent {
+    ProfileEvent event;
+    unsigned int track;
+};
+
+// Single producer, single consumer: the owning thread pushes, collectProfile pops
+struct ThreadRing {
+    std::array<ProfileEvent, ringCapacity> events;
+    std::atomic<std::size_t> head{0};
+    std::atomic<std::size_t> tail{0};
+    std::atomic<std::size_t> dropped{0};
+    // Set when the owning thread exits; the ring is released once drained
+    std::atomic<bool> retired{false};
+    unsigned int track = 0;
+};
+
+// Taken when threads first record or get named, and by the collector; never while recording an event
+static std::mutex registryMutex;
+static std::vector<std::shared_ptr<ThreadRing>> rings;
+static std::map<unsigned int, std::string> trackNames;
+static unsigned int nextTrack = gpuTrack + 1;
+
+// GL thread only
+struct PendingGpuScope {
+    const char* name;
+    GLuint begin;
+    GLuint end;
+};
+static std::vector<GLuint> queries;
+static std::vector<GLuint> freeQueries;
+static std::deque<PendingGpuScope> pendingGpuScopes;
+static bool gpuClockCalibrated = false;
+static std::int64_t gpuToProfileClock = 0;
+
+static std::vector<CollectedEvent> profile;
+static std::size_t droppedEvents = 0;
+
+// Registers the calling thread's ring on first use, retires it when the thread exits
+struct ThreadRingOwner {
+    std::shared_ptr<ThreadRing> ring = std::make_shared<ThreadRing>();
+
+    ThreadRingOwner() {
+        std::lock_guard<std::mutex> lock(registryMutex);
+        ring->track = nextTrack++;
+        rings.push_back(ring);
+    }
+
+    ~ThreadRingOwner() {
+        ring->retired.store(true, std::memory_order_release);
+    }
+};
+
+static ThreadRing& threadRing() {
+    thread_local ThreadRingOwner owner;
+    return *owner.ring;
+}
+
+static void pushEvent(const ProfileEvent& event) {
+    ThreadRing& ring = threadRing();
+    const std::size_t head = ring.head.load(std::memory_order_relaxed);
+    if (head - ring.tail.load(std::memory_order_acquire) == ringCapacity) {
+        ring.dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    ring.events[head % ringCapacity] = event;
+    ring.head.store(head + 1, std::memory_order_release);
+}
+
+static void record(const ProfileEvent& event, const unsigned int track) {
+    if (profile.size() == maxProfileEvents) {
+        droppedEvents++;
+        return;
+    }
+    profile.push_back({event, track});
+}
+
+static GLuint acquireQuery() {
+    if (!gpuClockCalibrated) {
+        // GPU timestamps are mapped onto the profile clock with one offset
+        GLint64 gpuNow = 0;
+        glGetInteger64v(GL_TIMESTAMP, &gpuNow);
+        gpuToProfileClock = nanosecondsNow() - gpuNow;
+        gpuClockCalibrated = true;
+    }
+    if (freeQueries.empty()) {
+        freeQueries.resize(queryBatch);
+        glGenQueries(static_cast<GLsizei>(queryBatch), &freeQueries[0]);
+        queries.insert(queries.end(), freeQueries.begin(), freeQueries.end());
+    }
+    const GLuint query = freeQueries.back();
+    freeQueries.pop_back();
+    return query;
+}
+
+static void collect(const bool wait) {
+    {
+        std::lock_guard<std::mutex> lock(registryMutex);
+        for (auto it = rings.begin(); it != rings.end();) {
+            ThreadRing& ring = **it;
+            // Checked first: a retired thread pushed everything before its head is read
+            const bool retired = ring.retired.load(std::memory_order_acquire);
+            const std::size_t tail = ring.tail.load(std::memory_order_relaxed);
+            const std::size_t head = ring.head.load(std::memory_order_acquire);
+            for (std::size_t i = tail; i < head; i++) {
+                record(ring.events[i % ringCapacity], ring.track);
+            }
+            ring.tail.store(head, std::memory_order_release);
+            droppedEvents += ring.dropped.exchange(0, std::memory_order_relaxed);
+            it = retired ? rings.erase(it) : it + 1;
+        }
+    }
+
+    // Scopes finish in order, so the oldest one gates the rest
+    while (!pendingGpuScopes.empty()) {
+        const PendingGpuScope scope = pendingGpuScopes.front();
+        if (!wait) {
+            GLint available = GL_FALSE;
+            glGetQueryObjectiv(scope.end, GL_QUERY_RESULT_AVAILABLE, &available);
+            if (available == GL_FALSE) {
+                break;
+            }
+        }
+        GLuint64 begin = 0;
+        GLuint64 end = 0;
+        glGetQueryObjectui64v(scope.begin, GL_QUERY_RESULT, &begin);
+        glGetQueryObjectui64v(scope.end, GL_QUERY_RESULT, &end);
+        record({scope.name, static_cast<std::int64_t>(begin) + gpuToProfileClock,
+                static_cast<std::int64_t>(end) + gpuToProfileClock}, gpuTrack);
+
+        freeQueries.push_back(scope.begin);
+        freeQueries.push_back(scope.end);
+        pendingGpuScopes.pop_front();
+    }
+}
+
+void collectProfile() {
+    collect(false);
+}
+
+void nameProfiledThread(const char* name) {
+    const unsigned int track = threadRing().track;
+    std::lock_guard<std::mutex> lock(registryMutex);
+    trackNames[track] = name;
+}
+
+ProfileScope::ProfileScope(const char* name) : name(name), begin(nanosecondsNow()) {
+}
+
+ProfileScope::~ProfileScope() {
+    pushEvent({name, begin, nanosecondsNow()});
+}
+
+GpuProfileScope::GpuProfileScope(const char* name) : cpu(name), name(name), beginQuery(acquireQuery()) {
+    glQueryCounter(beginQuery, GL_TIMESTAMP);
+}
+
+GpuProfileScope::~GpuProfileScope() {
+    const GLuint endQuery = acquireQuery();
+    glQueryCounter(endQuery, GL_TIMESTAMP);
+    pendingGpuScopes.push_back({name, beginQuery, endQuery});
+}
+
+bool writeProfile(const char* path) {
+    collect(true);
+    if (!queries.empty()) {
+        glDeleteQueries(static_cast<GLsizei>(queries.size()), &queries[0]);
+        queries.clear();
+        freeQueries.clear();
+    }
+
+    std::ofstream file(path);
+    if (!file.is_open()) {
+        std::cerr << "Profile " << path << " could not be written" << std::endl;
+        return false;
+    }
+
+    // Complete ("X") events in microseconds, one track per thread plus one for the GPU
+    file << std::fixed << std::setprecision(3) << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [" << std::endl
+         << "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": " << gpuTrack
+         << ", \"args\": {\"name\": \"GPU\"}}";
+    {
+        std::lock_guard<std::mutex> lock(registryMutex);
+        for (const auto& [track, name] : trackNames) {
+            file << "," << std::endl << "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": " << track
+                 << ", \"args\": {\"name\": \"" << name << "\"}}";
+        }
+    }
+    for (const auto& [event, track] : profile) {
+        file << "," << std::endl << "{\"name\": \"" << event.name << "\", \"ph\": \"X\", \"pid\": 1, \"tid\": "
+             << track << ", \"ts\": " << static_cast<double>(event.begin) * 1e-3
+             << ", \"dur\": " << static_cast<double>(event.end - event.begin) * 1e-3 << "}";
+    }
+    file << std::endl << "]}" << std::endl;
+
+    std::cout << "Profile of " << profile.size() << " events written to " << path << " (" << droppedEvents
+              << " dropped)" << std::endl;
+    return file.good();
+}
+
+#else
+
+bool writeProfile(const char*) {
+    std::cerr << "Profiling is compiled out: use the debug configuration, or pass --profile to premake" << std::endl;
+    return false;
+}
+
+#endif
@@ -0,0 +1,70 @@
+#ifndef PROFILER_HPP
+#define PROFILER_HPP
+
+#include <cstdint>
+
+#include <GL/glew.h>
+
+// Scoped CPU & GPU instrumentation, written out as Chrome trace_event JSON (chrome://tracing, Perfetto).
+// Compiled in with HEIGHTMAP_PROFILE (debug builds, or premake --profile); otherwise the macros vanish.
+//
+// PROFILE_SCOPE(name) times the enclosing block on the calling thread. Each thread records into its own
+// single-producer ring, drained without locks by PROFILE_COLLECT() once per frame on the GL thread.
+// PROFILE_GPU_SCOPE(name) also brackets the block's GL commands with GL_TIMESTAMP queries, which nest.
+// GL thread only; results are read back a few frames later.
+// PROFILE_THREAD(name) names the calling thread in the trace.
+// Names must be string literals, or otherwise outlive the profile.
+
+// Waits for outstanding GPU scopes, writes the profile and releases the GL queries. GL thread only.
+// Returns false if the file cannot be written, or profiling is compiled out.
+bool writeProfile(const char* path);
+
+#if defined(HEIGHTMAP_PROFILE)
+
+void collectProfile();
+void nameProfiledThread(const char* name);
+
+class ProfileScope {
+public:
+    explicit ProfileScope(const char* name);
+    ~ProfileScope();
+
+    ProfileScope(const ProfileScope&) = delete;
+    ProfileScope& operator=(const ProfileScope&) = delete;
+
+private:
+    const char* name;
+    std::int64_t begin;
+};
+
+class GpuProfileScope {
+public:
+    explicit GpuProfileScope(const char* name);
+    ~GpuProfileScope();
+
+    GpuProfileScope(const GpuProfileScope&) = delete;
+    GpuProfileScope& operator=(const GpuProfileScope&) = delete;
+
+private:
+    ProfileScope cpu;
+    const char* name;
+    GLuint beginQuery;
+};
+
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+#define PROFILE_SCOPE(name) ProfileScope PROFILE_CONCAT(profileScope, __LINE__)(name)
+#define PROFILE_GPU_SCOPE(name) GpuProfileScope PROFILE_CONCAT(gpuProfileScope, __LINE__)(name)
+#define PROFILE_THREAD(name) nameProfiledThread(name)
+#define PROFILE_COLLECT() collectProfile()
+
+#else
+
+#define PROFILE_SCOPE(name) ((void) 0)
+#define PROFILE_GPU_SCOPE(name) ((void) 0)
+#define PROFILE_THREAD(name) ((void) 0)
+#define PROFILE_COLLECT() ((void) 0)
+
+#endif
+
+#endif
@@ -0,0 +1,69 @@
+#include <vector>
+
+#include "program_reflection.hpp"
+
+void ProgramReflection::reflect(const GLuint program) {
+    locations.clear();
+    offsets.clear();
+    blockSizes.clear();
+
+    GLint linked = GL_FALSE;
+    glGetProgramiv(program, GL_LINK_STATUS, &linked);
+    if (linked != GL_TRUE) {
+        return;
+    }
+
+    GLint uniformCount = 0;
+    GLint maxNameLength = 0;
+    glGetProgramiv(program, GL_ACTIVE_UNIFORMS, &uniformCount);
+    glGetProgramiv(program, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxNameLength);
+    std::vector<char> name(static_cast<std::size_t>(maxNameLength) + 1);
+    for (GLuint i = 0; i < static_cast<GLuint>(uniformCount); i++) {
+        GLint size;
+        GLenum type;
+        glGetActiveUniform(program, i, static_cast<GLsizei>(name.size()), nullptr, &size, &type, &name[0]);
+
+        // Arrays are reported as name[0]; register them under their plain name
+        std::string uniform = &name[0];
+        if (const auto bracket = uniform.find('['); bracket != std::string::npos) {
+            uniform.resize(bracket);
+        }
+
+        GLint block = -1;
+        glGetActiveUniformsiv(program, 1, &i, GL_UNIFORM_BLOCK_INDEX, &block);
+        if (block == -1) {
+            locations[uniform] = glGetUniformLocation(program, &name[0]);
+        } else {
+            GLint offset = -1;
+            glGetActiveUniformsiv(program, 1, &i, GL_UNIFORM_OFFSET, &offset);
+            offsets[uniform] = offset;
+        }
+    }
+
+    GLint blockCount = 0;
+    GLint maxBlockNameLength = 0;
+    glGetProgramiv(program, GL_ACTIVE_UNIFORM_BLOCKS, &blockCount);
+    glGetProgramiv(program, GL_ACTIVE_UNIFORM_BLOCK_MAX_NAME_LENGTH, &maxBlockNameLength);
+    std::vector<char> blockName(static_cast<std::size_t>(maxBlockNameLength) + 1);
+    for (GLuint i = 0; i < static_cast<GLuint>(blockCount); i++) {
+        glGetActiveUniformBlockName(program, i, static_cast<GLsizei>(blockName.size()), nullptr, &blockName[0]);
+        GLint size = 0;
+        glGetActiveUniformBlockiv(program, i, GL_UNIFORM_BLOCK_DATA_SIZE, &size);
+        blockSizes[&blockName[0]] = size;
+    }
+}
+
+GLint ProgramReflection::location(const std::string& name) const {
+    const auto found = locations.find(name);
+    return found != locations.end() ? found->second : -1;
+}
+
+GLint ProgramReflection::blockOffset(const std::string& name) const {
+    const auto found = offsets.find(name);
+    return found != offsets.end() ? found->second : -1;
+}
+
+GLint ProgramReflection::blockSize(const std::string& name) const {
+    const auto found = blockSizes.find(name);
+    return found != blockSizes.end() ? found->second : 0;
+}
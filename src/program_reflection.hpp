@@ -0,0 +1,30 @@
+#ifndef PROGRAM_REFLECTION_HPP
+#define PROGRAM_REFLECTION_HPP
+
+#include <string>
+#include <unordered_map>
+
+#include <GL/glew.h>
+
+// Active uniforms & uniform blocks of a linked program, queried once per link instead of every frame
+class ProgramReflection {
+public:
+    // Replaces everything with the contents of program
+    void reflect(GLuint program);
+
+    // Location of a default block uniform, -1 when it is not active
+    GLint location(const std::string& name) const;
+
+    // Byte offset of a uniform inside its block, -1 when it is not an active block member
+    GLint blockOffset(const std::string& name) const;
+
+    // Data size of a uniform block, 0 when it is not active
+    GLint blockSize(const std::string& name) const;
+
+private:
+    std::unordered_map<std::string, GLint> locations;
+    std::unordered_map<std::string, GLint> offsets;
+    std::unordered_map<std::string, GLint> blockSizes;
+};
+
+#endif
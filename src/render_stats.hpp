@@ -0,0 +1,18 @@
+#ifndef RENDER_STATS_HPP
+#define RENDER_STATS_HPP
+
+#include <cstddef>
+
+// Work submitted for one frame
+struct RenderStats {
+    std::size_t drawCalls = 0;
+    std::size_t vertices = 0;
+    std::size_t triangles = 0;
+
+    // Terrain tiles tested against the view frustum, rejected by the test, and submitted
+    std::size_t tilesTested = 0;
+    std::size_t tilesCulled = 0;
+    std::size_t tilesDrawn = 0;
+};
+
+#endif
@@ -0,0 +1,73 @@
+#ifndef SHADER_BLOCKS_HPP
+#define SHADER_BLOCKS_HPP
+
+#include <cstddef>
+
+#include <GL/glew.h>
+#include <glm/mat4x4.hpp>
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+
+// Binding points of the uniform blocks declared by the shaders
+static constexpr GLuint frameUniformsBinding = 0;
+static constexpr GLuint materialUniformsBinding = 1;
+
+// std140 image of the FrameUniforms block: values that change at most once per frame.
+// A vec3 followed by a scalar shares one 16 byte slot; GLSL bools are 4 byte integers.
+struct FrameUniforms {
+    glm::mat4 MVP;
+    glm::mat4 V;
+    glm::mat4 M;
+    glm::vec3 lightDirection_wcs;
+    float heightMapScale;
+    glm::vec3 cameraPosition_wcs;
+    GLint normalMode;
+    glm::vec2 compactVertexDecode;
+    glm::vec2 lodUVTransform;
+    GLint packedTangents;
+    GLint compactVertices;
+    GLint lodMode;
+    GLint tiledHeightMap;
+    glm::vec4 heightTileGrid;
+    glm::vec4 tessellationGrid;
+    glm::vec4 tessellationDetail;
+    glm::vec2 pulledGrid;
+    GLint pulledVertices;
+    GLint padding;
+};
+
+static_assert(offsetof(FrameUniforms, lightDirection_wcs) == 192, "FrameUniforms must follow std140");
+static_assert(offsetof(FrameUniforms, cameraPosition_wcs) == 208, "FrameUniforms must follow std140");
+static_assert(offsetof(FrameUniforms, compactVertexDecode) == 224, "FrameUniforms must follow std140");
+static_assert(offsetof(FrameUniforms, packedTangents) == 240, "FrameUniforms must follow std140");
+static_assert(offsetof(FrameUniforms, heightTileGrid) == 256, "FrameUniforms must follow std140");
+static_assert(offsetof(FrameUniforms, tessellationGrid) == 272, "FrameUniforms must follow std140");
+static_assert(offsetof(FrameUniforms, pulledGrid) == 304, "FrameUniforms must follow std140");
+static_assert(sizeof(FrameUniforms) == 320, "FrameUniforms must follow std140");
+
+// Most terrain materials main.frag blends, a multiple of 4 (heights are packed in vec4s)
+static constexpr unsigned int maxTerrainMaterials = 8;
+
+// std140 image of the MaterialUniforms block: terrain shading constants
+struct MaterialUniforms {
+    glm::vec3 specularIntensity;
+    float tiles;
+    glm::vec3 ambientIntensity;
+    GLint materialCount;
+    glm::vec3 lightColour;
+    float padding;
+    // Height where material i takes over is materialHeights[i / 4][i % 4]
+    glm::vec4 materialHeights[maxTerrainMaterials / 4];
+    // Weights of the horizon map's channels, HorizonMap::weights
+    glm::vec2 horizonWeights;
+    glm::vec2 horizonPadding;
+};
+
+static_assert(offsetof(MaterialUniforms, ambientIntensity) == 16, "MaterialUniforms must follow std140");
+static_assert(offsetof(MaterialUniforms, materialHeights) == 48, "MaterialUniforms must follow std140");
+static_assert(offsetof(MaterialUniforms, horizonWeights) == 48 + 4 * maxTerrainMaterials,
+              "MaterialUniforms must follow std140");
+static_assert(sizeof(MaterialUniforms) == 64 + 4 * maxTerrainMaterials, "MaterialUniforms must follow std140");
+
+#endif
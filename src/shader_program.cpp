@@ -0,0 +1,343 @@
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include "mapped_file.hpp"
+#include "profiler.hpp"
+#include "shader_program.hpp"
+#include "texture_cache.hpp"
+
+// Bumped whenever the file layout changes, which invalidates every cached binary
+static constexpr std::uint32_t binaryCacheVersion = 1;
+static constexpr char binaryCacheMagic[4] = {'H', 'M', 'P', 'B'};
+
+// GL_COMPLETION_STATUS_KHR of KHR_parallel_shader_compile, newer than GLEW
+static constexpr GLenum completionStatus = 0x91B1;
+
+// Followed by the binary. Native byte order: the cache is local to the machine.
+struct BinaryCacheHeader {
+    char magic[4];
+    std::uint32_t version;
+    std::uint32_t format;
+    std::uint32_t size;
+    std::uint64_t hash;
+};
+
+static double millisecondsSince(const std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Whether shader & program status can be polled without blocking. GL thread only.
+static bool parallelCompileSupported() {
+    // GLEW only knows extensions from before it was released
+    static const bool supported = [] {
+        GLint extensionCount = 0;
+        glGetIntegerv(GL_NUM_EXTENSIONS, &extensionCount);
+        for (GLint i = 0; i < extensionCount; i++) {
+            const auto* extension = reinterpret_cast<const char*>(glGetStringi(GL_EXTENSIONS, static_cast<GLuint>(i)));
+            if (std::strcmp(extension, "GL_KHR_parallel_shader_compile") == 0 ||
+                std::strcmp(extension, "GL_ARB_parallel_shader_compile") == 0) {
+                return true;
+            }
+        }
+        return false;
+    }();
+    return supported;
+}
+
+static bool readSource(const std::string& path, std::string& source) {
+    std::ifstream stream(path, std::ios::in);
+    if (!stream.is_open()) {
+        std::cout << "Unable to open " << path << ". Are you in the right directory?" << std::endl;
+        return false;
+    }
+    std::stringstream sstr;
+    sstr << stream.rdbuf();
+    source = sstr.str();
+    return true;
+}
+
+// Starts compiling; the status is only queried once the driver is done
+static GLuint compileShader(const GLenum type, const std::string& path, const std::string& source) {
+    std::cout << "Compiling shader: " << path << std::endl;
+    const GLuint id = glCreateShader(type);
+    const char* sourcePointer = source.c_str();
+    glShaderSource(id, 1, &sourcePointer, nullptr);
+    glCompileShader(id);
+    return id;
+}
+
+// Reports the compilation result
+static bool checkShader(const GLuint id, const std::string& path) {
+    GLint compilationResult = GL_FALSE;
+    int infoLogLength;
+    glGetShaderiv(id, GL_COMPILE_STATUS, &compilationResult);
+    glGetShaderiv(id, GL_INFO_LOG_LENGTH, &infoLogLength);
+    if (infoLogLength > 0) {
+        std::vector<char> shaderErrorMessage(infoLogLength + 1);
+        glGetShaderInfoLog(id, infoLogLength, nullptr, &shaderErrorMessage[0]);
+        std::cout << &shaderErrorMessage[0] << std::endl;
+    }
+    std::cout << "Compilation of Shader: " << path << " " << (compilationResult == GL_TRUE ? "Success" : "Failed!")
+              << std::endl;
+    return compilationResult == GL_TRUE;
+}
+
+ShaderProgram::ShaderProgram(std::string vertexPath, std::string fragmentPath)
+    : stages{{GL_VERTEX_SHADER, std::move(vertexPath)}, {GL_FRAGMENT_SHADER, std::move(fragmentPath)}} {
+}
+
+ShaderProgram::ShaderProgram(std::string vertexPath, std::string tessControlPath, std::string tessEvaluationPath,
+                             std::string fragmentPath)
+    : stages{{GL_VERTEX_SHADER, std::move(vertexPath)},
+             {GL_TESS_CONTROL_SHADER, std::move(tessControlPath)},
+             {GL_TESS_EVALUATION_SHADER, std::move(tessEvaluationPath)},
+             {GL_FRAGMENT_SHADER, std::move(fragmentPath)}} {
+}
+
+ShaderProgram::ShaderProgram(std::string computePath) : stages{{GL_COMPUTE_SHADER, std::move(computePath)}} {
+}
+
+void ShaderProgram::setCacheDirectory(const std::string& directory) {
+    cacheDirectory = directory;
+}
+
+bool ShaderProgram::load() {
+    PROFILE_SCOPE("loadProgram");
+    Build build;
+    if (!start(build) || !finish(build)) {
+        discard(build);
+        return false;
+    }
+    glDeleteProgram(program);
+    program = build.program;
+    std::cout << std::fixed << std::setprecision(2) << "Program " << (build.cached ? "loaded from cache" : "built")
+              << " in " << millisecondsSince(build.startedAt) << " ms" << std::endl;
+    return true;
+}
+
+void ShaderProgram::reload() {
+    discard(pending);
+    reloading = start(pending);
+    if (!reloading) {
+        discard(pending);
+    }
+}
+
+bool ShaderProgram::update() {
+    if (!reloading || !isComplete(pending)) {
+        return false;
+    }
+    reloading = false;
+    if (!finish(pending)) {
+        std::cout << "Keeping the previous program" << std::endl;
+        discard(pending);
+        return false;
+    }
+
+    glDeleteProgram(program);
+    program = pending.program;
+    std::cout << std::fixed << std::setprecision(2) << "Program reloaded in " << millisecondsSince(pending.startedAt)
+              << " ms" << std::endl;
+    pending = Build();
+    return true;
+}
+
+GLuint ShaderProgram::id() const {
+    return program;
+}
+
+void ShaderProgram::destroy() {
+    discard(pending);
+    reloading = false;
+    glDeleteProgram(program);
+    program = 0;
+}
+
+bool ShaderProgram::start(Build& build) const {
+    build.startedAt = Clock::now();
+    std::vector<std::string> sources(stages.size());
+    for (std::size_t i = 0; i < stages.size(); i++) {
+        if (!readSource(stages[i].path, sources[i])) {
+            return false;
+        }
+    }
+
+    // Binaries are only valid for the driver that produced them
+    const std::string driver = std::string(reinterpret_cast<const char*>(glGetString(GL_RENDERER))) + "\n" +
+                               reinterpret_cast<const char*>(glGetString(GL_VERSION));
+    std::uint64_t hash = fnv1a(reinterpret_cast<const unsigned char*>(&binaryCacheVersion),
+                               sizeof(binaryCacheVersion));
+    const auto hashText = [&hash](const std::string& text) {
+        const auto length = static_cast<std::uint64_t>(text.size());
+        hash = fnv1a(reinterpret_cast<const unsigned char*>(&length), sizeof(length), hash);
+        hash = fnv1a(reinterpret_cast<const unsigned char*>(text.data()), text.size(), hash);
+    };
+    hashText(driver);
+    for (std::size_t i = 0; i < stages.size(); i++) {
+        hash = fnv1a(reinterpret_cast<const unsigned char*>(&stages[i].type), sizeof(stages[i].type), hash);
+        hashText(sources[i]);
+    }
+    build.hash = hash;
+    if (readBinary(build)) {
+        build.cached = true;
+        return true;
+    }
+
+    // Every stage and the link are only queued: drivers with parallel compilation return straight away
+    build.program = glCreateProgram();
+    for (std::size_t i = 0; i < stages.size(); i++) {
+        build.shaders.push_back(compileShader(stages[i].type, stages[i].path, sources[i]));
+        glAttachShader(build.program, build.shaders.back());
+    }
+    glProgramParameteri(build.program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    glLinkProgram(build.program);
+    return true;
+}
+
+bool ShaderProgram::isComplete(const Build& build) const {
+    if (build.cached || !parallelCompileSupported()) {
+        // Without the extension, the status is queried a frame after the link was issued
+        return true;
+    }
+    GLint complete = GL_FALSE;
+    glGetProgramiv(build.program, completionStatus, &complete);
+    return complete == GL_TRUE;
+}
+
+bool ShaderProgram::finish(Build& build) const {
+    if (build.cached) {
+        return true;
+    }
+
+    // Every stage reports its log, even after one has failed
+    bool compiled = true;
+    for (std::size_t i = 0; i < stages.size(); i++) {
+        compiled = checkShader(build.shaders[i], stages[i].path) && compiled;
+    }
+    if (!compiled) {
+        std::cout << "Program will not be linked: one of the shaders has an error" << std::endl;
+        return false;
+    }
+
+    PROFILE_SCOPE("linkProgram");
+    GLint result = GL_FALSE;
+    int infoLogLength;
+    std::cout << "Linking program..." << std::endl;
+    glGetProgramiv(build.program, GL_LINK_STATUS, &result);
+    glGetProgramiv(build.program, GL_INFO_LOG_LENGTH, &infoLogLength);
+    if (infoLogLength > 0) {
+        std::vector<char> programErrorMessages(infoLogLength + 1);
+        glGetProgramInfoLog(build.program, infoLogLength, nullptr, &programErrorMessages[0]);
+        std::cout << &programErrorMessages[0] << std::endl;
+    }
+    std::cout << "Linking program: " << (result == GL_TRUE ? "Success" : "Failed!") << std::endl;
+    if (result != GL_TRUE) {
+        return false;
+    }
+
+    // Shaders are no longer needed once linked
+    for (const GLuint shader : build.shaders) {
+        glDetachShader(build.program, shader);
+        glDeleteShader(shader);
+    }
+    build.shaders.clear();
+    writeBinary(build);
+    return true;
+}
+
+void ShaderProgram::discard(Build& build) {
+    for (const GLuint shader : build.shaders) {
+        glDeleteShader(shader);
+    }
+    glDeleteProgram(build.program);
+    build = Build();
+}
+
+bool ShaderProgram::readBinary(Build& build) const {
+    if (cacheDirectory.empty()) {
+        return false;
+    }
+    const std::string path = binaryPath(build.hash);
+    const MappedFile file(path.c_str());
+    if (!file.isOpen() || file.size() < sizeof(BinaryCacheHeader)) {
+        return false;
+    }
+    BinaryCacheHeader header;
+    std::memcpy(&header, file.data(), sizeof(header));
+    if (std::memcmp(header.magic, binaryCacheMagic, sizeof(binaryCacheMagic)) != 0 ||
+        header.version != binaryCacheVersion || header.hash != build.hash ||
+        file.size() != sizeof(header) + header.size) {
+        std::cerr << "Ignoring invalid program cache " << path << std::endl;
+        return false;
+    }
+
+    // The driver may still reject a binary, e.g. after an update that kept its version string
+    const GLuint id = glCreateProgram();
+    glProgramBinary(id, header.format, file.data() + sizeof(header), static_cast<GLsizei>(header.size));
+    GLint result = GL_FALSE;
+    glGetProgramiv(id, GL_LINK_STATUS, &result);
+    if (result != GL_TRUE) {
+        glDeleteProgram(id);
+        return false;
+    }
+    build.program = id;
+    return true;
+}
+
+void ShaderProgram::writeBinary(const Build& build) const {
+    GLint formatCount = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formatCount);
+    if (cacheDirectory.empty() || formatCount == 0) {
+        return;
+    }
+    GLint length = 0;
+    glGetProgramiv(build.program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0) {
+        return;
+    }
+    std::vector<char> binary(length);
+    GLenum format;
+    glGetProgramBinary(build.program, length, &length, &format, binary.data());
+
+    const std::string path = binaryPath(build.hash);
+    std::error_code error;
+    std::filesystem::create_directories(cacheDirectory, error);
+
+    // Written to a temporary file first, so readers never see a partial entry
+    const std::string temporaryPath = path + ".tmp";
+    {
+        std::ofstream file(temporaryPath, std::ios::binary);
+        BinaryCacheHeader header{};
+        std::memcpy(header.magic, binaryCacheMagic, sizeof(binaryCacheMagic));
+        header.version = binaryCacheVersion;
+        header.format = format;
+        header.size = static_cast<std::uint32_t>(length);
+        header.hash = build.hash;
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write(binary.data(), length);
+        if (!file.good()) {
+            std::cerr << "Program cache " << path << " could not be written" << std::endl;
+            file.close();
+            std::filesystem::remove(temporaryPath, error);
+            return;
+        }
+    }
+    std::filesystem::rename(temporaryPath, path, error);
+    if (error) {
+        std::cerr << "Program cache " << path << " could not be written: " << error.message() << std::endl;
+        std::filesystem::remove(temporaryPath, error);
+    }
+}
+
+std::string ShaderProgram::binaryPath(const std::uint64_t hash) const {
+    std::ostringstream name;
+    name << std::hex << std::setw(16) << std::setfill('0') << hash << ".program";
+    return (std::filesystem::path(cacheDirectory) / name.str()).string();
+}
@@ -0,0 +1,76 @@
+#ifndef SHADER_PROGRAM_HPP
+#define SHADER_PROGRAM_HPP
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <GL/glew.h>
+
+// A program linked from shader files: vertex & fragment, optionally with tessellation control & evaluation, or a
+// single compute shader.
+// Linked binaries are kept in a cache directory keyed by a hash of the sources and the driver, so unchanged
+// shaders skip compilation on later runs. Reloads compile in the background where the driver supports
+// KHR_parallel_shader_compile, and the current program stays in use until its replacement has linked.
+class ShaderProgram {
+public:
+    ShaderProgram(std::string vertexPath, std::string fragmentPath);
+    ShaderProgram(std::string vertexPath, std::string tessControlPath, std::string tessEvaluationPath,
+                  std::string fragmentPath);
+    explicit ShaderProgram(std::string computePath);
+
+    // Where linked binaries are cached across runs, none if empty. Call before loading.
+    void setCacheDirectory(const std::string& directory);
+
+    // Builds the program, blocking until it is linked. GL thread only; returns false if it fails.
+    bool load();
+
+    // Starts rebuilding from the files, replacing a reload still in progress. GL thread only.
+    void reload();
+
+    // Swaps in a reloaded program once the driver has linked it, deleting the old one; a program that fails to
+    // build is reported and dropped. Returns true when id() changed. Call once per frame on the GL thread.
+    bool update();
+
+    GLuint id() const;
+
+    // Deletes the program and any reload in progress. GL thread only.
+    void destroy();
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Stage {
+        GLenum type;
+        std::string path;
+    };
+
+    // Program being built, and its shaders (one per stage) until it has linked
+    struct Build {
+        std::vector<GLuint> shaders;
+        GLuint program = 0;
+        std::uint64_t hash = 0;
+        // Linked from the binary cache, no shaders involved
+        bool cached = false;
+        Clock::time_point startedAt;
+    };
+
+    bool start(Build& build) const;
+    bool isComplete(const Build& build) const;
+    bool finish(Build& build) const;
+    static void discard(Build& build);
+
+    bool readBinary(Build& build) const;
+    void writeBinary(const Build& build) const;
+    std::string binaryPath(std::uint64_t hash) const;
+
+    std::vector<Stage> stages;
+    std::string cacheDirectory;
+
+    GLuint program = 0;
+    Build pending;
+    bool reloading = false;
+};
+
+#endif
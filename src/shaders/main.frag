@@ -11,63 +11,85 @@ in float height;
 // Output
 out vec3 color;
 
-// Uniform samplers
-layout(binding = 1) uniform sampler2D grassSampler;
-layout(binding = 2) uniform sampler2D grassRoughnessSampler;
-layout(binding = 3) uniform sampler2D grassNormalSampler;
-layout(binding = 4) uniform sampler2D rocksSampler;
-layout(binding = 5) uniform sampler2D rocksRoughnessSampler;
-layout(binding = 6) uniform sampler2D rocksNormalSampler;
-layout(binding = 7) uniform sampler2D snowSampler;
-layout(binding = 8) uniform sampler2D snowRoughnessSampler;
-layout(binding = 9) uniform sampler2D snowNormalSampler;
-
-// Uniform model & view matrices
-uniform mat4 M;
-uniform mat4 V;
-
-// Uniform light properties
-uniform vec3 lightDirection_wcs;
-
-// Uniform normal mode - Output normals as colour
-uniform bool normalMode;
+// Uniform samplers - layer i of each array is terrain material i (terrain_materials.hpp)
+layout(binding = 1) uniform sampler2DArray albedoSampler;
+layout(binding = 2) uniform sampler2DArray roughnessSampler;
+layout(binding = 3) uniform sampler2DArray normalSampler;
+
+// Horizon tangents of two azimuth slices, one per channel (horizon_map.hpp)
+layout(binding = 6) uniform sampler2D horizonMapSampler;
+
+// Most materials blended, as maxTerrainMaterials in shader_blocks.hpp
+const int maxTerrainMaterials = 8;
+
+// Per-frame uniforms, shared with main.vert & the tess.* stages - std140 image in FrameUniforms (shader_blocks.hpp)
+layout(std140, binding = 0) uniform FrameUniforms {
+	mat4 MVP;
+	mat4 V;
+	mat4 M;
+	vec3 lightDirection_wcs;
+	float heightMapScale;
+	vec3 cameraPosition_wcs;
+	bool normalMode;
+	vec2 compactVertexDecode;
+	vec2 lodUVTransform;
+	bool packedTangents;
+	bool compactVertices;
+	bool lodMode;
+	bool tiledHeightMap;
+	vec4 heightTileGrid;
+	vec4 tessellationGrid;
+	vec4 tessellationDetail;
+	vec2 pulledGrid;
+	bool pulledVertices;
+};
+
+// Terrain shading parameters - std140 image in MaterialUniforms (shader_blocks.hpp)
+layout(std140, binding = 1) uniform MaterialUniforms {
+	// Lighting
+	vec3 specularIntensity;
+	// Texture repetitions across the terrain
+	float tiles;
+	vec3 ambientIntensity;
+	// Materials in the arrays
+	int materialCount;
+	vec3 lightColour;
+	// Height where material i takes over is materialHeights[i / 4][i % 4]
+	vec4 materialHeights[maxTerrainMaterials / 4];
+	// Blend of the horizon map channels giving the horizon towards the light
+	vec2 horizonWeights;
+};
+
+// Angle over which the light fades behind the horizon, in radians
+const float horizonPenumbra = 0.04;
 
 // Camera in view space - Always at (0, 0, 0)
 const vec3 camera_vcs = vec3(0.0, 0.0, 0.0);
 
-// Tiling constants
-const float tiles = 10.0;
-
-// Lighting constants
-const vec3 specularIntensity = vec3(0.01, 0.01, 0.01);
-const vec3 ambientIntensity = vec3(0.2, 0.2, 0.2);
-const vec3 lightColour = vec3(1.0, 1.0, 1.0);
-
-// Terrain interpolation constants
-const float grassHeight = 0.0;
-const float rocksHeight = grassHeight + 0.5;
-const float snowHeight = rocksHeight + 2.0;
-
-vec4 heightInterpolation(sampler2D grassTexture, sampler2D rocksTexture, sampler2D snowTexture) {
+vec4 heightInterpolation(sampler2DArray materials) {
 	vec2 tiledUV = tiles * UV;
-	float grassRocksFactor = clamp((height - rocksHeight) * 4.0, 0.0, 1.0);
-	float rocksSnowFactor = clamp((height - snowHeight) * 4.0, 0.0, 1.0);
 
-	vec4 grassRockMix = mix(texture(grassTexture, tiledUV), texture(rocksTexture, tiledUV), grassRocksFactor);
-	return mix(grassRockMix, texture(snowTexture, tiledUV), rocksSnowFactor);
+	// Each material fades in over the previous ones from its height
+	vec4 result = texture(materials, vec3(tiledUV, 0.0));
+	for (int i = 1; i < materialCount; i++) {
+		float factor = clamp((height - materialHeights[i / 4][i % 4]) * 4.0, 0.0, 1.0);
+		result = mix(result, texture(materials, vec3(tiledUV, float(i))), factor);
+	}
+	return result;
 }
 
 vec3 interpolateTerrain() {
-	return heightInterpolation(grassSampler, rocksSampler, snowSampler).rgb;
+	return heightInterpolation(albedoSampler).rgb;
 }
 
 float interpolateRoughness() {
-	return heightInterpolation(grassRoughnessSampler, rocksRoughnessSampler, snowRoughnessSampler).r;
+	return heightInterpolation(roughnessSampler).r;
 }
 
 vec3 interpolateNormal() {
-	vec3 normal = heightInterpolation(grassNormalSampler, rocksNormalSampler, snowNormalSampler).rgb;
-	return normalize(2.0 * normal - 1.0);
+	// Z is rebuilt from X & Y, which is all BC5 normal maps keep
+	vec2 xy = 2.0 * heightInterpolation(normalSampler).rg - 1.0;
+	return normalize(vec3(xy, sqrt(max(1.0 - dot(xy, xy), 0.0))));
 }
 
 mat3 computeTBN() {
@@ -78,6 +100,14 @@ mat3 computeTBN() {
 	return mat3(T_vcs, B_vcs, N_vcs);
 }
 
+// 1 where the light clears the terrain's horizon towards it, 0 where it sets behind it
+float horizonShadow() {
+	vec3 toLight = -lightDirection_wcs;
+	float horizon = dot(texture(horizonMapSampler, UV).rg, horizonWeights) * heightMapScale;
+	float elevation = atan(toLight.y, length(toLight.xz));
+	return smoothstep(-horizonPenumbra, horizonPenumbra, elevation - atan(horizon));
+}
+
 vec3 blinnPhongLighting() {
 	// Ambient
 	vec3 ambient = lightColour * ambientIntensity;
@@ -114,7 +144,7 @@ vec3 blinnPhongLighting() {
 	float cosThetaSpecular = max(dot(n, vb), 0.0);
 	vec3 specular = lightColour * specularIntensity * pow(cosThetaSpecular, shininess);
 
-	return ambient + diffuse + specular;
+	return ambient + (diffuse + specular) * horizonShadow();
 }
 
 void main() {
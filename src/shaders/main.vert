@@ -1,38 +1,66 @@
 #version 420 core
 
-// Uniform model view projection matrix
-uniform mat4 MVP;
-
-// Uniform height map values
+// Per-frame uniforms, shared with main.frag - std140 image in FrameUniforms (shader_blocks.hpp)
+layout(std140, binding = 0) uniform FrameUniforms {
+	// Model view projection, view & model matrices
+	mat4 MVP;
+	mat4 V;
+	mat4 M;
+	// Light direction & scale of the baked heights
+	vec3 lightDirection_wcs;
+	float heightMapScale;
+	// Camera position & normal mode - Output normals as colour
+	vec3 cameraPosition_wcs;
+	bool normalMode;
+	// Compact vertices - Positions & uvs are unorm16, expanded with compactVertexDecode (scale, uvRange)
+	vec2 compactVertexDecode;
+	// uv of an (x, z) position in LOD mode: xz * lodUVTransform.x + lodUVTransform.y, as on the strip
+	vec2 lodUVTransform;
+	// Packed tangents - TBN comes from vertexQTangent instead of vertexTangent & vertexBitangent
+	bool packedTangents;
+	bool compactVertices;
+	// LOD mode - vertexPosition_ocs.xy is a patch grid point, placed per node
+	bool lodMode;
+	// Tiled height map - Full resolution heights come from the tile atlas where resident, see bakedHeight.
+	// heightTileGrid is (width, height, tileSize, 0) of the full resolution map
+	bool tiledHeightMap;
+	vec4 heightTileGrid;
+	// Tessellated mode - see tess.tesc
+	vec4 tessellationGrid;
+	vec4 tessellationDetail;
+	// Pulled vertices - Strip grid points come from gl_VertexID & gl_InstanceID, pulledGrid is (nPoints, extent)
+	vec2 pulledGrid;
+	bool pulledVertices;
+};
+
+// Uniform baked height map: r = height, gb = (nx, nz) gradient of the normal kernel, all unscaled
 layout(binding = 0) uniform sampler2D heightMapSampler;
-uniform float heightMapScale;
 
-// Uniform nPoints
-uniform float nPoints;
+// Tiled height maps: tiles baked like heightMapSampler, one per layer, and the layer of every tile (-1 if absent).
+// heightMapSampler then holds the overview of the whole map.
+layout(binding = 4) uniform sampler2DArray heightTileAtlas;
+layout(binding = 5) uniform isampler2D heightTileTable;
 
-// Direction vectors
-const vec2 up = vec2(0.0, -1.0);
-const vec2 left = vec2(-1.0, 0.0);
-const vec2 down = vec2(0.0, 1.0);
-const vec2 right = vec2(0.0, 1.0);
+// Uniform LOD node - placed by lodNode (origin x, origin z, size, patchSize) and morphed into the coarser grid
+// between lodMorphRange (start, end) camera distances
+uniform vec4 lodNode;
+uniform vec2 lodMorphRange;
 
-const vec2 leftUp = left + up;
-const vec2 leftDown = left + down;
-const vec2 rightUp = right + up;
-const vec2 rightDown = right + down;
+// Indirect LOD draws - lodNode & lodMorphRange come per draw from vertexLodNode & vertexLodMorphRange instead,
+// as lod_cull.comp wrote them
+uniform bool lodIndirect;
 
-// Weights matrix - Used for normal approximation
-const mat3 weights = mat3(
-	1.0, 5.0, 1.0,
-	5.0, 0.25, 5.0,
-	1.0, 5.0, 1.0
-);
+// Centre weight of the normal kernel, see bakeTerrain
+const float normalKernelWeight = 0.25;
 
 // Input vertex data, different for all executions of this shader
 layout(location = 0) in vec3 vertexPosition_ocs;
 layout(location = 1) in vec2 vertexUV;
 layout(location = 2) in vec3 vertexTangent;
 layout(location = 3) in vec3 vertexBitangent;
+layout(location = 4) in vec4 vertexQTangent;
+layout(location = 5) in vec4 vertexLodNode;
+layout(location = 6) in vec2 vertexLodMorphRange;
 
 // Output data - will be interpolated for each fragment
 out vec2 UV;
@@ -42,51 +70,99 @@ out vec3 N;
 out vec3 position_ocs;
 out float height;
 
-float heightAt(vec2 uv) {
-	// Decode height from rgb height map
-	vec3 rgbHeight = texture(heightMapSampler, uv).rgb;
-	uint r = uint(rgbHeight.r * 255.0);
-	uint g = uint(rgbHeight.g * 255.0);
-	uint b = uint(rgbHeight.b * 255.0);
-
-	return float((r << 16) + (g << 8) + b) * heightMapScale;
+vec3 normalFrom(vec2 gradient) {
+	return normalize(abs(vec3(gradient.x * heightMapScale, normalKernelWeight, gradient.y * heightMapScale)));
 }
 
-float neighbourHeightIn(vec2 direction) {
-	return heightAt(vertexUV + (direction / nPoints));
+// (height, nx, nz) at uv: the resident tile's texel, or the height map's
+vec3 bakedHeight(vec2 uv) {
+	if (tiledHeightMap) {
+		ivec2 texel = clamp(ivec2(floor(uv * heightTileGrid.xy)), ivec2(0), ivec2(heightTileGrid.xy) - 1);
+		ivec2 tile = texel / int(heightTileGrid.z);
+		int layer = texelFetch(heightTileTable, tile, 0).r;
+		if (layer >= 0) {
+			return texelFetch(heightTileAtlas, ivec3(texel - tile * int(heightTileGrid.z), layer), 0).rgb;
+		}
+	}
+	return textureLod(heightMapSampler, uv, 0.0).rgb;
 }
 
-vec3 sampleNormal() {
-	float nx =
-		(weights[0][0] * neighbourHeightIn(leftUp) - weights[0][2] * neighbourHeightIn(rightUp)) +
-		(weights[1][0] * neighbourHeightIn(left) - weights[1][2] * neighbourHeightIn(right)) +
-		(weights[2][0] * neighbourHeightIn(leftDown) - weights[2][2] * neighbourHeightIn(rightDown));
-
-	float ny = weights[1][1];
-
-	float nz =
-		(weights[0][0] * neighbourHeightIn(leftUp) - weights[2][0] * neighbourHeightIn(leftDown)) +
-		(weights[0][1] * neighbourHeightIn(up) - weights[2][1] * neighbourHeightIn(down)) +
-		(weights[0][2] * neighbourHeightIn(rightUp) - weights[2][2] * neighbourHeightIn(rightDown));
+vec2 lodGridToXZ(vec4 node, vec2 grid) {
+	return node.xy + grid * (node.z / node.w);
+}
 
-	return normalize(abs(vec3(nx, ny, nz)));
+void unpackQTangent(vec4 q, out vec3 tangent, out vec3 bitangent) {
+	// Tangent & bitangent are the rotated x & y axes, the sign of w holds the handedness
+	q = normalize(q);
+	tangent = vec3(
+		1.0 - 2.0 * (q.y * q.y + q.z * q.z),
+		2.0 * (q.x * q.y + q.w * q.z),
+		2.0 * (q.x * q.z - q.w * q.y)
+	);
+	bitangent = vec3(
+		2.0 * (q.x * q.y - q.w * q.z),
+		1.0 - 2.0 * (q.x * q.x + q.z * q.z),
+		2.0 * (q.y * q.z + q.w * q.x)
+	) * (q.w < 0.0 ? -1.0 : 1.0);
 }
 
 void main() {
+	// Expand compact vertices: (x, z) in [0, 1] to [-scale, scale]
+	vec3 vertexPosition = vertexPosition_ocs;
+	if (compactVertices) {
+		vec2 xz = (2.0 * vertexPosition_ocs.xy - 1.0) * compactVertexDecode.x;
+		vertexPosition = vec3(xz.x, 0.0, xz.y);
+	}
+	vec2 uv = compactVertices ? vertexUV * compactVertexDecode.y : vertexUV;
+
+	// Generate pulled vertices as TerrainMeshBuilder does: instance i is the strip between rows i & i + 1,
+	// visited as (i + 1, j), (i, j) for every column j
+	if (pulledVertices) {
+		vec2 grid = vec2(gl_InstanceID + 1 - (gl_VertexID & 1), gl_VertexID / 2);
+		float cells = pulledGrid.x - 1.0;
+		vec2 xz = (grid / cells - 0.5) * 2.0 * pulledGrid.y;
+		vertexPosition = vec3(xz.x, 0.0, xz.y);
+		uv = (grid + 0.5) / cells;
+	}
+
+	// Place LOD patch vertices, morphing odd grid points onto their even neighbours with distance
+	if (lodMode) {
+		vec4 node = lodIndirect ? vertexLodNode : lodNode;
+		vec2 morphRange = lodIndirect ? vertexLodMorphRange : lodMorphRange;
+		vec2 grid = vertexPosition_ocs.xy;
+		vec2 xz = lodGridToXZ(node, grid);
+		float unmorphedHeight = bakedHeight(xz * lodUVTransform.x + lodUVTransform.y).r * heightMapScale;
+		float cameraDistance = distance(cameraPosition_wcs, vec3(xz.x, unmorphedHeight, xz.y));
+		float morph = clamp((cameraDistance - morphRange.x) / (morphRange.y - morphRange.x), 0.0, 1.0);
+		grid -= fract(grid * 0.5) * 2.0 * morph;
+		xz = lodGridToXZ(node, grid);
+		vertexPosition = vec3(xz.x, 0.0, xz.y);
+		uv = xz * lodUVTransform.x + lodUVTransform.y;
+	}
+
 	// Add height to vertexPosition, in object space
-	height = heightAt(vertexUV);
-	position_ocs = vertexPosition_ocs + vec3(0.0, height, 0.0);
+	vec3 baked = bakedHeight(uv);
+	height = baked.r * heightMapScale;
+	position_ocs = vertexPosition + vec3(0.0, height, 0.0);
 
 	// Output position of the vertex, in clip space: MVP * position
 	gl_Position = MVP * vec4(position_ocs, 1.0);
 
 	// Output vertex UV
-	UV = vertexUV;
+	UV = uv;
 
 	// Compute TBN vectors
-	T = normalize(vertexTangent);
-	B = normalize(vertexBitangent);
-	N = sampleNormal();
+	if (lodMode || pulledVertices) {
+		// Patches & the pulled grid are regular grids along x & z
+		T = vec3(1.0, 0.0, 0.0);
+		B = vec3(0.0, 0.0, 1.0);
+	} else if (packedTangents) {
+		unpackQTangent(vertexQTangent, T, B);
+	} else {
+		T = normalize(vertexTangent);
+		B = normalize(vertexBitangent);
+	}
+	N = normalFrom(baked.gb);
 	// Gram-Schmidt to orthogonalise T & B with respect to N
 	T = normalize(T - dot(T, N) * N);
 	B = normalize(B - dot(B, N) * N);
@@ -0,0 +1,36 @@
+#version 420 core
+
+// Per-frame uniforms, as declared by main.vert - std140 image in FrameUniforms (shader_blocks.hpp)
+layout(std140, binding = 0) uniform FrameUniforms {
+	mat4 MVP;
+	mat4 V;
+	mat4 M;
+	vec3 lightDirection_wcs;
+	float heightMapScale;
+	vec3 cameraPosition_wcs;
+	bool normalMode;
+	vec2 compactVertexDecode;
+	vec2 lodUVTransform;
+	bool packedTangents;
+	bool compactVertices;
+	bool lodMode;
+	bool tiledHeightMap;
+	vec4 heightTileGrid;
+	// Tessellated mode - (patches per side, extent, pixels per world unit at distance 1, edge pixels) and
+	// (flat detail, rough slope, 0, 0), see TessellationSettings
+	vec4 tessellationGrid;
+	vec4 tessellationDetail;
+	vec2 pulledGrid;
+	bool pulledVertices;
+};
+
+// Patch corner, in grid units: patch (i, j) spans [i, i + 1] x [j, j + 1]
+out vec2 corner;
+
+void main() {
+	// 4 corners per patch, (0, 0), (1, 0), (0, 1) & (1, 1) in turn - no vertex attributes
+	int patchesPerSide = int(tessellationGrid.x);
+	int patchIndex = gl_VertexID / 4;
+	int cornerIndex = gl_VertexID % 4;
+	corner = vec2(patchIndex % patchesPerSide + (cornerIndex & 1), patchIndex / patchesPerSide + (cornerIndex >> 1));
+}
\ No newline at end of file
@@ -0,0 +1,78 @@
+#include <algorithm>
+#include <cmath>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include "parallel.hpp"
+#include "tangent_frame.hpp"
+
+// Vertices per chunk when filling the per-vertex streams
+static constexpr std::size_t minVerticesPerChunk = 1 << 16;
+
+// Smallest |w| representable in snorm16, keeps the handedness sign when w would quantise to 0
+static constexpr float minQTangentW = 1.0f / 32767.0f;
+
+TangentFrame gridTangentFrame(const TerrainMesh& mesh) {
+    // First quad of the grid: v0 = (0, 0), v1 = (1, 0), v2 = (0, 1)
+    const unsigned int n = mesh.nPoints;
+    const glm::vec3 e1 = mesh.vertices[n] - mesh.vertices[0];
+    const glm::vec3 e2 = mesh.vertices[1] - mesh.vertices[0];
+    const glm::vec2 duv1 = mesh.uvs[n] - mesh.uvs[0];
+    const glm::vec2 duv2 = mesh.uvs[1] - mesh.uvs[0];
+
+    const float r = 1.0f / (duv1.x * duv2.y - duv2.x * duv1.y);
+    return {
+        (e1 * duv2.y - e2 * duv1.y) * r,
+        (e2 * duv1.x - e1 * duv2.x) * r
+    };
+}
+
+void generateTangentFrames(const TerrainMesh& mesh, std::vector<glm::vec3>& tangents,
+                           std::vector<glm::vec3>& bitangents) {
+    const TangentFrame frame = gridTangentFrame(mesh);
+    tangents.resize(mesh.vertices.size());
+    bitangents.resize(mesh.vertices.size());
+
+    parallelFor(0, mesh.vertices.size(), [&](const std::size_t begin, const std::size_t end) {
+        std::fill(tangents.begin() + begin, tangents.begin() + end, frame.tangent);
+        std::fill(bitangents.begin() + begin, bitangents.begin() + end, frame.bitangent);
+    }, minVerticesPerChunk);
+}
+
+void generatePackedTangentFrames(const TerrainMesh& mesh, const glm::vec3& normal,
+                                 std::vector<glm::i16vec4>& qtangents) {
+    const glm::i16vec4 qtangent = packQTangent(gridTangentFrame(mesh), normal);
+    qtangents.resize(mesh.vertices.size());
+
+    parallelFor(0, mesh.vertices.size(), [&](const std::size_t begin, const std::size_t end) {
+        std::fill(qtangents.begin() + begin, qtangents.begin() + end, qtangent);
+    }, minVerticesPerChunk);
+}
+
+glm::i16vec4 packQTangent(const TangentFrame& frame, const glm::vec3& normal) {
+    // Build a proper rotation from T and N, the bitangent is recovered up to its sign
+    const glm::vec3 n = glm::normalize(normal);
+    const glm::vec3 t = glm::normalize(frame.tangent - glm::dot(frame.tangent, n) * n);
+    const glm::vec3 b = glm::cross(n, t);
+    const float handedness = glm::dot(frame.bitangent, b) < 0.0f ? -1.0f : 1.0f;
+
+    glm::quat q = glm::normalize(glm::quat_cast(glm::mat3(t, b, n)));
+
+    // q and -q are the same rotation: force w >= minQTangentW, then store handedness in its sign
+    if (q.w < 0.0f) {
+        q = -q;
+    }
+    if (q.w < minQTangentW) {
+        q.w = minQTangentW;
+        q = glm::normalize(q);
+    }
+    if (handedness < 0.0f) {
+        q = -q;
+    }
+
+    const auto snorm16 = [](const float value) {
+        return static_cast<glm::i16>(std::round(glm::clamp(value, -1.0f, 1.0f) * 32767.0f));
+    };
+    return {snorm16(q.x), snorm16(q.y), snorm16(q.z), snorm16(q.w)};
+}
@@ -0,0 +1,33 @@
+#ifndef TANGENT_FRAME_HPP
+#define TANGENT_FRAME_HPP
+
+#include <vector>
+
+#include <glm/vec3.hpp>
+#include <glm/gtc/type_precision.hpp>
+
+#include "terrain_mesh_builder.hpp"
+
+// Tangent (dP/du) and bitangent (dP/dv) of a surface
+struct TangentFrame {
+    glm::vec3 tangent;
+    glm::vec3 bitangent;
+};
+
+// Closed form tangent frame of a regular grid.
+// Every quad has the same edges and UV deltas, so 1/det is computed once for the whole mesh.
+TangentFrame gridTangentFrame(const TerrainMesh& mesh);
+
+// Per-vertex tangents and bitangents, indexed like mesh.vertices
+void generateTangentFrames(const TerrainMesh& mesh, std::vector<glm::vec3>& tangents,
+                           std::vector<glm::vec3>& bitangents);
+
+// Per-vertex quaternion encoded TBN (QTangent) as 4 x snorm16, indexed like mesh.vertices.
+// The sign of w holds the bitangent handedness.
+void generatePackedTangentFrames(const TerrainMesh& mesh, const glm::vec3& normal,
+                                 std::vector<glm::i16vec4>& qtangents);
+
+// Encodes a tangent frame and its normal as a QTangent
+glm::i16vec4 packQTangent(const TangentFrame& frame, const glm::vec3& normal);
+
+#endif
@@ -0,0 +1,241 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+
+#include <glm/glm.hpp>
+
+#if defined(__SSSE3__)
+#include <tmmintrin.h>
+#endif
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define TERRAIN_BAKE_SSE2 1
+#endif
+
+#include "parallel.hpp"
+#include "terrain_bake.hpp"
+#include "terrain_mesh_builder.hpp"
+
+// Taps of the original main.vert kernel: direction (as declared there, including right == down) and the
+// weights it contributes to nx and nz
+struct KernelTap {
+    glm::vec2 direction;
+    float weightX;
+    float weightZ;
+};
+
+static const KernelTap kernelTaps[] = {
+    {{-1.0f, -1.0f}, 1.0f, 1.0f}, // leftUp
+    {{0.0f, 0.0f}, -1.0f, 1.0f}, // rightUp
+    {{-1.0f, 0.0f}, 5.0f, 0.0f}, // left
+    {{0.0f, 1.0f}, -5.0f, 0.0f}, // right
+    {{-1.0f, 1.0f}, 1.0f, -1.0f}, // leftDown
+    {{0.0f, 2.0f}, -1.0f, -1.0f}, // rightDown
+    {{0.0f, -1.0f}, 0.0f, 5.0f}, // up
+    {{0.0f, 1.0f}, 0.0f, -5.0f} // down
+};
+static constexpr int kernelTapCount = sizeof(kernelTaps) / sizeof(kernelTaps[0]);
+
+// Centre weight of the kernel, the y component of every normal
+static constexpr float kernelCentreWeight = 0.25f;
+
+// Rows per chunk when decoding and baking in parallel
+static constexpr std::size_t minRowsPerChunk = 8;
+
+float HeightField::at(const int x, const int y) const {
+    return heights[static_cast<std::size_t>(y) * width + x];
+}
+
+float HeightField::nearest(const glm::vec2& uv) const {
+    const int x = glm::clamp(static_cast<int>(std::floor(uv.x * width)), 0, width - 1);
+    const int y = glm::clamp(static_cast<int>(std::floor(uv.y * height)), 0, height - 1);
+    return at(x, y);
+}
+
+void decodeHeightRow(const ImageView& image, const int y, float* destination) {
+    // Bytes are B, G, R: the height is the little endian 24 bit value of each pixel
+    const unsigned char* source = image.row(y);
+    int x = 0;
+#if defined(__SSSE3__)
+    // 16 byte loads cover four pixels; stop while the load still stays inside the row
+    const __m128i gather = _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+    for (; static_cast<std::size_t>(x) * 3 + 16 <= image.stride && x + 4 <= image.width; x += 4) {
+        const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + 3 * x));
+        _mm_storeu_ps(destination + x, _mm_cvtepi32_ps(_mm_shuffle_epi8(bytes, gather)));
+    }
+#endif
+    for (; x < image.width; x++) {
+        const unsigned char* pixel = source + 3 * x;
+        destination[x] = static_cast<float>((pixel[2] << 16) + (pixel[1] << 8) + pixel[0]);
+    }
+}
+
+bool decodeHeightField(const ImageView& image, HeightField& field) {
+    if (image.format != PixelFormat::BGR8) {
+        return false;
+    }
+
+    field.width = image.width;
+    field.height = image.height;
+    field.heights.resize(static_cast<std::size_t>(image.width) * image.height);
+
+    parallelFor(0, image.height, [&](const std::size_t rowBegin, const std::size_t rowEnd) {
+        for (std::size_t y = rowBegin; y < rowEnd; y++) {
+            decodeHeightRow(image, static_cast<int>(y), &field.heights[y * image.width]);
+        }
+    }, minRowsPerChunk);
+    return true;
+}
+
+glm::vec2 referenceNormalGradient(const HeightField& field, const glm::vec2& uv, const float nPoints) {
+    glm::vec2 gradient(0.0f);
+    for (const auto& tap : kernelTaps) {
+        const float neighbour = field.nearest(uv + tap.direction / nPoints);
+        gradient.x += tap.weightX * neighbour;
+        gradient.y += tap.weightZ * neighbour;
+    }
+    return gradient;
+}
+
+glm::vec3 normalFromGradient(const glm::vec2& gradient, const float heightMapScale) {
+    return glm::normalize(glm::abs(glm::vec3(heightMapScale * gradient.x, kernelCentreWeight,
+                                             heightMapScale * gradient.y)));
+}
+
+void bakeTerrain(const HeightField& field, const float nPoints, glm::vec3* baked) {
+    const int width = field.width;
+    const int height = field.height;
+
+    // At texel centres, floor((x + 0.5) / width + d / nPoints) * width) = x + floor(0.5 + d * width / nPoints):
+    // every tap is a constant integer texel offset
+    int offsetX[kernelTapCount];
+    int offsetY[kernelTapCount];
+    int minOffsetX = 0;
+    int maxOffsetX = 0;
+    for (int t = 0; t < kernelTapCount; t++) {
+        offsetX[t] = static_cast<int>(std::floor(0.5f + kernelTaps[t].direction.x * width / nPoints));
+        offsetY[t] = static_cast<int>(std::floor(0.5f + kernelTaps[t].direction.y * height / nPoints));
+        minOffsetX = std::min(minOffsetX, offsetX[t]);
+        maxOffsetX = std::max(maxOffsetX, offsetX[t]);
+    }
+
+    parallelFor(0, height, [&](const std::size_t rowBegin, const std::size_t rowEnd) {
+        std::vector<float> gradientX(width);
+        std::vector<float> gradientZ(width);
+
+        for (auto y = static_cast<int>(rowBegin); y < static_cast<int>(rowEnd); y++) {
+            std::fill(gradientX.begin(), gradientX.end(), 0.0f);
+            std::fill(gradientZ.begin(), gradientZ.end(), 0.0f);
+
+            // Accumulate one tap at a time over the whole row; columns whose tap stays inside the row
+            // are a plain shifted, weighted add
+            const int interiorBegin = std::min(width, -minOffsetX);
+            const int interiorEnd = std::max(interiorBegin, width - maxOffsetX);
+            for (int t = 0; t < kernelTapCount; t++) {
+                const float* row = &field.heights[static_cast<std::size_t>(glm::clamp(y + offsetY[t], 0, height - 1))
+                                                  * width];
+                const float weightX = kernelTaps[t].weightX;
+                const float weightZ = kernelTaps[t].weightZ;
+                const int shift = offsetX[t];
+
+                const auto clampedAdd = [&](const int x) {
+                    const float neighbour = row[glm::clamp(x + shift, 0, width - 1)];
+                    gradientX[x] += weightX * neighbour;
+                    gradientZ[x] += weightZ * neighbour;
+                };
+                for (int x = 0; x < interiorBegin; x++) {
+                    clampedAdd(x);
+                }
+                int x = interiorBegin;
+#ifdef TERRAIN_BAKE_SSE2
+                const __m128 weightsX = _mm_set1_ps(weightX);
+                const __m128 weightsZ = _mm_set1_ps(weightZ);
+                for (; x + 4 <= interiorEnd; x += 4) {
+                    const __m128 neighbours = _mm_loadu_ps(row + x + shift);
+                    _mm_storeu_ps(&gradientX[x], _mm_add_ps(_mm_loadu_ps(&gradientX[x]),
+                                                            _mm_mul_ps(weightsX, neighbours)));
+                    _mm_storeu_ps(&gradientZ[x], _mm_add_ps(_mm_loadu_ps(&gradientZ[x]),
+                                                            _mm_mul_ps(weightsZ, neighbours)));
+                }
+#endif
+                for (; x < width; x++) {
+                    clampedAdd(x);
+                }
+            }
+
+            glm::vec3* destination = &baked[static_cast<std::size_t>(y) * width];
+            for (int x = 0; x < width; x++) {
+                destination[x] = glm::vec3(field.at(x, y), gradientX[x], gradientZ[x]);
+            }
+        }
+    }, minRowsPerChunk);
+}
+
+int runBakeCheck(const char* path, const unsigned int nPoints, const float heightMapScale) {
+    BMPImage image;
+    HeightField field;
+    if (!openBMP(path, image) || !decodeHeightField(image.view, field)) {
+        std::cout << "Height maps must be 24 bpp BMPs" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    // The shader divides by nPoints - 1, the number of cells
+    const auto cells = static_cast<float>(nPoints - 1);
+    std::vector<glm::vec3> baked(field.heights.size());
+    bakeTerrain(field, cells, baked.data());
+
+    const auto texelOf = [&field](const glm::vec2& uv) {
+        return glm::ivec2(glm::clamp(static_cast<int>(std::floor(uv.x * field.width)), 0, field.width - 1),
+                          glm::clamp(static_cast<int>(std::floor(uv.y * field.height)), 0, field.height - 1));
+    };
+
+    // The original shader ran the kernel at every vertex uv; the bake runs it at the centre of the texel the vertex
+    // falls in, and the vertex fetches that. A tap can then land one texel away from where the shader's did, which
+    // is reported as a shift. Where every tap lands on the same texel, both must agree.
+    const TerrainMesh mesh = TerrainMeshBuilder(nPoints, 1.0f).build();
+    std::size_t heightMismatches = 0;
+    std::size_t shifted = 0;
+    double maxError = 0.0;
+    double maxMagnitude = 0.0;
+    double maxShiftDegrees = 0.0;
+    double totalShiftDegrees = 0.0;
+    for (const glm::vec2& uv : mesh.uvs) {
+        const glm::ivec2 texel = texelOf(uv);
+        const glm::vec2 centre = (glm::vec2(texel) + 0.5f) / glm::vec2(field.width, field.height);
+        const glm::vec3& fetched = baked[static_cast<std::size_t>(texel.y) * field.width + texel.x];
+        const glm::vec2 gradient(fetched.y, fetched.z);
+        const glm::vec2 reference = referenceNormalGradient(field, uv, cells);
+        maxMagnitude = std::max(maxMagnitude, static_cast<double>(glm::length(reference)));
+        if (fetched.x != field.nearest(uv)) {
+            heightMismatches++;
+        }
+
+        bool tapsAgree = true;
+        for (const auto& tap : kernelTaps) {
+            tapsAgree = tapsAgree && texelOf(uv + tap.direction / cells) == texelOf(centre + tap.direction / cells);
+        }
+        if (tapsAgree) {
+            maxError = std::max(maxError, static_cast<double>(std::abs(gradient.x - reference.x)));
+            maxError = std::max(maxError, static_cast<double>(std::abs(gradient.y - reference.y)));
+            continue;
+        }
+        const float cosine = glm::dot(normalFromGradient(gradient, heightMapScale),
+                                      normalFromGradient(reference, heightMapScale));
+        const double degrees = glm::degrees(std::acos(static_cast<double>(glm::clamp(cosine, -1.0f, 1.0f))));
+        maxShiftDegrees = std::max(maxShiftDegrees, degrees);
+        totalShiftDegrees += degrees;
+        shifted++;
+    }
+
+    // Gradients are sums of exact integer heights, so they should match closely
+    const double relativeError = maxMagnitude > 0.0 ? maxError / maxMagnitude : maxError;
+    std::cout << field.width << " x " << field.height << " texels, " << mesh.uvs.size() << " vertices" << std::endl
+              << "  heights differing from the original shader: " << heightMismatches << std::endl
+              << "  where every tap agrees, max abs error " << maxError << ", relative " << relativeError << std::endl
+              << "  vertices with a tap one texel away: " << shifted << " ("
+              << 100.0 * static_cast<double>(shifted) / static_cast<double>(mesh.uvs.size())
+              << "%), normal shift max " << maxShiftDegrees << " degrees, mean "
+              << (shifted > 0 ? totalShiftDegrees / static_cast<double>(shifted) : 0.0) << " degrees" << std::endl;
+    return heightMismatches == 0 && relativeError < 1e-5 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,46 @@
+#ifndef TERRAIN_BAKE_HPP
+#define TERRAIN_BAKE_HPP
+
+#include <vector>
+
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
+
+#include "bmp.hpp"
+
+// Decoded height map, one unscaled float per texel, rows bottom-up like the texture
+struct HeightField {
+    int width = 0;
+    int height = 0;
+    std::vector<float> heights;
+
+    float at(int x, int y) const;
+
+    // Nearest texel, clamped to edge: what a GL_NEAREST / GL_CLAMP_TO_EDGE texture returns at uv
+    float nearest(const glm::vec2& uv) const;
+};
+
+// Decodes the packed 24 bit heights, (r << 16) + (g << 8) + b, of a BGR8 image.
+// Returns false for any other pixel format.
+bool decodeHeightField(const ImageView& image, HeightField& field);
+
+// Decodes row y (from the bottom) of a BGR8 height map into width floats
+void decodeHeightRow(const ImageView& image, int y, float* destination);
+
+// CPU reference of main.vert's original normal kernel, evaluated with nearest sampling at uv.
+// Neighbours are sampled at uv + direction / nPoints; returns the unscaled (nx, nz) gradient.
+glm::vec2 referenceNormalGradient(const HeightField& field, const glm::vec2& uv, float nPoints);
+
+// Normal main.vert derives from a gradient: normalize(abs(vec3(scale * nx, weight, scale * nz)))
+glm::vec3 normalFromGradient(const glm::vec2& gradient, float heightMapScale);
+
+// Bakes (height, nx, nz) per texel into width x height elements: the height and the reference kernel
+// evaluated at the texel centre. Sampling the result at a vertex uv takes one fetch instead of thirteen.
+void bakeTerrain(const HeightField& field, float nPoints, glm::vec3* baked);
+
+// Compares what the vertices of an nPoints grid fetch from bakeTerrain against referenceNormalGradient at their uvs,
+// as the original shader sampled. Reports how far taps shifted by baking at texel centres move the normals.
+// Headless; returns a process exit code.
+int runBakeCheck(const char* path, unsigned int nPoints, float heightMapScale);
+
+#endif
@@ -0,0 +1,260 @@
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <sstream>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
+#include <glm/gtc/type_precision.hpp>
+
+#include "index_layout.hpp"
+#include "terrain_cache.hpp"
+#include "texture_cache.hpp"
+#include "vertex_format.hpp"
+
+// Bumped whenever the mesh builder, the baker or the file layout change, which invalidates every cache
+static constexpr std::uint32_t terrainCacheVersion = 2;
+static constexpr char terrainCacheMagic[4] = {'H', 'M', 'C', 'T'};
+// Sections start on page boundaries
+static constexpr std::uint64_t sectionAlignment = 4096;
+
+// Followed by the sections at their offsets. Native byte order: the cache is local to the machine.
+struct TerrainCacheHeader {
+    char magic[4];
+    std::uint32_t version;
+    std::uint64_t key;
+    TerrainCacheMetadata metadata;
+    std::uint64_t offsets[terrainSectionCount];
+    std::uint64_t sizes[terrainSectionCount];
+};
+
+ByteRange& TerrainSections::operator[](const TerrainSection section) {
+    return ranges[static_cast<std::size_t>(section)];
+}
+
+const ByteRange& TerrainSections::operator[](const TerrainSection section) const {
+    return ranges[static_cast<std::size_t>(section)];
+}
+
+std::uint64_t terrainCacheKey(const std::string& heightMapPath, const TerrainCacheSettings& settings) {
+    std::uint64_t hash = fnv1a(reinterpret_cast<const unsigned char*>(&terrainCacheVersion),
+                               sizeof(terrainCacheVersion));
+    hash = fnv1a(reinterpret_cast<const unsigned char*>(&settings), sizeof(settings), hash);
+    if (!heightMapPath.empty()) {
+        // An unreadable file hashes as empty; building will report it
+        const MappedFile heightMap(heightMapPath.c_str());
+        hash = fnv1a(heightMap.data(), heightMap.size(), hash);
+    }
+    return hash;
+}
+
+// Whether every section settings need is there and each one is as large as the metadata says, so nothing that reads
+// them, on the CPU or the GPU, goes past their end. header's offsets & sizes must already lie inside data.
+static bool sectionsMatchMetadata(const TerrainCacheHeader& header, const TerrainCacheSettings& settings,
+                                  const unsigned char* data) {
+    const TerrainCacheMetadata& metadata = header.metadata;
+    if (metadata.nPoints != settings.nPoints) {
+        return false;
+    }
+    const auto size = [&header](const TerrainSection section) {
+        return header.sizes[static_cast<std::size_t>(section)];
+    };
+    const auto hasSize = [&size](const TerrainSection section, const std::uint64_t expected) {
+        return size(section) == expected;
+    };
+
+    // Decoded & baked heights come together, or not at all
+    const std::uint64_t texels = static_cast<std::uint64_t>(metadata.heightMapWidth) * metadata.heightMapHeight;
+    const bool heights = hasSize(TerrainSection::Heights, texels * sizeof(float)) &&
+                         hasSize(TerrainSection::BakedHeights, texels * sizeof(glm::vec3)) && texels != 0;
+    if (!heights && (size(TerrainSection::Heights) != 0 || size(TerrainSection::BakedHeights) != 0)) {
+        return false;
+    }
+
+    // Pulled vertices need no streams at all
+    const TerrainSection streams[] = {TerrainSection::Positions, TerrainSection::UVs, TerrainSection::Tangents,
+                                      TerrainSection::Bitangents, TerrainSection::QTangents,
+                                      TerrainSection::CompactVertices, TerrainSection::Indices,
+                                      TerrainSection::IndexChunks};
+    if (settings.pulledVertices) {
+        for (const TerrainSection section : streams) {
+            if (size(section) != 0) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // The vertex streams of the chosen layout, one element per grid point, and none of the others
+    const std::uint64_t vertices = static_cast<std::uint64_t>(metadata.nPoints) * metadata.nPoints;
+    std::uint64_t vertexSizes[terrainSectionCount] = {};
+    if (settings.compactVertices) {
+        vertexSizes[static_cast<std::size_t>(TerrainSection::CompactVertices)] = sizeof(CompactVertex);
+    } else {
+        vertexSizes[static_cast<std::size_t>(TerrainSection::Positions)] = sizeof(glm::vec3);
+        vertexSizes[static_cast<std::size_t>(TerrainSection::UVs)] = sizeof(glm::vec2);
+        if (settings.packedTangents) {
+            vertexSizes[static_cast<std::size_t>(TerrainSection::QTangents)] = sizeof(glm::i16vec4);
+        } else {
+            vertexSizes[static_cast<std::size_t>(TerrainSection::Tangents)] = sizeof(glm::vec3);
+            vertexSizes[static_cast<std::size_t>(TerrainSection::Bitangents)] = sizeof(glm::vec3);
+        }
+    }
+    for (std::size_t i = 0; i < static_cast<std::size_t>(TerrainSection::Indices); i++) {
+        if (header.sizes[i] != vertexSizes[i] * vertices) {
+            return false;
+        }
+    }
+
+    // Every chunk draws a range inside the indices, from a base vertex inside the streams
+    const std::uint64_t indexSize = metadata.shortIndices ? sizeof(std::uint16_t) : sizeof(std::uint32_t);
+    const std::uint64_t indexBytes = size(TerrainSection::Indices);
+    const std::uint64_t chunkBytes = size(TerrainSection::IndexChunks);
+    if (indexBytes == 0 || indexBytes % indexSize != 0 || chunkBytes == 0 || chunkBytes % sizeof(IndexChunk) != 0) {
+        return false;
+    }
+    const std::uint64_t indexCount = indexBytes / indexSize;
+    const unsigned char* chunkData = data + header.offsets[static_cast<std::size_t>(TerrainSection::IndexChunks)];
+    const unsigned char* indexData = data + header.offsets[static_cast<std::size_t>(TerrainSection::Indices)];
+    const std::uint64_t restart = metadata.shortIndices ? shortRestartIndex : restartIndex;
+    for (std::uint64_t i = 0; i < chunkBytes / sizeof(IndexChunk); i++) {
+        IndexChunk chunk;
+        std::memcpy(&chunk, chunkData + i * sizeof(IndexChunk), sizeof(chunk));
+        if (static_cast<std::uint64_t>(chunk.firstIndex) + chunk.indexCount > indexCount ||
+            chunk.baseVertex >= vertices) {
+            return false;
+        }
+        // And every index it draws stays inside the vertex streams
+        for (std::uint64_t j = chunk.firstIndex; j < static_cast<std::uint64_t>(chunk.firstIndex) + chunk.indexCount;
+             j++) {
+            std::uint64_t index;
+            if (metadata.shortIndices) {
+                std::uint16_t value;
+                std::memcpy(&value, indexData + j * indexSize, sizeof(value));
+                index = value;
+            } else {
+                std::uint32_t value;
+                std::memcpy(&value, indexData + j * indexSize, sizeof(value));
+                index = value;
+            }
+            if (index != restart && chunk.baseVertex + index >= vertices) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+bool TerrainCache::open(const std::string& path, const std::uint64_t key, const TerrainCacheSettings& settings) {
+    close();
+    file = MappedFile(path.c_str());
+    if (!file.isOpen()) {
+        return false;
+    }
+
+    TerrainCacheHeader header{};
+    bool valid = file.size() >= sizeof(header);
+    if (valid) {
+        std::memcpy(&header, file.data(), sizeof(header));
+        valid = std::memcmp(header.magic, terrainCacheMagic, sizeof(terrainCacheMagic)) == 0 &&
+                header.version == terrainCacheVersion;
+    }
+    for (std::size_t i = 0; i < terrainSectionCount && valid; i++) {
+        valid = header.offsets[i] % sectionAlignment == 0 && header.offsets[i] <= file.size() &&
+                header.sizes[i] <= file.size() - header.offsets[i];
+    }
+    if (!valid) {
+        std::cerr << "Ignoring invalid terrain cache " << path << std::endl;
+        close();
+        return false;
+    }
+    if (header.key != key) {
+        // Written for another height map or settings
+        close();
+        return false;
+    }
+    if (!sectionsMatchMetadata(header, settings, file.data())) {
+        std::cerr << "Ignoring terrain cache " << path << ", its sections do not match its metadata" << std::endl;
+        close();
+        return false;
+    }
+
+    mappedMetadata = header.metadata;
+    for (std::size_t i = 0; i < terrainSectionCount; i++) {
+        mappedSections.ranges[i] = {header.sizes[i] == 0 ? nullptr : file.data() + header.offsets[i],
+                                    static_cast<std::size_t>(header.sizes[i])};
+    }
+    return true;
+}
+
+bool TerrainCache::isOpen() const {
+    return file.isOpen();
+}
+
+const TerrainCacheMetadata& TerrainCache::metadata() const {
+    return mappedMetadata;
+}
+
+const TerrainSections& TerrainCache::sections() const {
+    return mappedSections;
+}
+
+void TerrainCache::close() {
+    file = MappedFile();
+    mappedMetadata = TerrainCacheMetadata();
+    mappedSections = TerrainSections();
+}
+
+bool TerrainCache::write(const std::string& path, const std::uint64_t key, const TerrainCacheMetadata& metadata,
+                         const TerrainSections& sections) {
+    std::error_code error;
+    std::filesystem::create_directories(std::filesystem::path(path).parent_path(), error);
+
+    TerrainCacheHeader header{};
+    std::memcpy(header.magic, terrainCacheMagic, sizeof(terrainCacheMagic));
+    header.version = terrainCacheVersion;
+    header.key = key;
+    header.metadata = metadata;
+    std::uint64_t offset = sizeof(header);
+    for (std::size_t i = 0; i < terrainSectionCount; i++) {
+        offset = (offset + sectionAlignment - 1) / sectionAlignment * sectionAlignment;
+        header.offsets[i] = offset;
+        header.sizes[i] = sections.ranges[i].size;
+        offset += sections.ranges[i].size;
+    }
+
+    // Unique per thread, like the texture cache's entries
+    std::ostringstream temporaryName;
+    temporaryName << path << "." << std::hash<std::thread::id>()(std::this_thread::get_id()) << ".tmp";
+    const std::string temporaryPath = temporaryName.str();
+    {
+        std::ofstream file(temporaryPath, std::ios::binary);
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        const std::vector<char> padding(sectionAlignment, 0);
+        std::uint64_t written = sizeof(header);
+        for (std::size_t i = 0; i < terrainSectionCount; i++) {
+            file.write(padding.data(), static_cast<std::streamsize>(header.offsets[i] - written));
+            file.write(static_cast<const char*>(sections.ranges[i].data),
+                       static_cast<std::streamsize>(sections.ranges[i].size));
+            written = header.offsets[i] + header.sizes[i];
+        }
+        if (!file.good()) {
+            std::cerr << "Terrain cache " << path << " could not be written" << std::endl;
+            file.close();
+            std::filesystem::remove(temporaryPath, error);
+            return false;
+        }
+    }
+    std::filesystem::rename(temporaryPath, path, error);
+    if (error) {
+        std::cerr << "Terrain cache " << path << " could not be written: " << error.message() << std::endl;
+        std::filesystem::remove(temporaryPath, error);
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,89 @@
+#ifndef TERRAIN_CACHE_HPP
+#define TERRAIN_CACHE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "mapped_file.hpp"
+
+// Sections of a terrain cache, each one optional
+enum class TerrainSection {
+    Positions, // glm::vec3 per vertex, float layout
+    UVs, // glm::vec2 per vertex, float layout
+    Tangents, // glm::vec3 per vertex, float layout
+    Bitangents, // glm::vec3 per vertex, float layout
+    QTangents, // glm::i16vec4 per vertex, packed tangents
+    CompactVertices, // CompactVertex per vertex, compact layout
+    Indices, // std::uint16_t or std::uint32_t indices as metadata.shortIndices says, relative to their chunk
+    IndexChunks, // IndexChunk per draw of the indices
+    Heights, // float per height map texel, rows bottom-up like HeightField
+    BakedHeights, // glm::vec3 per height map texel, as bakeTerrain writes them
+    Count
+};
+
+static constexpr std::size_t terrainSectionCount = static_cast<std::size_t>(TerrainSection::Count);
+
+struct ByteRange {
+    const void* data = nullptr;
+    std::size_t size = 0;
+};
+
+// Bytes of every section, empty where absent
+struct TerrainSections {
+    ByteRange ranges[terrainSectionCount];
+
+    ByteRange& operator[](TerrainSection section);
+    const ByteRange& operator[](TerrainSection section) const;
+};
+
+// What the sections are built from, besides the height map's contents
+struct TerrainCacheSettings {
+    std::uint32_t nPoints;
+    float scale;
+    std::uint32_t packedTangents;
+    std::uint32_t compactVertices;
+    std::uint32_t pulledVertices;
+    std::uint32_t indexLayout;
+};
+
+// Values needed to use the sections
+struct TerrainCacheMetadata {
+    std::uint32_t nPoints = 0;
+    std::uint32_t heightMapWidth = 0;
+    std::uint32_t heightMapHeight = 0;
+    float compactScale = 0.0f;
+    float compactUVRange = 0.0f;
+    std::uint32_t shortIndices = 0;
+};
+
+// Hash of the cache version, the settings and the contents of the height map file, if any.
+// A cache written under another key is stale.
+std::uint64_t terrainCacheKey(const std::string& heightMapPath, const TerrainCacheSettings& settings);
+
+// Precompiled terrain (.hmc): mesh streams, decoded & baked heights and their metadata in one file. Sections start
+// on page boundaries and are used in place from a memory mapping, so they upload without any parsing.
+class TerrainCache {
+public:
+    // Maps path if it holds a complete cache written for key, with every section settings need and of the size its
+    // metadata implies; returns false on a miss
+    bool open(const std::string& path, std::uint64_t key, const TerrainCacheSettings& settings);
+    bool isOpen() const;
+
+    const TerrainCacheMetadata& metadata() const;
+    // Point into the mapping, valid until close()
+    const TerrainSections& sections() const;
+
+    void close();
+
+    // Writes a cache through a temporary file, so readers never see a partial one. Returns false on failure.
+    static bool write(const std::string& path, std::uint64_t key, const TerrainCacheMetadata& metadata,
+                      const TerrainSections& sections);
+
+private:
+    MappedFile file;
+    TerrainCacheMetadata mappedMetadata;
+    TerrainSections mappedSections;
+};
+
+#endif
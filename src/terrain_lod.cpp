@@ -0,0 +1,251 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <limits>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "height_pyramid.hpp"
+#include "terrain_bake.hpp"
+#include "terrain_lod.hpp"
+
+// Lower bound of a level's range, in node sizes: keeps neighbouring nodes within one level of each other
+// and leaves room to finish morphing before the parent level takes over
+static constexpr float minRangeToNodeSize = 3.0f;
+
+LodPatch buildLodPatch(const unsigned int patchSize) {
+    LodPatch patch;
+    patch.patchSize = patchSize;
+
+    const unsigned int side = patchSize + 1;
+    patch.vertices.reserve(static_cast<std::size_t>(side) * side);
+    for (unsigned int z = 0; z < side; z++) {
+        for (unsigned int x = 0; x < side; x++) {
+            patch.vertices.emplace_back(x, z);
+        }
+    }
+
+    // Two triangles per cell, counter-clockwise seen from +Y like the strip, grouped by quadrant so any
+    // quadrant is one contiguous range
+    const unsigned int half = patchSize / 2;
+    patch.quadrantIndexCount = static_cast<std::size_t>(half) * half * 6;
+    patch.indices.reserve(4 * patch.quadrantIndexCount);
+    for (unsigned int quadrant = 0; quadrant < 4; quadrant++) {
+        const unsigned int beginX = (quadrant & 1) * half;
+        const unsigned int beginZ = (quadrant >> 1) * half;
+        for (unsigned int z = beginZ; z < beginZ + half; z++) {
+            for (unsigned int x = beginX; x < beginX + half; x++) {
+                const auto a = static_cast<unsigned short>(z * side + x);
+                const auto b = static_cast<unsigned short>(a + 1);
+                const auto c = static_cast<unsigned short>(a + side);
+                const auto d = static_cast<unsigned short>(c + 1);
+                patch.indices.insert(patch.indices.end(), {b, a, d, a, c, d});
+            }
+        }
+    }
+    return patch;
+}
+
+glm::vec2 terrainUVTransform(const float extent, const unsigned int nPoints) {
+    return glm::vec2(1.0f / (2.0f * extent), 0.5f + 0.5f / static_cast<float>(nPoints - 1));
+}
+
+unsigned int lodLevelCount(const unsigned int nPoints, const unsigned int patchSize) {
+    const float finestNodes = static_cast<float>(nPoints - 1) / static_cast<float>(patchSize);
+    return 1 + static_cast<unsigned int>(std::max(0.0f, std::ceil(std::log2(finestNodes))));
+}
+
+TerrainLod::TerrainLod(const float extent, const LodSettings& settings) : extent(extent), settings(settings) {
+    // 45 degrees over 720 pixels until told otherwise
+    setProjection(glm::radians(45.0f), 720.0f);
+}
+
+void TerrainLod::setProjection(const float fovY, const float viewportHeight) {
+    // Pixels covered by one world unit at distance 1
+    const float pixelsPerUnit = viewportHeight / (2.0f * std::tan(fovY / 2.0f));
+
+    // Dropping from level l to l + 1 doubles the vertex spacing, an error of about one level l + 1 spacing.
+    // Level l therefore holds while that spacing projects to at most pixelError pixels.
+    ranges.resize(settings.levels);
+    for (unsigned int level = 0; level < settings.levels; level++) {
+        const float nodeSize = 2.0f * extent / static_cast<float>(1u << (settings.levels - 1 - level));
+        const float coarserSpacing = 2.0f * nodeSize / static_cast<float>(settings.patchSize);
+        ranges[level] = std::max(coarserSpacing * pixelsPerUnit / settings.pixelError,
+                                 minRangeToNodeSize * nodeSize);
+    }
+    // The root covers everything that is left
+    ranges.back() = std::numeric_limits<float>::max();
+}
+
+void TerrainLod::select(const glm::vec3& camera, const Frustum& frustum, const HeightRange& heightRange,
+                        std::vector<LodNode>& selected, RenderStats& stats) const {
+    selected.clear();
+    const Selection selection{camera, frustum, heightRange, selected, stats};
+    selectNode(selection, glm::vec2(-extent), 2.0f * extent, settings.levels - 1, false);
+}
+
+void TerrainLod::selectInRange(const glm::vec3& camera, const HeightRange& heightRange,
+                               std::vector<LodNode>& selected) const {
+    selected.clear();
+    // Every node counts as inside, so neither the frustum nor the tile counts are touched
+    const Frustum frustum{};
+    RenderStats stats;
+    const Selection selection{camera, frustum, heightRange, selected, stats};
+    selectNode(selection, glm::vec2(-extent), 2.0f * extent, settings.levels - 1, true);
+}
+
+const LodSettings& TerrainLod::getSettings() const {
+    return settings;
+}
+
+const std::vector<float>& TerrainLod::getRanges() const {
+    return ranges;
+}
+
+bool TerrainLod::selectNode(const Selection& selection, const glm::vec2& origin, const float size,
+                            const unsigned int level, bool insideFrustum) const {
+    const glm::vec2 heights = selection.heightRange(origin, origin + size);
+    const glm::vec3 boxMin(origin.x, heights.x, origin.y);
+    const glm::vec3 boxMax(origin.x + size, heights.y, origin.y + size);
+
+    // Invisible nodes are handled: neither they nor their parent draw anything there
+    if (!insideFrustum) {
+        selection.stats.tilesTested++;
+        const FrustumTest visibility = selection.frustum.test(boxMin, boxMax);
+        if (visibility == FrustumTest::Outside) {
+            selection.stats.tilesCulled++;
+            return true;
+        }
+        insideFrustum = visibility == FrustumTest::Inside;
+    }
+
+    // Closest point of the node's bounding box to the camera
+    const glm::vec3& camera = selection.camera;
+    const glm::vec3 offset = camera - glm::clamp(camera, boxMin, boxMax);
+    const float distanceSquared = glm::dot(offset, offset);
+    const auto withinRange = [distanceSquared](const float range) {
+        return distanceSquared <= range * range;
+    };
+
+    // Too far for this level: the parent draws this area
+    if (!withinRange(ranges[level])) {
+        return false;
+    }
+
+    LodNode node{origin, size, level, lodQuadrantsAll, morphRangeOf(level)};
+    if (level == 0 || !withinRange(ranges[level - 1])) {
+        selection.selected.push_back(node);
+        selection.stats.tilesDrawn++;
+        return true;
+    }
+
+    // Children that are too far for the finer level are drawn as quadrants of this node
+    const float half = size / 2.0f;
+    node.quadrants = 0;
+    for (unsigned int quadrant = 0; quadrant < 4; quadrant++) {
+        const glm::vec2 childOrigin = origin + half * glm::vec2(quadrant & 1, quadrant >> 1);
+        if (!selectNode(selection, childOrigin, half, level - 1, insideFrustum)) {
+            node.quadrants |= 1u << quadrant;
+        }
+    }
+    if (node.quadrants != 0) {
+        selection.selected.push_back(node);
+        selection.stats.tilesDrawn++;
+    }
+    return true;
+}
+
+glm::vec2 TerrainLod::morphRangeOf(const unsigned int level) const {
+    // The root never morphs
+    if (level + 1 == settings.levels) {
+        const float far = std::numeric_limits<float>::max();
+        return glm::vec2(0.5f * far, far);
+    }
+
+    const float previous = level == 0 ? 0.0f : ranges[level - 1];
+    return glm::vec2(previous + settings.morphStartRatio * (ranges[level] - previous), ranges[level]);
+}
+
+// Camera pose of the cull check and what culling should do there
+struct CullPose {
+    const char* name;
+    glm::vec3 position;
+    glm::vec3 target;
+    glm::vec3 up;
+    bool expectDrawn; // Some tiles are drawn
+    bool expectCulled; // Some tiles are culled
+};
+
+int runCullCheck(const char* path, const unsigned int nPoints, const float extent, const float heightMapScale) {
+    BMPImage image;
+    HeightField field;
+    if (!openBMP(path, image) || !decodeHeightField(image.view, field)) {
+        std::cout << "Height maps must be 24 bpp BMPs" << std::endl;
+        return EXIT_FAILURE;
+    }
+    HeightPyramid pyramid;
+    pyramid.build(field);
+
+    LodSettings settings;
+    settings.levels = lodLevelCount(nPoints, settings.patchSize);
+    TerrainLod lod(extent, settings);
+    const glm::vec2 uvTransform = terrainUVTransform(extent, nPoints);
+    const TerrainLod::HeightRange heightRange = [&](const glm::vec2& xzMin, const glm::vec2& xzMax) {
+        return pyramid.range(xzMin * uvTransform.x + uvTransform.y, xzMax * uvTransform.x + uvTransform.y)
+               * heightMapScale;
+    };
+
+    // Same projection as computeMatrices
+    const glm::mat4 projection = glm::perspective(glm::radians(45.0f), 4.0f / 3.0f, 0.1f, 500.0f);
+    const glm::vec3 up(0.0f, 1.0f, 0.0f);
+    const CullPose poses[] = {
+        {"start", {0.0f, 3.0f, -14.0f}, {0.0f, 3.0f, -13.0f}, up, true, false},
+        {"away", {0.0f, 3.0f, -14.0f}, {0.0f, 3.0f, -15.0f}, up, false, true},
+        {"overhead", {0.0f, 60.0f, 0.0f}, {0.0f, 0.0f, 0.0f}, {0.0f, 0.0f, 1.0f}, true, false},
+        {"edge", {0.0f, 12.0f, 0.0f}, {1.0f, 11.0f, 0.0f}, up, true, true},
+        {"corner", {4.0f, 12.0f, 4.0f}, {5.0f, 8.0f, 5.0f}, up, true, true}
+    };
+
+    bool passed = true;
+    std::vector<LodNode> nodes;
+    for (const auto& pose : poses) {
+        const glm::mat4 viewProjection = projection * glm::lookAt(pose.position, pose.target, pose.up);
+        const Frustum frustum = Frustum::fromMatrix(viewProjection);
+        RenderStats stats;
+        lod.select(pose.position, frustum, heightRange, nodes, stats);
+
+        // Every grid point inside the frustum must lie in a drawn quadrant
+        std::size_t missed = 0;
+        for (unsigned int j = 0; j < nPoints; j++) {
+            for (unsigned int i = 0; i < nPoints; i++) {
+                const glm::vec2 xz = extent * (2.0f * glm::vec2(i, j) / static_cast<float>(nPoints - 1) - 1.0f);
+                const glm::vec3 point(xz.x, field.nearest(xz * uvTransform.x + uvTransform.y) * heightMapScale, xz.y);
+                if (!frustum.contains(point)) {
+                    continue;
+                }
+                const bool covered = std::any_of(nodes.begin(), nodes.end(), [&xz](const LodNode& node) {
+                    const float half = node.size / 2.0f;
+                    for (unsigned int quadrant = 0; quadrant < 4; quadrant++) {
+                        const glm::vec2 low = node.origin + half * glm::vec2(quadrant & 1, quadrant >> 1);
+                        if ((node.quadrants & (1u << quadrant)) != 0 && glm::all(glm::greaterThanEqual(xz, low))
+                            && glm::all(glm::lessThanEqual(xz, low + half))) {
+                            return true;
+                        }
+                    }
+                    return false;
+                });
+                missed += covered ? 0 : 1;
+            }
+        }
+
+        const bool posePassed = missed == 0 && (stats.tilesDrawn > 0) == pose.expectDrawn &&
+                                (stats.tilesCulled > 0) == pose.expectCulled;
+        passed = passed && posePassed;
+        std::cout << pose.name << ": " << stats.tilesTested << " tested, " << stats.tilesCulled << " culled, "
+                  << stats.tilesDrawn << " drawn, " << missed << " visible points missed"
+                  << (posePassed ? "" : " - FAILED") << std::endl;
+    }
+    return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
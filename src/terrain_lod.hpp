@@ -0,0 +1,110 @@
+#ifndef TERRAIN_LOD_HPP
+#define TERRAIN_LOD_HPP
+
+#include <cstddef>
+#include <functional>
+#include <vector>
+
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
+#include <glm/gtc/type_precision.hpp>
+
+#include "frustum.hpp"
+#include "render_stats.hpp"
+
+// Quadtree level-of-detail settings
+struct LodSettings {
+    // Cells per side of the patch every node is drawn with, must be even
+    unsigned int patchSize = 32;
+    // Quadtree depth, level 0 being the finest
+    unsigned int levels = 6;
+    // Largest screen-space error tolerated, in pixels
+    float pixelError = 2.0f;
+    // Fraction of each level's range after which vertices start morphing into the next level
+    float morphStartRatio = 0.66f;
+};
+
+// Quadrants of a node, in the order of the patch index ranges
+enum LodQuadrant : unsigned int {
+    lodQuadrantLowXLowZ = 1u << 0,
+    lodQuadrantHighXLowZ = 1u << 1,
+    lodQuadrantLowXHighZ = 1u << 2,
+    lodQuadrantHighXHighZ = 1u << 3,
+    lodQuadrantsAll = 0xF
+};
+
+// A selected quadtree node, drawn as one patch (or some of its quadrants)
+struct LodNode {
+    glm::vec2 origin; // Lowest (x, z) corner
+    float size; // Side length in world units
+    unsigned int level;
+    unsigned int quadrants; // LodQuadrant bits to draw
+    glm::vec2 morphRange; // Distances where morphing starts and ends
+};
+
+// Shared patch geometry: (patchSize + 1)^2 grid vertices and a triangle list split in four
+// contiguous quadrant ranges of quadrantIndexCount indices each
+struct LodPatch {
+    unsigned int patchSize = 0;
+    std::vector<glm::u16vec2> vertices;
+    std::vector<unsigned short> indices;
+    std::size_t quadrantIndexCount = 0;
+};
+
+LodPatch buildLodPatch(unsigned int patchSize);
+
+// (scale, offset) mapping terrain (x, z) to uv = xz * scale + offset, continuing the strip's uvs:
+// x = -extent lands on the centre of the first of nPoints - 1 cells
+glm::vec2 terrainUVTransform(float extent, unsigned int nPoints);
+
+// Quadtree depth whose finest level is at least as dense as an nPoints x nPoints grid
+unsigned int lodLevelCount(unsigned int nPoints, unsigned int patchSize);
+
+// CDLOD quadtree over the square terrain [-extent, extent]^2
+class TerrainLod {
+public:
+    TerrainLod(float extent, const LodSettings& settings);
+
+    // Recomputes the per-level distance ranges: level l is used until its vertex spacing projects
+    // to more than pixelError pixels
+    void setProjection(float fovY, float viewportHeight);
+
+    // World space (min, max) height over the (x, z) rectangle [xzMin, xzMax]
+    using HeightRange = std::function<glm::vec2(const glm::vec2& xzMin, const glm::vec2& xzMax)>;
+
+    // Selects the nodes to draw from camera, skipping subtrees whose bounds are outside the frustum.
+    // Counts tiles tested, culled & drawn into stats.
+    void select(const glm::vec3& camera, const Frustum& frustum, const HeightRange& heightRange,
+                std::vector<LodNode>& selected, RenderStats& stats) const;
+
+    // Selects the nodes to draw from camera without testing them against any frustum, for culling on the GPU
+    void selectInRange(const glm::vec3& camera, const HeightRange& heightRange, std::vector<LodNode>& selected) const;
+
+    const LodSettings& getSettings() const;
+    const std::vector<float>& getRanges() const;
+
+private:
+    struct Selection {
+        const glm::vec3& camera;
+        const Frustum& frustum;
+        const HeightRange& heightRange;
+        std::vector<LodNode>& selected;
+        RenderStats& stats;
+    };
+
+    // Returns false if the node is too far for its level, leaving its area to the parent.
+    // insideFrustum skips the frustum test for descendants of nodes entirely inside it.
+    bool selectNode(const Selection& selection, const glm::vec2& origin, float size, unsigned int level,
+                    bool insideFrustum) const;
+    glm::vec2 morphRangeOf(unsigned int level) const;
+
+    float extent;
+    LodSettings settings;
+    std::vector<float> ranges;
+};
+
+// Selects tiles of a height map BMP from fixed camera poses and checks that culling keeps every visible
+// grid point and matches the expected outcome of each pose. Headless; returns a process exit code.
+int runCullCheck(const char* path, unsigned int nPoints, float extent, float heightMapScale);
+
+#endif
@@ -0,0 +1,278 @@
+#include <algorithm>
+#include <cstddef>
+#include <iostream>
+
+#include "terrain_lod_indirect.hpp"
+
+// Invocations per work group of lod_cull.comp
+static constexpr GLuint cullGroupSize = 64;
+// Length of pyramidLevels in lod_cull.comp
+static constexpr std::size_t maxPyramidLevels = 24;
+// Runs of consecutive visible quadrants in a node, as 0101 or 1001 have
+static constexpr std::size_t maxCommandsPerNode = 2;
+
+// std430 images of Node, DrawNode & DrawElementsIndirectCommand in lod_cull.comp
+struct CullNode {
+    glm::vec4 node;
+    glm::vec2 morphRange;
+    GLuint quadrants;
+    GLuint padding;
+};
+
+struct DrawNode {
+    glm::vec4 node;
+    glm::vec4 morphRange;
+};
+
+struct DrawElementsIndirectCommand {
+    GLuint count;
+    GLuint instanceCount;
+    GLuint firstIndex;
+    GLint baseVertex;
+    GLuint baseInstance;
+};
+
+static const void* offset(const std::size_t bytes) {
+    return reinterpret_cast<const void*>(bytes);
+}
+
+TerrainLodIndirect::TerrainLodIndirect(const float maxHeight) : maxHeight(maxHeight) {
+}
+
+bool TerrainLodIndirect::isSupported() {
+    return GLEW_VERSION_4_3 || (GLEW_ARB_compute_shader && GLEW_ARB_shader_storage_buffer_object &&
+                                GLEW_ARB_multi_draw_indirect && GLEW_ARB_clear_buffer_object);
+}
+
+void TerrainLodIndirect::load(const LodPatch& patch, const GLuint vertexBuffer, const GLuint elementBuffer) {
+    patchSize = patch.patchSize;
+    quadrantIndexCount = patch.quadrantIndexCount;
+    patchVertices = static_cast<GLuint>(patch.vertices.size());
+    quadrantVertices = (patch.patchSize / 2 + 1) * (patch.patchSize / 2 + 1);
+
+    glGenBuffers(1, &nodeBuffer);
+    glGenBuffers(1, &pyramidBuffer);
+    glGenBuffers(1, &commandBuffer);
+    glGenBuffers(1, &drawNodeBuffer);
+    glGenBuffers(1, &counterBuffer);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, counterBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(Counters), nullptr, GL_DYNAMIC_COPY);
+    glGenBuffers(1, &readbackBuffer);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, readbackBuffer);
+    glBufferData(GL_COPY_WRITE_BUFFER, readbackSlots * sizeof(Counters), nullptr, GL_STREAM_READ);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    reserve(256);
+
+    // Patch grid points as in the per-node path, plus each draw's node, advanced once per instance
+    glGenVertexArrays(1, &vertexArrayID);
+    glBindVertexArray(vertexArrayID);
+    glEnableVertexAttribArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+    glVertexAttribPointer(0, 2, GL_UNSIGNED_SHORT, GL_FALSE, 0, nullptr);
+    glBindBuffer(GL_ARRAY_BUFFER, drawNodeBuffer);
+    glEnableVertexAttribArray(5);
+    glVertexAttribPointer(5, 4, GL_FLOAT, GL_FALSE, sizeof(DrawNode), offset(offsetof(DrawNode, node)));
+    glVertexAttribDivisor(5, 1);
+    glEnableVertexAttribArray(6);
+    glVertexAttribPointer(6, 2, GL_FLOAT, GL_FALSE, sizeof(DrawNode), offset(offsetof(DrawNode, morphRange)));
+    glVertexAttribDivisor(6, 1);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, elementBuffer);
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    culls = 0;
+    counters = {};
+}
+
+void TerrainLodIndirect::unload() {
+    for (auto& fence : readbackFences) {
+        if (fence != nullptr) {
+            glDeleteSync(fence);
+            fence = nullptr;
+        }
+    }
+    const GLuint buffers[] = {nodeBuffer, pyramidBuffer, commandBuffer, drawNodeBuffer, counterBuffer, readbackBuffer};
+    glDeleteBuffers(6, buffers);
+    glDeleteVertexArrays(1, &vertexArrayID);
+    vertexArrayID = nodeBuffer = pyramidBuffer = commandBuffer = drawNodeBuffer = counterBuffer = readbackBuffer = 0;
+    capacity = 0;
+    nodeCount = 0;
+    pyramidLevels.clear();
+}
+
+bool TerrainLodIndirect::isLoaded() const {
+    return vertexArrayID != 0;
+}
+
+void TerrainLodIndirect::setProgram(const GLuint program) {
+    uniforms.nodeCount = glGetUniformLocation(program, "nodeCount");
+    uniforms.frustumPlanes = glGetUniformLocation(program, "frustumPlanes");
+    uniforms.uvTransform = glGetUniformLocation(program, "uvTransform");
+    uniforms.heightMapScale = glGetUniformLocation(program, "heightMapScale");
+    uniforms.pyramidLevels = glGetUniformLocation(program, "pyramidLevels");
+    uniforms.pyramidLevelCount = glGetUniformLocation(program, "pyramidLevelCount");
+    uniforms.maxHeight = glGetUniformLocation(program, "maxHeight");
+    uniforms.quadrantIndexCount = glGetUniformLocation(program, "quadrantIndexCount");
+    uniforms.patchVertices = glGetUniformLocation(program, "patchVertices");
+}
+
+void TerrainLodIndirect::setHeights(const HeightPyramid& pyramid) {
+    if (pyramid.levelCount() > maxPyramidLevels) {
+        std::cerr << "Height pyramid has " << pyramid.levelCount() << " levels, GPU culling reads at most "
+                  << maxPyramidLevels << std::endl;
+        return;
+    }
+
+    // Levels one after another, row by row
+    std::vector<glm::vec2> cells;
+    pyramidLevels.clear();
+    for (std::size_t level = 0; level < pyramid.levelCount(); level++) {
+        const int width = pyramid.levelWidth(level);
+        const int height = pyramid.levelHeight(level);
+        pyramidLevels.insert(pyramidLevels.end(), {width, height, static_cast<GLint>(cells.size()), 0});
+        for (int y = 0; y < height; y++) {
+            for (int x = 0; x < width; x++) {
+                cells.push_back(pyramid.cell(level, x, y));
+            }
+        }
+    }
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, pyramidBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, static_cast<GLsizeiptr>(cells.size() * sizeof(glm::vec2)), cells.data(),
+                 GL_STATIC_DRAW);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+bool TerrainLodIndirect::hasHeights() const {
+    return !pyramidLevels.empty();
+}
+
+void TerrainLodIndirect::reserve(const std::size_t count) {
+    if (count <= capacity) {
+        return;
+    }
+    capacity = std::max(count, 2 * capacity);
+    const std::size_t commands = maxCommandsPerNode * capacity;
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, commandBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, static_cast<GLsizeiptr>(commands * sizeof(DrawElementsIndirectCommand)),
+                 nullptr, GL_DYNAMIC_COPY);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, drawNodeBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, static_cast<GLsizeiptr>(commands * sizeof(DrawNode)), nullptr,
+                 GL_DYNAMIC_COPY);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+void TerrainLodIndirect::readCounters() {
+    // The slot's copy is readbackSlots culls old; keep the last counts if even that one is not done
+    GLsync& fence = readbackFences[culls % readbackSlots];
+    if (fence == nullptr) {
+        return;
+    }
+    const GLenum status = glClientWaitSync(fence, 0, 0);
+    if (status == GL_ALREADY_SIGNALED || status == GL_CONDITION_SATISFIED) {
+        glBindBuffer(GL_COPY_READ_BUFFER, readbackBuffer);
+        glGetBufferSubData(GL_COPY_READ_BUFFER, static_cast<GLintptr>((culls % readbackSlots) * sizeof(Counters)),
+                           sizeof(Counters), &counters);
+        glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    }
+    glDeleteSync(fence);
+    fence = nullptr;
+}
+
+void TerrainLodIndirect::cull(const std::vector<LodNode>& nodes, const Frustum& frustum,
+                              const glm::vec2& uvTransform, const float heightScale) {
+    readCounters();
+    reserve(nodes.size());
+    nodeCount = nodes.size();
+
+    std::vector<CullNode> cullNodes;
+    cullNodes.reserve(nodes.size());
+    for (const LodNode& node : nodes) {
+        cullNodes.push_back({glm::vec4(node.origin, node.size, static_cast<float>(patchSize)), node.morphRange,
+                             node.quadrants, 0});
+    }
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, nodeBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, static_cast<GLsizeiptr>(cullNodes.size() * sizeof(CullNode)),
+                 cullNodes.data(), GL_STREAM_DRAW);
+
+    // Counters start from zero; so do the commands when the draw count cannot come from the GPU
+    const GLuint zero = 0;
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, counterBuffer);
+    glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+    if (!GLEW_ARB_indirect_parameters) {
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, commandBuffer);
+        glClearBufferSubData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, 0,
+                             static_cast<GLsizeiptr>(maxCommandsPerNode * nodeCount *
+                                                     sizeof(DrawElementsIndirectCommand)),
+                             GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+    }
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    glUniform1ui(uniforms.nodeCount, static_cast<GLuint>(nodeCount));
+    glUniform4fv(uniforms.frustumPlanes, 6, &frustum.planes[0][0]);
+    glUniform2fv(uniforms.uvTransform, 1, &uvTransform[0]);
+    glUniform1f(uniforms.heightMapScale, heightScale);
+    if (!pyramidLevels.empty()) {
+        glUniform4iv(uniforms.pyramidLevels, static_cast<GLsizei>(pyramidLevels.size() / 4), pyramidLevels.data());
+    }
+    glUniform1i(uniforms.pyramidLevelCount, static_cast<GLint>(pyramidLevels.size() / 4));
+    glUniform1f(uniforms.maxHeight, maxHeight);
+    glUniform1ui(uniforms.quadrantIndexCount, static_cast<GLuint>(quadrantIndexCount));
+    glUniform2ui(uniforms.patchVertices, patchVertices, quadrantVertices);
+
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, nodeBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, pyramidBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, commandBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, drawNodeBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, counterBuffer);
+    if (nodeCount > 0) {
+        glDispatchCompute(static_cast<GLuint>((nodeCount + cullGroupSize - 1) / cullGroupSize), 1, 1);
+    }
+
+    // The draw reads commands, count & nodes, and the copy the counters, all written by the dispatch
+    glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+    const std::size_t slot = culls % readbackSlots;
+    glBindBuffer(GL_COPY_READ_BUFFER, counterBuffer);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, readbackBuffer);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0,
+                        static_cast<GLintptr>(slot * sizeof(Counters)), sizeof(Counters));
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    readbackFences[slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    culls++;
+}
+
+void TerrainLodIndirect::draw(RenderStats& stats) {
+    const auto maxDrawCount = static_cast<GLsizei>(maxCommandsPerNode * nodeCount);
+    glBindVertexArray(vertexArrayID);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+    if (GLEW_ARB_indirect_parameters) {
+        // Only the commands the dispatch appended
+        glBindBuffer(GL_PARAMETER_BUFFER_ARB, counterBuffer);
+        glMultiDrawElementsIndirectCountARB(
+            GL_TRIANGLES, // mode
+            GL_UNSIGNED_SHORT, // type
+            nullptr, // indirect buffer offset
+            offsetof(Counters, commandCount), // parameter buffer offset of the draw count
+            maxDrawCount, // max draw count
+            0 // stride, tightly packed
+        );
+        glBindBuffer(GL_PARAMETER_BUFFER_ARB, 0);
+    } else {
+        // Every command there is room for, the ones past the appended ones cleared to empty draws
+        glMultiDrawElementsIndirect(
+            GL_TRIANGLES, // mode
+            GL_UNSIGNED_SHORT, // type
+            nullptr, // indirect buffer offset
+            maxDrawCount, // draw count
+            0 // stride, tightly packed
+        );
+    }
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+
+    stats.drawCalls++;
+    stats.tilesTested += nodeCount;
+    stats.tilesCulled += counters.tilesCulled;
+    stats.tilesDrawn += counters.tilesDrawn;
+    stats.vertices += counters.vertices;
+    stats.triangles += counters.indices / 3;
+}
@@ -0,0 +1,104 @@
+#ifndef TERRAIN_LOD_INDIRECT_HPP
+#define TERRAIN_LOD_INDIRECT_HPP
+
+#include <cstddef>
+#include <vector>
+
+#include <GL/glew.h>
+#include <glm/vec2.hpp>
+
+#include "frustum.hpp"
+#include "height_pyramid.hpp"
+#include "render_stats.hpp"
+#include "terrain_lod.hpp"
+
+// LOD nodes culled & submitted by the GPU instead of drawn one by one.
+// lod_cull.comp tests the quadrants of every node TerrainLod selected against the frustum, with heights from a copy
+// of the height map's min/max pyramid, and appends a DrawElementsIndirectCommand per run of visible quadrants along
+// with its node. A single glMultiDrawElementsIndirect then draws them, main.vert reading each draw's node as an
+// instanced attribute. Needs GL 4.3, or its compute shader, storage buffer & multi-draw indirect extensions.
+class TerrainLodIndirect {
+public:
+    // Heights span [0, maxHeight], unscaled, until setHeights
+    explicit TerrainLodIndirect(float maxHeight);
+
+    TerrainLodIndirect(const TerrainLodIndirect&) = delete;
+    TerrainLodIndirect& operator=(const TerrainLodIndirect&) = delete;
+
+    // Whether the context can run the GPU path. GL thread only.
+    static bool isSupported();
+
+    // Creates a vertex array drawing patch from its vertex & element buffers, and the culling buffers. GL thread only.
+    void load(const LodPatch& patch, GLuint vertexBuffer, GLuint elementBuffer);
+    void unload();
+    bool isLoaded() const;
+
+    // Resolves the uniforms of the cull program. Call after every link.
+    void setProgram(GLuint program);
+
+    // Uploads the pyramid bounds are taken from. GL thread only.
+    void setHeights(const HeightPyramid& pyramid);
+    bool hasHeights() const;
+
+    // Culls nodes against frustum with the cull program, which must be bound, and writes the draws
+    void cull(const std::vector<LodNode>& nodes, const Frustum& frustum, const glm::vec2& uvTransform,
+              float heightScale);
+
+    // Draws what the last cull kept with the bound program, in one call. Counts the nodes tested and, as the counters
+    // are read back without waiting, the tiles culled & drawn, vertices and triangles of a few frames earlier.
+    void draw(RenderStats& stats);
+
+private:
+    static constexpr std::size_t readbackSlots = 4;
+
+    // std430 image of Counters in lod_cull.comp
+    struct Counters {
+        GLuint commandCount;
+        GLuint tilesDrawn;
+        GLuint tilesCulled;
+        GLuint vertices;
+        GLuint indices;
+    };
+
+    void reserve(std::size_t count);
+    void readCounters();
+
+    float maxHeight;
+    unsigned int patchSize = 0;
+    std::size_t quadrantIndexCount = 0;
+    GLuint patchVertices = 0;
+    GLuint quadrantVertices = 0;
+
+    struct Uniforms {
+        GLint nodeCount = -1;
+        GLint frustumPlanes = -1;
+        GLint uvTransform = -1;
+        GLint heightMapScale = -1;
+        GLint pyramidLevels = -1;
+        GLint pyramidLevelCount = -1;
+        GLint maxHeight = -1;
+        GLint quadrantIndexCount = -1;
+        GLint patchVertices = -1;
+    } uniforms;
+
+    GLuint vertexArrayID = 0;
+    GLuint nodeBuffer = 0;
+    GLuint pyramidBuffer = 0;
+    GLuint commandBuffer = 0;
+    GLuint drawNodeBuffer = 0;
+    GLuint counterBuffer = 0;
+    // Nodes the buffers hold room for, two commands each
+    std::size_t capacity = 0;
+    std::size_t nodeCount = 0;
+
+    // (width, height, first cell, 0) of each uploaded pyramid level
+    std::vector<GLint> pyramidLevels;
+
+    // Copies of the counters of the last readbackSlots culls, each readable once its fence is signalled
+    GLuint readbackBuffer = 0;
+    GLsync readbackFences[readbackSlots] = {};
+    std::size_t culls = 0;
+    Counters counters = {};
+};
+
+#endif
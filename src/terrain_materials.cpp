@@ -0,0 +1,62 @@
+#include <iostream>
+
+#include "terrain_materials.hpp"
+
+bool TerrainMaterials::add(const TerrainMaterial& material) {
+    if (materials.size() == maxTerrainMaterials) {
+        std::cerr << "At most " << maxTerrainMaterials << " terrain materials are supported" << std::endl;
+        return false;
+    }
+    materials.push_back(material);
+    return true;
+}
+
+std::size_t TerrainMaterials::size() const {
+    return materials.size();
+}
+
+void TerrainMaterials::load(TextureLoader& loader, const bool compressed) {
+    std::vector<std::string> albedoPaths;
+    std::vector<std::string> roughnessPaths;
+    std::vector<std::string> normalPaths;
+    for (const auto& material : materials) {
+        albedoPaths.push_back(material.albedoPath);
+        roughnessPaths.push_back(material.roughnessPath);
+        normalPaths.push_back(material.normalPath);
+    }
+
+    // Grey until loaded; normals point along tangent space +Z, in BGR
+    const glm::u8vec3 grey(128, 128, 128);
+    const glm::u8vec3 flatNormal(255, 128, 128);
+    const TextureCompression colour = compressed ? TextureCompression::BC1 : TextureCompression::None;
+    const TextureCompression normal = compressed ? TextureCompression::BC5 : TextureCompression::None;
+    loader.loadArray(albedoPaths, &arrayIDs[0], TextureFilter::Trilinear, grey, colour);
+    loader.loadArray(roughnessPaths, &arrayIDs[1], TextureFilter::Trilinear, grey, colour);
+    loader.loadArray(normalPaths, &arrayIDs[2], TextureFilter::Trilinear, flatNormal, normal);
+}
+
+void TerrainMaterials::bind() const {
+    // One call for all three units when available
+    if (GLEW_ARB_multi_bind) {
+        glBindTextures(materialTextureUnit, 3, arrayIDs);
+        return;
+    }
+    for (GLuint i = 0; i < 3; i++) {
+        glActiveTexture(GL_TEXTURE0 + materialTextureUnit + i);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, arrayIDs[i]);
+    }
+}
+
+void TerrainMaterials::writeUniforms(MaterialUniforms& uniforms) const {
+    uniforms.materialCount = static_cast<GLint>(materials.size());
+    for (std::size_t i = 0; i < materials.size(); i++) {
+        uniforms.materialHeights[i / 4][i % 4] = materials[i].height;
+    }
+}
+
+void TerrainMaterials::unload() {
+    glDeleteTextures(3, arrayIDs);
+    for (auto& arrayID : arrayIDs) {
+        arrayID = 0;
+    }
+}
@@ -0,0 +1,54 @@
+#ifndef TERRAIN_MATERIALS_HPP
+#define TERRAIN_MATERIALS_HPP
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include <GL/glew.h>
+
+#include "shader_blocks.hpp"
+#include "texture_loader.hpp"
+
+// Texture units of the albedo, roughness & normal arrays, as bound in main.frag
+static constexpr GLuint materialTextureUnit = 1;
+
+// Textures of one terrain material and where it starts
+struct TerrainMaterial {
+    std::string albedoPath;
+    std::string roughnessPath;
+    std::string normalPath;
+    // Terrain height from which this material takes over from the previous ones
+    float height;
+};
+
+// Terrain materials packed into one albedo, one roughness and one normal texture array,
+// material i being layer i of each. main.frag blends them by height in the order they were added.
+class TerrainMaterials {
+public:
+    TerrainMaterials() = default;
+    TerrainMaterials(const TerrainMaterials&) = delete;
+    TerrainMaterials& operator=(const TerrainMaterials&) = delete;
+
+    // Returns false once maxTerrainMaterials have been added
+    bool add(const TerrainMaterial& material);
+    std::size_t size() const;
+
+    // Queues the three arrays, as BC1 albedo & roughness and BC5 normals if compressed. GL thread only.
+    void load(TextureLoader& loader, bool compressed);
+
+    // Binds the arrays to materialTextureUnit onwards
+    void bind() const;
+
+    // Material count & heights of the MaterialUniforms block
+    void writeUniforms(MaterialUniforms& uniforms) const;
+
+    void unload();
+
+private:
+    std::vector<TerrainMaterial> materials;
+    // Albedo, roughness & normal arrays, in texture unit order
+    GLuint arrayIDs[3] = {0, 0, 0};
+};
+
+#endif
@@ -0,0 +1,185 @@
+#include <cassert>
+#include <cstdlib>
+#include <iostream>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define TERRAIN_MESH_SSE2 1
+#endif
+
+#include "parallel.hpp"
+#include "terrain_mesh_builder.hpp"
+
+// Rows are cheap, hand out enough of them per chunk to amortise scheduling
+static constexpr std::size_t minRowsPerChunk = 16;
+
+TerrainMeshBuilder::TerrainMeshBuilder(const unsigned int nPoints, const float scale)
+    : nPoints(nPoints), scale(scale) {
+    assert(nPoints >= 2 && nPoints <= maxTerrainPoints);
+}
+
+std::size_t TerrainMeshBuilder::vertexCount() const {
+    return static_cast<std::size_t>(nPoints) * nPoints;
+}
+
+std::size_t TerrainMeshBuilder::indexCount() const {
+    // Each row but the last emits two indices per column plus the restart index
+    return static_cast<std::size_t>(nPoints - 1) * (2 * static_cast<std::size_t>(nPoints) + 1);
+}
+
+TerrainMesh TerrainMeshBuilder::build() const {
+    TerrainMesh mesh;
+    mesh.nPoints = nPoints;
+    mesh.vertices.resize(vertexCount());
+    mesh.uvs.resize(vertexCount());
+    mesh.indices.resize(indexCount());
+
+    buildVertices(mesh.vertices.data(), mesh.uvs.data());
+    buildIndices(mesh.indices.data());
+
+    return mesh;
+}
+
+void TerrainMeshBuilder::buildVertices(glm::vec3* vertices, glm::vec2* uvs) const {
+    const auto denominator = static_cast<float>(nPoints - 1);
+
+    // z and v only depend on the column, compute them once for every row
+    std::vector<float> zs(nPoints);
+    std::vector<float> vs(nPoints);
+    unsigned int j = 0;
+#ifdef TERRAIN_MESH_SSE2
+    const __m128 denominators = _mm_set1_ps(denominator);
+    const __m128 scales = _mm_set1_ps(scale);
+    const __m128 halves = _mm_set1_ps(0.5f);
+    const __m128 twos = _mm_set1_ps(2.0f);
+    for (; j + 4 <= nPoints; j += 4) {
+        const __m128 columns = _mm_cvtepi32_ps(_mm_setr_epi32(j, j + 1, j + 2, j + 3));
+        const __m128 z = _mm_mul_ps(_mm_mul_ps(scales, _mm_sub_ps(_mm_div_ps(columns, denominators), halves)), twos);
+        const __m128 v = _mm_div_ps(_mm_add_ps(columns, halves), denominators);
+        _mm_storeu_ps(&zs[j], z);
+        _mm_storeu_ps(&vs[j], v);
+    }
+#endif
+    for (; j < nPoints; j++) {
+        zs[j] = scale * (j / denominator - 0.5f) * 2.0f;
+        vs[j] = (j + 0.5f) / denominator;
+    }
+
+    parallelFor(0, nPoints, [&](const std::size_t rowBegin, const std::size_t rowEnd) {
+        for (auto i = static_cast<unsigned int>(rowBegin); i < rowEnd; i++) {
+            const float x = scale * (i / denominator - 0.5f) * 2.0f;
+            const float u = (i + 0.5f) / denominator;
+            float* position = &vertices[static_cast<std::size_t>(i) * nPoints].x;
+            float* uv = &uvs[static_cast<std::size_t>(i) * nPoints].x;
+
+            unsigned int column = 0;
+#ifdef TERRAIN_MESH_SSE2
+            // Four (x, 0, z) vertices span three registers, four (u, v) pairs span two
+            const __m128 xs = _mm_set1_ps(x);
+            const __m128 us = _mm_set1_ps(u);
+            const __m128 zeros = _mm_setzero_ps();
+            const __m128 xZeros = _mm_unpacklo_ps(xs, zeros);
+            for (; column + 4 <= nPoints; column += 4) {
+                const __m128 z = _mm_loadu_ps(&zs[column]);
+                const __m128 z0 = _mm_shuffle_ps(z, xs, _MM_SHUFFLE(0, 0, 0, 0));
+                const __m128 z1 = _mm_shuffle_ps(zeros, z, _MM_SHUFFLE(1, 1, 0, 0));
+                const __m128 z2 = _mm_shuffle_ps(z, xs, _MM_SHUFFLE(0, 0, 2, 2));
+                const __m128 z3 = _mm_shuffle_ps(zeros, z, _MM_SHUFFLE(3, 3, 0, 0));
+                _mm_storeu_ps(position, _mm_shuffle_ps(xZeros, z0, _MM_SHUFFLE(3, 0, 1, 0)));
+                _mm_storeu_ps(position + 4, _mm_shuffle_ps(z1, xZeros, _MM_SHUFFLE(1, 0, 2, 0)));
+                _mm_storeu_ps(position + 8, _mm_shuffle_ps(z2, z3, _MM_SHUFFLE(2, 0, 2, 0)));
+                position += 12;
+
+                const __m128 v = _mm_loadu_ps(&vs[column]);
+                _mm_storeu_ps(uv, _mm_unpacklo_ps(us, v));
+                _mm_storeu_ps(uv + 4, _mm_unpackhi_ps(us, v));
+                uv += 8;
+            }
+#endif
+            for (; column < nPoints; column++) {
+                *position++ = x;
+                *position++ = 0.0f;
+                *position++ = zs[column];
+                *uv++ = u;
+                *uv++ = vs[column];
+            }
+        }
+    }, minRowsPerChunk);
+}
+
+void TerrainMeshBuilder::buildIndices(unsigned int* indices) const {
+    const std::size_t rowLength = 2 * static_cast<std::size_t>(nPoints) + 1;
+
+    parallelFor(0, nPoints - 1, [&](const std::size_t rowBegin, const std::size_t rowEnd) {
+        for (std::size_t i = rowBegin; i < rowEnd; i++) {
+            // Each column adds (bottomLeft, topLeft), where bottomLeft is one row further
+            unsigned int* row = indices + i * rowLength;
+            const auto topLeft = static_cast<unsigned int>(i * nPoints);
+
+            unsigned int j = 0;
+#ifdef TERRAIN_MESH_SSE2
+            const __m128i offsets = _mm_setr_epi32(0, 1, 2, 3);
+            const __m128i rowStride = _mm_set1_epi32(static_cast<int>(nPoints));
+            for (; j + 4 <= nPoints; j += 4) {
+                const __m128i top = _mm_add_epi32(_mm_set1_epi32(static_cast<int>(topLeft + j)), offsets);
+                const __m128i bottom = _mm_add_epi32(top, rowStride);
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(row + 2 * j), _mm_unpacklo_epi32(bottom, top));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(row + 2 * j + 4), _mm_unpackhi_epi32(bottom, top));
+            }
+#endif
+            for (; j < nPoints; j++) {
+                row[2 * j] = topLeft + j + nPoints;
+                row[2 * j + 1] = topLeft + j;
+            }
+            row[rowLength - 1] = restartIndex;
+        }
+    }, minRowsPerChunk);
+}
+
+// The scalar loops the builder replaced, kept as the reference for runMeshCheck
+static TerrainMesh buildReferenceMesh(const unsigned int nPoints, const float scale) {
+    TerrainMesh mesh;
+    mesh.nPoints = nPoints;
+    for (unsigned int i = 0; i < nPoints; i++) {
+        const float x = scale * (i / static_cast<float>(nPoints - 1) - 0.5f) * 2.0f;
+
+        for (unsigned int j = 0; j < nPoints; j++) {
+            const float z = scale * (j / static_cast<float>(nPoints - 1) - 0.5f) * 2.0f;
+            mesh.vertices.emplace_back(x, 0, z);
+            mesh.uvs.emplace_back((i + 0.5f) / static_cast<float>(nPoints - 1),
+                                  (j + 0.5f) / static_cast<float>(nPoints - 1));
+        }
+    }
+
+    unsigned int n = 0;
+    for (unsigned int i = 0; i < nPoints - 1; i++) {
+        for (unsigned int j = 0; j < nPoints; j++) {
+            mesh.indices.push_back(n + nPoints);
+            mesh.indices.push_back(n);
+            n++;
+        }
+        mesh.indices.push_back(restartIndex);
+    }
+    return mesh;
+}
+
+int runMeshCheck() {
+    // Sizes below, at and past the vector width, most of them leaving a scalar tail
+    constexpr unsigned int sizes[] = {2, 3, 4, 5, 7, 8, 13, 64, 130, 257, 1001};
+    constexpr float scales[] = {1.0f, 3.7f};
+
+    bool passed = true;
+    for (const unsigned int nPoints : sizes) {
+        for (const float scale : scales) {
+            const TerrainMesh mesh = TerrainMeshBuilder(nPoints, scale).build();
+            const TerrainMesh reference = buildReferenceMesh(nPoints, scale);
+            // Both sides do the same float operations in the same order, so they must match exactly
+            const bool matches = mesh.vertices == reference.vertices && mesh.uvs == reference.uvs
+                                 && mesh.indices == reference.indices;
+            std::cout << nPoints << " x " << nPoints << ", scale " << scale << ": "
+                      << (matches ? "match" : "MISMATCH") << std::endl;
+            passed = passed && matches;
+        }
+    }
+    return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
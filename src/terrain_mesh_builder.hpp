@@ -0,0 +1,53 @@
+#ifndef TERRAIN_MESH_BUILDER_HPP
+#define TERRAIN_MESH_BUILDER_HPP
+
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
+
+// Index that separates the rows of the terrain triangle strip
+constexpr unsigned int restartIndex = std::numeric_limits<std::uint32_t>::max();
+
+// Largest grid that can be indexed with 32-bit indices without hitting restartIndex
+constexpr unsigned int maxTerrainPoints = 65535;
+
+// CPU side terrain grid: nPoints x nPoints vertices, rendered as one triangle strip per row
+struct TerrainMesh {
+    unsigned int nPoints = 0;
+    std::vector<glm::vec3> vertices;
+    std::vector<glm::vec2> uvs;
+    std::vector<unsigned int> indices;
+};
+
+// Builds the terrain grid without any GL dependency.
+// Storage is sized once up front and rows are filled in parallel with vectorised kernels.
+class TerrainMeshBuilder {
+public:
+    // nPoints must be in [2, maxTerrainPoints]; the grid spans [-scale, scale] on X and Z
+    TerrainMeshBuilder(unsigned int nPoints, float scale);
+
+    std::size_t vertexCount() const;
+    std::size_t indexCount() const;
+
+    // Allocates and fills a complete mesh
+    TerrainMesh build() const;
+
+    // Fill caller provided storage of vertexCount() elements each
+    void buildVertices(glm::vec3* vertices, glm::vec2* uvs) const;
+
+    // Fill caller provided storage of indexCount() elements
+    void buildIndices(unsigned int* indices) const;
+
+private:
+    unsigned int nPoints;
+    float scale;
+};
+
+// Compares TerrainMeshBuilder against the scalar reference loops on several grid sizes.
+// Returns EXIT_SUCCESS if every mesh matches exactly.
+int runMeshCheck();
+
+#endif
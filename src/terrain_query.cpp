@@ -0,0 +1,464 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define TERRAIN_QUERY_SSE2 1
+#endif
+
+#include "parallel.hpp"
+#include "terrain_lod.hpp"
+#include "terrain_query.hpp"
+
+// Rays per chunk when casting in parallel
+static constexpr std::size_t minRaysPerChunk = 64;
+
+// Distance stepped past a cell boundary, in cells, so the next lookup lands in the next cell
+static constexpr float cellBoundaryEpsilon = 1e-4f;
+
+// Bisection steps refining a linear raycast hit
+static constexpr int bisectionSteps = 24;
+
+TerrainQuery::TerrainQuery(const float extent, const glm::vec2& uvTransform) : extent(extent),
+                                                                                uvTransform(uvTransform),
+                                                                                cellScale(0.0f),
+                                                                                cellOffset(0.0f) {
+}
+
+void TerrainQuery::build(HeightField heights) {
+    field = std::move(heights);
+    if (field.width <= 0 || field.height <= 0) {
+        return;
+    }
+
+    // Texel centres sit at uv * size - 0.5
+    const glm::vec2 size(field.width, field.height);
+    cellScale = uvTransform.x * size;
+    cellOffset = uvTransform.y * size - 0.5f;
+
+    // A bilinear cell never rises above the highest of its four texels
+    HeightField cellMax;
+    cellMax.width = std::max(field.width - 1, 1);
+    cellMax.height = std::max(field.height - 1, 1);
+    cellMax.heights.resize(static_cast<std::size_t>(cellMax.width) * cellMax.height);
+    for (int y = 0; y < cellMax.height; y++) {
+        const int y1 = std::min(y + 1, field.height - 1);
+        for (int x = 0; x < cellMax.width; x++) {
+            const int x1 = std::min(x + 1, field.width - 1);
+            cellMax.heights[static_cast<std::size_t>(y) * cellMax.width + x] =
+                std::max(std::max(field.at(x, y), field.at(x1, y)), std::max(field.at(x, y1), field.at(x1, y1)));
+        }
+    }
+    cellPyramid.build(cellMax);
+}
+
+bool TerrainQuery::empty() const {
+    return cellPyramid.empty();
+}
+
+const HeightField& TerrainQuery::heightField() const {
+    return field;
+}
+
+void TerrainQuery::setHeightScale(const float scale) {
+    heightScale = scale;
+}
+
+glm::vec2 TerrainQuery::toCells(const glm::vec2& xz) const {
+    return xz * cellScale + cellOffset;
+}
+
+float TerrainQuery::sampleCells(const glm::vec2& cells) const {
+    const glm::vec2 clamped = glm::clamp(cells, glm::vec2(0.0f), glm::vec2(field.width - 1, field.height - 1));
+    const int x0 = std::min(static_cast<int>(clamped.x), std::max(field.width - 2, 0));
+    const int y0 = std::min(static_cast<int>(clamped.y), std::max(field.height - 2, 0));
+    const int x1 = std::min(x0 + 1, field.width - 1);
+    const int y1 = std::min(y0 + 1, field.height - 1);
+    const glm::vec2 fraction = clamped - glm::vec2(x0, y0);
+
+    const float bottom = glm::mix(field.at(x0, y0), field.at(x1, y0), fraction.x);
+    const float top = glm::mix(field.at(x0, y1), field.at(x1, y1), fraction.x);
+    return glm::mix(bottom, top, fraction.y);
+}
+
+float TerrainQuery::height(const glm::vec2& xz) const {
+    return sampleCells(toCells(xz)) * heightScale;
+}
+
+void TerrainQuery::heights(const float* x, const float* z, float* results, const std::size_t count) const {
+    std::size_t i = 0;
+#ifdef TERRAIN_QUERY_SSE2
+    // Four queries at a time: cell coordinates & weights in registers, texel fetches scalar
+    const __m128 scaleX = _mm_set1_ps(cellScale.x);
+    const __m128 scaleZ = _mm_set1_ps(cellScale.y);
+    const __m128 offsetX = _mm_set1_ps(cellOffset.x);
+    const __m128 offsetZ = _mm_set1_ps(cellOffset.y);
+    const __m128 maxX = _mm_set1_ps(static_cast<float>(field.width - 1));
+    const __m128 maxZ = _mm_set1_ps(static_cast<float>(field.height - 1));
+    const __m128 lastCellX = _mm_set1_ps(static_cast<float>(std::max(field.width - 2, 0)));
+    const __m128 lastCellZ = _mm_set1_ps(static_cast<float>(std::max(field.height - 2, 0)));
+    const __m128 scale = _mm_set1_ps(heightScale);
+    const __m128 zero = _mm_setzero_ps();
+    for (; i + 4 <= count; i += 4) {
+        const __m128 cellsX = _mm_min_ps(_mm_max_ps(_mm_add_ps(_mm_mul_ps(_mm_loadu_ps(x + i), scaleX), offsetX),
+                                                    zero), maxX);
+        const __m128 cellsZ = _mm_min_ps(_mm_max_ps(_mm_add_ps(_mm_mul_ps(_mm_loadu_ps(z + i), scaleZ), offsetZ),
+                                                    zero), maxZ);
+        // Coordinates are non-negative, so truncation is floor
+        const __m128 cellX = _mm_min_ps(_mm_cvtepi32_ps(_mm_cvttps_epi32(cellsX)), lastCellX);
+        const __m128 cellZ = _mm_min_ps(_mm_cvtepi32_ps(_mm_cvttps_epi32(cellsZ)), lastCellZ);
+        const __m128 fractionX = _mm_sub_ps(cellsX, cellX);
+        const __m128 fractionZ = _mm_sub_ps(cellsZ, cellZ);
+
+        alignas(16) int texelX[4];
+        alignas(16) int texelZ[4];
+        _mm_store_si128(reinterpret_cast<__m128i*>(texelX), _mm_cvttps_epi32(cellX));
+        _mm_store_si128(reinterpret_cast<__m128i*>(texelZ), _mm_cvttps_epi32(cellZ));
+        alignas(16) float h00[4];
+        alignas(16) float h10[4];
+        alignas(16) float h01[4];
+        alignas(16) float h11[4];
+        for (int lane = 0; lane < 4; lane++) {
+            const int x1 = std::min(texelX[lane] + 1, field.width - 1);
+            const int z1 = std::min(texelZ[lane] + 1, field.height - 1);
+            h00[lane] = field.at(texelX[lane], texelZ[lane]);
+            h10[lane] = field.at(x1, texelZ[lane]);
+            h01[lane] = field.at(texelX[lane], z1);
+            h11[lane] = field.at(x1, z1);
+        }
+
+        const __m128 bottom = _mm_add_ps(_mm_load_ps(h00),
+                                         _mm_mul_ps(fractionX, _mm_sub_ps(_mm_load_ps(h10), _mm_load_ps(h00))));
+        const __m128 top = _mm_add_ps(_mm_load_ps(h01),
+                                      _mm_mul_ps(fractionX, _mm_sub_ps(_mm_load_ps(h11), _mm_load_ps(h01))));
+        const __m128 height = _mm_add_ps(bottom, _mm_mul_ps(fractionZ, _mm_sub_ps(top, bottom)));
+        _mm_storeu_ps(results + i, _mm_mul_ps(height, scale));
+    }
+#endif
+    for (; i < count; i++) {
+        results[i] = height(glm::vec2(x[i], z[i]));
+    }
+}
+
+bool TerrainQuery::intersectCell(const int x, const int y, const glm::vec3& origin, const glm::vec3& direction,
+                                 const float tBegin, const float tEnd, float& distance) const {
+    // Along the ray, the bilinear fractions are linear in s = t - tBegin: fraction = a + b * s.
+    // Outside the field the sampler clamps, so the fraction is constant.
+    const glm::vec2 begin = toCells(glm::vec2(origin.x, origin.z) + tBegin * glm::vec2(direction.x, direction.z));
+    const glm::vec2 step = glm::vec2(direction.x, direction.z) * cellScale;
+    const auto axis = [](const int cell, const int cells, const float position, const float delta, int& texel,
+                         float& a, float& b) {
+        if (cell < 0) {
+            texel = 0;
+            a = 0.0f;
+            b = 0.0f;
+        } else if (cell >= cells) {
+            texel = cells - 1;
+            a = 1.0f;
+            b = 0.0f;
+        } else {
+            texel = cell;
+            a = position - static_cast<float>(cell);
+            b = delta;
+        }
+    };
+    int x0;
+    int y0;
+    float ax;
+    float bx;
+    float ay;
+    float by;
+    axis(x, std::max(field.width - 1, 1), begin.x, step.x, x0, ax, bx);
+    axis(y, std::max(field.height - 1, 1), begin.y, step.y, y0, ay, by);
+    const int x1 = std::min(x0 + 1, field.width - 1);
+    const int y1 = std::min(y0 + 1, field.height - 1);
+
+    // h(s) = A + B s + C s^2 from h00 + dx fx + dy fy + k fx fy
+    const float h00 = field.at(x0, y0) * heightScale;
+    const float dx = field.at(x1, y0) * heightScale - h00;
+    const float dy = field.at(x0, y1) * heightScale - h00;
+    const float k = field.at(x1, y1) * heightScale - h00 - dx - dy;
+    const float a = h00 + dx * ax + dy * ay + k * ax * ay;
+    const float b = dx * bx + dy * by + k * (ax * by + ay * bx);
+    const float c = k * bx * by;
+
+    // Ray height minus terrain height: f(s) = f0 + f1 s + f2 s^2, looking for its first root in [0, tEnd - tBegin]
+    const float f0 = origin.y + direction.y * tBegin - a;
+    const float f1 = direction.y - b;
+    const float f2 = -c;
+    const float length = tEnd - tBegin;
+    if (f0 <= 0.0f) {
+        distance = tBegin;
+        return true;
+    }
+
+    float root = std::numeric_limits<float>::infinity();
+    if (std::abs(f2) < 1e-12f) {
+        if (f1 < 0.0f) {
+            root = -f0 / f1;
+        }
+    } else {
+        const float discriminant = f1 * f1 - 4.0f * f2 * f0;
+        if (discriminant >= 0.0f) {
+            // Stable roots: q / f2 and f0 / q
+            const float q = -0.5f * (f1 + std::copysign(std::sqrt(discriminant), f1));
+            for (const float candidate : {q / f2, q != 0.0f ? f0 / q : -1.0f}) {
+                if (candidate >= 0.0f && candidate < root) {
+                    root = candidate;
+                }
+            }
+        }
+    }
+    if (root > length) {
+        return false;
+    }
+    distance = tBegin + root;
+    return true;
+}
+
+bool TerrainQuery::raycast(const glm::vec3& origin, const glm::vec3& direction, const float maxDistance,
+                           float& distance) const {
+    if (empty()) {
+        return false;
+    }
+
+    // Clip to the terrain's box: the field's square, up to its highest point
+    const std::size_t topLevel = cellPyramid.levelCount() - 1;
+    const float top = cellPyramid.cell(topLevel, 0, 0).y * heightScale;
+    float tBegin = 0.0f;
+    float tEnd = maxDistance;
+    const glm::vec3 boxMin(-extent, -std::numeric_limits<float>::infinity(), -extent);
+    const glm::vec3 boxMax(extent, top, extent);
+    for (int i = 0; i < 3; i++) {
+        if (direction[i] == 0.0f) {
+            if (origin[i] < boxMin[i] || origin[i] > boxMax[i]) {
+                return false;
+            }
+            continue;
+        }
+        float t0 = (boxMin[i] - origin[i]) / direction[i];
+        float t1 = (boxMax[i] - origin[i]) / direction[i];
+        if (t0 > t1) {
+            std::swap(t0, t1);
+        }
+        tBegin = std::max(tBegin, t0);
+        tEnd = std::min(tEnd, t1);
+    }
+    if (tBegin > tEnd) {
+        return false;
+    }
+
+    // Walk the max chain in cell space: skip cells the ray passes above, descend into the others
+    const glm::vec2 cellOrigin = toCells(glm::vec2(origin.x, origin.z));
+    const glm::vec2 cellDirection = glm::vec2(direction.x, direction.z) * cellScale;
+    const float largestStep = std::max(std::abs(cellDirection.x), std::abs(cellDirection.y));
+    const float epsilon = largestStep > 0.0f ? cellBoundaryEpsilon / largestStep : 0.0f;
+
+    std::size_t level = topLevel;
+    float t = tBegin;
+    while (t <= tEnd) {
+        const auto size = static_cast<float>(1u << level);
+        const glm::vec2 position = cellOrigin + t * cellDirection;
+        const glm::vec2 cell = glm::floor(position / size);
+
+        // Where the ray leaves this cell
+        float tCell = tEnd;
+        for (int i = 0; i < 2; i++) {
+            if (cellDirection[i] > 0.0f) {
+                tCell = std::min(tCell, ((cell[i] + 1.0f) * size - cellOrigin[i]) / cellDirection[i]);
+            } else if (cellDirection[i] < 0.0f) {
+                tCell = std::min(tCell, (cell[i] * size - cellOrigin[i]) / cellDirection[i]);
+            }
+        }
+        tCell = std::max(tCell, t);
+
+        const int cellX = static_cast<int>(cell.x);
+        const int cellY = static_cast<int>(cell.y);
+        const float cellTop = cellPyramid.cell(level, cellX, cellY).y * heightScale;
+        const float lowest = std::min(origin.y + direction.y * t, origin.y + direction.y * tCell);
+        if (lowest <= cellTop && level > 0) {
+            level--;
+            continue;
+        }
+        if (lowest <= cellTop && intersectCell(cellX, cellY, origin, direction, t, tCell, distance)) {
+            return true;
+        }
+
+        // Passed above this cell: move on, trying a coarser level next
+        if (tCell >= tEnd) {
+            break;
+        }
+        t = tCell + epsilon;
+        level = std::min(level + 1, topLevel);
+    }
+    return false;
+}
+
+void TerrainQuery::raycasts(const glm::vec3* origins, const glm::vec3* directions, const std::size_t count,
+                            const float maxDistance, float* distances) const {
+    parallelFor(0, count, [&](const std::size_t begin, const std::size_t end) {
+        for (std::size_t i = begin; i < end; i++) {
+            float distance;
+            distances[i] = raycast(origins[i], directions[i], maxDistance, distance) ? distance : -1.0f;
+        }
+    }, minRaysPerChunk);
+}
+
+bool TerrainQuery::lineOfSight(const glm::vec3& a, const glm::vec3& b) const {
+    float distance;
+    return !raycast(a, b - a, 1.0f, distance);
+}
+
+bool TerrainQuery::raycastLinear(const glm::vec3& origin, const glm::vec3& direction, const float maxDistance,
+                                 const float step, float& distance) const {
+    const auto below = [&](const float t) {
+        const glm::vec3 point = origin + t * direction;
+        return point.y <= height(glm::vec2(point.x, point.z));
+    };
+    const auto inside = [&](const float t) {
+        const glm::vec3 point = origin + t * direction;
+        return std::abs(point.x) <= extent && std::abs(point.z) <= extent;
+    };
+
+    float previous = 0.0f;
+    for (float t = 0.0f; t <= maxDistance; t += step) {
+        if (inside(t) && below(t)) {
+            if (t == 0.0f) {
+                distance = 0.0f;
+                return true;
+            }
+            // Bisect between the last sample above and this one
+            float low = previous;
+            float high = t;
+            for (int i = 0; i < bisectionSteps; i++) {
+                const float middle = 0.5f * (low + high);
+                (below(middle) ? high : low) = middle;
+            }
+            distance = high;
+            return true;
+        }
+        previous = t;
+    }
+    return false;
+}
+
+using Clock = std::chrono::steady_clock;
+
+static double secondsSince(const Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+int runQueryBenchmark(const char* path, const unsigned int nPoints, const float extent, const float heightMapScale,
+                      const unsigned int iterations, const unsigned int seed) {
+    BMPImage image;
+    HeightField field;
+    if (!openBMP(path, image) || !decodeHeightField(image.view, field)) {
+        std::cout << "Height maps must be 24 bpp BMPs" << std::endl;
+        return EXIT_FAILURE;
+    }
+    const int width = field.width;
+    const int height = field.height;
+
+    TerrainQuery query(extent, terrainUVTransform(extent, nPoints));
+    Clock::time_point start = Clock::now();
+    query.build(std::move(field));
+    query.setHeightScale(heightMapScale);
+    const double buildSeconds = secondsSince(start);
+
+    std::mt19937 random(seed);
+    std::uniform_real_distribution<float> coordinate(-extent, extent);
+
+    // Height queries over the whole square
+    constexpr std::size_t heightQueries = 1 << 16;
+    std::vector<float> x(heightQueries);
+    std::vector<float> z(heightQueries);
+    for (std::size_t i = 0; i < heightQueries; i++) {
+        x[i] = coordinate(random);
+        z[i] = coordinate(random);
+    }
+    std::vector<float> single(heightQueries);
+    std::vector<float> batched(heightQueries);
+
+    start = Clock::now();
+    for (unsigned int iteration = 0; iteration < iterations; iteration++) {
+        for (std::size_t i = 0; i < heightQueries; i++) {
+            single[i] = query.height(glm::vec2(x[i], z[i]));
+        }
+    }
+    const double singleSeconds = secondsSince(start) / (static_cast<double>(iterations) * heightQueries);
+
+    start = Clock::now();
+    for (unsigned int iteration = 0; iteration < iterations; iteration++) {
+        query.heights(x.data(), z.data(), batched.data(), heightQueries);
+    }
+    const double batchedSeconds = secondsSince(start) / (static_cast<double>(iterations) * heightQueries);
+
+    float maxHeight = 0.0f;
+    float heightError = 0.0f;
+    for (std::size_t i = 0; i < heightQueries; i++) {
+        maxHeight = std::max(maxHeight, single[i]);
+        heightError = std::max(heightError, std::abs(single[i] - batched[i]));
+    }
+
+    // Rays from above the terrain, aimed at random points on it
+    constexpr std::size_t rayQueries = 1 << 12;
+    std::vector<glm::vec3> origins(rayQueries);
+    std::vector<glm::vec3> directions(rayQueries);
+    for (std::size_t i = 0; i < rayQueries; i++) {
+        origins[i] = glm::vec3(coordinate(random), 1.5f * maxHeight + 1.0f, coordinate(random));
+        const glm::vec3 target(coordinate(random), 0.0f, coordinate(random));
+        directions[i] = glm::normalize(target - origins[i]);
+    }
+    const float maxDistance = 4.0f * extent + 2.0f * maxHeight;
+    std::vector<float> hierarchical(rayQueries);
+
+    start = Clock::now();
+    for (unsigned int iteration = 0; iteration < iterations; iteration++) {
+        query.raycasts(origins.data(), directions.data(), rayQueries, maxDistance, hierarchical.data());
+    }
+    const double raySeconds = secondsSince(start) / (static_cast<double>(iterations) * rayQueries);
+
+    // Linear marching a quarter texel per step, once: it is the slow reference
+    const float step = extent / static_cast<float>(2 * std::max(width, height));
+    std::vector<float> linear(rayQueries);
+    start = Clock::now();
+    for (std::size_t i = 0; i < rayQueries; i++) {
+        float distance;
+        linear[i] = query.raycastLinear(origins[i], directions[i], maxDistance, step, distance) ? distance : -1.0f;
+    }
+    const double linearSeconds = secondsSince(start) / rayQueries;
+
+    // Linear marching can step over thin peaks, so only hits it finds earlier are errors
+    std::size_t hits = 0;
+    std::size_t missed = 0;
+    std::size_t steppedOver = 0;
+    for (std::size_t i = 0; i < rayQueries; i++) {
+        hits += hierarchical[i] >= 0.0f;
+        if (linear[i] >= 0.0f && (hierarchical[i] < 0.0f || hierarchical[i] > linear[i] + step)) {
+            missed++;
+        } else if (hierarchical[i] >= 0.0f && (linear[i] < 0.0f || hierarchical[i] < linear[i] - step)) {
+            steppedOver++;
+        }
+    }
+
+    std::cout << width << " x " << height << " heights, max chain built in " << std::fixed << std::setprecision(2)
+              << buildSeconds * 1e3 << " ms" << std::endl
+              << "  height, single    " << std::setw(10) << singleSeconds * 1e9 << " ns/query" << std::endl
+              << "  height, batched   " << std::setw(10) << batchedSeconds * 1e9 << " ns/query (max difference "
+              << heightError << ")" << std::endl
+              << "  raycast, max mips " << std::setw(10) << raySeconds * 1e9 << " ns/ray, " << workerCount()
+              << " threads (" << hits << " / " << rayQueries << " hits)" << std::endl
+              << "  raycast, linear   " << std::setw(10) << linearSeconds * 1e9 << " ns/ray, 1 thread ("
+              << steppedOver << " peaks stepped over, " << missed << " hits missed by the max mips)" << std::endl;
+    return heightError <= 1e-4f * std::max(maxHeight, 1.0f) && missed == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,74 @@
+#ifndef TERRAIN_QUERY_HPP
+#define TERRAIN_QUERY_HPP
+
+#include <cstddef>
+
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
+
+#include "height_pyramid.hpp"
+#include "terrain_bake.hpp"
+
+// CPU height & ray queries against a decoded height field, in world space.
+// The field covers the terrain square [-extent, extent]^2 through uv = xz * uvTransform.x + uvTransform.y,
+// like the renderer; heights are multiplied by the height scale and clamp to the field's edges.
+class TerrainQuery {
+public:
+    TerrainQuery(float extent, const glm::vec2& uvTransform);
+
+    // Takes the field and builds the max mip chain of its bilinear cells
+    void build(HeightField heights);
+    bool empty() const;
+
+    // The field taken by build, unscaled
+    const HeightField& heightField() const;
+
+    void setHeightScale(float scale);
+
+    // Bilinear height between texel centres
+    float height(const glm::vec2& xz) const;
+
+    // Heights of count (x[i], z[i]) positions, as structure of arrays
+    void heights(const float* x, const float* z, float* results, std::size_t count) const;
+
+    // Parameter t of the first hit of origin + t * direction with the terrain, t in [0, maxDistance].
+    // Returns false on a miss. Cells of the max mip chain entirely below the ray are skipped at once.
+    bool raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, float& distance) const;
+
+    // count raycasts in parallel; distances[i] is negative on a miss
+    void raycasts(const glm::vec3* origins, const glm::vec3* directions, std::size_t count, float maxDistance,
+                  float* distances) const;
+
+    // Whether the segment from a to b clears the terrain
+    bool lineOfSight(const glm::vec3& a, const glm::vec3& b) const;
+
+    // Raycast sampling every step along the ray, refined by bisection. Baseline of the benchmark.
+    bool raycastLinear(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, float step,
+                       float& distance) const;
+
+private:
+    // Cell space: bilinear cell (i, j) spans [i, i + 1] x [j, j + 1] between texel centres i and i + 1
+    glm::vec2 toCells(const glm::vec2& xz) const;
+    float sampleCells(const glm::vec2& cells) const;
+
+    // First hit inside level 0 cell (x, y), for t in [tBegin, tEnd]
+    bool intersectCell(int x, int y, const glm::vec3& origin, const glm::vec3& direction, float tBegin, float tEnd,
+                       float& distance) const;
+
+    float extent;
+    glm::vec2 uvTransform;
+    glm::vec2 cellScale;
+    glm::vec2 cellOffset;
+    float heightScale = 1.0f;
+
+    HeightField field;
+    // Max of the four texels of each bilinear cell, and coarser levels
+    HeightPyramid cellPyramid;
+};
+
+// Times single & batched height queries and hierarchical against linear raycasts on a height map BMP,
+// checking they agree. Headless; returns a process exit code.
+int runQueryBenchmark(const char* path, unsigned int nPoints, float extent, float heightMapScale,
+                      unsigned int iterations, unsigned int seed);
+
+#endif
@@ -0,0 +1,63 @@
+#include <cmath>
+
+#include <glm/glm.hpp>
+
+#include "terrain_tessellation.hpp"
+
+TerrainTessellation::TerrainTessellation(const float extent, const TessellationSettings& settings)
+    : extent(extent), settings(settings) {
+    // 45 degrees over 720 pixels until told otherwise
+    setProjection(glm::radians(45.0f), 720.0f);
+}
+
+void TerrainTessellation::setProjection(const float fovY, const float viewportHeight) {
+    pixelsPerUnit = viewportHeight / (2.0f * std::tan(fovY / 2.0f));
+}
+
+glm::vec4 TerrainTessellation::grid() const {
+    return glm::vec4(static_cast<float>(settings.patchesPerSide), extent, pixelsPerUnit, settings.edgePixels);
+}
+
+glm::vec4 TerrainTessellation::detail() const {
+    return glm::vec4(settings.flatDetail, settings.roughSlope, 0.0f, 0.0f);
+}
+
+void TerrainTessellation::load() {
+    // Draws need a vertex array even without attributes
+    glGenVertexArrays(1, &vertexArrayID);
+    glGenQueries(static_cast<GLsizei>(querySlots), queries);
+    draws = 0;
+    generatedTriangles = 0;
+}
+
+void TerrainTessellation::unload() {
+    glDeleteQueries(static_cast<GLsizei>(querySlots), queries);
+    glDeleteVertexArrays(1, &vertexArrayID);
+    vertexArrayID = 0;
+}
+
+void TerrainTessellation::draw(RenderStats& stats) {
+    // The slot's previous query is querySlots draws old; keep the last count if even that one is not done
+    const GLuint query = queries[draws % querySlots];
+    if (draws >= querySlots) {
+        GLuint available = GL_FALSE;
+        glGetQueryObjectuiv(query, GL_QUERY_RESULT_AVAILABLE, &available);
+        if (available == GL_TRUE) {
+            GLuint triangles = 0;
+            glGetQueryObjectuiv(query, GL_QUERY_RESULT, &triangles);
+            generatedTriangles = triangles;
+        }
+    }
+
+    const std::size_t patches = static_cast<std::size_t>(settings.patchesPerSide) * settings.patchesPerSide;
+    glBindVertexArray(vertexArrayID);
+    glPatchParameteri(GL_PATCH_VERTICES, 4);
+    glBeginQuery(GL_PRIMITIVES_GENERATED, query);
+    glDrawArrays(GL_PATCHES, 0, static_cast<GLsizei>(4 * patches));
+    glEndQuery(GL_PRIMITIVES_GENERATED);
+    draws++;
+
+    stats.drawCalls++;
+    stats.vertices += 4 * patches;
+    stats.triangles += generatedTriangles;
+}
@@ -0,0 +1,59 @@
+#ifndef TERRAIN_TESSELLATION_HPP
+#define TERRAIN_TESSELLATION_HPP
+
+#include <cstddef>
+
+#include <GL/glew.h>
+#include <glm/vec4.hpp>
+
+#include "render_stats.hpp"
+
+// Tessellated terrain settings
+struct TessellationSettings {
+    // Quad patches per side of the coarse grid
+    unsigned int patchesPerSide = 32;
+    // Screen-space length, in pixels, that rough edges are subdivided down to
+    float edgePixels = 16.0f;
+    // Fraction of that detail kept along edges whose heights follow a straight line
+    float flatDetail = 0.25f;
+    // RMS height deviation from the straight line, per unit of edge length, that earns an edge full detail
+    float roughSlope = 0.02f;
+};
+
+// Terrain drawn as a coarse grid of quad patches over [-extent, extent]^2 that tess.tesc subdivides on the GPU,
+// each edge by its projected length & the height variation along it, and tess.tese displaces. Patch corners come
+// from gl_VertexID, so no vertex or index buffers are involved.
+class TerrainTessellation {
+public:
+    TerrainTessellation(float extent, const TessellationSettings& settings);
+
+    void setProjection(float fovY, float viewportHeight);
+
+    // FrameUniforms values: (patches per side, extent, pixels per world unit at distance 1, edge pixels) and
+    // (flat detail, rough slope, 0, 0)
+    glm::vec4 grid() const;
+    glm::vec4 detail() const;
+
+    // Creates & deletes the vertex array and the primitive queries. GL thread only.
+    void load();
+    void unload();
+
+    // Draws every patch with the bound program. Counts patch corners as vertices and, as the result is read without
+    // waiting, the triangles generated a few frames earlier.
+    void draw(RenderStats& stats);
+
+private:
+    static constexpr std::size_t querySlots = 4;
+
+    float extent;
+    TessellationSettings settings;
+    float pixelsPerUnit = 0.0f;
+
+    GLuint vertexArrayID = 0;
+    // GL_PRIMITIVES_GENERATED of the last querySlots draws, reused in turn
+    GLuint queries[querySlots] = {};
+    std::size_t draws = 0;
+    std::size_t generatedTriangles = 0;
+};
+
+#endif
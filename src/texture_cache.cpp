@@ -0,0 +1,316 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <sstream>
+#include <system_error>
+#include <thread>
+
+#include <glm/gtc/constants.hpp>
+
+#include "bmp.hpp"
+#include "texture_cache.hpp"
+
+using Clock = std::chrono::steady_clock;
+
+// Bumped whenever the encoders or the file layout change, which invalidates every cached texture
+static constexpr std::uint32_t cacheVersion = 1;
+static constexpr char cacheMagic[4] = {'H', 'M', 'B', 'C'};
+
+// Followed by every level back to back, largest first. Native byte order: the cache is local to the machine.
+struct CacheHeader {
+    char magic[4];
+    std::uint32_t version;
+    std::uint32_t compression;
+    std::uint32_t width;
+    std::uint32_t height;
+    std::uint32_t levelCount;
+    std::uint64_t sourceHash;
+};
+
+static double millisecondsSince(const Clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+std::uint64_t fnv1a(const unsigned char* data, const std::size_t size, std::uint64_t hash) {
+    for (std::size_t i = 0; i < size; i++) {
+        hash = (hash ^ data[i]) * 1099511628211ull;
+    }
+    return hash;
+}
+
+// Covers the file's contents, the target format and the encoder version
+static std::uint64_t sourceHash(const MappedFile& file, const TextureCompression compression) {
+    const std::uint32_t key[2] = {cacheVersion, static_cast<std::uint32_t>(compression)};
+    const std::uint64_t hash = fnv1a(reinterpret_cast<const unsigned char*>(key), sizeof(key));
+    return fnv1a(file.data(), file.size(), hash);
+}
+
+static std::string cachePath(const std::string& directory, const std::uint64_t hash,
+                             const TextureCompression compression) {
+    std::ostringstream name;
+    name << std::hex << std::setw(16) << std::setfill('0') << hash
+         << (compression == TextureCompression::BC1 ? ".bc1" : ".bc5");
+    return (std::filesystem::path(directory) / name.str()).string();
+}
+
+// Sizes of the whole mip chain, as buildMipChain produces it
+static std::vector<std::pair<int, int>> levelSizes(int width, int height) {
+    std::vector<std::pair<int, int>> sizes = {{width, height}};
+    while (width > 1 || height > 1) {
+        width = std::max(1, width / 2);
+        height = std::max(1, height / 2);
+        sizes.emplace_back(width, height);
+    }
+    return sizes;
+}
+
+// Returns false on a miss; entries that do not match the source exactly are ignored
+static bool readCache(const std::string& path, const std::uint64_t hash, const TextureCompression compression,
+                      const int width, const int height, CompressedTexture& texture) {
+    const MappedFile file(path.c_str());
+    if (!file.isOpen() || file.size() < sizeof(CacheHeader)) {
+        return false;
+    }
+    CacheHeader header;
+    std::memcpy(&header, file.data(), sizeof(header));
+    const auto sizes = levelSizes(width, height);
+    std::size_t expectedSize = sizeof(CacheHeader);
+    for (const auto& [levelWidth, levelHeight] : sizes) {
+        expectedSize += compressedLevelSize(compression, levelWidth, levelHeight);
+    }
+    if (std::memcmp(header.magic, cacheMagic, sizeof(cacheMagic)) != 0 || header.version != cacheVersion ||
+        header.compression != static_cast<std::uint32_t>(compression) || header.sourceHash != hash ||
+        header.width != static_cast<std::uint32_t>(width) || header.height != static_cast<std::uint32_t>(height) ||
+        header.levelCount != sizes.size() || file.size() != expectedSize) {
+        std::cerr << "Ignoring invalid texture cache " << path << std::endl;
+        return false;
+    }
+
+    texture.levels.clear();
+    const unsigned char* blocks = file.data() + sizeof(CacheHeader);
+    for (const auto& [levelWidth, levelHeight] : sizes) {
+        const std::size_t size = compressedLevelSize(compression, levelWidth, levelHeight);
+        texture.levels.push_back({levelWidth, levelHeight, std::vector<unsigned char>(blocks, blocks + size)});
+        blocks += size;
+    }
+    return true;
+}
+
+// Written to a temporary file first, so readers never see a partial entry
+static void writeCache(const std::string& path, const std::uint64_t hash, const TextureCompression compression,
+                       const CompressedTexture& texture) {
+    std::error_code error;
+    std::filesystem::create_directories(std::filesystem::path(path).parent_path(), error);
+
+    // Unique per thread: identical files queued together encode to the same entry
+    std::ostringstream temporaryName;
+    temporaryName << path << "." << std::hash<std::thread::id>()(std::this_thread::get_id()) << ".tmp";
+    const std::string temporaryPath = temporaryName.str();
+    {
+        std::ofstream file(temporaryPath, std::ios::binary);
+        CacheHeader header{};
+        std::memcpy(header.magic, cacheMagic, sizeof(cacheMagic));
+        header.version = cacheVersion;
+        header.compression = static_cast<std::uint32_t>(compression);
+        header.width = static_cast<std::uint32_t>(texture.levels.front().width);
+        header.height = static_cast<std::uint32_t>(texture.levels.front().height);
+        header.levelCount = static_cast<std::uint32_t>(texture.levels.size());
+        header.sourceHash = hash;
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        for (const auto& level : texture.levels) {
+            file.write(reinterpret_cast<const char*>(level.blocks.data()),
+                       static_cast<std::streamsize>(level.blocks.size()));
+        }
+        if (!file.good()) {
+            std::cerr << "Texture cache " << path << " could not be written" << std::endl;
+            file.close();
+            std::filesystem::remove(temporaryPath, error);
+            return;
+        }
+    }
+    std::filesystem::rename(temporaryPath, path, error);
+    if (error) {
+        std::cerr << "Texture cache " << path << " could not be written: " << error.message() << std::endl;
+        std::filesystem::remove(temporaryPath, error);
+    }
+}
+
+bool loadCompressedTexture(const std::string& path, const TextureCompression compression,
+                           const std::string& cacheDirectory, CompressedTexture& texture) {
+    BMPImage image;
+    if (!openBMP(path.c_str(), image)) {
+        return false;
+    }
+    const ImageView& view = image.view;
+    const int channels = mipChannels(view.format);
+    if (channels < 3) {
+        std::cerr << path << " is not 24 or 32 bpp, it cannot be block compressed" << std::endl;
+        return false;
+    }
+
+    const std::uint64_t hash = sourceHash(image.file, compression);
+    const std::string cacheFile = cacheDirectory.empty() ? "" : cachePath(cacheDirectory, hash, compression);
+    if (!cacheFile.empty() && readCache(cacheFile, hash, compression, view.width, view.height, texture)) {
+        texture.cached = true;
+        return true;
+    }
+
+    texture.cached = false;
+    texture.levels.clear();
+    texture.levels.push_back(compressLevel([&view](const int y) { return view.row(y); }, view.width, view.height,
+                                           channels, compression));
+    for (const auto& mip : buildMipChain(view, channels)) {
+        texture.levels.push_back(compressLevel(mip.rows(), mip.width, mip.height, channels, compression));
+    }
+    if (!cacheFile.empty()) {
+        writeCache(cacheFile, hash, compression, texture);
+    }
+    return true;
+}
+
+// Peak signal to noise ratio over the first channels of tightly packed BGR pixels, red & green first
+static double psnr(const ImageView& source, const std::vector<unsigned char>& decoded, const int channels) {
+    const int sourceChannels = mipChannels(source.format);
+    double squaredError = 0.0;
+    for (int y = 0; y < source.height; y++) {
+        const unsigned char* row = source.row(y);
+        for (int x = 0; x < source.width; x++) {
+            const unsigned char* original = row + x * sourceChannels;
+            const unsigned char* compressed = &decoded[(static_cast<std::size_t>(y) * source.width + x) * 3];
+            for (int c = 2; c > 2 - channels; c--) {
+                const double d = static_cast<double>(original[c]) - static_cast<double>(compressed[c]);
+                squaredError += d * d;
+            }
+        }
+    }
+    const double meanSquaredError = squaredError / (static_cast<double>(source.width) * source.height * channels);
+    if (meanSquaredError == 0.0) {
+        return std::numeric_limits<double>::infinity();
+    }
+    return 10.0 * std::log10(255.0 * 255.0 / meanSquaredError);
+}
+
+// Mean angle in degrees between the source normals and those rebuilt from BC5 red & green, as main.frag does
+static double meanNormalError(const ImageView& source, const std::vector<unsigned char>& decoded) {
+    const int sourceChannels = mipChannels(source.format);
+    const auto unpack = [](const unsigned char value) { return static_cast<double>(value) / 255.0 * 2.0 - 1.0; };
+    double sum = 0.0;
+    for (int y = 0; y < source.height; y++) {
+        const unsigned char* row = source.row(y);
+        for (int x = 0; x < source.width; x++) {
+            const unsigned char* original = row + x * sourceChannels;
+            const unsigned char* compressed = &decoded[(static_cast<std::size_t>(y) * source.width + x) * 3];
+            const double ox = unpack(original[2]);
+            const double oy = unpack(original[1]);
+            const double oz = unpack(original[0]);
+            const double cx = unpack(compressed[2]);
+            const double cy = unpack(compressed[1]);
+            const double cz = std::sqrt(std::max(0.0, 1.0 - cx * cx - cy * cy));
+            const double originalLength = std::sqrt(ox * ox + oy * oy + oz * oz);
+            const double compressedLength = std::sqrt(cx * cx + cy * cy + cz * cz);
+            if (originalLength > 0.0 && compressedLength > 0.0) {
+                const double cosine = (ox * cx + oy * cy + oz * cz) / (originalLength * compressedLength);
+                sum += std::acos(std::clamp(cosine, -1.0, 1.0));
+            }
+        }
+    }
+    return sum / (static_cast<double>(source.width) * source.height) * 180.0 / glm::pi<double>();
+}
+
+int runCompressionReport(const char* path, const std::string& cacheDirectory) {
+    BMPImage image;
+    if (!openBMP(path, image)) {
+        return EXIT_FAILURE;
+    }
+    const ImageView& view = image.view;
+    const int channels = mipChannels(view.format);
+    if (channels < 3) {
+        std::cerr << path << " is not 24 or 32 bpp, it cannot be block compressed" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    // What the uncompressed path uploads: GL_RGB levels built on the CPU
+    Clock::time_point start = Clock::now();
+    const std::vector<MipLevel> mips = buildMipChain(view, channels);
+    const double mipMilliseconds = millisecondsSince(start);
+    std::size_t rawSize = static_cast<std::size_t>(view.width) * view.height * 3;
+    for (const auto& mip : mips) {
+        rawSize += static_cast<std::size_t>(mip.width) * mip.height * 3;
+    }
+    start = Clock::now();
+    const std::uint64_t hash = fnv1a(image.file.data(), image.file.size());
+    const double hashMilliseconds = millisecondsSince(start);
+
+    std::ostringstream report;
+    report << std::fixed << std::setprecision(2) << view.width << " x " << view.height << ", " << view.bitsPerPixel
+           << " bpp, " << levelSizes(view.width, view.height).size() << " levels, hash " << std::hex << hash
+           << std::dec << " in " << hashMilliseconds << " ms" << std::endl
+           << "  format         MiB   ratio   PSNR dB   normal err   encode ms   cached ms" << std::endl
+           << "  RGB8    " << std::setw(10) << static_cast<double>(rawSize) / (1024.0 * 1024.0) << std::setw(7)
+           << 1.0 << "x" << std::setw(10) << "-" << std::setw(13) << "-" << std::setw(12) << mipMilliseconds
+           << std::setw(12) << "-" << "   (mips only)" << std::endl;
+
+    bool ok = true;
+    for (const TextureCompression compression : {TextureCompression::BC1, TextureCompression::BC5}) {
+        // Drop a previous entry so the first load encodes
+        std::error_code error;
+        if (!cacheDirectory.empty()) {
+            std::filesystem::remove(cachePath(cacheDirectory, sourceHash(image.file, compression), compression),
+                                    error);
+        }
+
+        CompressedTexture encoded;
+        start = Clock::now();
+        ok = loadCompressedTexture(path, compression, cacheDirectory, encoded) && ok;
+        const double encodeMilliseconds = millisecondsSince(start);
+
+        CompressedTexture cached;
+        double cachedMilliseconds = -1.0;
+        if (!cacheDirectory.empty()) {
+            start = Clock::now();
+            ok = loadCompressedTexture(path, compression, cacheDirectory, cached) && cached.cached && ok;
+            cachedMilliseconds = millisecondsSince(start);
+        }
+        if (!ok) {
+            break;
+        }
+
+        std::size_t size = 0;
+        for (const auto& level : encoded.levels) {
+            size += level.blocks.size();
+        }
+        const std::vector<unsigned char> decoded = decompressLevel(encoded.levels.front(), compression);
+        const bool normals = compression == TextureCompression::BC5;
+        report << "  " << compressionName(compression) << "     " << std::setw(10)
+               << static_cast<double>(size) / (1024.0 * 1024.0) << std::setw(7)
+               << static_cast<double>(rawSize) / static_cast<double>(size) << "x" << std::setw(10)
+               << psnr(view, decoded, normals ? 2 : 3);
+        if (normals) {
+            report << std::setw(9) << meanNormalError(view, decoded) << " deg";
+        } else {
+            report << std::setw(13) << "-";
+        }
+        report << std::setw(12) << encodeMilliseconds << std::setw(12);
+        if (cachedMilliseconds >= 0.0) {
+            report << cachedMilliseconds;
+        } else {
+            report << "-";
+        }
+        report << std::endl;
+    }
+
+    if (!ok) {
+        std::cerr << "Compression report failed" << std::endl;
+        return EXIT_FAILURE;
+    }
+    std::cout << report.str();
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,32 @@
+#ifndef TEXTURE_CACHE_HPP
+#define TEXTURE_CACHE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "block_compression.hpp"
+
+// Block compressed mip chain of one texture file
+struct CompressedTexture {
+    std::vector<CompressedLevel> levels;
+    // Read from the cache rather than encoded
+    bool cached = false;
+};
+
+// 64 bit FNV-1a of size bytes, continuing from hash
+std::uint64_t fnv1a(const unsigned char* data, std::size_t size, std::uint64_t hash = 14695981039346656037ull);
+
+// Compresses a 24 or 32 bpp BMP and its whole mip chain.
+// With a cache directory, the result is stored there keyed by a hash of the file's contents, and read back
+// instead of encoding again while the file is unchanged. Returns false if the file cannot be decoded or
+// compressed; a cache that cannot be written is reported and skipped.
+bool loadCompressedTexture(const std::string& path, TextureCompression compression, const std::string& cacheDirectory,
+                           CompressedTexture& texture);
+
+// Headless report of BC1 & BC5 on a BMP: quality of level 0, sizes including mips, and encoding vs
+// cached load times. Returns a process exit code.
+int runCompressionReport(const char* path, const std::string& cacheDirectory);
+
+#endif
@@ -0,0 +1,622 @@
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+
+#include "mip_chain.hpp"
+#include "parallel.hpp"
+#include "profiler.hpp"
+#include "texture_cache.hpp"
+#include "texture_loader.hpp"
+
+using Clock = std::chrono::steady_clock;
+
+// Staging allocations are aligned so every level starts on a 4 byte unpack boundary
+static constexpr std::size_t stagingAlignment = 256;
+
+// Longest a blocking wait on an upload fence may take
+static constexpr GLuint64 fenceTimeout = 1000000000;
+
+static double millisecondsBetween(const Clock::time_point start, const Clock::time_point end) {
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+// One level to upload, rows bottom-up
+struct UploadLevel {
+    int width;
+    int height;
+    std::size_t stride;
+    // Bytes of the whole level
+    std::size_t size;
+    // Start of the rows when they are stored bottom-up back to back, otherwise nullptr. Always set for blocks.
+    const unsigned char* contiguous;
+    RowAccessor row;
+};
+
+// One decoded image of a texture and the levels generated from it
+struct DecodedLayer {
+    BMPImage image;
+    std::vector<MipLevel> mips;
+};
+
+struct TextureLoader::Asset {
+    // One path per layer of GL_TEXTURE_2D_ARRAY, a single one for GL_TEXTURE_2D
+    std::vector<std::string> paths;
+    std::string name;
+    GLenum target;
+    GLuint* textureID;
+    TextureFilter filter;
+    TextureBaker baker;
+    TextureCompression compression;
+
+    // Written by a worker, read by the GL thread once handed over through readyQueue
+    std::vector<DecodedLayer> layers;
+    BakedTexture baked;
+    // One per layer when compressed, replacing layers
+    std::vector<CompressedTexture> compressed;
+    bool decoded = false;
+
+    Clock::time_point queuedAt;
+    Clock::time_point decodeStartedAt;
+    Clock::time_point decodedAt;
+    Clock::time_point mipsBuiltAt;
+};
+
+void pixelTransferFormat(const PixelFormat format, GLenum& glFormat, GLenum& glType) {
+    switch (format) {
+        case PixelFormat::R8:
+            glFormat = GL_RED;
+            glType = GL_UNSIGNED_BYTE;
+            break;
+        case PixelFormat::BGR5A1:
+            glFormat = GL_BGRA;
+            glType = GL_UNSIGNED_SHORT_1_5_5_5_REV;
+            break;
+        case PixelFormat::R5G6B5:
+            glFormat = GL_RGB;
+            glType = GL_UNSIGNED_SHORT_5_6_5;
+            break;
+        case PixelFormat::BGR8:
+            glFormat = GL_BGR;
+            glType = GL_UNSIGNED_BYTE;
+            break;
+        case PixelFormat::BGRA8:
+            glFormat = GL_BGRA;
+            glType = GL_UNSIGNED_BYTE;
+            break;
+    }
+}
+
+TextureLoader::TextureLoader(const std::size_t stagingSize, const std::size_t uploadBudget)
+    : stagingSize(stagingSize), uploadBudget(uploadBudget) {
+}
+
+TextureLoader::~TextureLoader() {
+    // Jobs still decoding write into the assets
+    for (const auto& job : decodeJobs) {
+        waitForJob(job);
+    }
+}
+
+void TextureLoader::load(const std::string& path, GLuint* textureID, const TextureFilter filter,
+                         const glm::u8vec3& placeholder, TextureBaker baker) {
+    queue({path}, GL_TEXTURE_2D, textureID, filter, placeholder, std::move(baker), TextureCompression::None);
+}
+
+void TextureLoader::loadArray(const std::vector<std::string>& paths, GLuint* textureID, const TextureFilter filter,
+                              const glm::u8vec3& placeholder, const TextureCompression compression) {
+    queue(paths, GL_TEXTURE_2D_ARRAY, textureID, filter, placeholder, nullptr, compression);
+}
+
+void TextureLoader::setCacheDirectory(const std::string& directory) {
+    cacheDirectory = directory;
+}
+
+void TextureLoader::queue(const std::vector<std::string>& paths, const GLenum target, GLuint* textureID,
+                          const TextureFilter filter, const glm::u8vec3& placeholder, TextureBaker baker,
+                          TextureCompression compression) {
+    // Compressed levels always include the mip chain, and BC1 is an extension rather than core
+    if (filter != TextureFilter::Trilinear || !compressionSupported(compression)) {
+        compression = TextureCompression::None;
+    }
+
+    // Placeholder texture, usable straight away
+    glGenTextures(1, textureID);
+    glBindTexture(target, *textureID);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    if (target == GL_TEXTURE_2D_ARRAY) {
+        const std::vector<glm::u8vec3> layers(paths.size(), placeholder);
+        glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGB, 1, 1, static_cast<GLsizei>(paths.size()), 0, GL_BGR,
+                     GL_UNSIGNED_BYTE, &layers[0]);
+    } else {
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, 1, 1, 0, GL_BGR, GL_UNSIGNED_BYTE, &placeholder[0]);
+    }
+    glTexParameteri(target, GL_TEXTURE_MAX_LEVEL, 0);
+
+    if (filter == TextureFilter::Point) {
+        // Clamp to edge makes obtaining values outside [0, 1] to repeat the edge value
+        glTexParameteri(target, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(target, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        // No interpolation
+        glTexParameteri(target, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(target, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    } else {
+        // Repeat texture
+        glTexParameteri(target, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(target, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        // Trilinear interpolation
+        glTexParameteri(target, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(target, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    }
+    glBindTexture(target, 0);
+
+    auto asset = std::make_unique<Asset>();
+    asset->paths = paths;
+    for (const auto& path : paths) {
+        asset->name += (asset->name.empty() ? "" : ", ") + path;
+    }
+    asset->target = target;
+    asset->textureID = textureID;
+    asset->filter = filter;
+    asset->baker = std::move(baker);
+    asset->compression = compression;
+    asset->queuedAt = Clock::now();
+
+    decodeJobs.push_back(submitJob([this, decoding = asset.get()] {
+        decode(*decoding);
+        std::lock_guard<std::mutex> lock(mutex);
+        readyQueue.push_back(decoding);
+        workAvailable.notify_all();
+    }, {}, JobPriority::Background));
+
+    assets.push_back(std::move(asset));
+    pendingUploads++;
+}
+
+void TextureLoader::decode(Asset& asset) const {
+    asset.decodeStartedAt = Clock::now();
+    if (asset.compression != TextureCompression::None) {
+        if (decodeCompressed(asset)) {
+            return;
+        }
+        // Formats the encoders do not take are uploaded as they are
+        asset.compression = TextureCompression::None;
+    }
+
+    // Layers decode in parallel
+    asset.layers.resize(asset.paths.size());
+    std::vector<char> layersDecoded(asset.paths.size(), 0);
+    parallelFor(0, asset.paths.size(), [&](const std::size_t begin, const std::size_t end) {
+        for (std::size_t i = begin; i < end; i++) {
+            PROFILE_SCOPE("decodeBMP");
+            layersDecoded[i] = openBMP(asset.paths[i].c_str(), asset.layers[i].image);
+        }
+    });
+    asset.decoded = std::all_of(layersDecoded.begin(), layersDecoded.end(), [](const char decoded) {
+        return decoded != 0;
+    });
+
+    // Layers of an array share one size & format
+    const ImageView& first = asset.layers.front().image.view;
+    for (std::size_t i = 1; i < asset.layers.size() && asset.decoded; i++) {
+        const ImageView& view = asset.layers[i].image.view;
+        if (view.width != first.width || view.height != first.height || view.format != first.format) {
+            std::cerr << asset.paths[i] << " does not match the size & format of " << asset.paths[0] << std::endl;
+            asset.decoded = false;
+        }
+    }
+    asset.decodedAt = Clock::now();
+
+    // Baked textures replace the image entirely
+    if (asset.baker) {
+        PROFILE_SCOPE("bakeTexture");
+        asset.decoded = asset.decoded && asset.baker(first, asset.baked);
+        asset.layers.clear();
+        asset.mipsBuiltAt = Clock::now();
+        return;
+    }
+
+    // Point textures never sample below level 0; other formats fall back to glGenerateMipmap
+    const int channels = mipChannels(first.format);
+    if (asset.decoded && asset.filter == TextureFilter::Trilinear && channels > 0) {
+        parallelFor(0, asset.layers.size(), [&](const std::size_t begin, const std::size_t end) {
+            for (std::size_t i = begin; i < end; i++) {
+                PROFILE_SCOPE("buildMips");
+                asset.layers[i].mips = buildMipChain(asset.layers[i].image.view, channels);
+            }
+        });
+    }
+    asset.mipsBuiltAt = Clock::now();
+}
+
+bool TextureLoader::decodeCompressed(Asset& asset) const {
+    PROFILE_SCOPE("compressTexture");
+    asset.compressed.resize(asset.paths.size());
+    std::vector<char> layersLoaded(asset.paths.size(), 0);
+    parallelFor(0, asset.paths.size(), [&](const std::size_t begin, const std::size_t end) {
+        for (std::size_t i = begin; i < end; i++) {
+            layersLoaded[i] = loadCompressedTexture(asset.paths[i], asset.compression, cacheDirectory,
+                                                    asset.compressed[i]);
+        }
+    });
+    if (std::find(layersLoaded.begin(), layersLoaded.end(), 0) != layersLoaded.end()) {
+        asset.compressed.clear();
+        return false;
+    }
+
+    // Layers of an array share one size
+    const CompressedLevel& first = asset.compressed.front().levels.front();
+    for (std::size_t i = 1; i < asset.compressed.size(); i++) {
+        const CompressedLevel& level = asset.compressed[i].levels.front();
+        if (level.width != first.width || level.height != first.height) {
+            std::cerr << asset.paths[i] << " does not match the size of " << asset.paths[0] << std::endl;
+            asset.compressed.clear();
+            return false;
+        }
+    }
+    asset.decoded = true;
+    asset.decodedAt = Clock::now();
+    asset.mipsBuiltAt = asset.decodedAt;
+    return true;
+}
+
+void TextureLoader::update() {
+    if (pendingUploads == 0) {
+        return;
+    }
+    PROFILE_SCOPE("textureLoader.update");
+    retireStaging(false);
+
+    std::size_t uploaded = 0;
+    while (uploaded < uploadBudget) {
+        Asset* asset;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (readyQueue.empty()) {
+                break;
+            }
+            asset = readyQueue.front();
+        }
+
+        std::size_t size = asset->baked.pixels.size();
+        for (const auto& layer : asset->layers) {
+            size += layer.image.view.byteSize();
+        }
+        for (const auto& texture : asset->compressed) {
+            for (const auto& level : texture.levels) {
+                size += level.blocks.size();
+            }
+        }
+        // Only the first upload of a frame may exceed the budget, so a large asset still gets through
+        if (uploaded > 0 && uploaded + size > uploadBudget) {
+            break;
+        }
+        // Out of staging space, try again next frame once the GPU has consumed earlier uploads
+        if (!upload(*asset)) {
+            break;
+        }
+        uploaded += size;
+
+        std::lock_guard<std::mutex> lock(mutex);
+        readyQueue.pop_front();
+        pendingUploads--;
+    }
+}
+
+void TextureLoader::finish() {
+    while (pendingUploads > 0) {
+        Asset* asset;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            workAvailable.wait(lock, [this] { return !readyQueue.empty(); });
+            asset = readyQueue.front();
+        }
+
+        while (!upload(*asset)) {
+            retireStaging(true);
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+        readyQueue.pop_front();
+        pendingUploads--;
+    }
+}
+
+bool TextureLoader::isIdle() const {
+    return pendingUploads == 0;
+}
+
+void TextureLoader::shutdown() {
+    retireStaging(true);
+    for (const auto& range : stagingInFlight) {
+        glDeleteSync(range.fence);
+    }
+    stagingInFlight.clear();
+    stagingUsed = 0;
+
+    if (stagingBuffer != 0) {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, stagingBuffer);
+        glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        glDeleteBuffers(1, &stagingBuffer);
+        stagingBuffer = 0;
+        stagingMapping = nullptr;
+    }
+}
+
+bool TextureLoader::upload(Asset& asset) {
+    PROFILE_GPU_SCOPE("uploadTexture");
+    const Clock::time_point uploadStartedAt = Clock::now();
+    if (!asset.decoded) {
+        // Keep the placeholder
+        std::cerr << "Failed to load " + asset.name << std::endl;
+        return true;
+    }
+
+    // Every level of every layer as bottom-up rows padded to 4 bytes, either baked or viewed in the mapped file,
+    // or as blocks
+    const bool compressed = asset.compression != TextureCompression::None;
+    GLint internalFormat = GL_RGB;
+    GLenum format = GL_RGB;
+    GLenum type = GL_UNSIGNED_BYTE;
+    std::vector<std::vector<UploadLevel>> layers;
+    if (asset.baker) {
+        const BakedTexture& baked = asset.baked;
+        internalFormat = baked.internalFormat;
+        format = baked.format;
+        type = baked.type;
+        const std::size_t stride = baked.pixels.size() / baked.height;
+        const unsigned char* pixels = baked.pixels.data();
+        layers.push_back({{baked.width, baked.height, stride, baked.pixels.size(), pixels,
+                           [pixels, stride](const int y) { return pixels + y * stride; }}});
+    } else if (compressed) {
+        internalFormat = static_cast<GLint>(compressedInternalFormat(asset.compression));
+        for (const auto& texture : asset.compressed) {
+            std::vector<UploadLevel> levels;
+            for (const auto& level : texture.levels) {
+                levels.push_back({level.width, level.height, 0, level.blocks.size(), level.blocks.data(), nullptr});
+            }
+            layers.push_back(std::move(levels));
+        }
+    } else {
+        pixelTransferFormat(asset.layers.front().image.view.format, format, type);
+        for (const auto& layer : asset.layers) {
+            const ImageView& view = layer.image.view;
+            std::vector<UploadLevel> levels;
+            levels.push_back({view.width, view.height, view.stride, view.stride * view.height,
+                              view.topDown ? nullptr : view.pixels, [&view](const int y) { return view.row(y); }});
+            for (const auto& mip : layer.mips) {
+                levels.push_back({mip.width, mip.height, mip.stride, mip.pixels.size(), mip.pixels.data(),
+                                  mip.rows()});
+            }
+            layers.push_back(std::move(levels));
+        }
+    }
+
+    std::size_t totalSize = 0;
+    for (const auto& levels : layers) {
+        for (const auto& level : levels) {
+            totalSize += level.size;
+        }
+    }
+
+    // Stage every level first, so the texture switches from placeholder to complete in one go
+    if (stagingBuffer == 0 && GLEW_ARB_buffer_storage) {
+        glGenBuffers(1, &stagingBuffer);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, stagingBuffer);
+        const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glBufferStorage(GL_PIXEL_UNPACK_BUFFER, static_cast<GLsizeiptr>(stagingSize), nullptr, flags);
+        stagingMapping = static_cast<unsigned char*>(
+            glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, static_cast<GLsizeiptr>(stagingSize), flags));
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    }
+
+    GLuint unpackBuffer = 0;
+    unsigned char* staging = nullptr;
+    std::size_t offset = 0;
+    if (stagingMapping != nullptr && totalSize <= stagingSize) {
+        if (!allocateStaging(totalSize, offset)) {
+            return false;
+        }
+        unpackBuffer = stagingBuffer;
+        staging = stagingMapping + offset;
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, unpackBuffer);
+    } else if (stagingMapping == nullptr) {
+        // No persistent mapping: a one-off orphaned buffer per texture
+        glGenBuffers(1, &unpackBuffer);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, unpackBuffer);
+        glBufferData(GL_PIXEL_UNPACK_BUFFER, static_cast<GLsizeiptr>(totalSize), nullptr, GL_STREAM_DRAW);
+        staging = static_cast<unsigned char*>(glMapBufferRange(
+            GL_PIXEL_UNPACK_BUFFER, 0, static_cast<GLsizeiptr>(totalSize),
+            GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT));
+    }
+    // Otherwise the texture is larger than the whole ring, upload straight from client memory
+
+    glBindTexture(asset.target, *asset.textureID);
+    // Rows are padded to 4 bytes, which is exactly an unpack alignment of 4
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+    // Storage for every level, shared by all layers; nothing is read from the unpack buffer
+    const std::vector<UploadLevel>& shape = layers.front();
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    for (std::size_t i = 0; i < shape.size(); i++) {
+        const auto levelIndex = static_cast<GLint>(i);
+        if (compressed) {
+            const auto layerCount = static_cast<GLsizei>(layers.size());
+            const auto size = static_cast<GLsizei>(shape[i].size);
+            if (asset.target == GL_TEXTURE_2D_ARRAY) {
+                glCompressedTexImage3D(GL_TEXTURE_2D_ARRAY, levelIndex, static_cast<GLenum>(internalFormat),
+                                       shape[i].width, shape[i].height, layerCount, 0, size * layerCount, nullptr);
+            } else {
+                glCompressedTexImage2D(GL_TEXTURE_2D, levelIndex, static_cast<GLenum>(internalFormat), shape[i].width,
+                                       shape[i].height, 0, size, nullptr);
+            }
+        } else if (asset.target == GL_TEXTURE_2D_ARRAY) {
+            glTexImage3D(GL_TEXTURE_2D_ARRAY, levelIndex, internalFormat, shape[i].width, shape[i].height,
+                         static_cast<GLsizei>(layers.size()), 0, format, type, nullptr);
+        } else {
+            glTexImage2D(GL_TEXTURE_2D, levelIndex, internalFormat, shape[i].width, shape[i].height, 0, format, type,
+                         nullptr);
+        }
+    }
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, unpackBuffer);
+
+    // Rows [y, y + rows) of one level of one layer; blocks are always sent whole
+    const auto subImage = [&asset, &layers, compressed, internalFormat, format, type](
+            const GLint level, const GLint layer, const GLint y, const GLsizei width, const GLsizei rows,
+            const void* pixels) {
+        if (compressed) {
+            const auto size = static_cast<GLsizei>(layers[layer][level].size);
+            if (asset.target == GL_TEXTURE_2D_ARRAY) {
+                glCompressedTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, 0, 0, layer, width, rows, 1,
+                                          static_cast<GLenum>(internalFormat), size, pixels);
+            } else {
+                glCompressedTexSubImage2D(GL_TEXTURE_2D, level, 0, 0, width, rows, static_cast<GLenum>(internalFormat),
+                                          size, pixels);
+            }
+        } else if (asset.target == GL_TEXTURE_2D_ARRAY) {
+            glTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, 0, y, layer, width, rows, 1, format, type, pixels);
+        } else {
+            glTexSubImage2D(GL_TEXTURE_2D, level, 0, y, width, rows, format, type, pixels);
+        }
+    };
+
+    if (staging != nullptr) {
+        // Copy rows bottom-up, which also flips top-down images
+        unsigned char* destination = staging;
+        for (const auto& levels : layers) {
+            for (const auto& level : levels) {
+                if (!level.row) {
+                    std::memcpy(destination, level.contiguous, level.size);
+                    destination += level.size;
+                    continue;
+                }
+                for (int y = 0; y < level.height; y++) {
+                    std::memcpy(destination, level.row(y), level.stride);
+                    destination += level.stride;
+                }
+            }
+        }
+        if (unpackBuffer != stagingBuffer) {
+            glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+            offset = 0;
+        }
+
+        for (std::size_t layer = 0; layer < layers.size(); layer++) {
+            for (std::size_t i = 0; i < layers[layer].size(); i++) {
+                const UploadLevel& level = layers[layer][i];
+                subImage(static_cast<GLint>(i), static_cast<GLint>(layer), 0, level.width, level.height,
+                         reinterpret_cast<const void*>(offset));
+                offset += level.size;
+            }
+        }
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+        if (unpackBuffer == stagingBuffer) {
+            stagingInFlight.back().fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        } else {
+            glDeleteBuffers(1, &unpackBuffer);
+        }
+    } else {
+        for (std::size_t layer = 0; layer < layers.size(); layer++) {
+            for (std::size_t i = 0; i < layers[layer].size(); i++) {
+                const UploadLevel& level = layers[layer][i];
+                const auto levelIndex = static_cast<GLint>(i);
+                const auto layerIndex = static_cast<GLint>(layer);
+                if (level.contiguous != nullptr) {
+                    subImage(levelIndex, layerIndex, 0, level.width, level.height, level.contiguous);
+                    continue;
+                }
+                // Flip top-down images row by row, still without an intermediate copy
+                for (int y = 0; y < level.height; y++) {
+                    subImage(levelIndex, layerIndex, y, level.width, 1, level.row(y));
+                }
+            }
+        }
+    }
+
+    if (asset.filter == TextureFilter::Trilinear) {
+        if (shape.size() == 1) {
+            // Formats without a CPU downsampler
+            glTexParameteri(asset.target, GL_TEXTURE_MAX_LEVEL, 1000);
+            glGenerateMipmap(asset.target);
+        } else {
+            glTexParameteri(asset.target, GL_TEXTURE_MAX_LEVEL, static_cast<GLint>(shape.size() - 1));
+        }
+    }
+
+    // Single channel images are greyscale
+    if (!asset.baker && !compressed && asset.layers.front().image.view.format == PixelFormat::R8) {
+        glTexParameteri(asset.target, GL_TEXTURE_SWIZZLE_G, GL_RED);
+        glTexParameteri(asset.target, GL_TEXTURE_SWIZZLE_B, GL_RED);
+    }
+    glBindTexture(asset.target, 0);
+
+    const Clock::time_point uploadedAt = Clock::now();
+    std::cout << std::fixed << std::setprecision(2) << "Loaded " << asset.name << ": ";
+    if (compressed) {
+        const bool cached = std::all_of(asset.compressed.begin(), asset.compressed.end(),
+                                        [](const CompressedTexture& texture) { return texture.cached; });
+        std::cout << compressionName(asset.compression) << (cached ? " from cache " : " encode ")
+                  << millisecondsBetween(asset.decodeStartedAt, asset.decodedAt) << " ms";
+    } else {
+        std::cout << "decode " << millisecondsBetween(asset.decodeStartedAt, asset.decodedAt) << " ms"
+                  << ", " << (asset.baker ? "bake " : "mips ")
+                  << millisecondsBetween(asset.decodedAt, asset.mipsBuiltAt) << " ms";
+    }
+    std::cout << ", queued " << millisecondsBetween(asset.queuedAt, asset.decodeStartedAt) +
+                                    millisecondsBetween(asset.mipsBuiltAt, uploadStartedAt) << " ms"
+              << ", upload " << millisecondsBetween(uploadStartedAt, uploadedAt) << " ms"
+              << ", total " << millisecondsBetween(asset.queuedAt, uploadedAt) << " ms" << std::endl;
+
+    // The mapped file and generated levels are no longer needed
+    asset.layers.clear();
+    asset.layers.shrink_to_fit();
+    asset.compressed.clear();
+    asset.compressed.shrink_to_fit();
+    asset.baked = BakedTexture();
+    return true;
+}
+
+bool TextureLoader::allocateStaging(const std::size_t size, std::size_t& offset) {
+    retireStaging(false);
+
+    const std::size_t alignedSize = (size + stagingAlignment - 1) / stagingAlignment * stagingAlignment;
+    if (stagingInFlight.empty()) {
+        offset = 0;
+    } else {
+        // Free space is [head, oldest) when wrapped, [head, end) + [0, oldest) otherwise. A head back at oldest is
+        // a wrapped, full ring unless nothing is in use.
+        const std::size_t oldest = stagingInFlight.front().begin;
+        const std::size_t head = stagingInFlight.back().end;
+        const bool wrapped = head < oldest || (head == oldest && stagingUsed > 0);
+        if (!wrapped && head + alignedSize <= stagingSize) {
+            offset = head;
+        } else if (!wrapped && alignedSize <= oldest) {
+            offset = 0;
+        } else if (wrapped && head + alignedSize <= oldest) {
+            offset = head;
+        } else {
+            return false;
+        }
+    }
+
+    stagingInFlight.push_back({offset, std::min(offset + alignedSize, stagingSize), nullptr});
+    stagingUsed += stagingInFlight.back().end - offset;
+    return true;
+}
+
+void TextureLoader::retireStaging(const bool wait) {
+    while (!stagingInFlight.empty()) {
+        const GLsync fence = stagingInFlight.front().fence;
+        const GLenum status = glClientWaitSync(fence, wait ? GL_SYNC_FLUSH_COMMANDS_BIT : 0, wait ? fenceTimeout : 0);
+        if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) {
+            return;
+        }
+        glDeleteSync(fence);
+        stagingUsed -= stagingInFlight.front().end - stagingInFlight.front().begin;
+        stagingInFlight.pop_front();
+    }
+}
@@ -0,0 +1,125 @@
+#ifndef TEXTURE_LOADER_HPP
+#define TEXTURE_LOADER_HPP
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <GL/glew.h>
+#include <glm/gtc/type_precision.hpp>
+
+#include "block_compression.hpp"
+#include "bmp.hpp"
+#include "job_system.hpp"
+
+// OpenGL client format & type matching a pixel layout
+void pixelTransferFormat(PixelFormat format, GLenum& glFormat, GLenum& glType);
+
+// Sampling set up for a loaded texture
+enum class TextureFilter {
+    Point, // Nearest, clamped to edge, no mipmaps sampled
+    Trilinear // Mipmapped, repeated
+};
+
+// Texture data produced from a decoded image instead of the image itself
+struct BakedTexture {
+    int width = 0;
+    int height = 0;
+    GLint internalFormat = GL_RGB;
+    GLenum format = GL_RGB;
+    GLenum type = GL_UNSIGNED_BYTE;
+    // Rows bottom-up, each padded to 4 bytes
+    std::vector<unsigned char> pixels;
+};
+
+// Runs on a job system worker after decoding, returns false if the image cannot be baked
+using TextureBaker = std::function<bool(const ImageView& image, BakedTexture& baked)>;
+
+// Loads BMP textures & texture arrays asynchronously.
+// Background jobs decode and build mip chains, block compressing them on request; the GL thread streams the
+// results through pixel-unpack buffers in update(). Until then every texture holds a 1x1 placeholder.
+class TextureLoader {
+public:
+    // stagingSize bytes of persistently mapped pixel-unpack buffer are shared by all uploads
+    explicit TextureLoader(std::size_t stagingSize = 64 * 1024 * 1024,
+                           std::size_t uploadBudget = 32 * 1024 * 1024);
+    ~TextureLoader();
+
+    TextureLoader(const TextureLoader&) = delete;
+    TextureLoader& operator=(const TextureLoader&) = delete;
+
+    // Creates *textureID holding a placeholder colour (BGR) and queues the file for decoding. GL thread only.
+    // With a baker, the texture holds whatever it produces from the decoded image.
+    void load(const std::string& path, GLuint* textureID, TextureFilter filter, const glm::u8vec3& placeholder,
+              TextureBaker baker = nullptr);
+
+    // Creates *textureID as a GL_TEXTURE_2D_ARRAY with one layer per file, all holding the placeholder colour,
+    // and queues the files. The layers must share size & format; they replace the placeholder together.
+    // Trilinear arrays of 24 or 32 bpp files can be block compressed, mips included; other files, or a format
+    // the driver lacks, fall back to uncompressed.
+    void loadArray(const std::vector<std::string>& paths, GLuint* textureID, TextureFilter filter,
+                   const glm::u8vec3& placeholder, TextureCompression compression = TextureCompression::None);
+
+    // Where block compressed textures are cached across runs, none if empty. Call before loading.
+    void setCacheDirectory(const std::string& directory);
+
+    // Uploads decoded textures, at most uploadBudget bytes per call unless one texture is larger.
+    // Call once per frame on the GL thread.
+    void update();
+
+    // Blocks until every queued texture has been uploaded. GL thread only.
+    void finish();
+
+    // Whether every queued texture has been uploaded
+    bool isIdle() const;
+
+    // Releases the staging buffer. Call on the GL thread before the context goes away.
+    void shutdown();
+
+private:
+    struct Asset;
+
+    struct StagingRange {
+        std::size_t begin;
+        std::size_t end;
+        GLsync fence;
+    };
+
+    void queue(const std::vector<std::string>& paths, GLenum target, GLuint* textureID, TextureFilter filter,
+               const glm::u8vec3& placeholder, TextureBaker baker, TextureCompression compression);
+    void decode(Asset& asset) const;
+    bool decodeCompressed(Asset& asset) const;
+
+    bool upload(Asset& asset);
+    bool allocateStaging(std::size_t size, std::size_t& offset);
+    void retireStaging(bool wait);
+
+    std::size_t stagingSize;
+    std::size_t uploadBudget;
+    std::string cacheDirectory;
+
+    // Assets are owned here and only touched by one side at a time, handed over through the queues
+    std::vector<std::unique_ptr<Asset>> assets;
+    std::size_t pendingUploads = 0;
+
+    // One background job per asset, each handing it over through readyQueue
+    std::vector<JobHandle> decodeJobs;
+
+    mutable std::mutex mutex;
+    std::condition_variable workAvailable;
+    std::deque<Asset*> readyQueue;
+
+    // Staging ring, persistently mapped when ARB_buffer_storage is available
+    GLuint stagingBuffer = 0;
+    unsigned char* stagingMapping = nullptr;
+    std::deque<StagingRange> stagingInFlight;
+    // Bytes held by stagingInFlight: tells a full ring from an empty one when its head meets its oldest range
+    std::size_t stagingUsed = 0;
+};
+
+#endif
@@ -0,0 +1,316 @@
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+#include <glm/glm.hpp>
+
+#include "profiler.hpp"
+#include "tile_streamer.hpp"
+
+// Tiles of a tilesX x tilesY map nearer than radius tiles to one of its corners
+static int tilesNearCorner(const int tilesX, const int tilesY, const int radius) {
+    int count = 0;
+    for (int x = 0; x < std::min(tilesX, radius); x++) {
+        for (int y = 0; y < tilesY && x * x + y * y < radius * radius; y++) {
+            count++;
+        }
+    }
+    return count;
+}
+
+TileStreamer::TileStreamer(const TileStreamerSettings& settings) : settings(settings) {
+    this->settings.memoryTiles = std::max<std::size_t>(1, settings.memoryTiles);
+    this->settings.gpuTiles = std::max(1, settings.gpuTiles);
+    this->settings.uploadsPerFrame = std::max(1, settings.uploadsPerFrame);
+}
+
+TileStreamer::~TileStreamer() {
+    stopLoader();
+}
+
+bool TileStreamer::open(const std::string& path, const float cells, GLuint* overviewTextureID,
+                        HeightField& overviewMinimums, HeightField& overviewMaximums) {
+    PROFILE_SCOPE("openTiledHeightMap");
+    if (!map.open(path)) {
+        return false;
+    }
+
+    // The overview stands in for the whole map: baked & sampled like a height map texture of its own size
+    const HeightField overview = map.overview();
+    map.overviewBounds(overviewMinimums, overviewMaximums);
+    std::vector<glm::vec3> baked(overview.heights.size());
+    bakeTerrain(overview, cells, baked.data());
+    glGenTextures(1, overviewTextureID);
+    glBindTexture(GL_TEXTURE_2D, *overviewTextureID);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB32F, overview.width, overview.height, 0, GL_RGB, GL_FLOAT, baked.data());
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+
+    // The overview kernel spans width / cells texels of the map per tap, tile kernels one: on a locally linear
+    // surface their gradients differ by that factor
+    gradientScale = static_cast<float>(map.width()) / cells;
+
+    // Atlas of baked tiles, one per layer
+    const int tileCount = map.tilesX() * map.tilesY();
+    const int tileSize = map.tileSize();
+    slots.assign(std::min(settings.gpuTiles, tileCount), Slot());
+    tileSlots.clear();
+    tileSlots.reserve(slots.size());
+    // Tiles beyond searchRadius of the camera's are at least that far from it. Once even a camera in a corner of the
+    // map, where the fewest are, has a whole atlas of tiles nearer than that, the nearest ones are never beyond it.
+    searchRadius = 1;
+    while (tilesNearCorner(map.tilesX(), map.tilesY(), searchRadius) < static_cast<int>(slots.size())) {
+        searchRadius++;
+    }
+    glGenTextures(1, &atlasID);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, atlasID);
+    glTexStorage3D(GL_TEXTURE_2D_ARRAY, 1, GL_RGB32F, tileSize, tileSize, static_cast<GLsizei>(slots.size()));
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+    // Indirection table, every tile missing; filled a row at a time so no copy of it is kept in RAM
+    const std::vector<GLshort> missingRow(map.tilesX(), -1);
+    glGenTextures(1, &tableID);
+    glBindTexture(GL_TEXTURE_2D, tableID);
+    glTexStorage2D(GL_TEXTURE_2D, 1, GL_R16I, map.tilesX(), map.tilesY());
+    for (int y = 0; y < map.tilesY(); y++) {
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, y, map.tilesX(), 1, GL_RED_INTEGER, GL_SHORT, missingRow.data());
+    }
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    const std::size_t tileBytes = static_cast<std::size_t>(tileSize) * tileSize * sizeof(glm::vec3);
+    std::cout << "Streaming " << path << ": " << map.width() << " x " << map.height() << " in " << tileCount
+              << " tiles of " << tileSize << ", overview " << overview.width << " x " << overview.height
+              << ", at most " << settings.memoryTiles * tileBytes / (1024 * 1024) << " MiB in RAM & "
+              << slots.size() * tileBytes / (1024 * 1024) << " MiB in the atlas" << std::endl;
+
+    stopping = false;
+    loader = std::thread(&TileStreamer::loaderLoop, this);
+    return true;
+}
+
+bool TileStreamer::isOpen() const {
+    return map.isOpen();
+}
+
+void TileStreamer::update(const glm::vec2& cameraUV) {
+    if (!map.isOpen()) {
+        return;
+    }
+    PROFILE_SCOPE("tileStreamer.update");
+    frame++;
+
+    // Distance from the camera to the tiles within searchRadius of its own, in tiles. Outside the map, from the
+    // nearest point of the map, so the work stays bounded by the atlas.
+    const glm::vec2 camera = glm::clamp(cameraUV, glm::vec2(0.0f), glm::vec2(1.0f))
+                             * glm::vec2(map.width(), map.height()) / static_cast<float>(map.tileSize());
+    const glm::ivec2 cameraTile = glm::clamp(glm::ivec2(glm::floor(camera)), glm::ivec2(0),
+                                             glm::ivec2(map.tilesX() - 1, map.tilesY() - 1));
+    const glm::ivec2 first = glm::max(cameraTile - searchRadius, glm::ivec2(0));
+    const glm::ivec2 last = glm::min(cameraTile + searchRadius, glm::ivec2(map.tilesX() - 1, map.tilesY() - 1));
+    wanted.clear();
+    for (int y = first.y; y <= last.y; y++) {
+        for (int x = first.x; x <= last.x; x++) {
+            const float dx = std::max(0.0f, std::max(x - camera.x, camera.x - (x + 1)));
+            const float dy = std::max(0.0f, std::max(y - camera.y, camera.y - (y + 1)));
+            wanted.emplace_back(dx * dx + dy * dy, y * map.tilesX() + x);
+        }
+    }
+    // As many as the atlas holds, nearest first
+    const std::size_t wantedCount = std::min(slots.size(), wanted.size());
+    std::partial_sort(wanted.begin(), wanted.begin() + static_cast<std::ptrdiff_t>(wantedCount), wanted.end());
+
+    std::deque<int> missing;
+    for (std::size_t i = 0; i < wantedCount; i++) {
+        const int tile = wanted[i].second;
+        const auto resident = tileSlots.find(tile);
+        if (resident != tileSlots.end()) {
+            slots[resident->second].lastUsed = frame;
+        } else {
+            missing.push_back(tile);
+        }
+    }
+
+    std::deque<int> pending;
+    int uploads = 0;
+    int evictions = 0;
+    for (const int tile : missing) {
+        const BakedTile baked = findCached(tile);
+        if (baked == nullptr) {
+            pending.push_back(tile);
+            continue;
+        }
+        if (uploads == settings.uploadsPerFrame) {
+            continue;
+        }
+
+        // A free layer, or the least recently used one no wanted tile is in
+        auto slot = std::find_if(slots.begin(), slots.end(), [](const Slot& s) { return s.tile == -1; });
+        if (slot == slots.end()) {
+            slot = std::min_element(slots.begin(), slots.end(), [](const Slot& a, const Slot& b) {
+                return a.lastUsed < b.lastUsed;
+            });
+            tileSlots.erase(slot->tile);
+            setTableEntry(slot->tile, -1);
+            evictions++;
+        }
+        const auto layer = static_cast<int>(slot - slots.begin());
+        {
+            PROFILE_GPU_SCOPE("uploadHeightTile");
+            glBindTexture(GL_TEXTURE_2D_ARRAY, atlasID);
+            glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+            glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, layer, map.tileSize(), map.tileSize(), 1, GL_RGB, GL_FLOAT,
+                            baked->data());
+            glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+        }
+        *slot = {tile, frame};
+        tileSlots[tile] = layer;
+        setTableEntry(tile, static_cast<GLshort>(layer));
+        uploads++;
+    }
+
+    const int resident = static_cast<int>(std::count_if(slots.begin(), slots.end(),
+                                                        [](const Slot& s) { return s.tile != -1; }));
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        // Requests are replaced every frame, so tiles the camera moved away from are never read
+        requests.clear();
+        for (const int tile : pending) {
+            if (tile != loadingTile) {
+                requests.push_back(tile);
+            }
+        }
+        counters.tilesUploaded += uploads;
+        counters.gpuEvictions += evictions;
+        counters.residentTiles = resident;
+        counters.missingTiles = static_cast<int>(missing.size()) - uploads;
+    }
+    workAvailable.notify_one();
+}
+
+void TileStreamer::bind() const {
+    glActiveTexture(GL_TEXTURE0 + heightTileAtlasUnit);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, atlasID);
+    glActiveTexture(GL_TEXTURE0 + heightTileTableUnit);
+    glBindTexture(GL_TEXTURE_2D, tableID);
+}
+
+glm::vec4 TileStreamer::grid() const {
+    return glm::vec4(map.width(), map.height(), map.tileSize(), 0.0f);
+}
+
+TileStreamerStats TileStreamer::stats() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return counters;
+}
+
+void TileStreamer::close() {
+    stopLoader();
+    glDeleteTextures(1, &atlasID);
+    glDeleteTextures(1, &tableID);
+    atlasID = 0;
+    tableID = 0;
+    slots.clear();
+    tileSlots.clear();
+    requests.clear();
+    recentTiles.clear();
+    cache.clear();
+    map = TiledHeightMap();
+}
+
+void TileStreamer::stopLoader() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    workAvailable.notify_all();
+    if (loader.joinable()) {
+        loader.join();
+    }
+}
+
+void TileStreamer::loaderLoop() {
+    PROFILE_THREAD("tile loader");
+    std::vector<float> heights;
+    while (true) {
+        int tile;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            workAvailable.wait(lock, [this] { return stopping || !requests.empty(); });
+            if (stopping) {
+                return;
+            }
+            tile = requests.front();
+            requests.pop_front();
+            if (cache.count(tile) != 0) {
+                continue;
+            }
+            loadingTile = tile;
+        }
+
+        BakedTile baked = bakeTile(tile, heights);
+
+        std::lock_guard<std::mutex> lock(mutex);
+        loadingTile = -1;
+        counters.tilesRead++;
+        recentTiles.push_front(tile);
+        cache[tile] = {std::move(baked), recentTiles.begin()};
+        while (cache.size() > settings.memoryTiles) {
+            cache.erase(recentTiles.back());
+            recentTiles.pop_back();
+            counters.memoryEvictions++;
+        }
+    }
+}
+
+TileStreamer::BakedTile TileStreamer::bakeTile(const int tile, std::vector<float>& heights) const {
+    PROFILE_SCOPE("bakeHeightTile");
+    map.readTile(tile % map.tilesX(), tile / map.tilesX(), heights);
+
+    // With nPoints equal to its size, every tap of the kernel is its direction in texels, within the border
+    HeightField field;
+    field.width = map.paddedTileSize();
+    field.height = map.paddedTileSize();
+    field.heights.swap(heights);
+    std::vector<glm::vec3> padded(field.heights.size());
+    bakeTerrain(field, static_cast<float>(field.width), padded.data());
+    heights.swap(field.heights);
+
+    // Keep the interior
+    const int size = map.tileSize();
+    auto baked = std::make_shared<std::vector<glm::vec3>>(static_cast<std::size_t>(size) * size);
+    for (int y = 0; y < size; y++) {
+        const glm::vec3* source = &padded[static_cast<std::size_t>(y + tileBorder) * field.width + tileBorder];
+        glm::vec3* destination = &(*baked)[static_cast<std::size_t>(y) * size];
+        for (int x = 0; x < size; x++) {
+            destination[x] = glm::vec3(source[x].x, source[x].y * gradientScale, source[x].z * gradientScale);
+        }
+    }
+    return baked;
+}
+
+TileStreamer::BakedTile TileStreamer::findCached(const int tile) {
+    std::lock_guard<std::mutex> lock(mutex);
+    const auto cached = cache.find(tile);
+    if (cached == cache.end()) {
+        return nullptr;
+    }
+    recentTiles.splice(recentTiles.begin(), recentTiles, cached->second.recent);
+    return cached->second.baked;
+}
+
+void TileStreamer::setTableEntry(const int tile, const GLshort layer) const {
+    glBindTexture(GL_TEXTURE_2D, tableID);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, tile % map.tilesX(), tile / map.tilesX(), 1, 1, GL_RED_INTEGER, GL_SHORT,
+                    &layer);
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
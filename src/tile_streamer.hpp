@@ -0,0 +1,130 @@
+#ifndef TILE_STREAMER_HPP
+#define TILE_STREAMER_HPP
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <GL/glew.h>
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+
+#include "terrain_bake.hpp"
+#include "tiled_height_map.hpp"
+
+// Texture units of the tile atlas & indirection table, as bound in main.vert
+static constexpr GLuint heightTileAtlasUnit = 4;
+static constexpr GLuint heightTileTableUnit = 5;
+
+// Bounds of the memory a TileStreamer keeps resident
+struct TileStreamerSettings {
+    // Baked tiles cached in RAM, least recently used first out
+    std::size_t memoryTiles = 96;
+    // Layers of the GPU atlas, i.e. most tiles drawn at full resolution at once
+    int gpuTiles = 64;
+    // Tiles uploaded to the atlas per update
+    int uploadsPerFrame = 4;
+};
+
+struct TileStreamerStats {
+    std::size_t tilesRead = 0;
+    std::size_t tilesUploaded = 0;
+    std::size_t memoryEvictions = 0;
+    std::size_t gpuEvictions = 0;
+    // Tiles in the atlas, and the wanted ones still missing after the last update
+    int residentTiles = 0;
+    int missingTiles = 0;
+};
+
+// Streams a tiled height map (.hmt) around the camera at full resolution.
+// The map's overview is baked up front into an ordinary height map texture. A loader thread reads and bakes the
+// tiles nearest to the camera into an LRU cache in RAM; update() copies them into layers of a GL_TEXTURE_2D_ARRAY
+// atlas, itself recycled least recently used first. An indirection table of one texel per tile holds its atlas
+// layer, or -1 where main.vert falls back to the overview.
+class TileStreamer {
+public:
+    explicit TileStreamer(const TileStreamerSettings& settings = TileStreamerSettings());
+    ~TileStreamer();
+
+    TileStreamer(const TileStreamer&) = delete;
+    TileStreamer& operator=(const TileStreamer&) = delete;
+
+    // Maps the file, bakes its overview into *overviewTextureID (RGB32F, as loadHeightMapTexture does), reads its
+    // bounds into overviewMinimums & overviewMaximums, creates the atlas & table and starts the loader. cells is the
+    // number of grid cells the normal kernel spans. GL thread only; returns false if the file is not a tiled map.
+    bool open(const std::string& path, float cells, GLuint* overviewTextureID, HeightField& overviewMinimums,
+              HeightField& overviewMaximums);
+    bool isOpen() const;
+
+    // Requests the tiles nearest to cameraUV and uploads up to uploadsPerFrame that are ready. GL thread only.
+    void update(const glm::vec2& cameraUV);
+
+    // Binds the atlas & table to heightTileAtlasUnit & heightTileTableUnit
+    void bind() const;
+
+    // (width, height, tileSize, 0) of the full resolution map, as main.vert indexes the table
+    glm::vec4 grid() const;
+
+    TileStreamerStats stats() const;
+
+    // Stops the loader and deletes the atlas & table. GL thread only.
+    void close();
+
+private:
+    using BakedTile = std::shared_ptr<const std::vector<glm::vec3>>;
+
+    struct Slot {
+        int tile = -1;
+        std::uint64_t lastUsed = 0;
+    };
+
+    struct CachedTile {
+        BakedTile baked;
+        std::list<int>::iterator recent;
+    };
+
+    void stopLoader();
+    void loaderLoop();
+    BakedTile bakeTile(int tile, std::vector<float>& heights) const;
+    BakedTile findCached(int tile);
+    void setTableEntry(int tile, GLshort layer) const;
+
+    TileStreamerSettings settings;
+    TiledHeightMap map;
+    // Gradients of 1 texel tile kernels are scaled by this to match the overview's, see bakeTile
+    float gradientScale = 1.0f;
+
+    // GL thread only
+    GLuint atlasID = 0;
+    GLuint tableID = 0;
+    std::vector<Slot> slots;
+    // Layer of every tile in the atlas
+    std::unordered_map<int, int> tileSlots;
+    // Tiles farther than this from the camera's along x or y are never among the nearest gpuTiles
+    int searchRadius = 0;
+    std::uint64_t frame = 0;
+    std::vector<std::pair<float, int>> wanted;
+
+    // Shared with the loader, under mutex
+    mutable std::mutex mutex;
+    std::condition_variable workAvailable;
+    std::deque<int> requests;
+    int loadingTile = -1;
+    std::list<int> recentTiles;
+    std::unordered_map<int, CachedTile> cache;
+    TileStreamerStats counters;
+    bool stopping = false;
+    std::thread loader;
+};
+
+#endif
@@ -0,0 +1,273 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+
+#include "bmp.hpp"
+#include "parallel.hpp"
+#include "tiled_height_map.hpp"
+
+using Clock = std::chrono::steady_clock;
+
+static constexpr char tiledHeightMapMagic[4] = {'H', 'M', 'T', 'L'};
+static constexpr std::uint32_t tiledHeightMapVersion = 2;
+// Tiles are aligned to this many bytes, the usual page size
+static constexpr std::uint64_t tileAlignment = 4096;
+// Rows per chunk when decoding a band of tiles in parallel
+static constexpr std::size_t minRowsPerChunk = 16;
+
+static std::uint64_t alignUp(const std::uint64_t value, const std::uint64_t alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+// First & last of the size map texels along an axis that overlap overview texel i of overviewSize
+static int firstCovered(const int i, const int size, const int overviewSize) {
+    return static_cast<int>(static_cast<std::int64_t>(i) * size / overviewSize);
+}
+
+static int lastCovered(const int i, const int size, const int overviewSize) {
+    return static_cast<int>((static_cast<std::int64_t>(i + 1) * size - 1) / overviewSize);
+}
+
+bool TiledHeightMap::open(const std::string& path) {
+    file = MappedFile(path.c_str());
+    if (!file.isOpen()) {
+        std::cout << path << " could not be opened. Are you in the right directory?" << std::endl;
+        return false;
+    }
+    if (file.size() < sizeof(header)) {
+        std::cerr << path << " is not a tiled height map" << std::endl;
+        file = MappedFile();
+        return false;
+    }
+    std::memcpy(&header, file.data(), sizeof(header));
+
+    const std::uint64_t padded = header.tileSize + 2 * static_cast<std::uint64_t>(header.tileBorder);
+    const bool valid = std::memcmp(header.magic, tiledHeightMapMagic, sizeof(tiledHeightMapMagic)) == 0 &&
+                       header.version == tiledHeightMapVersion && header.tileBorder == tileBorder &&
+                       header.width > 0 && header.height > 0 && header.tileSize > 0 &&
+                       header.tilesX == (header.width + header.tileSize - 1) / header.tileSize &&
+                       header.tilesY == (header.height + header.tileSize - 1) / header.tileSize &&
+                       header.overviewWidth > 0 && header.overviewHeight > 0 &&
+                       header.overviewOffset + 4ull * header.overviewWidth * header.overviewHeight <=
+                       header.overviewBoundsOffset &&
+                       header.overviewBoundsOffset + 8ull * header.overviewWidth * header.overviewHeight <=
+                       header.tilesOffset &&
+                       header.tileStride >= padded * padded * sizeof(float) &&
+                       header.tilesOffset + header.tileStride * header.tilesX * header.tilesY <= file.size();
+    if (!valid) {
+        std::cerr << path << " is not a valid tiled height map" << std::endl;
+        file = MappedFile();
+        return false;
+    }
+    return true;
+}
+
+bool TiledHeightMap::isOpen() const {
+    return file.isOpen();
+}
+
+int TiledHeightMap::width() const {
+    return static_cast<int>(header.width);
+}
+
+int TiledHeightMap::height() const {
+    return static_cast<int>(header.height);
+}
+
+int TiledHeightMap::tileSize() const {
+    return static_cast<int>(header.tileSize);
+}
+
+int TiledHeightMap::tilesX() const {
+    return static_cast<int>(header.tilesX);
+}
+
+int TiledHeightMap::tilesY() const {
+    return static_cast<int>(header.tilesY);
+}
+
+int TiledHeightMap::paddedTileSize() const {
+    return static_cast<int>(header.tileSize + 2 * header.tileBorder);
+}
+
+HeightField TiledHeightMap::overview() const {
+    HeightField field;
+    field.width = static_cast<int>(header.overviewWidth);
+    field.height = static_cast<int>(header.overviewHeight);
+    field.heights.resize(static_cast<std::size_t>(field.width) * field.height);
+    std::memcpy(field.heights.data(), file.data() + header.overviewOffset, field.heights.size() * sizeof(float));
+    file.evict(header.overviewOffset, field.heights.size() * sizeof(float));
+    return field;
+}
+
+void TiledHeightMap::overviewBounds(HeightField& minimums, HeightField& maximums) const {
+    const std::size_t count = static_cast<std::size_t>(header.overviewWidth) * header.overviewHeight;
+    for (HeightField* field : {&minimums, &maximums}) {
+        field->width = static_cast<int>(header.overviewWidth);
+        field->height = static_cast<int>(header.overviewHeight);
+        field->heights.resize(count);
+    }
+    const unsigned char* bounds = file.data() + header.overviewBoundsOffset;
+    std::memcpy(minimums.heights.data(), bounds, count * sizeof(float));
+    std::memcpy(maximums.heights.data(), bounds + count * sizeof(float), count * sizeof(float));
+    file.evict(header.overviewBoundsOffset, 2 * count * sizeof(float));
+}
+
+void TiledHeightMap::readTile(const int x, const int y, std::vector<float>& heights) const {
+    const std::size_t tile = static_cast<std::size_t>(y) * header.tilesX + x;
+    const std::size_t offset = header.tilesOffset + tile * header.tileStride;
+    const std::size_t count = static_cast<std::size_t>(paddedTileSize()) * paddedTileSize();
+    heights.resize(count);
+    std::memcpy(heights.data(), file.data() + offset, count * sizeof(float));
+    file.evict(offset, header.tileStride);
+}
+
+bool writeTiledHeightMap(const std::string& path, const int width, const int height, const unsigned int tileSize,
+                         const HeightRowSource& readRow) {
+    const Clock::time_point start = Clock::now();
+    const int size = static_cast<int>(tileSize);
+    const int padded = size + 2 * tileBorder;
+    // Every step-th texel of the map, so the overview stays within maxOverviewSize
+    const int step = (std::max(width, height) + maxOverviewSize - 1) / maxOverviewSize;
+
+    TiledHeightMapHeader header{};
+    std::memcpy(header.magic, tiledHeightMapMagic, sizeof(tiledHeightMapMagic));
+    header.version = tiledHeightMapVersion;
+    header.width = static_cast<std::uint32_t>(width);
+    header.height = static_cast<std::uint32_t>(height);
+    header.tileSize = tileSize;
+    header.tileBorder = tileBorder;
+    header.tilesX = static_cast<std::uint32_t>((width + size - 1) / size);
+    header.tilesY = static_cast<std::uint32_t>((height + size - 1) / size);
+    header.overviewWidth = static_cast<std::uint32_t>((width + step - 1) / step);
+    header.overviewHeight = static_cast<std::uint32_t>((height + step - 1) / step);
+    header.overviewOffset = sizeof(header);
+    header.overviewBoundsOffset = header.overviewOffset + 4ull * header.overviewWidth * header.overviewHeight;
+    header.tilesOffset = alignUp(header.overviewBoundsOffset + 8ull * header.overviewWidth * header.overviewHeight,
+                                 tileAlignment);
+    header.tileStride = alignUp(4ull * padded * padded, tileAlignment);
+
+    std::ofstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        std::cerr << "Tiled height map " << path << " could not be written" << std::endl;
+        return false;
+    }
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+    // Overview, one row at a time
+    std::vector<float> row(width);
+    std::vector<float> overviewRow(header.overviewWidth);
+    for (std::uint32_t y = 0; y < header.overviewHeight; y++) {
+        readRow(std::min(static_cast<int>(y) * step + step / 2, height - 1), row.data());
+        for (std::uint32_t x = 0; x < header.overviewWidth; x++) {
+            overviewRow[x] = row[std::min(static_cast<int>(x) * step + step / 2, width - 1)];
+        }
+        file.write(reinterpret_cast<const char*>(overviewRow.data()),
+                   static_cast<std::streamsize>(overviewRow.size() * sizeof(float)));
+    }
+
+    // Bounds of the overview, gathered from the rows as the tiles read them
+    const int overviewWidth = static_cast<int>(header.overviewWidth);
+    const int overviewHeight = static_cast<int>(header.overviewHeight);
+    const std::size_t overviewCount = static_cast<std::size_t>(overviewWidth) * overviewHeight;
+    std::vector<float> bounds(2 * overviewCount);
+    std::fill(bounds.begin(), bounds.begin() + overviewCount, std::numeric_limits<float>::infinity());
+    std::fill(bounds.begin() + overviewCount, bounds.end(), -std::numeric_limits<float>::infinity());
+    std::vector<float> rowMinimums(overviewWidth);
+    std::vector<float> rowMaximums(overviewWidth);
+    const auto addBoundsRow = [&](const int y, const float* heights) {
+        for (int x = 0; x < overviewWidth; x++) {
+            const auto [lowest, highest] = std::minmax_element(heights + firstCovered(x, width, overviewWidth),
+                                                               heights + lastCovered(x, width, overviewWidth) + 1);
+            rowMinimums[x] = *lowest;
+            rowMaximums[x] = *highest;
+        }
+        // A map row overlaps at most the overview rows either side of its own
+        const int centre = firstCovered(y, overviewHeight, height);
+        for (int overviewY = std::max(0, centre - 1); overviewY <= std::min(overviewHeight - 1, centre + 1);
+             overviewY++) {
+            if (y < firstCovered(overviewY, height, overviewHeight) ||
+                y > lastCovered(overviewY, height, overviewHeight)) {
+                continue;
+            }
+            float* minimums = &bounds[static_cast<std::size_t>(overviewY) * overviewWidth];
+            float* maximums = minimums + overviewCount;
+            for (int x = 0; x < overviewWidth; x++) {
+                minimums[x] = std::min(minimums[x], rowMinimums[x]);
+                maximums[x] = std::max(maximums[x], rowMaximums[x]);
+            }
+        }
+    };
+
+    // Tiles, reading one band of padded rows per row of tiles: memory is proportional to the map's width only
+    std::vector<float> band(static_cast<std::size_t>(padded) * width);
+    std::vector<float> tile(static_cast<std::size_t>(padded) * padded);
+    const std::vector<char> padding(header.tileStride - tile.size() * sizeof(float), 0);
+    file.seekp(static_cast<std::streamoff>(header.tilesOffset));
+    for (std::uint32_t tileY = 0; tileY < header.tilesY; tileY++) {
+        const int bandBegin = static_cast<int>(tileY) * size - tileBorder;
+        parallelFor(0, padded, [&](const std::size_t begin, const std::size_t end) {
+            for (std::size_t r = begin; r < end; r++) {
+                const int y = std::clamp(bandBegin + static_cast<int>(r), 0, height - 1);
+                readRow(y, &band[r * width]);
+            }
+        }, minRowsPerChunk);
+        for (int r = tileBorder; r < tileBorder + size && static_cast<int>(tileY) * size + r - tileBorder < height;
+             r++) {
+            addBoundsRow(static_cast<int>(tileY) * size + r - tileBorder, &band[static_cast<std::size_t>(r) * width]);
+        }
+
+        for (std::uint32_t tileX = 0; tileX < header.tilesX; tileX++) {
+            const int columnBegin = static_cast<int>(tileX) * size - tileBorder;
+            for (int r = 0; r < padded; r++) {
+                const float* source = &band[static_cast<std::size_t>(r) * width];
+                float* destination = &tile[static_cast<std::size_t>(r) * padded];
+                for (int c = 0; c < padded; c++) {
+                    destination[c] = source[std::clamp(columnBegin + c, 0, width - 1)];
+                }
+            }
+            file.write(reinterpret_cast<const char*>(tile.data()),
+                       static_cast<std::streamsize>(tile.size() * sizeof(float)));
+            file.write(padding.data(), static_cast<std::streamsize>(padding.size()));
+        }
+    }
+
+    const std::streamoff end = file.tellp();
+    file.seekp(static_cast<std::streamoff>(header.overviewBoundsOffset));
+    file.write(reinterpret_cast<const char*>(bounds.data()),
+               static_cast<std::streamsize>(bounds.size() * sizeof(float)));
+    file.seekp(end);
+
+    if (!file.good()) {
+        std::cerr << "Tiled height map " << path << " could not be written" << std::endl;
+        return false;
+    }
+    const double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    std::cout << std::fixed << std::setprecision(2) << "Wrote " << path << ": " << width << " x " << height
+              << " in " << header.tilesX << " x " << header.tilesY << " tiles of " << tileSize << ", overview "
+              << header.overviewWidth << " x " << header.overviewHeight << ", "
+              << static_cast<double>(file.tellp()) / (1024.0 * 1024.0) << " MiB in " << seconds << " s"
+              << std::endl;
+    return true;
+}
+
+int runMakeTiles(const char* bmpPath, const char* path, const unsigned int tileSize) {
+    BMPImage image;
+    if (!openBMP(bmpPath, image)) {
+        return EXIT_FAILURE;
+    }
+    const ImageView& view = image.view;
+    if (view.format != PixelFormat::BGR8) {
+        std::cerr << "Height maps must be 24 bpp BMPs" << std::endl;
+        return EXIT_FAILURE;
+    }
+    const bool written = writeTiledHeightMap(path, view.width, view.height, tileSize, [&view](const int y, float* row) {
+        decodeHeightRow(view, y, row);
+    });
+    return written ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,90 @@
+#ifndef TILED_HEIGHT_MAP_HPP
+#define TILED_HEIGHT_MAP_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "mapped_file.hpp"
+#include "terrain_bake.hpp"
+
+// Texels every tile repeats from its neighbours on each side, enough for the normal kernel
+static constexpr int tileBorder = 2;
+
+// Range of tile sizes, in texels
+static constexpr unsigned int minTileSize = 16;
+static constexpr unsigned int maxTileSize = 4096;
+
+// Longest side of the overview stored with every tiled height map
+static constexpr int maxOverviewSize = 1024;
+
+// Header of a tiled height map (.hmt), little endian.
+// It is followed by the overview (overviewWidth x overviewHeight floats), from overviewBoundsOffset by the minimum
+// then the maximum of the map's texels each overview texel overlaps (as many floats each) and, from tilesOffset, by
+// tilesX x tilesY tiles row by row from the bottom left, tileStride bytes apart. A tile holds
+// (tileSize + 2 * tileBorder)^2 unscaled float heights; borders repeat the neighbouring texels, or the
+// map's edge, so every tile bakes on its own. Tiles start on page boundaries and the pages of one tile
+// can be dropped without touching its neighbours. All rows are bottom-up, like the textures.
+struct TiledHeightMapHeader {
+    char magic[4];
+    std::uint32_t version;
+    std::uint32_t width;
+    std::uint32_t height;
+    std::uint32_t tileSize;
+    std::uint32_t tileBorder;
+    std::uint32_t tilesX;
+    std::uint32_t tilesY;
+    std::uint32_t overviewWidth;
+    std::uint32_t overviewHeight;
+    std::uint64_t overviewOffset;
+    std::uint64_t overviewBoundsOffset;
+    std::uint64_t tilesOffset;
+    std::uint64_t tileStride;
+};
+
+// Read-only view of a tiled height map through a memory mapping. Reading a tile only faults in its own
+// pages and drops them again, so resident memory does not grow with the size of the map.
+class TiledHeightMap {
+public:
+    // Returns false if the file cannot be mapped or is not a complete tiled height map
+    bool open(const std::string& path);
+    bool isOpen() const;
+
+    int width() const;
+    int height() const;
+    int tileSize() const;
+    int tilesX() const;
+    int tilesY() const;
+    // Texels per side of a stored tile, both borders included
+    int paddedTileSize() const;
+
+    // Point sampled overview of the whole map, at most maxOverviewSize texels per side
+    HeightField overview() const;
+
+    // Fields the size of the overview holding the min & max of the map's texels under each of its texels, so bounds
+    // and queries taken from them never miss a peak or a pit between the overview's samples
+    void overviewBounds(HeightField& minimums, HeightField& maximums) const;
+
+    // Copies tile (x, y) with its borders into heights, then drops its pages. Safe from any thread.
+    void readTile(int x, int y, std::vector<float>& heights) const;
+
+private:
+    MappedFile file;
+    TiledHeightMapHeader header{};
+};
+
+// Writes row y (from the bottom) of a height map into width floats. Called from several threads at once.
+using HeightRowSource = std::function<void(int y, float* row)>;
+
+// Writes a width x height map, read row by row, as a tiled height map of tileSize texel tiles.
+// Prints a summary; returns false if the file cannot be written.
+bool writeTiledHeightMap(const std::string& path, int width, int height, unsigned int tileSize,
+                         const HeightRowSource& readRow);
+
+// Splits a 24 bpp height map BMP into a tiled height map of tileSize texel tiles, one row of tiles at a time.
+// Headless; returns a process exit code.
+int runMakeTiles(const char* bmpPath, const char* path, unsigned int tileSize);
+
+#endif
@@ -0,0 +1,53 @@
+#ifndef TRIPLE_BUFFER_HPP
+#define TRIPLE_BUFFER_HPP
+
+#include <atomic>
+#include <cstdint>
+
+// Lock-free single writer, single reader hand-over of the latest value. The writer fills back() and publishes it;
+// the reader picks up the most recent publication with update() and reads front(). Neither ever waits: the
+// writer and the reader each own one slot and swap it with the shared third, so values published in between two
+// updates are skipped rather than queued.
+template<typename T>
+class TripleBuffer {
+public:
+    // Writer only
+    T& back() {
+        return slots[backIndex];
+    }
+
+    // Writer only: hands back() over to the reader; back() is then another slot to fill
+    void publish() {
+        const std::uint8_t previous = shared.exchange(static_cast<std::uint8_t>(backIndex | freshBit),
+                                                      std::memory_order_acq_rel);
+        backIndex = static_cast<std::uint8_t>(previous & indexMask);
+    }
+
+    // Reader only: moves the latest publication to front(), returns false if nothing was published since
+    bool update() {
+        if ((shared.load(std::memory_order_relaxed) & freshBit) == 0) {
+            return false;
+        }
+        const std::uint8_t previous = shared.exchange(frontIndex, std::memory_order_acq_rel);
+        frontIndex = static_cast<std::uint8_t>(previous & indexMask);
+        return true;
+    }
+
+    // Reader only
+    const T& front() const {
+        return slots[frontIndex];
+    }
+
+private:
+    static constexpr std::uint8_t indexMask = 3;
+    // Set on the shared slot index while the reader has not picked it up
+    static constexpr std::uint8_t freshBit = 4;
+
+    T slots[3] = {};
+    // Slot indices: the writer's, the one in between and the reader's
+    std::uint8_t backIndex = 0;
+    alignas(64) std::atomic<std::uint8_t> shared{1};
+    alignas(64) std::uint8_t frontIndex = 2;
+};
+
+#endif
@@ -0,0 +1,97 @@
+#include <cstring>
+#include <iostream>
+
+#include "uniform_ring.hpp"
+
+// Longest wait for a slot the GPU is still reading, in nanoseconds
+static constexpr GLuint64 fenceTimeout = 1000000000;
+
+UniformRing::UniformRing(const GLuint binding, const std::size_t blockSize, const unsigned int slotCount)
+    : binding(binding), blockSize(blockSize), slotCount(slotCount), fences(slotCount, nullptr),
+      lastBlock(blockSize) {
+}
+
+void UniformRing::create() {
+    // Slots start at multiples of the uniform buffer offset alignment
+    GLint alignment = 256;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+    const auto align = static_cast<std::size_t>(alignment);
+    slotStride = (blockSize + align - 1) / align * align;
+    const auto bufferSize = static_cast<GLsizeiptr>(slotStride * slotCount);
+
+    glGenBuffers(1, &buffer);
+    glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+    if (GLEW_ARB_buffer_storage) {
+        const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glBufferStorage(GL_UNIFORM_BUFFER, bufferSize, nullptr, flags);
+        mapping = static_cast<unsigned char*>(glMapBufferRange(GL_UNIFORM_BUFFER, 0, bufferSize, flags));
+    } else {
+        glBufferData(GL_UNIFORM_BUFFER, bufferSize, nullptr, GL_STREAM_DRAW);
+    }
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+bool UniformRing::update(const void* block) {
+    if (hasLastBlock && std::memcmp(block, lastBlock.data(), blockSize) == 0) {
+        return false;
+    }
+    if (buffer == 0) {
+        create();
+    }
+
+    // Fence everything issued with the current slot bound, then move on to the next one
+    if (slotInUse) {
+        fences[slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        slot = (slot + 1) % slotCount;
+    }
+    if (fences[slot] != nullptr) {
+        const GLenum status = glClientWaitSync(fences[slot], GL_SYNC_FLUSH_COMMANDS_BIT, fenceTimeout);
+        if (status == GL_TIMEOUT_EXPIRED || status == GL_WAIT_FAILED) {
+            std::cerr << "Uniform buffer slot still in use after waiting" << std::endl;
+        }
+        glDeleteSync(fences[slot]);
+        fences[slot] = nullptr;
+    }
+
+    const std::size_t offset = slot * slotStride;
+    if (mapping != nullptr) {
+        std::memcpy(mapping + offset, block, blockSize);
+    } else {
+        glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+        glBufferSubData(GL_UNIFORM_BUFFER, static_cast<GLintptr>(offset), static_cast<GLsizeiptr>(blockSize), block);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    }
+    glBindBufferRange(GL_UNIFORM_BUFFER, binding, buffer, static_cast<GLintptr>(offset),
+                      static_cast<GLsizeiptr>(blockSize));
+
+    slotInUse = true;
+    std::memcpy(lastBlock.data(), block, blockSize);
+    hasLastBlock = true;
+    return true;
+}
+
+void UniformRing::invalidate() {
+    hasLastBlock = false;
+}
+
+void UniformRing::destroy() {
+    for (auto& fence : fences) {
+        if (fence != nullptr) {
+            glDeleteSync(fence);
+            fence = nullptr;
+        }
+    }
+    if (buffer != 0) {
+        if (mapping != nullptr) {
+            glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+            glUnmapBuffer(GL_UNIFORM_BUFFER);
+            glBindBuffer(GL_UNIFORM_BUFFER, 0);
+            mapping = nullptr;
+        }
+        glDeleteBuffers(1, &buffer);
+        buffer = 0;
+    }
+    slot = 0;
+    slotInUse = false;
+    hasLastBlock = false;
+}
@@ -0,0 +1,50 @@
+#ifndef UNIFORM_RING_HPP
+#define UNIFORM_RING_HPP
+
+#include <cstddef>
+#include <vector>
+
+#include <GL/glew.h>
+
+// One uniform block's values, streamed through a ring of slots in a single uniform buffer.
+// Each change goes to the next slot, so the CPU never overwrites values the GPU may still be reading;
+// unchanged values are not sent at all. Slots are persistently mapped when ARB_buffer_storage is available.
+class UniformRing {
+public:
+    UniformRing(GLuint binding, std::size_t blockSize, unsigned int slotCount = 3);
+
+    UniformRing(const UniformRing&) = delete;
+    UniformRing& operator=(const UniformRing&) = delete;
+
+    // Uploads blockSize bytes of block into the next slot and binds it, unless they equal the last upload.
+    // Returns whether anything was uploaded. GL thread only.
+    bool update(const void* block);
+
+    // Forgets the last upload, so the next update always sends its values
+    void invalidate();
+
+    // Releases the buffer. Call on the GL thread before the context goes away.
+    void destroy();
+
+private:
+    void create();
+
+    GLuint binding;
+    std::size_t blockSize;
+    std::size_t slotStride = 0;
+    unsigned int slotCount;
+    unsigned int slot = 0;
+
+    GLuint buffer = 0;
+    unsigned char* mapping = nullptr;
+    // Signalled once the GPU is done with the commands issued while each slot was bound
+    std::vector<GLsync> fences;
+
+    // Whether the current slot has been bound for drawing
+    bool slotInUse = false;
+
+    std::vector<unsigned char> lastBlock;
+    bool hasLastBlock = false;
+};
+
+#endif
@@ -0,0 +1,35 @@
+#include <algorithm>
+#include <cmath>
+
+#include "parallel.hpp"
+#include "vertex_format.hpp"
+
+// Vertices per chunk when quantising in parallel
+static constexpr std::size_t minVerticesPerChunk = 1 << 16;
+
+static glm::u16 unorm16(const float value) {
+    return static_cast<glm::u16>(std::lround(std::clamp(value, 0.0f, 1.0f) * 65535.0f));
+}
+
+CompactVertexDecode packCompactVertices(const TerrainMesh& mesh, const float scale, const glm::i16vec4& qtangent,
+                                        std::vector<CompactVertex>& vertices) {
+    // Grid uvs overshoot 1 by half a cell, the largest one is the last vertex
+    const CompactVertexDecode decode = {scale, std::max(mesh.uvs.back().x, mesh.uvs.back().y)};
+    const float positionToUnorm = 0.5f / scale;
+    const float uvToUnorm = 1.0f / decode.uvRange;
+
+    vertices.resize(mesh.vertices.size());
+    parallelFor(0, mesh.vertices.size(), [&](const std::size_t begin, const std::size_t end) {
+        for (std::size_t i = begin; i < end; i++) {
+            const glm::vec3& position = mesh.vertices[i];
+            const glm::vec2& uv = mesh.uvs[i];
+            vertices[i] = {
+                {unorm16(position.x * positionToUnorm + 0.5f), unorm16(position.z * positionToUnorm + 0.5f)},
+                {unorm16(uv.x * uvToUnorm), unorm16(uv.y * uvToUnorm)},
+                qtangent
+            };
+        }
+    }, minVerticesPerChunk);
+
+    return decode;
+}
@@ -0,0 +1,34 @@
+#ifndef VERTEX_FORMAT_HPP
+#define VERTEX_FORMAT_HPP
+
+#include <vector>
+
+#include <glm/gtc/type_precision.hpp>
+
+#include "terrain_mesh_builder.hpp"
+
+// Bytes per vertex of the float layout: vec3 position, vec2 uv, vec3 tangent, vec3 bitangent
+constexpr std::size_t floatVertexSize = sizeof(glm::vec3) + sizeof(glm::vec2) + 2 * sizeof(glm::vec3);
+
+// Quantised, interleaved terrain vertex
+struct CompactVertex {
+    // unorm16 x & z, 0 and 1 map to -scale and scale
+    glm::u16vec2 position;
+    // unorm16 u & v, 1 maps to CompactVertexDecode::uvRange
+    glm::u16vec2 uv;
+    // snorm16 QTangent, see packQTangent
+    glm::i16vec4 qtangent;
+};
+static_assert(sizeof(CompactVertex) == 16, "CompactVertex must stay tightly packed");
+
+// Constants the vertex shader needs to expand a CompactVertex
+struct CompactVertexDecode {
+    float scale;
+    float uvRange;
+};
+
+// Quantises mesh positions & uvs and interleaves them with a single QTangent shared by every vertex
+CompactVertexDecode packCompactVertices(const TerrainMesh& mesh, float scale, const glm::i16vec4& qtangent,
+                                        std::vector<CompactVertex>& vertices);
+
+#endif